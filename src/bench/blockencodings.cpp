@@ -0,0 +1,68 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <blockencodings.h>
+#include <consensus/amount.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/script.h>
+#include <sync.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <cassert>
+#include <vector>
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    LockPoints lp;
+    pool.addUnchecked(CTxMemPoolEntry(tx, /*fee=*/1000, /*time=*/0, /*entry_height=*/1, /*spends_coinbase=*/false, /*sigops_cost=*/4, lp));
+}
+
+/** Match the short IDs of a 2500 transaction compact block against a mempool of 100000, all but 10 of which are not in the block. */
+static void CompactBlockReconstruction(benchmark::Bench& bench)
+{
+    static constexpr int MEMPOOL_TXS{100000};
+    static constexpr int BLOCK_TXS{2500};
+    static constexpr int MISSING_TXS{10};
+
+    FastRandomContext det_rand{/*fDeterministic=*/true};
+    CTxMemPool pool;
+    CBlock block;
+    block.nBits = 0x207fffff;
+    {
+        LOCK2(cs_main, pool.cs);
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].scriptSig = CScript() << OP_1 << OP_1;
+        coinbase.vout.resize(1);
+        block.vtx.push_back(MakeTransactionRef(coinbase));
+        for (int i = 0; i < MEMPOOL_TXS + MISSING_TXS; ++i) {
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout = COutPoint{det_rand.rand256(), 0};
+            tx.vin[0].scriptWitness.stack.push_back({1});
+            tx.vout.resize(1);
+            tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+            tx.vout[0].nValue = i;
+            const CTransactionRef tx_r{MakeTransactionRef(tx)};
+            if (i < MEMPOOL_TXS) AddTx(tx_r, pool);
+            if (i >= MEMPOOL_TXS + MISSING_TXS - BLOCK_TXS) block.vtx.push_back(tx_r);
+        }
+    }
+    const CBlockHeaderAndShortTxIDs cmpctblock{block, /*fUseWTXID=*/true};
+    const std::vector<std::pair<uint256, CTransactionRef>> extra_txn;
+
+    bench.run([&] {
+        PartiallyDownloadedBlock partial_block{&pool};
+        const ReadStatus status{partial_block.InitData(cmpctblock, extra_txn)};
+        assert(status == READ_STATUS_OK);
+        assert(!partial_block.IsTxAvailable(block.vtx.size() - 1));
+        assert(partial_block.IsTxAvailable(1));
+    });
+}
+
+BENCHMARK(CompactBlockReconstruction);
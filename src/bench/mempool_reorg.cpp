@@ -0,0 +1,107 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/policy.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <set>
+#include <vector>
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    int64_t nTime = 0;
+    unsigned int nHeight = 1;
+    bool spendsCoinbase = false;
+    unsigned int sigOpCost = 4;
+    LockPoints lp;
+    pool.addUnchecked(CTxMemPoolEntry(tx, 1000, nTime, nHeight, spendsCoinbase, sigOpCost, lp));
+}
+
+static CTransactionRef MakeTx(const std::vector<COutPoint>& prevouts, size_t n_outputs)
+{
+    CMutableTransaction tx;
+    for (const COutPoint& prevout : prevouts) {
+        tx.vin.emplace_back(prevout);
+        tx.vin.back().scriptWitness.stack.push_back({1});
+    }
+    tx.vout.resize(n_outputs);
+    for (auto& out : tx.vout) {
+        out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        out.nValue = COIN;
+    }
+    return MakeTransactionRef(tx);
+}
+
+static COutPoint RandomOutPoint(FastRandomContext& det_rand)
+{
+    return COutPoint(det_rand.rand256(), 0);
+}
+
+/** Disconnect (and reconnect) the last REORG_BLOCKS blocks with a mempool of
+ * MEMPOOL_BYTES. Some transactions of the disconnected blocks have
+ * descendants in the mempool, which UpdateTransactionsFromBlock has to link
+ * up and account for. */
+static void MempoolReorg(benchmark::Bench& bench)
+{
+    static constexpr int REORG_BLOCKS{3};
+    static constexpr int BLOCK_TXS{2000};
+    static constexpr size_t MEMPOOL_BYTES{300 * 1000 * 1000};
+
+    FastRandomContext det_rand{true};
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>(CBaseChainParams::MAIN);
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+
+    // Transactions of the disconnected blocks. Some spend an output of an
+    // earlier transaction in the same or a previous block. Output 0 of each is
+    // left for an in-mempool child, output 1 for an in-mempool grandchild and
+    // output 2 for a later block transaction.
+    std::vector<std::vector<CTransactionRef>> blocks(REORG_BLOCKS);
+    std::vector<CTransactionRef> block_txs;
+    std::set<size_t> spent_by_block, spent_by_mempool;
+    for (auto& block : blocks) {
+        for (int i = 0; i < BLOCK_TXS; ++i) {
+            COutPoint prevout = RandomOutPoint(det_rand);
+            if (!block_txs.empty() && det_rand.randrange(8) == 0) {
+                const size_t parent = det_rand.randrange(block_txs.size());
+                if (spent_by_block.insert(parent).second) prevout = COutPoint(block_txs[parent]->GetHash(), 2);
+            }
+            block.push_back(MakeTx({prevout}, 3));
+            block_txs.push_back(block.back());
+        }
+    }
+    for (const auto& tx : block_txs) AddTx(tx, pool);
+
+    // In-mempool descendants: a child of every fourth block transaction, and
+    // every so often a grandchild also spending another block transaction.
+    for (size_t i = 0; i < block_txs.size(); i += 4) {
+        const CTransactionRef child = MakeTx({COutPoint(block_txs[i]->GetHash(), 0)}, 2);
+        AddTx(child, pool);
+        const size_t other = det_rand.randrange(block_txs.size());
+        if (det_rand.randrange(4) == 0 && spent_by_mempool.insert(other).second) {
+            AddTx(MakeTx({COutPoint(child->GetHash(), 0), COutPoint(block_txs[other]->GetHash(), 1)}, 2), pool);
+        }
+    }
+
+    // Unrelated transactions to fill the mempool.
+    while (pool.DynamicMemoryUsage() < MEMPOOL_BYTES) {
+        AddTx(MakeTx({RandomOutPoint(det_rand)}, 2), pool);
+    }
+
+    std::vector<uint256> hashes_to_update;
+    for (const auto& tx : block_txs) hashes_to_update.push_back(tx->GetHash());
+
+    bench.run([&]() NO_THREAD_SAFETY_ANALYSIS {
+        for (int i = 0; i < REORG_BLOCKS; ++i) {
+            pool.removeForBlock(blocks[i], i + 1);
+        }
+        for (const auto& tx : block_txs) AddTx(tx, pool);
+        pool.UpdateTransactionsFromBlock(hashes_to_update, DEFAULT_ANCESTOR_SIZE_LIMIT * 1000, DEFAULT_ANCESTOR_LIMIT);
+    });
+}
+
+BENCHMARK(MempoolReorg);
@@ -0,0 +1,63 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/script.h>
+#include <txorphanage.h>
+#include <uint256.h>
+
+#include <cassert>
+#include <set>
+#include <vector>
+
+/**
+ * A chain of 100 orphans, each spending one of the 10 outputs of the one
+ * before, arrives child first. Once the parent of the whole chain is accepted,
+ * every orphan in turn is looked up, accepted and erased, and its children
+ * added to the work set.
+ */
+static void OrphanageResolveChain(benchmark::Bench& bench)
+{
+    static constexpr int CHAIN_LENGTH{100};
+    static constexpr int NUM_OUTPUTS{10};
+
+    FastRandomContext det_rand{/*fDeterministic=*/true};
+    CMutableTransaction parent;
+    parent.vin.resize(1);
+    parent.vin[0].prevout = COutPoint{det_rand.rand256(), 0};
+    parent.vout.resize(NUM_OUTPUTS);
+    std::vector<CTransactionRef> chain{MakeTransactionRef(parent)};
+    for (int i = 0; i < CHAIN_LENGTH; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint{chain.back()->GetHash(), uint32_t(i % NUM_OUTPUTS)};
+        tx.vout.resize(NUM_OUTPUTS);
+        for (auto& out : tx.vout) out.scriptPubKey = CScript() << OP_TRUE;
+        chain.push_back(MakeTransactionRef(tx));
+    }
+
+    TxOrphanage orphanage;
+    bench.batch(CHAIN_LENGTH).unit("orphan").run([&] {
+        for (int i = CHAIN_LENGTH; i > 0; --i) orphanage.AddTx(chain[i], /*peer=*/0);
+
+        std::set<uint256> orphan_work_set;
+        orphanage.AddChildrenToWorkSet(*chain[0], orphan_work_set);
+        int resolved{0};
+        while (!orphan_work_set.empty()) {
+            const uint256 txid{*orphan_work_set.begin()};
+            orphan_work_set.erase(orphan_work_set.begin());
+            const auto [tx, from_peer] = orphanage.GetTx(txid);
+            if (!tx) continue;
+            orphanage.AddChildrenToWorkSet(*tx, orphan_work_set);
+            orphanage.EraseTx(txid);
+            ++resolved;
+        }
+        assert(resolved == CHAIN_LENGTH);
+        assert(orphanage.Size() == 0);
+    });
+}
+
+BENCHMARK(OrphanageResolveChain);
@@ -0,0 +1,154 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <net.h>
+#include <net_processing.h>
+#include <netmessagemaker.h>
+#include <protocol.h>
+#include <random.h>
+#include <test/util/net.h>
+#include <test/util/setup_common.h>
+#include <test/util/validation.h>
+#include <version.h>
+
+#include <cassert>
+#include <list>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * Have 8 inbound peers each announce 2000 transactions in 40 inv messages, and
+ * let the message handler loop of CConnman process them on `num_threads`
+ * threads, as with -msghandthreads. All the transactions are announced again
+ * on every run, so the cost is in parsing the messages and looking up the
+ * announcements rather than in growing the download state.
+ */
+static void ProcessInvMessages(benchmark::Bench& bench, int num_threads)
+{
+    static constexpr int NUM_PEERS{8};
+    static constexpr int INVS_PER_PEER{40};
+    static constexpr int TXS_PER_INV{50};
+
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    const auto& node = testing_setup->m_node;
+    static_cast<TestChainState&>(node.chainman->ActiveChainstate()).JumpOutOfIbd();
+    ConnmanTestMsg connman{0x1337, 0x1337, *node.addrman};
+    const auto peerman = PeerManager::make(Params(), connman, *node.addrman, /*banman=*/nullptr,
+                                           *node.chainman, *node.mempool, /*ignore_incoming_txs=*/false);
+    CConnman::Options options;
+    options.m_msgproc = peerman.get();
+    options.nSendBufferMaxSize = 1000 * DEFAULT_MAXSENDBUFFER;
+    options.nReceiveFloodSize = 1000 * DEFAULT_MAXRECEIVEBUFFER;
+    options.m_num_msghand_threads = num_threads;
+    connman.Init(options);
+
+    FastRandomContext det_rand{/*fDeterministic=*/true};
+    std::vector<CNode*> peers;
+    std::vector<std::vector<std::vector<unsigned char>>> invs(NUM_PEERS);
+    for (NodeId id = 0; id < NUM_PEERS; ++id) {
+        peers.push_back(new CNode{id, NODE_NETWORK, /*sock=*/nullptr, CAddress{}, /*nKeyedNetGroupIn=*/0,
+                                  /*nLocalHostNonceIn=*/0, CAddress{}, /*addrNameIn=*/"",
+                                  ConnectionType::INBOUND, /*inbound_onion=*/false});
+        CNode& peer{*peers.back()};
+        peer.SetCommonVersion(PROTOCOL_VERSION);
+        peerman->InitializeNode(&peer);
+        peer.fSuccessfullyConnected = true;
+        connman.AddTestNode(peer);
+        for (int i = 0; i < INVS_PER_PEER; ++i) {
+            std::vector<CInv> inv;
+            for (int j = 0; j < TXS_PER_INV; ++j) inv.emplace_back(MSG_TX, det_rand.rand256());
+            invs[id].push_back(CNetMsgMaker{PROTOCOL_VERSION}.Make(NetMsgType::INV, inv).data);
+        }
+    }
+
+    connman.StartMessageHandlers();
+    bench.batch(NUM_PEERS * INVS_PER_PEER * TXS_PER_INV).unit("inv").run([&] {
+        for (NodeId id = 0; id < NUM_PEERS; ++id) {
+            // Nothing is sent to the peers, so drop the getdata messages queued for them.
+            {
+                LOCK(peers[id]->cs_vSend);
+                peers[id]->vSendMsg.clear();
+                peers[id]->nSendSize = 0;
+                peers[id]->fPauseSend = false;
+            }
+            for (const auto& data : invs[id]) {
+                CSerializedNetMsg msg;
+                msg.m_type = NetMsgType::INV;
+                msg.data = data;
+                connman.ReceiveMsgFrom(*peers[id], msg);
+            }
+        }
+        connman.WakeMessageHandler();
+        // Wait until every message was taken off the queues, and the threads
+        // are done processing them.
+        for (CNode* peer : peers) {
+            while (WITH_LOCK(peer->cs_vProcessMsg, return !peer->vProcessMsg.empty())) {
+                std::this_thread::yield();
+            }
+            LOCK(peer->m_msgproc_mutex);
+        }
+    });
+    connman.StopMessageHandlers();
+
+    for (CNode* peer : peers) peerman->FinalizeNode(*peer);
+    connman.ClearTestNodes();
+}
+
+/**
+ * Have a peer send 500 tx messages of 250 bytes in one go, and hand their
+ * buffers back once done with them, like the message handler does.
+ */
+static void ReceiveTxMessages(benchmark::Bench& bench)
+{
+    static constexpr int NUM_MSGS{500};
+    static constexpr size_t MSG_SIZE{250};
+
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    ConnmanTestMsg connman{0x1337, 0x1337, *testing_setup->m_node.addrman};
+    CNode peer{/*id=*/0, NODE_NETWORK, /*sock=*/nullptr, CAddress{}, /*nKeyedNetGroupIn=*/0,
+               /*nLocalHostNonceIn=*/0, CAddress{}, /*addrNameIn=*/"",
+               ConnectionType::INBOUND, /*inbound_onion=*/false};
+
+    FastRandomContext det_rand{/*fDeterministic=*/true};
+    std::vector<uint8_t> wire;
+    for (int i = 0; i < NUM_MSGS; ++i) {
+        CSerializedNetMsg msg;
+        msg.m_type = NetMsgType::TX;
+        msg.data = det_rand.randbytes(MSG_SIZE);
+        std::vector<unsigned char> header;
+        peer.m_serializer->prepareForTransport(msg, header);
+        wire.insert(wire.end(), header.begin(), header.end());
+        wire.insert(wire.end(), msg.data.begin(), msg.data.end());
+    }
+
+    bench.batch(NUM_MSGS).unit("msg").run([&] {
+        bool complete;
+        connman.NodeReceiveMsgBytes(peer, wire, complete);
+        std::list<CNetMessage> msgs;
+        {
+            LOCK(peer.cs_vProcessMsg);
+            msgs.swap(peer.vProcessMsg);
+            peer.nProcessQueueSize = 0;
+        }
+        assert(msgs.size() == NUM_MSGS);
+        for (CNetMessage& msg : msgs) {
+            assert(msg.m_recv.size() == MSG_SIZE);
+            peer.m_recv_buffers.Put(std::move(msg.m_recv));
+        }
+    });
+}
+
+static void ProcessInvMessages1Thread(benchmark::Bench& bench) { ProcessInvMessages(bench, 1); }
+static void ProcessInvMessages2Threads(benchmark::Bench& bench) { ProcessInvMessages(bench, 2); }
+static void ProcessInvMessages4Threads(benchmark::Bench& bench) { ProcessInvMessages(bench, 4); }
+static void ProcessInvMessages8Threads(benchmark::Bench& bench) { ProcessInvMessages(bench, 8); }
+
+BENCHMARK(ProcessInvMessages1Thread);
+BENCHMARK(ProcessInvMessages2Threads);
+BENCHMARK(ProcessInvMessages4Threads);
+BENCHMARK(ProcessInvMessages8Threads);
+BENCHMARK(ReceiveTxMessages);
@@ -0,0 +1,54 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/fees.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+
+#include <memory>
+#include <vector>
+
+/** Confirm a block of 4000 tracked transactions, with feerates spread over
+ * the estimator's buckets. The transactions are tracked by a new estimator
+ * first, as they would be when they entered the mempool. */
+static void PolicyEstimatorProcessBlock(benchmark::Bench& bench)
+{
+    static constexpr unsigned int NUM_TXS{4000};
+    static constexpr unsigned int HEIGHT{100};
+
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+
+    std::vector<CTxMemPoolEntry> entries;
+    entries.reserve(NUM_TXS);
+    TestMemPoolEntryHelper entry;
+    for (unsigned int i = 0; i < NUM_TXS; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.n = i;
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = COIN;
+        entries.push_back(entry.Fee(1000 + 37 * i).Height(HEIGHT).FromTx(tx));
+    }
+    std::vector<const CTxMemPoolEntry*> block_entries;
+    for (const CTxMemPoolEntry& e : entries) {
+        block_entries.push_back(&e);
+    }
+
+    bench.run([&] {
+        auto estimator{std::make_unique<CBlockPolicyEstimator>()};
+        std::vector<const CTxMemPoolEntry*> no_entries;
+        estimator->processBlock(HEIGHT, no_entries);
+        for (const CTxMemPoolEntry& e : entries) {
+            estimator->processTransaction(e, /*validFeeEstimate=*/true);
+        }
+        estimator->processBlock(HEIGHT + 1, block_entries);
+    });
+}
+
+BENCHMARK(PolicyEstimatorProcessBlock);
@@ -0,0 +1,65 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <compat.h>
+#include <util/sock.h>
+#include <util/sock_events.h>
+#include <util/system.h>
+
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+/** Wait for 1000 registered sockets, 10 of which have data to receive, like
+ * the socket handler thread of a node with many mostly idle peers does. */
+static void SockEventsWait(benchmark::Bench& bench, SockEventsBackend backend)
+{
+#ifndef WIN32
+    static constexpr size_t NUM_SOCKETS{1000};
+    static constexpr size_t NUM_READY{10};
+
+    const std::unique_ptr<SockEvents> sock_events{MakeSockEvents(backend)};
+    if (!sock_events) return; // not available on this platform
+    if (RaiseFileDescriptorLimit(2 * NUM_SOCKETS + 100) < int{2 * NUM_SOCKETS + 100}) return;
+
+    // Each mock socket is one end of a socket pair; the other end is used to make it ready.
+    std::vector<Sock> socks;
+    socks.reserve(2 * NUM_SOCKETS);
+    for (size_t i = 0; i < NUM_SOCKETS; ++i) {
+        int s[2];
+        const int ret{socketpair(AF_UNIX, SOCK_STREAM, 0, s)};
+        assert(ret == 0);
+        socks.emplace_back(s[0]);
+        socks.emplace_back(s[1]);
+        const bool registered{sock_events->Set(&socks[2 * i], socks[2 * i].Get(), Sock::RECV)};
+        assert(registered);
+    }
+    for (size_t i = 0; i < NUM_READY; ++i) {
+        const ssize_t sent{socks[2 * i * (NUM_SOCKETS / NUM_READY) + 1].Send("a", 1, 0)};
+        assert(sent == 1);
+    }
+
+    std::vector<SockEvents::Ready> ready;
+    bench.run([&] {
+        const bool waited{sock_events->Wait(0ms, ready)};
+        assert(waited && ready.size() == NUM_READY);
+    });
+
+    for (size_t i = 0; i < NUM_SOCKETS; ++i) {
+        sock_events->Remove(&socks[2 * i]);
+    }
+#endif // WIN32
+}
+
+static void SockEventsWaitSelect(benchmark::Bench& bench) { SockEventsWait(bench, SockEventsBackend::SELECT); }
+static void SockEventsWaitPoll(benchmark::Bench& bench) { SockEventsWait(bench, SockEventsBackend::POLL); }
+static void SockEventsWaitEpoll(benchmark::Bench& bench) { SockEventsWait(bench, SockEventsBackend::EPOLL); }
+
+BENCHMARK(SockEventsWaitSelect);
+BENCHMARK(SockEventsWaitPoll);
+BENCHMARK(SockEventsWaitEpoll);
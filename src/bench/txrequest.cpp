@@ -0,0 +1,57 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <txrequest.h>
+#include <uint256.h>
+
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+/**
+ * 1000 peers, 8 of them preferred, each announcing 5000 transactions per second (so every transaction is announced
+ * by every peer). Every run covers 50ms: the 250 transactions of that time are announced, requested from the best
+ * peer, and received.
+ */
+static void TxRequestAnnouncements(benchmark::Bench& bench)
+{
+    static constexpr int NUM_PEERS{1000};
+    static constexpr int NUM_PREFERRED{8};
+    static constexpr int TXS_PER_RUN{250};
+    static constexpr std::chrono::microseconds RUN_TIME{50000};
+    static constexpr std::chrono::microseconds NONPREF_PEER_TX_DELAY{2000000};
+    static constexpr std::chrono::microseconds GETDATA_TX_INTERVAL{60000000};
+
+    TxRequestTracker tracker;
+    FastRandomContext rng{/*fDeterministic=*/true};
+    std::chrono::microseconds now{1000000000};
+    std::vector<uint256> txhashes(TXS_PER_RUN);
+
+    bench.batch(NUM_PEERS * TXS_PER_RUN).unit("inv").run([&] {
+        for (uint256& txhash : txhashes) txhash = rng.rand256();
+        for (NodeId peer = 0; peer < NUM_PEERS; ++peer) {
+            const bool preferred{peer < NUM_PREFERRED};
+            for (const uint256& txhash : txhashes) {
+                tracker.ReceivedInv(peer, GenTxid::Wtxid(txhash), preferred, preferred ? now : now + NONPREF_PEER_TX_DELAY);
+            }
+        }
+        int requested{0};
+        for (NodeId peer = 0; peer < NUM_PEERS; ++peer) {
+            for (const GenTxid& gtxid : tracker.GetRequestable(peer, now)) {
+                tracker.RequestedTx(peer, gtxid.GetHash(), now + GETDATA_TX_INTERVAL);
+                tracker.ReceivedResponse(peer, gtxid.GetHash());
+                tracker.ForgetTxHash(gtxid.GetHash());
+                ++requested;
+            }
+        }
+        assert(requested == TXS_PER_RUN);
+        assert(tracker.Size() == 0);
+        now += RUN_TIME;
+    });
+}
+
+BENCHMARK(TxRequestAnnouncements);
@@ -0,0 +1,69 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <consensus/validation.h>
+#include <script/sigcache.h>
+#include <script/sign.h>
+#include <script/signingprovider.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <cassert>
+#include <vector>
+
+/** Load a mempool.dat of 2000 signed transactions (1000 parents with one child
+ * each) into an empty mempool. The signature and script execution caches are
+ * reset before every load, as they would be after a restart. */
+static void ValidationLoadMempool(benchmark::Bench& bench)
+{
+    static constexpr size_t NUM_PARENTS{1000};
+
+    TestChain100Setup test_setup{{"-nodebuglogfile", "-nodebug"}};
+    const CScript p2pk = CScript() << ToByteVector(test_setup.coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    FillableSigningProvider keystore;
+    keystore.AddKey(test_setup.coinbaseKey);
+
+    // Confirm a transaction with an output for each parent.
+    CMutableTransaction fan_out;
+    fan_out.vin.emplace_back(COutPoint(test_setup.m_coinbase_txns[0]->GetHash(), 0));
+    fan_out.vout.assign(NUM_PARENTS, CTxOut(4 * CENT, p2pk));
+    SignSignature(keystore, *test_setup.m_coinbase_txns[0], fan_out, 0, SIGHASH_ALL);
+    test_setup.CreateAndProcessBlock({fan_out}, p2pk);
+    const CTransaction fan_out_tx{fan_out};
+
+    CTxMemPool& pool = *test_setup.m_node.mempool;
+    CChainState& chainstate = test_setup.m_node.chainman->ActiveChainstate();
+    {
+        LOCK(cs_main);
+        for (uint32_t i = 0; i < NUM_PARENTS; ++i) {
+            CMutableTransaction parent;
+            parent.vin.emplace_back(COutPoint(fan_out_tx.GetHash(), i));
+            parent.vout.assign(1, CTxOut(3 * CENT, p2pk));
+            SignSignature(keystore, fan_out_tx, parent, 0, SIGHASH_ALL);
+            const CTransactionRef parent_tx = MakeTransactionRef(parent);
+            AcceptToMemoryPool(chainstate, parent_tx, GetTime(), /*bypass_limits=*/false, /*test_accept=*/false);
+
+            CMutableTransaction child;
+            child.vin.emplace_back(COutPoint(parent_tx->GetHash(), 0));
+            child.vout.assign(1, CTxOut(2 * CENT, p2pk));
+            SignSignature(keystore, *parent_tx, child, 0, SIGHASH_ALL);
+            AcceptToMemoryPool(chainstate, MakeTransactionRef(child), GetTime(), /*bypass_limits=*/false, /*test_accept=*/false);
+        }
+    }
+    assert(pool.size() == 2 * NUM_PARENTS);
+    const bool dumped{DumpMempool(pool, fsbridge::fopen, /*skip_file_commit=*/true)};
+    assert(dumped);
+
+    bench.run([&] {
+        pool.clear();
+        InitSignatureCache();
+        InitScriptExecutionCache();
+        LoadMempool(pool, chainstate);
+        assert(pool.size() == 2 * NUM_PARENTS);
+    });
+}
+
+BENCHMARK(ValidationLoadMempool);
@@ -14,6 +14,7 @@
 #include <validation.h>
 #include <util/system.h>
 
+#include <array>
 #include <unordered_map>
 
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
@@ -102,11 +103,22 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     if (shorttxids.size() != cmpctblock.shorttxids.size())
         return READ_STATUS_FAILED; // Short ID collision
 
+    // Most mempool transactions are not in the block. Rule out nearly all of
+    // them by their short ID's low bits, which are uniformly distributed, in a
+    // bitmap small enough to stay in cache, before looking them up.
+    size_t filter_size{1024};
+    while (filter_size < 16 * cmpctblock.shorttxids.size()) filter_size *= 2;
+    std::vector<bool> shortid_filter(filter_size);
+    for (const uint64_t shortid : cmpctblock.shorttxids) {
+        shortid_filter[shortid & (filter_size - 1)] = true;
+    }
+
     std::vector<bool> have_txn(txn_available.size());
     {
     LOCK(pool->cs);
-    for (size_t i = 0; i < pool->vTxHashes.size(); i++) {
-        uint64_t shortid = cmpctblock.GetShortID(pool->vTxHashes[i].first);
+    // Match the transaction with index i in vTxHashes. Returns whether to stop.
+    const auto match_mempool_tx = [&](size_t i, uint64_t shortid) EXCLUSIVE_LOCKS_REQUIRED(pool->cs) {
+        if (!shortid_filter[shortid & (filter_size - 1)]) return false;
         std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
         if (idit != shorttxids.end()) {
             if (!have_txn[idit->second]) {
@@ -126,8 +138,25 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
         // Though ideally we'd continue scanning for the two-txn-match-shortid case,
         // the performance win of an early exit here is too good to pass up and worth
         // the extra risk.
-        if (mempool_count == shorttxids.size())
-            break;
+        return mempool_count == shorttxids.size();
+    };
+    // Compute the short IDs several at a time, which takes less time per transaction.
+    const size_t mempool_size{pool->vTxHashes.size()};
+    size_t i = 0;
+    bool done = false;
+    std::array<const uint256*, SIPHASH_LANES> lane_hashes;
+    std::array<uint64_t, SIPHASH_LANES> lane_shortids;
+    for (; !done && i + SIPHASH_LANES <= mempool_size; i += SIPHASH_LANES) {
+        for (size_t l = 0; l < SIPHASH_LANES; l++) {
+            lane_hashes[l] = &pool->vTxHashes[i + l].first;
+        }
+        SipHashUint256Lanes(cmpctblock.shorttxidk0, cmpctblock.shorttxidk1, lane_hashes, lane_shortids);
+        for (size_t l = 0; !done && l < SIPHASH_LANES; l++) {
+            done = match_mempool_tx(i + l, lane_shortids[l] & 0xffffffffffffL);
+        }
+    }
+    for (; !done && i < mempool_size; i++) {
+        done = match_mempool_tx(i, cmpctblock.GetShortID(pool->vTxHashes[i].first));
     }
     }
 
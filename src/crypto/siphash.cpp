@@ -4,6 +4,17 @@
 
 #include <crypto/siphash.h>
 
+#include <crypto/common.h>
+
+#include <compat/cpuid.h>
+
+static_assert(SIPHASH_LANES == 4);
+
+namespace siphash_avx2
+{
+void Uint256_4way(uint64_t k0, uint64_t k1, const unsigned char* val0, const unsigned char* val1, const unsigned char* val2, const unsigned char* val3, uint64_t* out);
+}
+
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
 
 #define SIPROUND do { \
@@ -171,3 +182,45 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+namespace {
+#if defined(ENABLE_AVX2) && defined(USE_ASM) && defined(HAVE_GETCPUID) && !defined(BUILD_BITCOIN_INTERNAL)
+bool HaveAVX2()
+{
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    const bool have_xsave = (ecx >> 27) & 1;
+    const bool have_avx = (ecx >> 28) & 1;
+    if (!have_xsave || !have_avx) return false;
+    // Check whether the OS has enabled AVX registers.
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    if ((a & 6) != 6) return false;
+    GetCPUID(7, 0, eax, ebx, ecx, edx);
+    return (ebx >> 5) & 1;
+}
+#endif
+
+void Uint256Lanes(uint64_t k0, uint64_t k1, const std::array<const uint256*, SIPHASH_LANES>& vals, std::array<uint64_t, SIPHASH_LANES>& out)
+{
+    for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+        out[l] = SipHashUint256(k0, k1, *vals[l]);
+    }
+}
+
+#if defined(ENABLE_AVX2) && defined(USE_ASM) && defined(HAVE_GETCPUID) && !defined(BUILD_BITCOIN_INTERNAL)
+void Uint256LanesAVX2(uint64_t k0, uint64_t k1, const std::array<const uint256*, SIPHASH_LANES>& vals, std::array<uint64_t, SIPHASH_LANES>& out)
+{
+    siphash_avx2::Uint256_4way(k0, k1, vals[0]->data(), vals[1]->data(), vals[2]->data(), vals[3]->data(), out.data());
+}
+
+const auto g_uint256_lanes{HaveAVX2() ? Uint256LanesAVX2 : Uint256Lanes};
+#else
+const auto g_uint256_lanes{Uint256Lanes};
+#endif
+} // namespace
+
+void SipHashUint256Lanes(uint64_t k0, uint64_t k1, const std::array<const uint256*, SIPHASH_LANES>& vals, std::array<uint64_t, SIPHASH_LANES>& out)
+{
+    g_uint256_lanes(k0, k1, vals, out);
+}
@@ -9,6 +9,9 @@
 
 #include <uint256.h>
 
+#include <array>
+#include <cstddef>
+
 /** SipHash-2-4 */
 class CSipHasher
 {
@@ -44,4 +47,14 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** Number of values SipHashUint256Lanes() hashes at once. */
+static constexpr size_t SIPHASH_LANES{4};
+
+/** SipHashUint256() of several values with the same key at once.
+ *
+ *  Where the CPU supports AVX2, the values are hashed in parallel, one per
+ *  64-bit lane of the vector registers.
+ */
+void SipHashUint256Lanes(uint64_t k0, uint64_t k1, const std::array<const uint256*, SIPHASH_LANES>& vals, std::array<uint64_t, SIPHASH_LANES>& out);
+
 #endif // BITCOIN_CRYPTO_SIPHASH_H
@@ -0,0 +1,78 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace siphash_avx2 {
+namespace {
+
+__m256i inline K(uint64_t x) { return _mm256_set1_epi64x(x); }
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline RotL(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - n)); }
+__m256i inline RotL32(__m256i x) { return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+__m256i inline RotL16(__m256i x) { return _mm256_shuffle_epi8(x, _mm256_setr_epi8(6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11, 12, 13, 6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11, 12, 13)); }
+
+/** One SipRound of four independent SipHash states. */
+void inline __attribute__((always_inline)) SipRound(__m256i& v0, __m256i& v1, __m256i& v2, __m256i& v3)
+{
+    v0 = Add(v0, v1); v1 = RotL(v1, 13); v1 = Xor(v1, v0);
+    v0 = RotL32(v0);
+    v2 = Add(v2, v3); v3 = RotL16(v3); v3 = Xor(v3, v2);
+    v0 = Add(v0, v3); v3 = RotL(v3, 21); v3 = Xor(v3, v0);
+    v2 = Add(v2, v1); v1 = RotL(v1, 17); v1 = Xor(v1, v2);
+    v2 = RotL32(v2);
+}
+
+} // namespace
+
+/** SipHashUint256() of four 32-byte values at once, one per 64-bit lane. */
+void Uint256_4way(uint64_t k0, uint64_t k1, const unsigned char* val0, const unsigned char* val1, const unsigned char* val2, const unsigned char* val3, uint64_t* out)
+{
+    // Transpose the values, so that d[i] holds the i-th (little endian) 64-bit word of each.
+    const __m256i r0 = _mm256_loadu_si256((const __m256i*)val0);
+    const __m256i r1 = _mm256_loadu_si256((const __m256i*)val1);
+    const __m256i r2 = _mm256_loadu_si256((const __m256i*)val2);
+    const __m256i r3 = _mm256_loadu_si256((const __m256i*)val3);
+    const __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+    const __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+    const __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+    const __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+    const __m256i d[4] = {
+        _mm256_permute2x128_si256(t0, t2, 0x20),
+        _mm256_permute2x128_si256(t1, t3, 0x20),
+        _mm256_permute2x128_si256(t0, t2, 0x31),
+        _mm256_permute2x128_si256(t1, t3, 0x31),
+    };
+
+    __m256i v0 = K(0x736f6d6570736575ULL ^ k0);
+    __m256i v1 = K(0x646f72616e646f6dULL ^ k1);
+    __m256i v2 = K(0x6c7967656e657261ULL ^ k0);
+    __m256i v3 = K(0x7465646279746573ULL ^ k1);
+
+    for (int i = 0; i < 4; ++i) {
+        v3 = Xor(v3, d[i]);
+        SipRound(v0, v1, v2, v3);
+        SipRound(v0, v1, v2, v3);
+        v0 = Xor(v0, d[i]);
+    }
+    v3 = Xor(v3, K(((uint64_t)4) << 59));
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    v0 = Xor(v0, K(((uint64_t)4) << 59));
+    v2 = Xor(v2, K(0xFF));
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+
+    _mm256_storeu_si256((__m256i*)out, Xor(Xor(v0, v1), Xor(v2, v3)));
+}
+
+} // namespace siphash_avx2
+
+#endif
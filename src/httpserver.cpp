@@ -21,6 +21,8 @@
 #include <util/threadnames.h>
 #include <util/translation.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <memory>
 #include <stdio.h>
@@ -41,6 +43,9 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** Maximum number of bytes of a chunked reply waiting to be sent, before writing more of it blocks */
+static constexpr size_t MAX_CHUNKED_REPLY_BUFFER{1 << 20};
+
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure
 {
@@ -512,7 +517,12 @@ HTTPRequest::HTTPRequest(struct evhttp_request* _req, bool _replySent) : req(_re
 
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (m_chunked_reply) {
+        // The reply was started already, so the best that can be done is
+        // to end it early.
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        WriteReplyEnd();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL_SERVER_ERROR, "Unhandled request");
@@ -593,6 +603,126 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = nullptr; // transferred back to main thread
 }
 
+/** State of a chunked reply, shared by the worker writing it and the main http thread. */
+struct HTTPChunkedReply {
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    //! Bytes of chunks handed to the main http thread, but not to libevent yet
+    size_t m_queued GUARDED_BY(m_mutex){0};
+    //! Bytes waiting in the connection's output buffer
+    size_t m_buffered GUARDED_BY(m_mutex){0};
+    //! Whether the connection was closed, which frees the request
+    bool m_closed GUARDED_BY(m_mutex){false};
+
+    //! The connection's output buffer and our callback on it, only used on the main http thread
+    evbuffer* m_output{nullptr};
+    evbuffer_cb_entry* m_output_cb{nullptr};
+
+    bool IsClosed() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        return WITH_LOCK(m_mutex, return m_closed);
+    }
+
+    void StopWatchingOutput()
+    {
+        if (m_output_cb) evbuffer_remove_cb_entry(m_output, m_output_cb);
+        m_output_cb = nullptr;
+    }
+};
+
+void HTTPRequest::WriteReplyStart(int nStatus)
+{
+    assert(!replySent && req && !m_chunked_reply);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    // The connection may be closed, and the request freed, while the reply is
+    // being sent. Every step below runs on the main http thread, in order, and
+    // stops touching the request once that happened.
+    m_chunked_reply = new HTTPChunkedReply;
+    auto req_copy = req;
+    auto chunked_reply = m_chunked_reply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus, chunked_reply] {
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, [](evhttp_connection*, void* arg) {
+                auto chunked_reply = static_cast<HTTPChunkedReply*>(arg);
+                chunked_reply->StopWatchingOutput();
+                WITH_LOCK(chunked_reply->m_mutex, chunked_reply->m_closed = true);
+                chunked_reply->m_cond.notify_all();
+            }, chunked_reply);
+            // Track how much of the reply is still waiting to be sent, so
+            // that a slow client holds back the worker writing it.
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                chunked_reply->m_output = bufferevent_get_output(bev);
+                chunked_reply->m_output_cb = evbuffer_add_cb(chunked_reply->m_output, [](evbuffer* buffer, const evbuffer_cb_info*, void* arg) {
+                    auto chunked_reply = static_cast<HTTPChunkedReply*>(arg);
+                    WITH_LOCK(chunked_reply->m_mutex, chunked_reply->m_buffered = evbuffer_get_length(buffer));
+                    chunked_reply->m_cond.notify_all();
+                }, chunked_reply);
+            }
+        }
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& chunk)
+{
+    assert(!replySent && req && m_chunked_reply);
+    if (chunk.empty()) return;
+    {
+        // Wait for the client to catch up. Give up on that at shutdown, or
+        // the worker could not be joined until the client goes away.
+        WAIT_LOCK(m_chunked_reply->m_mutex, lock);
+        while (!m_chunked_reply->m_closed && m_chunked_reply->m_queued + m_chunked_reply->m_buffered >= MAX_CHUNKED_REPLY_BUFFER && !ShutdownRequested()) {
+            m_chunked_reply->m_cond.wait_for(lock, std::chrono::milliseconds{100});
+        }
+        if (m_chunked_reply->m_closed) return;
+        m_chunked_reply->m_queued += chunk.size();
+    }
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, chunk.data(), chunk.size());
+    auto req_copy = req;
+    auto chunked_reply = m_chunked_reply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb, chunked_reply, size = chunk.size()] {
+        if (!chunked_reply->IsClosed()) evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+        WITH_LOCK(chunked_reply->m_mutex, chunked_reply->m_queued -= size);
+        chunked_reply->m_cond.notify_all();
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::WriteReplyEnd()
+{
+    assert(!replySent && req && m_chunked_reply);
+    auto req_copy = req;
+    auto chunked_reply = m_chunked_reply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, chunked_reply] {
+        const bool closed{chunked_reply->IsClosed()};
+        chunked_reply->StopWatchingOutput();
+        delete chunked_reply;
+        if (closed) return;
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) evhttp_connection_set_closecb(conn, nullptr, nullptr);
+        evhttp_send_reply_end(req_copy);
+        // Re-enable reading from the socket, as in WriteReply.
+        if (conn && event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+    m_chunked_reply = nullptr;
+}
+
 CService HTTPRequest::GetPeer() const
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -16,6 +16,7 @@ struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPChunkedReply;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -58,6 +59,8 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    //! Set while a chunked reply is being sent, owned by the main http thread
+    HTTPChunkedReply* m_chunked_reply{nullptr};
 
 public:
     explicit HTTPRequest(struct evhttp_request* req, bool replySent = false);
@@ -113,6 +116,29 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start an HTTP reply whose body is sent in pieces, using chunked transfer
+     * encoding for HTTP/1.1 clients, so that a large body does not have to be
+     * built as a whole first.
+     *
+     * @note Call WriteReplyChunk for every piece of the body and WriteReplyEnd
+     * afterwards, instead of WriteReply. Pieces written after the client went
+     * away are dropped.
+     */
+    void WriteReplyStart(int nStatus);
+
+    /**
+     * Send the next piece of a reply started with WriteReplyStart. Blocks
+     * while too much of the reply is waiting to be sent to the client.
+     */
+    void WriteReplyChunk(const std::string& chunk);
+
+    /**
+     * Finish a reply started with WriteReplyStart. Like WriteReply, this gives
+     * the request back to the main thread.
+     */
+    void WriteReplyEnd();
 };
 
 /** Event handler closure.
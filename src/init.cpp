@@ -37,6 +37,7 @@
 #include <node/caches.h>
 #include <node/chainstate.h>
 #include <node/context.h>
+#include <node/mempool_journal.h>
 #include <node/miner.h>
 #include <node/ui_interface.h>
 #include <policy/feerate.h>
@@ -98,6 +99,7 @@
 #include <zmq/zmqrpc.h>
 #endif
 
+using node::BlockTemplateCache;
 using node::CacheSizes;
 using node::CalculateCacheSizes;
 using node::ChainstateLoadVerifyError;
@@ -106,6 +108,8 @@ using node::CleanupBlockRevFiles;
 using node::DEFAULT_PRINTPRIORITY;
 using node::DEFAULT_STOPAFTERBLOCKIMPORT;
 using node::LoadChainstate;
+using node::MEMPOOL_JOURNAL_COMPACT_INTERVAL;
+using node::MempoolJournal;
 using node::NodeContext;
 using node::ThreadImport;
 using node::VerifyLoadedChainstate;
@@ -231,6 +235,7 @@ void Shutdown(NodeContext& node)
     // After everything has been shut down, but before things get flushed, stop the
     // CScheduler/checkqueue, scheduler and load block thread.
     if (node.scheduler) node.scheduler->stop();
+    if (node.block_template_cache) node.block_template_cache->Stop();
     if (node.chainman && node.chainman->m_load_block.joinable()) node.chainman->m_load_block.join();
     StopScriptCheckWorkerThreads();
 
@@ -241,10 +246,6 @@ void Shutdown(NodeContext& node)
     node.banman.reset();
     node.addrman.reset();
 
-    if (node.mempool && node.mempool->IsLoaded() && node.args->GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
-        DumpMempool(*node.mempool);
-    }
-
     // Drop transactions we were still watching, and record fee estimations.
     if (node.fee_estimator) node.fee_estimator->Flush();
 
@@ -262,6 +263,18 @@ void Shutdown(NodeContext& node)
     // CValidationInterface callbacks, flush them...
     GetMainSignals().FlushBackgroundCallbacks();
 
+    if (node.block_template_cache) {
+        UnregisterValidationInterface(node.block_template_cache.get());
+    }
+
+    // Only the tail of the mempool journal, which is complete now, needs to be
+    // written out.
+    if (node.mempool_journal) {
+        node.mempool_journal->Flush();
+        UnregisterValidationInterface(node.mempool_journal.get());
+        node.mempool_journal.reset();
+    }
+
     // Stop and delete all indexes only after flushing background callbacks.
     if (g_txindex) {
         g_txindex->Stop();
@@ -305,6 +318,7 @@ void Shutdown(NodeContext& node)
     UnregisterAllValidationInterfaces();
     GetMainSignals().UnregisterBackgroundSignalScheduler();
     init::UnsetGlobals();
+    node.block_template_cache.reset();
     node.mempool.reset();
     node.fee_estimator.reset();
     node.chainman.reset();
@@ -418,7 +432,8 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex(), signetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
-    argsman.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-persistmempool", strprintf("Whether to keep a journal of the mempool on disk and load it on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-persistmempoolv1", strprintf("Whether mempool.dat is written in the legacy format (version 1), which older versions can read, instead of the indexed format (version 2) (default: %u)", DEFAULT_PERSIST_V1_DAT), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -coinstatsindex. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
@@ -459,6 +474,7 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by outbound peers forward or backward by this amount (default: %u seconds).", DEFAULT_MAX_TIME_ADJUSTMENT), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-maxuploadtarget=<n>", strprintf("Tries to keep outbound traffic under the given target per 24h. Limit does not apply to peers with 'download' permission or blocks created within past week. 0 = no limit (default: %s). Optional suffix units [k|K|m|M|g|G|t|T] (default: M). Lowercase is 1000 base while uppercase is 1024 base", DEFAULT_MAX_UPLOAD_TARGET), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    argsman.AddArg("-msghandthreads=<n>", strprintf("Number of threads processing messages from and to peers (%u to %d, default: %d). Messages from each peer are still processed in order, by one thread at a time.", 1, MAX_MSGHAND_THREADS, DEFAULT_MSGHAND_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-onion=<ip:port>", "Use separate SOCKS5 proxy to reach peers via Tor onion services, set -noonion to disable (default: -proxy)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-i2psam=<ip:port>", "I2P SAM proxy to reach I2P peers and accept I2P connections (default: none)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-i2pacceptincoming", "If set and -i2psam is also set then incoming I2P connections are accepted via the SAM proxy. If this is not set but -i2psam is set then only outgoing connections will be made to the I2P network. Ignored if -i2psam is not set. Listening for incoming I2P connections is done through the SAM proxy, not by binding to a local address and port (default: 1)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -527,6 +543,12 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-zmqpubchainconnectedhwm=<n>", strprintf("Set publish raw block connected outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     argsman.AddArg("-zmqpubchainheaderadded=<address>", "Enable publish header added events in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     argsman.AddArg("-zmqpubchainheaderaddedhwm=<n>", strprintf("Set header added outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubmempoolhistogram=<address>", "Enable publish of the mempool fee histogram, whenever it changed, in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubmempoolhistogramhwm=<n>", strprintf("Set mempool fee histogram outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubblocktemplatechanged=<address>", "Enable publish of the fees of the next block template, and their change, whenever it was rebuilt, in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubblocktemplatechangedhwm=<n>", strprintf("Set block template changed outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubprojectedblock=<address>", "Enable publish of the txids entering and leaving the projected next block, with its fees and weight, in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubprojectedblockhwm=<n>", strprintf("Set projected block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
@@ -553,6 +575,12 @@ void SetupServerArgs(ArgsManager& argsman)
     hidden_args.emplace_back("-zmqpubchainconnectedhwm=<address>");
     hidden_args.emplace_back("-zmqpubchainheaderadded=<address>");
     hidden_args.emplace_back("-zmqpubchainheaderaddedhwm=<address>");
+    hidden_args.emplace_back("-zmqpubmempoolhistogram=<address>");
+    hidden_args.emplace_back("-zmqpubmempoolhistogramhwm=<n>");
+    hidden_args.emplace_back("-zmqpubblocktemplatechanged=<address>");
+    hidden_args.emplace_back("-zmqpubblocktemplatechangedhwm=<n>");
+    hidden_args.emplace_back("-zmqpubprojectedblock=<address>");
+    hidden_args.emplace_back("-zmqpubprojectedblockhwm=<n>");
 #endif
 
     argsman.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -1055,6 +1083,11 @@ bool AppInitParameterInteraction(const ArgsManager& args)
 
     nMaxTipAge = args.GetIntArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
 
+    const int64_t msghand_threads{args.GetIntArg("-msghandthreads", DEFAULT_MSGHAND_THREADS)};
+    if (msghand_threads < 1 || msghand_threads > MAX_MSGHAND_THREADS) {
+        return InitError(strprintf(_("Invalid -msghandthreads value %d (must be between 1 and %d)"), msghand_threads, MAX_MSGHAND_THREADS));
+    }
+
     if (args.IsArgSet("-proxy") && args.GetArg("-proxy", "").empty()) {
         return InitError(_("No proxy server specified. Use -proxy=<ip> or -proxy=<ip:port>."));
     }
@@ -1301,6 +1334,12 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     int check_ratio = std::min<int>(std::max<int>(args.GetIntArg("-checkmempool", chainparams.DefaultConsistencyChecks() ? 1 : 0), 0), 1000000);
     node.mempool = std::make_unique<CTxMemPool>(node.fee_estimator.get(), check_ratio);
 
+    assert(!node.mempool_journal);
+    if (args.GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        node.mempool_journal = std::make_unique<MempoolJournal>(*node.mempool, args.GetDataDirNet());
+        RegisterValidationInterface(node.mempool_journal.get());
+    }
+
     assert(!node.chainman);
     node.chainman = std::make_unique<ChainstateManager>();
     ChainstateManager& chainman = *node.chainman;
@@ -1656,8 +1695,12 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         vImportFiles.push_back(fs::PathFromString(strFile));
     }
 
+    std::function<void(CChainState&)> load_mempool;
+    if (MempoolJournal* mempool_journal = node.mempool_journal.get()) {
+        load_mempool = [mempool_journal](CChainState& chainstate) { mempool_journal->Load(chainstate); };
+    }
     chainman.m_load_block = std::thread(&util::TraceThread, "loadblk", [=, &chainman, &args] {
-        ThreadImport(chainman, vImportFiles, args);
+        ThreadImport(chainman, vImportFiles, args, load_mempool);
     });
 
     // Wait for genesis block to be processed
@@ -1708,6 +1751,7 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     connOptions.m_max_outbound_block_relay = std::min(MAX_BLOCK_RELAY_ONLY_CONNECTIONS, connOptions.nMaxConnections-connOptions.m_max_outbound_full_relay);
     connOptions.nMaxAddnode = MAX_ADDNODE_CONNECTIONS;
     connOptions.nMaxFeeler = MAX_FEELER_CONNECTIONS;
+    connOptions.m_num_msghand_threads = args.GetIntArg("-msghandthreads", DEFAULT_MSGHAND_THREADS);
     connOptions.uiInterface = &uiInterface;
     connOptions.m_banman = node.banman.get();
     connOptions.m_msgproc = node.peerman.get();
@@ -1831,6 +1875,27 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         return false;
     }
 
+    if (node.mempool) {
+        node.block_template_cache = std::make_unique<BlockTemplateCache>(chainman, *node.mempool);
+#if ENABLE_ZMQ
+        if (g_zmq_notification_interface) {
+            for (const CZMQAbstractNotifier* notifier : g_zmq_notification_interface->GetActiveNotifiers()) {
+                if (notifier->GetType() != "pubblocktemplatechanged" && notifier->GetType() != "pubprojectedblock") continue;
+                // The notifiers are only used from the scheduler thread, which
+                // also runs the validation interface callbacks.
+                node.block_template_cache->AddListener([scheduler = node.scheduler.get()](const std::shared_ptr<const node::CBlockTemplate>& old_template, const std::shared_ptr<const node::CBlockTemplate>& new_template) {
+                    scheduler->scheduleFromNow([old_template, new_template] {
+                        g_zmq_notification_interface->NotifyBlockTemplateChanged(old_template.get(), *new_template);
+                    }, std::chrono::milliseconds{0});
+                });
+                break;
+            }
+        }
+#endif
+        RegisterValidationInterface(node.block_template_cache.get());
+        node.block_template_cache->Start();
+    }
+
     // ********************************************************* Step 13: finished
 
     // At this point, the RPC is "started", but still in warmup, which means it
@@ -1855,7 +1920,31 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         banman->DumpBanlist();
     }, DUMP_BANS_INTERVAL);
 
-    if (node.peerman) node.peerman->StartScheduledTasks(*node.scheduler);
+    if (node.peerman) {
+        node.peerman->StartScheduledTasks(*node.scheduler);
+        node.peerman->StartReconstructionThread();
+    }
+
+    if (CTxMemPool* mempool = node.mempool.get()) {
+        const std::chrono::hours mempool_expiry{args.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY)};
+        node.scheduler->scheduleEvery([mempool, mempool_expiry] {
+            ExpireMempool(*mempool, mempool_expiry);
+        }, MEMPOOL_EXPIRY_INTERVAL);
+    }
+
+#if ENABLE_ZMQ
+    if (g_zmq_notification_interface && node.mempool) {
+        node.scheduler->scheduleEvery([mempool = node.mempool.get()] {
+            g_zmq_notification_interface->NotifyMempoolHistogram(*mempool);
+        }, ZMQ_MEMPOOL_HISTOGRAM_INTERVAL);
+    }
+#endif
+
+    if (MempoolJournal* mempool_journal = node.mempool_journal.get()) {
+        node.scheduler->scheduleEvery([mempool_journal] {
+            mempool_journal->MaybeCompact();
+        }, MEMPOOL_JOURNAL_COMPACT_INTERVAL);
+    }
 
 #if HAVE_SYSTEM
     StartupNotify(args);
@@ -10,7 +10,9 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cassert>
+#include <deque>
 #include <map>
 #include <memory>
 #include <set>
@@ -89,6 +91,17 @@ static inline size_t DynamicUsage(const std::vector<X>& v)
     return MallocUsage(v.capacity() * sizeof(X));
 }
 
+template<typename X>
+static inline size_t DynamicUsage(const std::deque<X>& d)
+{
+    // Assume libstdc++'s layout: elements are kept in blocks of 512 bytes (or
+    // of a single element, if that is larger), which are referred to by an
+    // array of at least 8 pointers.
+    const size_t block_elements{sizeof(X) < 512 ? 512 / sizeof(X) : 1};
+    const size_t blocks{d.size() / block_elements + 1};
+    return blocks * MallocUsage(block_elements * sizeof(X)) + MallocUsage(std::max<size_t>(8, blocks + 2) * sizeof(void*));
+}
+
 template<unsigned int N, typename X, typename S, typename D>
 static inline size_t DynamicUsage(const prevector<N, X, S, D>& v)
 {
@@ -43,10 +43,6 @@
 #include <ifaddrs.h>
 #endif
 
-#ifdef USE_POLL
-#include <poll.h>
-#endif
-
 #include <algorithm>
 #include <array>
 #include <cstdint>
@@ -99,10 +95,13 @@ enum BindFlags {
     BF_DONT_ADVERTISE = (1U << 2),
 };
 
-// The set of sockets cannot be modified while waiting
+// Unless epoll(7) is used, the set of sockets cannot be modified while waiting
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+/** How often all nodes are checked for inactivity. */
+static constexpr auto INACTIVITY_CHECK_INTERVAL{1s};
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -565,6 +564,8 @@ void CNode::CloseSocketDisconnect()
     LOCK(m_sock_mutex);
     if (m_sock) {
         LogPrint(BCLog::NET, "disconnecting peer=%d\n", id);
+        if (m_sock_events) m_sock_events->Remove(this);
+        m_sock_events = nullptr;
         m_sock.reset();
     }
 }
@@ -756,6 +757,10 @@ int V1TransportDeserializer::readHeader(Span<const uint8_t> msg_bytes)
 
     // switch state to reading message data
     in_data = true;
+    if (m_recv_buffers && vRecv.capacity() == 0) {
+        // The buffer went with the previous message, take over the one of an earlier message instead.
+        vRecv = m_recv_buffers->Get(vRecv.GetType(), vRecv.GetVersion());
+    }
 
     return nCopy;
 }
@@ -777,6 +782,25 @@ int V1TransportDeserializer::readData(Span<const uint8_t> msg_bytes)
     return nCopy;
 }
 
+CDataStream RecvBufferPool::Get(int type, int version)
+{
+    LOCK(m_mutex);
+    if (m_buffers.empty()) return CDataStream{type, version};
+    CDataStream buffer{std::move(m_buffers.back())};
+    m_buffers.pop_back();
+    buffer.clear();
+    buffer.SetType(type);
+    buffer.SetVersion(version);
+    return buffer;
+}
+
+void RecvBufferPool::Put(CDataStream&& buffer)
+{
+    if (buffer.capacity() == 0 || buffer.capacity() > MAX_BUFFER_SIZE) return;
+    LOCK(m_mutex);
+    if (m_buffers.size() < MAX_BUFFERS) m_buffers.push_back(std::move(buffer));
+}
+
 const uint256& V1TransportDeserializer::GetMessageHash() const
 {
     assert(Complete());
@@ -835,34 +859,55 @@ void V1TransportSerializer::prepareForTransport(CSerializedNetMsg& msg, std::vec
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, header, 0, hdr};
 }
 
+CSharedNetMsg::CSharedNetMsg(CSerializedNetMsg&& msg) : m_type{msg.m_type}
+{
+    std::vector<unsigned char> header;
+    V1TransportSerializer{}.prepareForTransport(msg, header);
+    m_header = std::make_shared<const std::vector<unsigned char>>(std::move(header));
+    m_data = std::make_shared<const std::vector<unsigned char>>(std::move(msg.data));
+}
+
 size_t CConnman::SocketSendData(CNode& node) const
 {
-    auto it = node.vSendMsg.begin();
     size_t nSentSize = 0;
 
-    while (it != node.vSendMsg.end()) {
-        const auto& data = *it;
-        assert(data.size() > node.nSendOffset);
+    while (!node.vSendMsg.empty()) {
+        // Hand as many queued buffers to the kernel as it takes in one call.
+        std::array<Span<const unsigned char>, MAX_SEND_BUFFERS> buffers;
+        size_t count{0};
+        size_t len{0};
+        for (auto it = node.vSendMsg.begin(); it != node.vSendMsg.end() && count < buffers.size(); ++it) {
+            buffers[count] = Span<const unsigned char>{**it};
+            len += (*it)->size();
+            ++count;
+        }
+        assert(buffers[0].size() > node.nSendOffset);
+        buffers[0] = buffers[0].subspan(node.nSendOffset);
+        len -= node.nSendOffset;
+
         int nBytes = 0;
         {
             LOCK(node.m_sock_mutex);
             if (!node.m_sock) {
                 break;
             }
-            nBytes = node.m_sock->Send(reinterpret_cast<const char*>(data.data()) + node.nSendOffset, data.size() - node.nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            nBytes = node.m_sock->SendMany(Span{buffers.data(), count}, MSG_NOSIGNAL | MSG_DONTWAIT);
         }
         if (nBytes > 0) {
             node.m_last_send = GetTime<std::chrono::seconds>();
             node.nSendBytes += nBytes;
-            node.nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (node.nSendOffset == data.size()) {
-                node.nSendOffset = 0;
-                node.nSendSize -= data.size();
-                node.fPauseSend = node.nSendSize > nSendBufferMaxSize;
-                it++;
-            } else {
-                // could not send full message; stop sending more
+            // Drop the buffers that were sent completely.
+            size_t sent = node.nSendOffset + nBytes;
+            while (!node.vSendMsg.empty() && sent >= node.vSendMsg.front()->size()) {
+                sent -= node.vSendMsg.front()->size();
+                node.nSendSize -= node.vSendMsg.front()->size();
+                node.vSendMsg.pop_front();
+            }
+            node.nSendOffset = sent;
+            node.fPauseSend = node.nSendSize > nSendBufferMaxSize;
+            if (size_t(nBytes) < len) {
+                // could not send everything; stop sending more
                 break;
             }
         } else {
@@ -879,11 +924,11 @@ size_t CConnman::SocketSendData(CNode& node) const
         }
     }
 
-    if (it == node.vSendMsg.end()) {
+    if (node.vSendMsg.empty()) {
         assert(node.nSendOffset == 0);
         assert(node.nSendSize == 0);
     }
-    node.vSendMsg.erase(node.vSendMsg.begin(), it);
+    node.UpdateSockEvents();
     return nSentSize;
 }
 
@@ -1261,6 +1306,7 @@ void CConnman::CreateNodeFromAcceptedSocket(std::unique_ptr<Sock>&& sock,
 
     LogPrint(BCLog::NET, "connection from %s accepted\n", addr.ToString());
 
+    pnode->RegisterSockEvents(*m_sock_events);
     {
         LOCK(m_nodes_mutex);
         m_nodes.push_back(pnode);
@@ -1335,6 +1381,7 @@ void CConnman::DisconnectNodes()
 
                 // close socket and cleanup
                 pnode->CloseSocketDisconnect();
+                m_paused_nodes.erase(std::remove(m_paused_nodes.begin(), m_paused_nodes.end(), pnode), m_paused_nodes.end());
 
                 // hold in disconnected pool until all refs are released
                 pnode->Release();
@@ -1409,224 +1456,99 @@ bool CConnman::InactivityCheck(const CNode& node) const
     return false;
 }
 
-bool CConnman::GenerateSelectSet(const std::vector<CNode*>& nodes,
-                                 std::set<SOCKET>& recv_set,
-                                 std::set<SOCKET>& send_set,
-                                 std::set<SOCKET>& error_set)
+void CNode::RegisterSockEvents(SockEvents& sock_events)
 {
-    for (const ListenSocket& hListenSocket : vhListenSocket) {
-        recv_set.insert(hListenSocket.sock->Get());
-    }
-
-    for (CNode* pnode : nodes) {
-        // Implement the following logic:
-        // * If there is data to send, select() for sending data. As this only
-        //   happens when optimistic write failed, we choose to first drain the
-        //   write buffer in this case before receiving more. This avoids
-        //   needlessly queueing received data, if the remote peer is not themselves
-        //   receiving data. This means properly utilizing TCP flow control signalling.
-        // * Otherwise, if there is space left in the receive buffer, select() for
-        //   receiving data.
-        // * Hand off all complete messages to the processor, to be handled without
-        //   blocking here.
-
-        bool select_recv = !pnode->fPauseRecv;
-        bool select_send;
-        {
-            LOCK(pnode->cs_vSend);
-            select_send = !pnode->vSendMsg.empty();
-        }
-
-        LOCK(pnode->m_sock_mutex);
-        if (!pnode->m_sock) {
-            continue;
-        }
-
-        error_set.insert(pnode->m_sock->Get());
-        if (select_send) {
-            send_set.insert(pnode->m_sock->Get());
-            continue;
-        }
-        if (select_recv) {
-            recv_set.insert(pnode->m_sock->Get());
-        }
-    }
-
-    return !recv_set.empty() || !send_set.empty() || !error_set.empty();
+    LOCK(cs_vSend);
+    WITH_LOCK(m_sock_mutex, m_sock_events = &sock_events; m_sock_events_requested = 0);
+    UpdateSockEvents();
 }
 
-#ifdef USE_POLL
-void CConnman::SocketEvents(const std::vector<CNode*>& nodes,
-                            std::set<SOCKET>& recv_set,
-                            std::set<SOCKET>& send_set,
-                            std::set<SOCKET>& error_set)
+void CNode::UpdateSockEvents()
 {
-    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
-    if (!GenerateSelectSet(nodes, recv_select_set, send_select_set, error_select_set)) {
-        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
-        return;
-    }
-
-    std::unordered_map<SOCKET, struct pollfd> pollfds;
-    for (SOCKET socket_id : recv_select_set) {
-        pollfds[socket_id].fd = socket_id;
-        pollfds[socket_id].events |= POLLIN;
-    }
-
-    for (SOCKET socket_id : send_select_set) {
-        pollfds[socket_id].fd = socket_id;
-        pollfds[socket_id].events |= POLLOUT;
-    }
+    AssertLockHeld(cs_vSend);
+    // Implement the following logic:
+    // * If there is data to send, wait for sending data. As this only
+    //   happens when optimistic write failed, we choose to first drain the
+    //   write buffer in this case before receiving more. This avoids
+    //   needlessly queueing received data, if the remote peer is not themselves
+    //   receiving data. This means properly utilizing TCP flow control signalling.
+    // * Otherwise, if there is space left in the receive buffer, wait for
+    //   receiving data.
+    // * Hand off all complete messages to the processor, to be handled without
+    //   blocking here.
+    // Errors are reported either way.
+    const SockEvents::Event requested{!vSendMsg.empty() ? Sock::SEND : fPauseRecv ? SockEvents::Event{0} : Sock::RECV};
 
-    for (SOCKET socket_id : error_select_set) {
-        pollfds[socket_id].fd = socket_id;
-        // These flags are ignored, but we set them for clarity
-        pollfds[socket_id].events |= POLLERR|POLLHUP;
-    }
-
-    std::vector<struct pollfd> vpollfds;
-    vpollfds.reserve(pollfds.size());
-    for (auto it : pollfds) {
-        vpollfds.push_back(std::move(it.second));
+    LOCK(m_sock_mutex);
+    if (!m_sock || !m_sock_events || requested == m_sock_events_requested) return;
+    if (m_sock_events->Set(this, m_sock->Get(), requested)) {
+        m_sock_events_requested = requested;
+    } else {
+        // Nothing would be received from or sent to the peer anymore.
+        LogPrint(BCLog::NET, "failed to wait for socket events, disconnecting peer=%d\n", GetId());
+        fDisconnect = true;
     }
+}
 
-    if (poll(vpollfds.data(), vpollfds.size(), SELECT_TIMEOUT_MILLISECONDS) < 0) return;
-
-    if (interruptNet) return;
-
-    for (struct pollfd pollfd_entry : vpollfds) {
-        if (pollfd_entry.revents & POLLIN)            recv_set.insert(pollfd_entry.fd);
-        if (pollfd_entry.revents & POLLOUT)           send_set.insert(pollfd_entry.fd);
-        if (pollfd_entry.revents & (POLLERR|POLLHUP)) error_set.insert(pollfd_entry.fd);
+const CConnman::ListenSocket* CConnman::FindListenSocket(const void* key) const
+{
+    for (const ListenSocket& listen_socket : vhListenSocket) {
+        if (&listen_socket == key) return &listen_socket;
     }
+    return nullptr;
 }
-#else
-void CConnman::SocketEvents(const std::vector<CNode*>& nodes,
-                            std::set<SOCKET>& recv_set,
-                            std::set<SOCKET>& send_set,
-                            std::set<SOCKET>& error_set)
+
+void CConnman::SocketHandler()
 {
-    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
-    if (!GenerateSelectSet(nodes, recv_select_set, send_select_set, error_select_set)) {
+    // Wait for receiving from nodes again once the message handler made space
+    // in their receive queue.
+    m_paused_nodes.erase(std::remove_if(m_paused_nodes.begin(), m_paused_nodes.end(), [](CNode* pnode) {
+        if (pnode->fPauseRecv) return false;
+        WITH_LOCK(pnode->cs_vSend, pnode->UpdateSockEvents());
+        return true;
+    }), m_paused_nodes.end());
+
+    // Check for the readiness of the already connected sockets and the
+    // listening sockets in one call ("readiness" as in poll(2) or
+    // select(2)). If none are ready, wait for a short while.
+    std::vector<SockEvents::Ready> ready;
+    if (!m_sock_events->Wait(std::chrono::milliseconds{SELECT_TIMEOUT_MILLISECONDS}, ready)) {
+        LogPrintf("socket wait error %s\n", NetworkErrorString(WSAGetLastError()));
         interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
         return;
     }
+    if (interruptNet) return;
 
-    //
-    // Find which sockets have data to receive
-    //
-    struct timeval timeout;
-    timeout.tv_sec  = 0;
-    timeout.tv_usec = SELECT_TIMEOUT_MILLISECONDS * 1000; // frequency to poll pnode->vSend
-
-    fd_set fdsetRecv;
-    fd_set fdsetSend;
-    fd_set fdsetError;
-    FD_ZERO(&fdsetRecv);
-    FD_ZERO(&fdsetSend);
-    FD_ZERO(&fdsetError);
-    SOCKET hSocketMax = 0;
-
-    for (SOCKET hSocket : recv_select_set) {
-        FD_SET(hSocket, &fdsetRecv);
-        hSocketMax = std::max(hSocketMax, hSocket);
-    }
-
-    for (SOCKET hSocket : send_select_set) {
-        FD_SET(hSocket, &fdsetSend);
-        hSocketMax = std::max(hSocketMax, hSocket);
-    }
-
-    for (SOCKET hSocket : error_select_set) {
-        FD_SET(hSocket, &fdsetError);
-        hSocketMax = std::max(hSocketMax, hSocket);
-    }
-
-    int nSelect = select(hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
-
-    if (interruptNet)
-        return;
-
-    if (nSelect == SOCKET_ERROR)
-    {
-        int nErr = WSAGetLastError();
-        LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-        for (unsigned int i = 0; i <= hSocketMax; i++)
-            FD_SET(i, &fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        if (!interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS)))
-            return;
-    }
-
-    for (SOCKET hSocket : recv_select_set) {
-        if (FD_ISSET(hSocket, &fdsetRecv)) {
-            recv_set.insert(hSocket);
-        }
-    }
-
-    for (SOCKET hSocket : send_select_set) {
-        if (FD_ISSET(hSocket, &fdsetSend)) {
-            send_set.insert(hSocket);
-        }
-    }
-
-    for (SOCKET hSocket : error_select_set) {
-        if (FD_ISSET(hSocket, &fdsetError)) {
-            error_set.insert(hSocket);
-        }
-    }
-}
-#endif
+    // Service (send/receive) each of the already connected nodes.
+    SocketHandlerConnected(ready);
 
-void CConnman::SocketHandler()
-{
-    std::set<SOCKET> recv_set;
-    std::set<SOCKET> send_set;
-    std::set<SOCKET> error_set;
+    // Accept new connections from listening sockets.
+    SocketHandlerListening(ready);
 
-    {
+    // Inactive nodes are not woken up by their sockets, so look at all of
+    // them every once in a while.
+    const auto now{std::chrono::steady_clock::now()};
+    if (now >= m_next_inactivity_check) {
+        m_next_inactivity_check = now + INACTIVITY_CHECK_INTERVAL;
         const NodesSnapshot snap{*this, /*shuffle=*/false};
-
-        // Check for the readiness of the already connected sockets and the
-        // listening sockets in one call ("readiness" as in poll(2) or
-        // select(2)). If none are ready, wait for a short while and return
-        // empty sets.
-        SocketEvents(snap.Nodes(), recv_set, send_set, error_set);
-
-        // Service (send/receive) each of the already connected nodes.
-        SocketHandlerConnected(snap.Nodes(), recv_set, send_set, error_set);
+        for (CNode* pnode : snap.Nodes()) {
+            if (InactivityCheck(*pnode)) pnode->fDisconnect = true;
+        }
     }
-
-    // Accept new connections from listening sockets.
-    SocketHandlerListening(recv_set);
 }
 
-void CConnman::SocketHandlerConnected(const std::vector<CNode*>& nodes,
-                                      const std::set<SOCKET>& recv_set,
-                                      const std::set<SOCKET>& send_set,
-                                      const std::set<SOCKET>& error_set)
+void CConnman::SocketHandlerConnected(const std::vector<SockEvents::Ready>& ready)
 {
-    for (CNode* pnode : nodes) {
+    for (const SockEvents::Ready& socket_ready : ready) {
         if (interruptNet)
             return;
+        if (FindListenSocket(socket_ready.key)) continue;
+        CNode* pnode = static_cast<CNode*>(socket_ready.key);
 
         //
         // Receive
         //
-        bool recvSet = false;
-        bool sendSet = false;
-        bool errorSet = false;
-        {
-            LOCK(pnode->m_sock_mutex);
-            if (!pnode->m_sock) {
-                continue;
-            }
-            recvSet = recv_set.count(pnode->m_sock->Get()) > 0;
-            sendSet = send_set.count(pnode->m_sock->Get()) > 0;
-            errorSet = error_set.count(pnode->m_sock->Get()) > 0;
-        }
-        if (recvSet || errorSet)
+        if (socket_ready.occurred & (Sock::RECV | SockEvents::ERR))
         {
             // typical socket buffer is 8K-64K
             uint8_t pchBuf[0x10000];
@@ -1659,6 +1581,10 @@ void CConnman::SocketHandlerConnected(const std::vector<CNode*>& nodes,
                         pnode->nProcessQueueSize += nSizeAdded;
                         pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
                     }
+                    if (pnode->fPauseRecv && std::find(m_paused_nodes.begin(), m_paused_nodes.end(), pnode) == m_paused_nodes.end()) {
+                        WITH_LOCK(pnode->cs_vSend, pnode->UpdateSockEvents());
+                        m_paused_nodes.push_back(pnode);
+                    }
                     WakeMessageHandler();
                 }
             }
@@ -1684,24 +1610,23 @@ void CConnman::SocketHandlerConnected(const std::vector<CNode*>& nodes,
             }
         }
 
-        if (sendSet) {
+        if (socket_ready.occurred & Sock::SEND) {
             // Send data
             size_t bytes_sent = WITH_LOCK(pnode->cs_vSend, return SocketSendData(*pnode));
             if (bytes_sent) RecordBytesSent(bytes_sent);
         }
-
-        if (InactivityCheck(*pnode)) pnode->fDisconnect = true;
     }
 }
 
-void CConnman::SocketHandlerListening(const std::set<SOCKET>& recv_set)
+void CConnman::SocketHandlerListening(const std::vector<SockEvents::Ready>& ready)
 {
-    for (const ListenSocket& listen_socket : vhListenSocket) {
+    for (const SockEvents::Ready& socket_ready : ready) {
         if (interruptNet) {
             return;
         }
-        if (recv_set.count(listen_socket.sock->Get()) > 0) {
-            AcceptConnection(listen_socket);
+        const ListenSocket* listen_socket{FindListenSocket(socket_ready.key)};
+        if (listen_socket && (socket_ready.occurred & Sock::RECV)) {
+            AcceptConnection(*listen_socket);
         }
     }
 }
@@ -1709,6 +1634,9 @@ void CConnman::SocketHandlerListening(const std::set<SOCKET>& recv_set)
 void CConnman::ThreadSocketHandler()
 {
     SetSyscallSandboxPolicy(SyscallSandboxPolicy::NET);
+    for (ListenSocket& listen_socket : vhListenSocket) {
+        m_sock_events->Set(&listen_socket, listen_socket.sock->Get(), Sock::RECV);
+    }
     while (!interruptNet)
     {
         DisconnectNodes();
@@ -1721,9 +1649,9 @@ void CConnman::WakeMessageHandler()
 {
     {
         LOCK(mutexMsgProc);
-        fMsgProcWake = true;
+        ++m_msgproc_wake_count;
     }
-    condMsgProc.notify_one();
+    condMsgProc.notify_all();
 }
 
 void CConnman::ThreadDNSAddressSeed()
@@ -2304,6 +2232,7 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         grantOutbound->MoveTo(pnode->grantOutbound);
 
     m_msgproc->InitializeNode(pnode);
+    pnode->RegisterSockEvents(*m_sock_events);
     {
         LOCK(m_nodes_mutex);
         m_nodes.push_back(pnode);
@@ -2313,6 +2242,7 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
 void CConnman::ThreadMessageHandler()
 {
     SetSyscallSandboxPolicy(SyscallSandboxPolicy::MESSAGE_HANDLER);
+    uint64_t wake_count{WITH_LOCK(mutexMsgProc, return m_msgproc_wake_count)};
     while (!flagInterruptMsgProc)
     {
         bool fMoreWork = false;
@@ -2327,6 +2257,12 @@ void CConnman::ThreadMessageHandler()
                 if (pnode->fDisconnect)
                     continue;
 
+                // Another message handler thread is busy with this node, and
+                // will notice any work that arrived for it in the meantime.
+                TRY_LOCK(pnode->m_msgproc_mutex, lock_msgproc);
+                if (!lock_msgproc)
+                    continue;
+
                 // Receive messages
                 bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
                 fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
@@ -2345,9 +2281,9 @@ void CConnman::ThreadMessageHandler()
 
         WAIT_LOCK(mutexMsgProc, lock);
         if (!fMoreWork) {
-            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this]() EXCLUSIVE_LOCKS_REQUIRED(mutexMsgProc) { return fMsgProcWake; });
+            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [&]() EXCLUSIVE_LOCKS_REQUIRED(mutexMsgProc) { return m_msgproc_wake_count != wake_count; });
         }
-        fMsgProcWake = false;
+        wake_count = m_msgproc_wake_count;
     }
 }
 
@@ -2632,11 +2568,6 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     interruptNet.reset();
     flagInterruptMsgProc = false;
 
-    {
-        LOCK(mutexMsgProc);
-        fMsgProcWake = false;
-    }
-
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&util::TraceThread, "net", [this] { ThreadSocketHandler(); });
 
@@ -2663,7 +2594,11 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     }
 
     // Process messages
-    threadMessageHandler = std::thread(&util::TraceThread, "msghand", [this] { ThreadMessageHandler(); });
+    for (int i = 0; i < m_num_msghand_threads; ++i) {
+        m_message_handler_threads.emplace_back([this, thread_name = i == 0 ? std::string{"msghand"} : strprintf("msghand.%i", i)] {
+            util::TraceThread(thread_name.c_str(), [this] { ThreadMessageHandler(); });
+        });
+    }
 
     if (connOptions.m_i2p_accept_incoming && m_i2p_sam_session.get() != nullptr) {
         threadI2PAcceptIncoming =
@@ -2720,8 +2655,10 @@ void CConnman::StopThreads()
     if (threadI2PAcceptIncoming.joinable()) {
         threadI2PAcceptIncoming.join();
     }
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (std::thread& thread : m_message_handler_threads) {
+        thread.join();
+    }
+    m_message_handler_threads.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2760,6 +2697,10 @@ void CConnman::StopNodes()
         DeleteNode(pnode);
     }
     m_nodes_disconnected.clear();
+    m_paused_nodes.clear();
+    for (ListenSocket& listen_socket : vhListenSocket) {
+        m_sock_events->Remove(&listen_socket);
+    }
     vhListenSocket.clear();
     semOutbound.reset();
     semAddnode.reset();
@@ -3045,7 +2986,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, std::shared_ptr<Sock> s
         LogPrint(BCLog::NET, "Added connection peer=%d\n", id);
     }
 
-    m_deserializer = std::make_unique<V1TransportDeserializer>(V1TransportDeserializer(Params(), id, SER_NETWORK, INIT_PROTO_VERSION));
+    m_deserializer = std::make_unique<V1TransportDeserializer>(V1TransportDeserializer(Params(), id, SER_NETWORK, INIT_PROTO_VERSION, &m_recv_buffers));
     m_serializer = std::make_unique<V1TransportSerializer>(V1TransportSerializer());
 }
 
@@ -3056,25 +2997,37 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
-    size_t nMessageSize = msg.data.size();
-    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n", msg.m_type, nMessageSize, pnode->GetId());
+    // make sure we use the appropriate network transport format
+    std::vector<unsigned char> serializedHeader;
+    pnode->m_serializer->prepareForTransport(msg, serializedHeader);
+    QueueMessage(pnode, msg.m_type,
+                 std::make_shared<const std::vector<unsigned char>>(std::move(serializedHeader)),
+                 std::make_shared<const std::vector<unsigned char>>(std::move(msg.data)));
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsg& msg)
+{
+    QueueMessage(pnode, msg.m_type, msg.m_header, msg.m_data);
+}
+
+void CConnman::QueueMessage(CNode* pnode, const std::string& msg_type, SendBuffer header, SendBuffer data)
+{
+    size_t nMessageSize = data->size();
+    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n", msg_type, nMessageSize, pnode->GetId());
     if (gArgs.GetBoolArg("-capturemessages", false)) {
-        CaptureMessage(pnode->addr, msg.m_type, msg.data, /*is_incoming=*/false);
+        CaptureMessage(pnode->addr, msg_type, *data, /*is_incoming=*/false);
     }
 
     TRACE6(net, outbound_message,
         pnode->GetId(),
         pnode->m_addr_name.c_str(),
         pnode->ConnectionTypeAsString().c_str(),
-        msg.m_type.c_str(),
-        msg.data.size(),
-        msg.data.data()
+        msg_type.c_str(),
+        data->size(),
+        data->data()
     );
 
-    // make sure we use the appropriate network transport format
-    std::vector<unsigned char> serializedHeader;
-    pnode->m_serializer->prepareForTransport(msg, serializedHeader);
-    size_t nTotalSize = nMessageSize + serializedHeader.size();
+    size_t nTotalSize = nMessageSize + header->size();
 
     size_t nBytesSent = 0;
     {
@@ -3082,12 +3035,12 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         bool optimisticSend(pnode->vSendMsg.empty());
 
         //log total amount of bytes per message type
-        pnode->mapSendBytesPerMsgCmd[msg.m_type] += nTotalSize;
+        pnode->mapSendBytesPerMsgCmd[msg_type] += nTotalSize;
         pnode->nSendSize += nTotalSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize) pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize) pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.push_back(std::move(header));
+        if (nMessageSize) pnode->vSendMsg.push_back(std::move(data));
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend) nBytesSent = SocketSendData(*pnode);
@@ -27,7 +27,9 @@
 #include <uint256.h>
 #include <util/check.h>
 #include <util/sock.h>
+#include <util/sock_events.h>
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
@@ -81,6 +83,10 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
 /** Number of file descriptors required for message capture **/
 static const int NUM_FDS_MESSAGE_CAPTURE = 1;
+/** -msghandthreads default */
+static const int DEFAULT_MSGHAND_THREADS = 1;
+/** Maximum number of message handler threads */
+static const int MAX_MSGHAND_THREADS = 16;
 
 static constexpr bool DEFAULT_FORCEDNSSEED{false};
 static constexpr bool DEFAULT_DNSSEED{true};
@@ -114,6 +120,9 @@ struct CSerializedNetMsg
     std::string m_type;
 };
 
+/** Serialized bytes in the send queue of a peer, possibly shared with the send queues of other peers. */
+using SendBuffer = std::shared_ptr<const std::vector<unsigned char>>;
+
 /** Different types of connections to a peer. This enum encapsulates the
  * information we have available at the time of opening or accepting the
  * connection. Aside from INBOUND, all types are initiated by us.
@@ -307,6 +316,28 @@ public:
     }
 };
 
+/** Receive buffers of a connection's messages that have been processed, kept
+ * for the next messages received on that connection. This saves allocating,
+ * and zeroing on release, a buffer for every message.
+ */
+class RecvBufferPool
+{
+public:
+    /** Buffers with more capacity than this are released, so that the occasional big message does not pin memory. */
+    static constexpr size_t MAX_BUFFER_SIZE{256 * 1024};
+    /** Maximum number of buffers kept */
+    static constexpr size_t MAX_BUFFERS{4};
+
+    /** Get an empty buffer, reusing the capacity of an earlier message's if there is one. */
+    CDataStream Get(int type, int version) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Return the buffer of a message that has been processed. */
+    void Put(CDataStream&& buffer) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    Mutex m_mutex;
+    std::vector<CDataStream> m_buffers GUARDED_BY(m_mutex);
+};
+
 /** The TransportDeserializer takes care of holding and deserializing the
  * network receive buffer. It can deserialize the network buffer into a
  * transport protocol agnostic CNetMessage (command & payload)
@@ -329,6 +360,7 @@ class V1TransportDeserializer final : public TransportDeserializer
 private:
     const CChainParams& m_chain_params;
     const NodeId m_node_id; // Only for logging
+    RecvBufferPool* const m_recv_buffers; // May be nullptr
     mutable CHash256 hasher;
     mutable uint256 data_hash;
     bool in_data;                   // parsing header (false) or data (true)
@@ -354,9 +386,11 @@ private:
     }
 
 public:
-    V1TransportDeserializer(const CChainParams& chain_params, const NodeId node_id, int nTypeIn, int nVersionIn)
+    V1TransportDeserializer(const CChainParams& chain_params, const NodeId node_id, int nTypeIn, int nVersionIn,
+                            RecvBufferPool* recv_buffers = nullptr)
         : m_chain_params(chain_params),
           m_node_id(node_id),
+          m_recv_buffers(recv_buffers),
           hdrbuf(nTypeIn, nVersionIn),
           vRecv(nTypeIn, nVersionIn)
     {
@@ -401,6 +435,20 @@ public:
     void prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header) override;
 };
 
+/**
+ * A message that is serialized, and its transport header computed, once to be
+ * pushed to many peers. Their send queues share its buffers instead of copying
+ * them. The header is that of the V1 transport protocol, which all connections use.
+ */
+struct CSharedNetMsg
+{
+    explicit CSharedNetMsg(CSerializedNetMsg&& msg);
+
+    std::string m_type;
+    SendBuffer m_header;
+    SendBuffer m_data;
+};
+
 /** Information about a peer */
 class CNode
 {
@@ -408,6 +456,8 @@ class CNode
     friend struct ConnmanTestMsg;
 
 public:
+    /** Receive buffers for m_deserializer to reuse */
+    RecvBufferPool m_recv_buffers;
     std::unique_ptr<TransportDeserializer> m_deserializer;
     std::unique_ptr<TransportSerializer> m_serializer;
 
@@ -429,17 +479,25 @@ public:
     /** Offset inside the first vSendMsg already sent */
     size_t nSendOffset GUARDED_BY(cs_vSend){0};
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    std::deque<SendBuffer> vSendMsg GUARDED_BY(cs_vSend);
     Mutex cs_vSend;
     Mutex m_sock_mutex;
     Mutex cs_vRecv;
 
+    /** The SockEvents `m_sock` is registered with, if any, and the events it waits for on it. */
+    SockEvents* m_sock_events GUARDED_BY(m_sock_mutex){nullptr};
+    SockEvents::Event m_sock_events_requested GUARDED_BY(m_sock_mutex){0};
+
     RecursiveMutex cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg GUARDED_BY(cs_vProcessMsg);
     size_t nProcessQueueSize{0};
 
     RecursiveMutex cs_sendProcessing;
 
+    /** Held by the message handler thread that is processing this node's
+     *  messages, so that each node is handled by one thread at a time. */
+    Mutex m_msgproc_mutex;
+
     uint64_t nRecvBytes GUARDED_BY(cs_vRecv){0};
 
     std::atomic<std::chrono::seconds> m_last_send{0s};
@@ -672,6 +730,12 @@ public:
 
     void CloseSocketDisconnect();
 
+    /** Wait for IO on the socket with `sock_events` from now on, until it is closed. */
+    void RegisterSockEvents(SockEvents& sock_events) EXCLUSIVE_LOCKS_REQUIRED(!cs_vSend, !m_sock_mutex);
+
+    /** Update the events waited for on the socket, after vSendMsg or fPauseRecv changed. */
+    void UpdateSockEvents() EXCLUSIVE_LOCKS_REQUIRED(cs_vSend, !m_sock_mutex);
+
     void CopyStats(CNodeStats& stats);
 
     ServiceFlags GetLocalServices() const
@@ -770,6 +834,7 @@ public:
         int m_max_outbound_block_relay = 0;
         int nMaxAddnode = 0;
         int nMaxFeeler = 0;
+        int m_num_msghand_threads = DEFAULT_MSGHAND_THREADS;
         CClientUIInterface* uiInterface = nullptr;
         NetEventsInterface* m_msgproc = nullptr;
         BanMan* m_banman = nullptr;
@@ -800,6 +865,7 @@ public:
         nMaxAddnode = connOptions.nMaxAddnode;
         nMaxFeeler = connOptions.nMaxFeeler;
         m_max_outbound = m_max_outbound_full_relay + m_max_outbound_block_relay + nMaxFeeler;
+        m_num_msghand_threads = connOptions.m_num_msghand_threads;
         m_client_interface = connOptions.uiInterface;
         m_banman = connOptions.m_banman;
         m_msgproc = connOptions.m_msgproc;
@@ -841,6 +907,9 @@ public:
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
 
+    /** Push a message serialized once for many peers, without copying it. */
+    void PushMessage(CNode* pnode, const CSharedNetMsg& msg);
+
     using NodeFn = std::function<void(CNode*)>;
     void ForEachNode(const NodeFn& func)
     {
@@ -1004,54 +1073,26 @@ private:
     bool InactivityCheck(const CNode& node) const;
 
     /**
-     * Generate a collection of sockets to check for IO readiness.
-     * @param[in] nodes Select from these nodes' sockets.
-     * @param[out] recv_set Sockets to check for read readiness.
-     * @param[out] send_set Sockets to check for write readiness.
-     * @param[out] error_set Sockets to check for errors.
-     * @return true if at least one socket is to be checked (the returned set is not empty)
-     */
-    bool GenerateSelectSet(const std::vector<CNode*>& nodes,
-                           std::set<SOCKET>& recv_set,
-                           std::set<SOCKET>& send_set,
-                           std::set<SOCKET>& error_set);
-
-    /**
-     * Check which sockets are ready for IO.
-     * @param[in] nodes Select from these nodes' sockets.
-     * @param[out] recv_set Sockets which are ready for read.
-     * @param[out] send_set Sockets which are ready for write.
-     * @param[out] error_set Sockets which have errors.
-     * This calls `GenerateSelectSet()` to gather a list of sockets to check.
-     */
-    void SocketEvents(const std::vector<CNode*>& nodes,
-                      std::set<SOCKET>& recv_set,
-                      std::set<SOCKET>& send_set,
-                      std::set<SOCKET>& error_set);
-
-    /**
-     * Check connected and listening sockets for IO readiness and process them accordingly.
+     * Wait for connected and listening sockets to become ready for IO and process them accordingly.
+     * The sockets are registered with `m_sock_events`, so the work done here
+     * grows with the number of sockets that are ready rather than connected.
      */
     void SocketHandler();
 
     /**
      * Do the read/write for connected sockets that are ready for IO.
-     * @param[in] nodes Nodes to process. The socket of each node is checked against
-     * `recv_set`, `send_set` and `error_set`.
-     * @param[in] recv_set Sockets that are ready for read.
-     * @param[in] send_set Sockets that are ready for send.
-     * @param[in] error_set Sockets that have an exceptional condition (error).
+     * @param[in] ready Sockets that are ready, those of listening sockets are skipped.
      */
-    void SocketHandlerConnected(const std::vector<CNode*>& nodes,
-                                const std::set<SOCKET>& recv_set,
-                                const std::set<SOCKET>& send_set,
-                                const std::set<SOCKET>& error_set);
+    void SocketHandlerConnected(const std::vector<SockEvents::Ready>& ready);
 
     /**
      * Accept incoming connections, one from each read-ready listening socket.
-     * @param[in] recv_set Sockets that are ready for read.
+     * @param[in] ready Sockets that are ready, those of connected sockets are skipped.
      */
-    void SocketHandlerListening(const std::set<SOCKET>& recv_set);
+    void SocketHandlerListening(const std::vector<SockEvents::Ready>& ready);
+
+    /** Return the listening socket registered with `m_sock_events` under this key, if any. */
+    const ListenSocket* FindListenSocket(const void* key) const;
 
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
@@ -1078,6 +1119,9 @@ private:
     NodeId GetNewNodeId();
 
     size_t SocketSendData(CNode& node) const EXCLUSIVE_LOCKS_REQUIRED(node.cs_vSend);
+
+    /** Append a message's header and payload to the send queue of a peer, and try to send them right away if it was empty. */
+    void QueueMessage(CNode* pnode, const std::string& msg_type, SendBuffer header, SendBuffer data);
     void DumpAddresses();
 
     // Network stats
@@ -1113,6 +1157,20 @@ private:
     unsigned int nReceiveFloodSize{0};
 
     std::vector<ListenSocket> vhListenSocket;
+
+    /**
+     * Waits for IO on the sockets of the listening sockets and nodes. They are
+     * registered under pointers to their ListenSocket and CNode. Nodes are
+     * only deleted by the socket handler thread, after their socket is closed,
+     * so the nodes it is handed back are alive.
+     */
+    const std::unique_ptr<SockEvents> m_sock_events{MakeSockEvents()};
+
+    /** Nodes not waited for receiving because their receive queue is full. Only used by the socket handler thread. */
+    std::vector<CNode*> m_paused_nodes;
+
+    /** When to check all nodes for inactivity next. Only used by the socket handler thread. */
+    std::chrono::steady_clock::time_point m_next_inactivity_check{};
     std::atomic<bool> fNetworkActive{true};
     bool fAddressesInitialized{false};
     AddrMan& addrman;
@@ -1181,6 +1239,8 @@ private:
     int nMaxAddnode;
     int nMaxFeeler;
     int m_max_outbound;
+    // How many threads process messages from and to peers
+    int m_num_msghand_threads{DEFAULT_MSGHAND_THREADS};
     bool m_use_addrman_outgoing;
     CClientUIInterface* m_client_interface;
     NetEventsInterface* m_msgproc;
@@ -1196,8 +1256,9 @@ private:
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake GUARDED_BY(mutexMsgProc);
+    /** Incremented for waking the message processor threads. Each of them
+     *  notices every increment, even those made while it was busy. */
+    uint64_t m_msgproc_wake_count GUARDED_BY(mutexMsgProc){0};
 
     std::condition_variable condMsgProc;
     Mutex mutexMsgProc;
@@ -1221,7 +1282,7 @@ private:
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> m_message_handler_threads;
     std::thread threadI2PAcceptIncoming;
 
     /** flag for deciding to connect to an extra outbound peer,
@@ -24,6 +24,7 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <random.h>
+#include <relaycache.h>
 #include <reverse_iterator.h>
 #include <scheduler.h>
 #include <streams.h>
@@ -34,15 +35,20 @@
 #include <txrequest.h>
 #include <util/check.h> // For NDEBUG compile time check
 #include <util/strencodings.h>
+#include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/thread.h>
 #include <util/trace.h>
 #include <validation.h>
 
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
 #include <optional>
+#include <thread>
 #include <typeinfo>
 
 using node::ReadBlockFromDisk;
@@ -101,6 +107,9 @@ static constexpr auto NONPREF_PEER_TX_DELAY{2s};
 static constexpr auto OVERLOADED_PEER_TX_DELAY{2s};
 /** How long to wait before downloading a transaction from an additional peer */
 static constexpr auto GETDATA_TX_INTERVAL{60s};
+/** Maximum number of orphan transactions reconsidered in one go, before giving other peers a turn.
+ *  Each one goes through mempool validation under cs_main, so this is kept small. */
+static constexpr unsigned int MAX_ORPHANS_RECONSIDERED{5};
 /** Limit to avoid sending big packets. Not used in processing incoming GETDATA for compatibility */
 static const unsigned int MAX_GETDATA_SZ = 1000;
 /** Number of blocks that can be requested at any given time from a single peer. */
@@ -183,6 +192,8 @@ struct QueuedBlock {
     std::unique_ptr<PartiallyDownloadedBlock> partialBlock;
 };
 
+struct CompactBlockReconstruction;
+
 /**
  * Data structure for an individual peer. This struct is not protected by
  * cs_main since it does not contain validation-critical data.
@@ -232,8 +243,11 @@ struct Peer {
     /** Whether a ping has been requested by the user */
     std::atomic<bool> m_ping_queued{false};
 
+    /** Protects the addresses queued for and known to this peer, which the
+     *  processing of other peers' messages adds to. */
+    Mutex m_addrs_to_send_mutex;
     /** A vector of addresses to send to the peer, limited to MAX_ADDR_TO_SEND. */
-    std::vector<CAddress> m_addrs_to_send;
+    std::vector<CAddress> m_addrs_to_send GUARDED_BY(m_addrs_to_send_mutex);
     /** Probabilistic filter to track recent addr messages relayed with this
      *  peer. Used to avoid relaying redundant addresses to this peer.
      *
@@ -243,7 +257,7 @@ struct Peer {
      *
      *  Presence of this filter must correlate with m_addr_relay_enabled.
      **/
-    std::unique_ptr<CRollingBloomFilter> m_addr_known;
+    std::unique_ptr<CRollingBloomFilter> m_addr_known GUARDED_BY(m_addrs_to_send_mutex);
     /** Whether we are participating in address relay with this connection.
      *
      *  We set this bool to true for outbound peers (other than
@@ -285,11 +299,28 @@ struct Peer {
     /** Set of txids to reconsider once their parent transactions have been accepted **/
     std::set<uint256> m_orphan_work_set GUARDED_BY(g_cs_orphans);
 
+    /** Whether this peer relays txs via wtxid **/
+    std::atomic_bool m_wtxid_relay{false};
+
+    /** Protects m_recently_announced_invs **/
+    Mutex m_recently_announced_invs_mutex;
+    /** A rolling bloom filter of all announced tx CInvs to this peer **/
+    CRollingBloomFilter m_recently_announced_invs GUARDED_BY(m_recently_announced_invs_mutex){INVENTORY_MAX_RECENT_RELAY, 0.000001};
+
     /** Protects m_getdata_requests **/
     Mutex m_getdata_requests_mutex;
     /** Work queue of items requested by this peer **/
     std::deque<CInv> m_getdata_requests GUARDED_BY(m_getdata_requests_mutex);
 
+    /** Protects compact block reconstruction data members **/
+    Mutex m_reconstruction_mutex;
+    /** Whether a compact block from this peer is being reconstructed. Its
+     *  further messages are not processed until that is done, so that they
+     *  are still handled in order. **/
+    bool m_reconstruction_pending GUARDED_BY(m_reconstruction_mutex){false};
+    /** The reconstruction once it is done, to be finished by the message handler thread **/
+    std::unique_ptr<CompactBlockReconstruction> m_reconstruction_done GUARDED_BY(m_reconstruction_mutex);
+
     explicit Peer(NodeId id)
         : m_id(id)
     {}
@@ -297,12 +328,41 @@ struct Peer {
 
 using PeerRef = std::shared_ptr<Peer>;
 
+/**
+ * A compact block to reconstruct from the mempool, or to complete with the
+ * transactions that were missing from it, on the reconstruction thread rather
+ * than the message handler thread.
+ */
+struct CompactBlockReconstruction {
+    /** The peer that sent the compact block or transactions. Not a PeerRef,
+     *  as the finished reconstruction is kept by the Peer itself. */
+    NodeId peer_id;
+    uint256 hash;
+    /** Whether the block is in flight from the peer, so that missing
+     *  transactions can be requested from it. Otherwise, only reconstructing
+     *  it from the mempool is attempted. */
+    bool in_flight{false};
+    std::unique_ptr<PartiallyDownloadedBlock> partial_block;
+    /** The compact block to initialize partial_block with, or nothing if it is initialized already */
+    std::optional<CBlockHeaderAndShortTxIDs> cmpctblock;
+    std::vector<std::pair<uint256, CTransactionRef>> extra_txn;
+    /** The transactions that were missing from partial_block, from a blocktxn message */
+    std::vector<CTransactionRef> missing_txn;
+
+    ReadStatus status{READ_STATUS_OK};
+    /** Indexes of the transactions to request, if the block could not be completed yet */
+    std::vector<uint16_t> missing_indexes;
+    /** The block, if it could be completed */
+    std::shared_ptr<CBlock> block;
+};
+
 class PeerManagerImpl final : public PeerManager
 {
 public:
     PeerManagerImpl(const CChainParams& chainparams, CConnman& connman, AddrMan& addrman,
                     BanMan* banman, ChainstateManager& chainman,
                     CTxMemPool& pool, bool ignore_incoming_txs);
+    ~PeerManagerImpl();
 
     /** Overridden from CValidationInterface. */
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected) override;
@@ -319,6 +379,7 @@ public:
 
     /** Implement PeerManager */
     void StartScheduledTasks(CScheduler& scheduler) override;
+    void StartReconstructionThread() override;
     void CheckForStaleTipAndEvictPeers() override;
     std::optional<std::string> FetchBlock(NodeId peer_id, const CBlockIndex& block_index) override;
     bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats) const override;
@@ -331,8 +392,7 @@ public:
                         const std::chrono::microseconds time_received, const std::atomic<bool>& interruptMsgProc) override;
 
 private:
-    void _RelayTransaction(const uint256& txid, const uint256& wtxid)
-        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    void _RelayTransaction(const uint256& txid, const uint256& wtxid);
 
     /** Consider evicting an outbound peer based on the amount of time they've been behind our tip */
     void ConsiderEviction(CNode& pto, std::chrono::seconds time_in_seconds) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -379,11 +439,11 @@ private:
      */
     bool MaybeDiscourageAndDisconnect(CNode& pnode, Peer& peer);
 
-    void ProcessOrphanTx(std::set<uint256>& orphan_work_set) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans);
+    void ProcessOrphanTx(std::set<uint256>& orphan_work_set) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_tx_download_mutex, g_cs_orphans);
     /** Process a single headers message from a peer. */
     void ProcessHeadersMessage(CNode& pfrom, const Peer& peer,
                                const std::vector<CBlockHeader>& headers,
-                               bool via_compact_block);
+                               bool via_compact_block) EXCLUSIVE_LOCKS_REQUIRED(m_block_download_mutex);
 
     void SendBlockTransactions(CNode& pfrom, const CBlock& block, const BlockTransactionsRequest& req);
 
@@ -391,7 +451,7 @@ private:
      *  peer. The announcement parameters are decided in PeerManager and then
      *  passed to TxRequestTracker. */
     void AddTxAnnouncement(const CNode& node, const GenTxid& gtxid, std::chrono::microseconds current_time)
-        EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+        EXCLUSIVE_LOCKS_REQUIRED(m_tx_download_mutex);
 
     /** Send a version message to a peer */
     void PushNodeVersion(CNode& pnode);
@@ -424,7 +484,43 @@ private:
     BanMan* const m_banman;
     ChainstateManager& m_chainman;
     CTxMemPool& m_mempool;
-    TxRequestTracker m_txrequest GUARDED_BY(::cs_main);
+
+    /**
+     * Protects the state of transaction downloads, so that announcements can
+     * be handled and transactions requested without cs_main, while messages
+     * from several peers are processed at once.
+     *
+     * Lock order: cs_main, m_tx_download_mutex, g_cs_orphans.
+     */
+    Mutex m_tx_download_mutex;
+
+    /**
+     * Held from accepting a peer's block headers until the blocks they
+     * announce have been requested from it, and while picking blocks to
+     * download in SendMessages. Accepting headers needs cs_main to be
+     * released, and otherwise another message handler thread could request
+     * those blocks from some other peer in between.
+     *
+     * Lock order: m_block_download_mutex, cs_main.
+     */
+    Mutex m_block_download_mutex;
+    TxRequestTracker m_txrequest GUARDED_BY(m_tx_download_mutex);
+
+    /** Transactions and blocks recently serialized for relay to some peer, to be shared with the others. */
+    RelayCache m_relay_cache;
+
+    /**
+     * Push a tx, block or cmpctblock message, reusing its serialization for
+     * another peer if there is one. Other than through `flags`, how these
+     * messages are serialized does not depend on the peer.
+     */
+    template <typename T>
+    void PushRelayMessage(CNode& node, const std::string& msg_type, const uint256& hash, int flags, const T& obj)
+    {
+        m_connman.PushMessage(&node, m_relay_cache.Get(msg_type, hash, flags, [&] {
+            return CNetMsgMaker{node.GetCommonVersion()}.Make(flags, msg_type, obj);
+        }));
+    }
 
     /** The height of the best chain */
     std::atomic<int> m_best_height{-1};
@@ -464,12 +560,12 @@ private:
     std::map<uint256, std::pair<NodeId, bool>> mapBlockSource GUARDED_BY(cs_main);
 
     /** Number of peers with wtxid relay. */
-    int m_wtxid_relay_peers GUARDED_BY(cs_main) = 0;
+    std::atomic<int> m_wtxid_relay_peers{0};
 
     /** Number of outbound peers with m_chain_sync.m_protect. */
     int m_outbound_peers_with_protect_from_disconnect GUARDED_BY(cs_main) = 0;
 
-    bool AlreadyHaveTx(const GenTxid& gtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool AlreadyHaveTx(const GenTxid& gtxid) EXCLUSIVE_LOCKS_REQUIRED(m_tx_download_mutex);
 
     /**
      * Filter for transactions that were recently rejected by the mempool.
@@ -505,8 +601,11 @@ private:
      *
      * Memory used: 1.3 MB
      */
-    CRollingBloomFilter m_recent_rejects GUARDED_BY(::cs_main){120'000, 0.000'001};
-    uint256 hashRecentRejectsChainTip GUARDED_BY(cs_main);
+    CRollingBloomFilter m_recent_rejects GUARDED_BY(m_tx_download_mutex){120'000, 0.000'001};
+    /** The chain tip m_recent_rejects was last reset for. Checked against g_best_block rather than
+     *  reset from UpdatedBlockTip, which runs asynchronously and would leave a window where a tx
+     *  that has become valid is still treated as rejected. */
+    uint256 m_recent_rejects_tip GUARDED_BY(m_tx_download_mutex);
 
     /*
      * Filter for transactions that have been recently confirmed.
@@ -563,18 +662,39 @@ private:
     std::atomic<std::chrono::seconds> m_last_tip_update{0s};
 
     /** Determine whether or not a peer can request a transaction, and return it (or nullptr if not found or not allowed). */
-    CTransactionRef FindTxForGetData(const CNode& peer, const GenTxid& gtxid, const std::chrono::seconds mempool_req, const std::chrono::seconds now) LOCKS_EXCLUDED(cs_main);
+    CTransactionRef FindTxForGetData(Peer& peer, const GenTxid& gtxid, const std::chrono::seconds mempool_req, const std::chrono::seconds now) LOCKS_EXCLUDED(cs_main);
 
     void ProcessGetData(CNode& pfrom, Peer& peer, const std::atomic<bool>& interruptMsgProc) EXCLUSIVE_LOCKS_REQUIRED(peer.m_getdata_requests_mutex) LOCKS_EXCLUDED(::cs_main);
 
     /** Process a new block. Perform any post-processing housekeeping */
     void ProcessBlock(CNode& node, const std::shared_ptr<const CBlock>& block, bool force_processing);
 
+    /** Hand a compact block to the reconstruction thread, holding back further messages from its peer. */
+    void QueueReconstruction(Peer& peer, std::unique_ptr<CompactBlockReconstruction> reconstruction) EXCLUSIVE_LOCKS_REQUIRED(!m_reconstruction_mutex);
+    /** Main loop of the reconstruction thread. */
+    void ThreadReconstructCompactBlocks() EXCLUSIVE_LOCKS_REQUIRED(!m_reconstruction_mutex);
+    /** Reconstruct a compact block, or complete it with the missing transactions. */
+    void ReconstructCompactBlock(CompactBlockReconstruction& reconstruction);
+    /**
+     * Act on a finished reconstruction of a compact block from a peer: request
+     * the missing transactions, or process the block.
+     * @return false if the reconstruction is not done yet, so messages from the peer must wait
+     */
+    bool FinishReconstruction(CNode& node, Peer& peer) LOCKS_EXCLUDED(::cs_main);
+
+    Mutex m_reconstruction_mutex;
+    std::condition_variable m_reconstruction_cond;
+    std::deque<std::unique_ptr<CompactBlockReconstruction>> m_reconstruction_queue GUARDED_BY(m_reconstruction_mutex);
+    bool m_reconstruction_interrupt GUARDED_BY(m_reconstruction_mutex){false};
+    std::thread m_reconstruction_thread;
+
+    /** Protects mapRelay and g_relay_expiration */
+    Mutex m_relay_mutex;
     /** Relay map (txid or wtxid -> CTransactionRef) */
     typedef std::map<uint256, CTransactionRef> MapRelay;
-    MapRelay mapRelay GUARDED_BY(cs_main);
+    MapRelay mapRelay GUARDED_BY(m_relay_mutex);
     /** Expiration-time ordered list of (expire time, relay map entry) pairs. */
-    std::deque<std::pair<std::chrono::microseconds, MapRelay::iterator>> g_relay_expiration GUARDED_BY(cs_main);
+    std::deque<std::pair<std::chrono::microseconds, MapRelay::iterator>> g_relay_expiration GUARDED_BY(m_relay_mutex);
 
     /**
      * When a peer sends us a valid block, instruct it to announce blocks to us
@@ -776,12 +896,6 @@ struct CNodeState {
     //! Whether this peer is an inbound connection
     const bool m_is_inbound;
 
-    //! A rolling bloom filter of all announced tx CInvs to this peer.
-    CRollingBloomFilter m_recently_announced_invs = CRollingBloomFilter{INVENTORY_MAX_RECENT_RELAY, 0.000001};
-
-    //! Whether this peer relays txs via wtxid
-    bool m_wtxid_relay{false};
-
     CNodeState(bool is_inbound) : m_is_inbound(is_inbound) {}
 };
 
@@ -807,6 +921,7 @@ static bool IsAddrCompatible(const Peer& peer, const CAddress& addr)
 
 static void AddAddressKnown(Peer& peer, const CAddress& addr)
 {
+    LOCK(peer.m_addrs_to_send_mutex);
     assert(peer.m_addr_known);
     peer.m_addr_known->insert(addr.GetKey());
 }
@@ -816,6 +931,7 @@ static void PushAddress(Peer& peer, const CAddress& addr, FastRandomContext& ins
     // Known checking here is only to save space from duplicates.
     // Before sending, we'll filter it again for known addresses that were
     // added after addresses were pushed.
+    LOCK(peer.m_addrs_to_send_mutex);
     assert(peer.m_addr_known);
     if (addr.IsValid() && !peer.m_addr_known->contains(addr.GetKey()) && IsAddrCompatible(peer, addr)) {
         if (peer.m_addrs_to_send.size() >= MAX_ADDR_TO_SEND) {
@@ -826,12 +942,17 @@ static void PushAddress(Peer& peer, const CAddress& addr, FastRandomContext& ins
     }
 }
 
+/** Whether this node should be marked as a preferred download node. */
+static bool IsPreferredDownload(const CNode& node)
+{
+    return (!node.IsInboundConn() || node.HasPermission(NetPermissionFlags::NoBan)) && !node.IsAddrFetchConn() && !node.fClient;
+}
+
 static void UpdatePreferredDownload(const CNode& node, CNodeState* state) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     nPreferredDownload -= state->fPreferredDownload;
 
-    // Whether this node should be marked as a preferred download node.
-    state->fPreferredDownload = (!node.IsInboundConn() || node.HasPermission(NetPermissionFlags::NoBan)) && !node.IsAddrFetchConn() && !node.fClient;
+    state->fPreferredDownload = IsPreferredDownload(node);
 
     nPreferredDownload += state->fPreferredDownload;
 }
@@ -839,13 +960,14 @@ static void UpdatePreferredDownload(const CNode& node, CNodeState* state) EXCLUS
 std::chrono::microseconds PeerManagerImpl::NextInvToInbounds(std::chrono::microseconds now,
                                                              std::chrono::seconds average_interval)
 {
-    if (m_next_inv_to_inbounds.load() < now) {
-        // If this function were called from multiple threads simultaneously
-        // it would possible that both update the next send variable, and return a different result to their caller.
-        // This is not possible in practice as only the net processing thread invokes this function.
-        m_next_inv_to_inbounds = GetExponentialRand(now, average_interval);
-    }
-    return m_next_inv_to_inbounds;
+    auto next{m_next_inv_to_inbounds.load()};
+    while (next < now) {
+        // Message handler threads calling this simultaneously must agree on
+        // the next send time, so only one of them may move it.
+        const auto candidate{GetExponentialRand(now, average_interval)};
+        if (m_next_inv_to_inbounds.compare_exchange_weak(next, candidate)) return candidate;
+    }
+    return next;
 }
 
 bool PeerManagerImpl::IsBlockRequested(const uint256& hash)
@@ -1151,13 +1273,12 @@ void PeerManagerImpl::PushNodeVersion(CNode& pnode)
 
 void PeerManagerImpl::AddTxAnnouncement(const CNode& node, const GenTxid& gtxid, std::chrono::microseconds current_time)
 {
-    AssertLockHeld(::cs_main); // For m_txrequest
+    AssertLockHeld(m_tx_download_mutex); // For m_txrequest
     NodeId nodeid = node.GetId();
     if (!node.HasPermission(NetPermissionFlags::Relay) && m_txrequest.Count(nodeid) >= MAX_PEER_TX_ANNOUNCEMENTS) {
         // Too many queued announcements from this peer
         return;
     }
-    const CNodeState* state = State(nodeid);
 
     // Decide the TxRequestTracker parameters for this announcement:
     // - "preferred": if fPreferredDownload is set (= outbound, or NetPermissionFlags::NoBan permission)
@@ -1167,7 +1288,7 @@ void PeerManagerImpl::AddTxAnnouncement(const CNode& node, const GenTxid& gtxid,
     //   - OVERLOADED_PEER_TX_DELAY for announcements from peers which have at least
     //     MAX_PEER_TX_REQUEST_IN_FLIGHT requests in flight (and don't have NetPermissionFlags::Relay).
     auto delay{0us};
-    const bool preferred = state->fPreferredDownload;
+    const bool preferred = IsPreferredDownload(node);
     if (!preferred) delay += NONPREF_PEER_TX_DELAY;
     if (!gtxid.IsWtxid() && m_wtxid_relay_peers > 0) delay += TXID_RELAY_DELAY;
     const bool overloaded = !node.HasPermission(NetPermissionFlags::Relay) &&
@@ -1229,7 +1350,7 @@ void PeerManagerImpl::FinalizeNode(const CNode& node)
     NodeId nodeid = node.GetId();
     int misbehavior{0};
     {
-    LOCK(cs_main);
+    LOCK2(cs_main, m_tx_download_mutex);
     {
         // We remove the PeerRef from g_peer_map here, but we don't always
         // destruct the Peer. Sometimes another thread is still holding a
@@ -1239,6 +1360,11 @@ void PeerManagerImpl::FinalizeNode(const CNode& node)
         PeerRef peer = RemovePeer(nodeid);
         assert(peer != nullptr);
         misbehavior = WITH_LOCK(peer->m_misbehavior_mutex, return peer->m_misbehavior_score);
+        m_wtxid_relay_peers -= peer->m_wtxid_relay;
+        // A reconstruction still queued for the peer is dropped once it is done.
+        LOCK(peer->m_reconstruction_mutex);
+        peer->m_reconstruction_pending = false;
+        peer->m_reconstruction_done.reset();
     }
     CNodeState *state = State(nodeid);
     assert(state != nullptr);
@@ -1249,14 +1375,13 @@ void PeerManagerImpl::FinalizeNode(const CNode& node)
     for (const QueuedBlock& entry : state->vBlocksInFlight) {
         mapBlocksInFlight.erase(entry.pindex->GetBlockHash());
     }
-    WITH_LOCK(g_cs_orphans, m_orphanage.EraseForPeer(nodeid));
+    m_orphanage.EraseForPeer(nodeid);
     m_txrequest.DisconnectedPeer(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
     m_peers_downloading_from -= (state->nBlocksInFlight != 0);
     assert(m_peers_downloading_from >= 0);
     m_outbound_peers_with_protect_from_disconnect -= state->m_chain_sync.m_protect;
     assert(m_outbound_peers_with_protect_from_disconnect >= 0);
-    m_wtxid_relay_peers -= state->m_wtxid_relay;
     assert(m_wtxid_relay_peers >= 0);
 
     mapNodeState.erase(nodeid);
@@ -1515,6 +1640,19 @@ PeerManagerImpl::PeerManagerImpl(const CChainParams& chainparams, CConnman& conn
 {
 }
 
+PeerManagerImpl::~PeerManagerImpl()
+{
+    WITH_LOCK(m_reconstruction_mutex, m_reconstruction_interrupt = true);
+    m_reconstruction_cond.notify_all();
+    if (m_reconstruction_thread.joinable()) m_reconstruction_thread.join();
+}
+
+void PeerManagerImpl::StartReconstructionThread()
+{
+    assert(!m_reconstruction_thread.joinable());
+    m_reconstruction_thread = std::thread(&util::TraceThread, "cmpctblock", [this] { ThreadReconstructCompactBlocks(); });
+}
+
 void PeerManagerImpl::StartScheduledTasks(CScheduler& scheduler)
 {
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -1549,7 +1687,7 @@ void PeerManagerImpl::BlockConnected(const std::shared_ptr<const CBlock>& pblock
         }
     }
     {
-        LOCK(cs_main);
+        LOCK(m_tx_download_mutex);
         for (const auto& ptx : pblock->vtx) {
             m_txrequest.ForgetTxHash(ptx->GetHash());
             m_txrequest.ForgetTxHash(ptx->GetWitnessHash());
@@ -1608,7 +1746,6 @@ void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::sha
     m_connman.ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
         AssertLockHeld(::cs_main);
 
-        // TODO: Avoid the repeated-serialization here
         if (pnode->GetCommonVersion() < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -1620,7 +1757,11 @@ void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::sha
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerManager::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
-            m_connman.PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            // Serialized once, for the first peer it is announced to, and
+            // kept for those that request it later.
+            m_connman.PushMessage(pnode, m_relay_cache.Get(NetMsgType::CMPCTBLOCK, hashBlock, /*flags=*/0, [&] {
+                return msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock);
+            }));
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1708,13 +1849,18 @@ void PeerManagerImpl::BlockChecked(const CBlock& block, const BlockValidationSta
 
 bool PeerManagerImpl::AlreadyHaveTx(const GenTxid& gtxid)
 {
-    if (m_chainman.ActiveChain().Tip()->GetBlockHash() != hashRecentRejectsChainTip) {
+    AssertLockHeld(m_tx_download_mutex);
+
+    {
         // If the chain tip has changed previously rejected transactions
         // might be now valid, e.g. due to a nLockTime'd tx becoming valid,
         // or a double-spend. Reset the rejects filter and give those
         // txs a second chance.
-        hashRecentRejectsChainTip = m_chainman.ActiveChain().Tip()->GetBlockHash();
-        m_recent_rejects.reset();
+        LOCK(g_best_block_mutex);
+        if (g_best_block != m_recent_rejects_tip) {
+            m_recent_rejects_tip = g_best_block;
+            m_recent_rejects.reset();
+        }
     }
 
     const uint256& hash = gtxid.GetHash();
@@ -1742,17 +1888,15 @@ void PeerManagerImpl::SendPings()
 
 void PeerManagerImpl::RelayTransaction(const uint256& txid, const uint256& wtxid)
 {
-    WITH_LOCK(cs_main, _RelayTransaction(txid, wtxid););
+    _RelayTransaction(txid, wtxid);
 }
 
 void PeerManagerImpl::_RelayTransaction(const uint256& txid, const uint256& wtxid)
 {
-    m_connman.ForEachNode([&txid, &wtxid](CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
-        AssertLockHeld(::cs_main);
-
-        CNodeState* state = State(pnode->GetId());
-        if (state == nullptr) return;
-        if (state->m_wtxid_relay) {
+    m_connman.ForEachNode([this, &txid, &wtxid](CNode* pnode) {
+        const PeerRef peer{GetPeerRef(pnode->GetId())};
+        if (peer == nullptr) return;
+        if (peer->m_wtxid_relay) {
             pnode->PushTxInventory(wtxid);
         } else {
             pnode->PushTxInventory(txid);
@@ -1876,7 +2020,14 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
         return;
     }
     std::shared_ptr<const CBlock> pblock;
-    if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
+    std::optional<CSharedNetMsg> cached_block;
+    if (inv.IsMsgBlk() || inv.IsMsgWitnessBlk()) {
+        cached_block = m_relay_cache.Find(NetMsgType::BLOCK, pindex->GetBlockHash(), inv.IsMsgBlk() ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
+    }
+    if (cached_block) {
+        m_connman.PushMessage(&pfrom, *cached_block);
+        // Don't set pblock as we've sent the block
+    } else if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
         pblock = a_recent_block;
     } else if (inv.IsMsgWitnessBlk()) {
         // Fast-path: in this case it is possible to serve the block directly from disk,
@@ -1885,7 +2036,8 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
         if (!ReadRawBlockFromDisk(block_data, pindex->GetBlockPos(), m_chainparams.MessageStart())) {
             assert(!"cannot load block from disk");
         }
-        m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, Span{block_data}));
+        m_connman.PushMessage(&pfrom, m_relay_cache.Add(NetMsgType::BLOCK, pindex->GetBlockHash(), /*flags=*/0,
+                                                        CSharedNetMsg{msgMaker.Make(NetMsgType::BLOCK, Span{block_data})}));
         // Don't set pblock as we've sent the block
     } else {
         // Send block from disk
@@ -1897,9 +2049,9 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
     }
     if (pblock) {
         if (inv.IsMsgBlk()) {
-            m_connman.PushMessage(&pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
+            PushRelayMessage(pfrom, NetMsgType::BLOCK, pindex->GetBlockHash(), SERIALIZE_TRANSACTION_NO_WITNESS, *pblock);
         } else if (inv.IsMsgWitnessBlk()) {
-            m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
+            PushRelayMessage(pfrom, NetMsgType::BLOCK, pindex->GetBlockHash(), /*flags=*/0, *pblock);
         } else if (inv.IsMsgFilteredBlk()) {
             bool sendMerkleBlock = false;
             CMerkleBlock merkleBlock;
@@ -1933,13 +2085,15 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
             int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
             if (CanDirectFetch() && pindex->nHeight >= m_chainman.ActiveChain().Height() - MAX_CMPCTBLOCK_DEPTH) {
                 if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
-                    m_connman.PushMessage(&pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+                    PushRelayMessage(pfrom, NetMsgType::CMPCTBLOCK, pindex->GetBlockHash(), nSendFlags, *a_recent_compact_block);
+                } else if (auto cached_cmpctblock{m_relay_cache.Find(NetMsgType::CMPCTBLOCK, pindex->GetBlockHash(), nSendFlags)}) {
+                    m_connman.PushMessage(&pfrom, *cached_cmpctblock);
                 } else {
                     CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
-                    m_connman.PushMessage(&pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+                    PushRelayMessage(pfrom, NetMsgType::CMPCTBLOCK, pindex->GetBlockHash(), nSendFlags, cmpctblock);
                 }
             } else {
-                m_connman.PushMessage(&pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
+                PushRelayMessage(pfrom, NetMsgType::BLOCK, pindex->GetBlockHash(), nSendFlags, *pblock);
             }
         }
     }
@@ -1959,7 +2113,7 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
     }
 }
 
-CTransactionRef PeerManagerImpl::FindTxForGetData(const CNode& peer, const GenTxid& gtxid, const std::chrono::seconds mempool_req, const std::chrono::seconds now)
+CTransactionRef PeerManagerImpl::FindTxForGetData(Peer& peer, const GenTxid& gtxid, const std::chrono::seconds mempool_req, const std::chrono::seconds now)
 {
     auto txinfo = m_mempool.info(gtxid);
     if (txinfo.tx) {
@@ -1971,16 +2125,14 @@ CTransactionRef PeerManagerImpl::FindTxForGetData(const CNode& peer, const GenTx
         }
     }
 
-    {
-        LOCK(cs_main);
-        // Otherwise, the transaction must have been announced recently.
-        if (State(peer.GetId())->m_recently_announced_invs.contains(gtxid.GetHash())) {
-            // If it was, it can be relayed from either the mempool...
-            if (txinfo.tx) return std::move(txinfo.tx);
-            // ... or the relay pool.
-            auto mi = mapRelay.find(gtxid.GetHash());
-            if (mi != mapRelay.end()) return mi->second;
-        }
+    // Otherwise, the transaction must have been announced recently.
+    if (WITH_LOCK(peer.m_recently_announced_invs_mutex, return peer.m_recently_announced_invs.contains(gtxid.GetHash()))) {
+        // If it was, it can be relayed from either the mempool...
+        if (txinfo.tx) return std::move(txinfo.tx);
+        // ... or the relay pool.
+        LOCK(m_relay_mutex);
+        auto mi = mapRelay.find(gtxid.GetHash());
+        if (mi != mapRelay.end()) return mi->second;
     }
 
     return {};
@@ -2014,11 +2166,11 @@ void PeerManagerImpl::ProcessGetData(CNode& pfrom, Peer& peer, const std::atomic
             continue;
         }
 
-        CTransactionRef tx = FindTxForGetData(pfrom, ToGenTxid(inv), mempool_req, now);
+        CTransactionRef tx = FindTxForGetData(peer, ToGenTxid(inv), mempool_req, now);
         if (tx) {
             // WTX and WITNESS_TX imply we serialize with witness
             int nSendFlags = (inv.IsMsgTx() ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
-            m_connman.PushMessage(&pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *tx));
+            PushRelayMessage(pfrom, NetMsgType::TX, tx->GetWitnessHash(), nSendFlags, *tx);
             m_mempool.RemoveUnbroadcastTx(tx->GetHash());
             // As we're going to send tx, make sure its unconfirmed parents are made requestable.
             std::vector<uint256> parent_ids_to_add;
@@ -2038,8 +2190,8 @@ void PeerManagerImpl::ProcessGetData(CNode& pfrom, Peer& peer, const std::atomic
             for (const uint256& parent_txid : parent_ids_to_add) {
                 // Relaying a transaction with a recent but unconfirmed parent.
                 if (WITH_LOCK(pfrom.m_tx_relay->cs_tx_inventory, return !pfrom.m_tx_relay->filterInventoryKnown.contains(parent_txid))) {
-                    LOCK(cs_main);
-                    State(pfrom.GetId())->m_recently_announced_invs.insert(parent_txid);
+                    LOCK(peer.m_recently_announced_invs_mutex);
+                    peer.m_recently_announced_invs.insert(parent_txid);
                 }
             }
         } else {
@@ -2107,6 +2259,7 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, const Peer& peer,
                                             const std::vector<CBlockHeader>& headers,
                                             bool via_compact_block)
 {
+    AssertLockHeld(m_block_download_mutex);
     const CNetMsgMaker msgMaker(pfrom.GetCommonVersion());
     size_t nCount = headers.size();
 
@@ -2295,22 +2448,28 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, const Peer& peer,
 /**
  * Reconsider orphan transactions after a parent has been accepted to the mempool.
  *
- * @param[in,out]  orphan_work_set  The set of orphan transactions to reconsider. Generally only one
- *                                  orphan will be reconsidered on each call of this function. This set
- *                                  may be added to if accepting an orphan causes its children to be
- *                                  reconsidered.
+ * @param[in,out]  orphan_work_set  The set of orphan transactions to reconsider. Up to
+ *                                  MAX_ORPHANS_RECONSIDERED orphans are reconsidered on each call of
+ *                                  this function, the rest are left for the next one, which
+ *                                  ProcessMessages makes after other peers had a turn. This set is
+ *                                  added to when accepting an orphan causes its children to be
+ *                                  reconsidered, so a chain of orphans resolves without waiting for
+ *                                  further messages.
  */
 void PeerManagerImpl::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
 {
     AssertLockHeld(cs_main);
+    AssertLockHeld(m_tx_download_mutex);
     AssertLockHeld(g_cs_orphans);
 
-    while (!orphan_work_set.empty()) {
+    unsigned int num_reconsidered{0};
+    while (!orphan_work_set.empty() && num_reconsidered < MAX_ORPHANS_RECONSIDERED) {
         const uint256 orphanHash = *orphan_work_set.begin();
         orphan_work_set.erase(orphan_work_set.begin());
 
         const auto [porphanTx, from_peer] = m_orphanage.GetTx(orphanHash);
         if (porphanTx == nullptr) continue;
+        ++num_reconsidered;
 
         const MempoolAcceptResult result = m_chainman.ProcessTransaction(porphanTx);
         const TxValidationState& state = result.m_state;
@@ -2323,7 +2482,6 @@ void PeerManagerImpl::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
             for (const CTransactionRef& removedTx : result.m_replaced_transactions.value()) {
                 AddToCompactExtraTransactions(removedTx);
             }
-            break;
         } else if (state.GetResult() != TxValidationResult::TX_MISSING_INPUTS) {
             if (state.IsInvalid()) {
                 LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s from peer=%d. %s\n",
@@ -2366,7 +2524,6 @@ void PeerManagerImpl::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
                 }
             }
             m_orphanage.EraseTx(orphanHash);
-            break;
         }
     }
 }
@@ -2551,6 +2708,179 @@ void PeerManagerImpl::ProcessBlock(CNode& node, const std::shared_ptr<const CBlo
     }
 }
 
+void PeerManagerImpl::QueueReconstruction(Peer& peer, std::unique_ptr<CompactBlockReconstruction> reconstruction)
+{
+    WITH_LOCK(peer.m_reconstruction_mutex, peer.m_reconstruction_pending = true);
+    {
+        LOCK(m_reconstruction_mutex);
+        m_reconstruction_queue.push_back(std::move(reconstruction));
+    }
+    m_reconstruction_cond.notify_one();
+}
+
+void PeerManagerImpl::ThreadReconstructCompactBlocks()
+{
+    SetSyscallSandboxPolicy(SyscallSandboxPolicy::COMPACT_BLOCK);
+    while (true) {
+        std::unique_ptr<CompactBlockReconstruction> reconstruction;
+        {
+            WAIT_LOCK(m_reconstruction_mutex, lock);
+            m_reconstruction_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_reconstruction_mutex) {
+                return m_reconstruction_interrupt || !m_reconstruction_queue.empty();
+            });
+            if (m_reconstruction_interrupt) return;
+            reconstruction = std::move(m_reconstruction_queue.front());
+            m_reconstruction_queue.pop_front();
+        }
+        ReconstructCompactBlock(*reconstruction);
+        // The peer may have disconnected meanwhile.
+        const PeerRef peer{GetPeerRef(reconstruction->peer_id)};
+        if (!peer) continue;
+        {
+            LOCK(peer->m_reconstruction_mutex);
+            if (!peer->m_reconstruction_pending) continue;
+            peer->m_reconstruction_done = std::move(reconstruction);
+        }
+        m_connman.WakeMessageHandler();
+    }
+}
+
+void PeerManagerImpl::ReconstructCompactBlock(CompactBlockReconstruction& reconstruction)
+{
+    if (reconstruction.cmpctblock) {
+        reconstruction.status = reconstruction.partial_block->InitData(*reconstruction.cmpctblock, reconstruction.extra_txn);
+        if (reconstruction.status != READ_STATUS_OK) return;
+        if (reconstruction.in_flight) {
+            for (size_t i = 0; i < reconstruction.cmpctblock->BlockTxCount(); i++) {
+                if (!reconstruction.partial_block->IsTxAvailable(i)) {
+                    reconstruction.missing_indexes.push_back(i);
+                }
+            }
+            if (!reconstruction.missing_indexes.empty()) return;
+        }
+    }
+    reconstruction.block = std::make_shared<CBlock>();
+    reconstruction.status = reconstruction.partial_block->FillBlock(*reconstruction.block, reconstruction.missing_txn);
+}
+
+bool PeerManagerImpl::FinishReconstruction(CNode& pfrom, Peer& peer)
+{
+    std::unique_ptr<CompactBlockReconstruction> reconstruction;
+    {
+        LOCK(peer.m_reconstruction_mutex);
+        if (!peer.m_reconstruction_pending) return true;
+        if (!peer.m_reconstruction_done) return false;
+        reconstruction = std::move(peer.m_reconstruction_done);
+        peer.m_reconstruction_pending = false;
+    }
+    const uint256& hash{reconstruction->hash};
+    const CNetMsgMaker msgMaker(pfrom.GetCommonVersion());
+
+    if (!reconstruction->in_flight) {
+        if (reconstruction->status != READ_STATUS_OK) {
+            // TODO: don't ignore failures
+            return true;
+        }
+        // If we got here, we were able to optimistically reconstruct a
+        // block that is in flight from some other peer.
+        {
+            LOCK(cs_main);
+            mapBlockSource.emplace(hash, std::make_pair(pfrom.GetId(), false));
+        }
+        // Setting force_processing to true means that we bypass some of
+        // our anti-DoS protections in AcceptBlock, which filters
+        // unrequested blocks that might be trying to waste our resources
+        // (eg disk space). Because we only try to reconstruct blocks when
+        // we're close to caught up (via the CanDirectFetch() requirement
+        // in the compact block handler, combined with the behavior of not
+        // requesting blocks until we have a chain with at least
+        // nMinimumChainWork), and we ignore compact blocks with less work
+        // than our tip, it is safe to treat reconstructed compact blocks
+        // as having been requested.
+        ProcessBlock(pfrom, reconstruction->block, /*force_processing=*/true);
+        LOCK(cs_main); // hold cs_main for CBlockIndex::IsValid()
+        const CBlockIndex* pindex = m_chainman.m_blockman.LookupBlockIndex(hash);
+        if (pindex && pindex->IsValid(BLOCK_VALID_TRANSACTIONS)) {
+            // Clear download state for this block, which is in
+            // process from some other peer.  We do this after calling
+            // ProcessNewBlock so that a malleated cmpctblock announcement
+            // can't be used to interfere with block relay.
+            RemoveBlockRequest(hash);
+        }
+        return true;
+    }
+
+    {
+        LOCK(cs_main);
+
+        // The block may have been received in full, or timed out, in the meantime.
+        auto it = mapBlocksInFlight.find(hash);
+        if (it == mapBlocksInFlight.end() || it->second.first != pfrom.GetId()) {
+            LogPrint(BCLog::NET, "Block %s from peer=%d is no longer in flight after reconstructing it\n", hash.ToString(), pfrom.GetId());
+            return true;
+        }
+
+        if (reconstruction->status == READ_STATUS_INVALID) {
+            RemoveBlockRequest(hash); // Reset in-flight state in case Misbehaving does not result in a disconnect
+            Misbehaving(pfrom.GetId(), 100, reconstruction->cmpctblock ? "invalid compact block" : "invalid compact block/non-matching block transactions");
+            return true;
+        } else if (reconstruction->status == READ_STATUS_FAILED) {
+            // Duplicate txindexes in the compact block, or the transactions
+            // might have collided: the block is in flight, so just request it.
+            std::vector<CInv> invs;
+            invs.push_back(CInv(MSG_BLOCK | GetFetchFlags(pfrom), hash));
+            m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETDATA, invs));
+            return true;
+        } else if (!reconstruction->block) {
+            // Keep the initialized partial block for the peer's blocktxn reply.
+            it->second.second->partialBlock = std::move(reconstruction->partial_block);
+            BlockTransactionsRequest req;
+            req.blockhash = hash;
+            req.indexes = std::move(reconstruction->missing_indexes);
+            m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETBLOCKTXN, req));
+            return true;
+        }
+
+        // Block is either okay, or possibly we received
+        // READ_STATUS_CHECKBLOCK_FAILED.
+        // Note that CheckBlock can only fail for one of a few reasons:
+        // 1. bad-proof-of-work (impossible here, because we've already
+        //    accepted the header)
+        // 2. merkleroot doesn't match the transactions given (already
+        //    caught in FillBlock with READ_STATUS_FAILED, so
+        //    impossible here)
+        // 3. the block is otherwise invalid (eg invalid coinbase,
+        //    block is too big, too many legacy sigops, etc).
+        // So if CheckBlock failed, #3 is the only possibility.
+        // Under BIP 152, we don't discourage the peer unless proof of work is
+        // invalid (we don't require all the stateless checks to have
+        // been run).  This is handled below, so just treat this as
+        // though the block was successfully read, and rely on the
+        // handling in ProcessNewBlock to ensure the block index is
+        // updated, etc.
+        // The request is cleared once the block has been stored, as for a
+        // full block.
+        State(pfrom.GetId())->m_stalling_since = 0us;
+        // mapBlockSource is used for potentially punishing peers and
+        // updating which peers send us compact blocks, so the race
+        // between here and cs_main in ProcessNewBlock is fine.
+        // BIP 152 permits peers to relay compact blocks after validating
+        // the header only; we should not punish peers if the block turns
+        // out to be invalid.
+        mapBlockSource.emplace(hash, std::make_pair(pfrom.GetId(), false));
+    } // Don't hold cs_main when we call into ProcessNewBlock
+
+    // Since we requested this block (it was in mapBlocksInFlight), force it to be processed,
+    // even if it would not be a candidate for new tip (missing previous block, chain not long enough, etc)
+    // This bypasses some anti-DoS logic in AcceptBlock (eg to prevent
+    // disk-space attacks), but this should be safe due to the
+    // protections in the compact block handler -- see related comment
+    // in compact block optimistic reconstruction handling.
+    ProcessBlock(pfrom, reconstruction->block, /*force_processing=*/true);
+    WITH_LOCK(cs_main, RemoveBlockRequest(hash));
+    return true;
+}
+
 void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type, CDataStream& vRecv,
                                      const std::chrono::microseconds time_received,
                                      const std::atomic<bool>& interruptMsgProc)
@@ -2863,9 +3193,8 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             return;
         }
         if (pfrom.GetCommonVersion() >= WTXID_RELAY_VERSION) {
-            LOCK(cs_main);
-            if (!State(pfrom.GetId())->m_wtxid_relay) {
-                State(pfrom.GetId())->m_wtxid_relay = true;
+            if (!peer->m_wtxid_relay) {
+                peer->m_wtxid_relay = true;
                 m_wtxid_relay_peers++;
             } else {
                 LogPrint(BCLog::NET, "ignoring duplicate wtxidrelay from peer=%d\n", pfrom.GetId());
@@ -3008,24 +3337,39 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             reject_tx_invs = false;
         }
 
-        LOCK(cs_main);
-
-        const auto current_time{GetTime<std::chrono::microseconds>()};
-        uint256* best_block{nullptr};
-
+        std::vector<CInv> block_invs;
+        std::vector<CInv> tx_invs;
         for (CInv& inv : vInv) {
-            if (interruptMsgProc) return;
-
             // Ignore INVs that don't match wtxidrelay setting.
             // Note that orphan parent fetching always uses MSG_TX GETDATAs regardless of the wtxidrelay setting.
             // This is fine as no INV messages are involved in that process.
-            if (State(pfrom.GetId())->m_wtxid_relay) {
+            if (peer->m_wtxid_relay) {
                 if (inv.IsMsgTx()) continue;
             } else {
                 if (inv.IsMsgWtx()) continue;
             }
 
             if (inv.IsMsgBlk()) {
+                block_invs.push_back(inv);
+            } else if (inv.IsGenTxMsg()) {
+                if (reject_tx_invs) {
+                    LogPrint(BCLog::NET, "transaction (%s) inv sent in violation of protocol, disconnecting peer=%d\n", inv.hash.ToString(), pfrom.GetId());
+                    pfrom.fDisconnect = true;
+                    return;
+                }
+                tx_invs.push_back(inv);
+            } else {
+                LogPrint(BCLog::NET, "Unknown inv type \"%s\" received from peer=%d\n", inv.ToString(), pfrom.GetId());
+            }
+        }
+
+        if (!block_invs.empty()) {
+            LOCK(cs_main);
+            const uint256* best_block{nullptr};
+
+            for (const CInv& inv : block_invs) {
+                if (interruptMsgProc) return;
+
                 const bool fAlreadyHave = AlreadyHaveBlock(inv.hash);
                 LogPrint(BCLog::NET, "got inv: %s  %s peer=%d\n", inv.ToString(), fAlreadyHave ? "have" : "new", pfrom.GetId());
 
@@ -3038,30 +3382,35 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                     // then fetch the blocks we need to catch up.
                     best_block = &inv.hash;
                 }
-            } else if (inv.IsGenTxMsg()) {
-                if (reject_tx_invs) {
-                    LogPrint(BCLog::NET, "transaction (%s) inv sent in violation of protocol, disconnecting peer=%d\n", inv.hash.ToString(), pfrom.GetId());
-                    pfrom.fDisconnect = true;
-                    return;
-                }
+            }
+
+            if (best_block != nullptr) {
+                m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETHEADERS, m_chainman.ActiveChain().GetLocator(pindexBestHeader), *best_block));
+                LogPrint(BCLog::NET, "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, best_block->ToString(), pfrom.GetId());
+            }
+        }
+
+        if (!tx_invs.empty()) {
+            // Transaction announcements don't need cs_main, so that they are
+            // handled while other peers' transactions are being validated.
+            const bool is_ibd{m_chainman.ActiveChainstate().IsInitialBlockDownload()};
+            const auto current_time{GetTime<std::chrono::microseconds>()};
+            LOCK(m_tx_download_mutex);
+
+            for (const CInv& inv : tx_invs) {
+                if (interruptMsgProc) return;
+
                 const GenTxid gtxid = ToGenTxid(inv);
                 const bool fAlreadyHave = AlreadyHaveTx(gtxid);
                 LogPrint(BCLog::NET, "got inv: %s  %s peer=%d\n", inv.ToString(), fAlreadyHave ? "have" : "new", pfrom.GetId());
 
                 pfrom.AddKnownTx(inv.hash);
-                if (!fAlreadyHave && !m_chainman.ActiveChainstate().IsInitialBlockDownload()) {
+                if (!fAlreadyHave && !is_ibd) {
                     AddTxAnnouncement(pfrom, gtxid, current_time);
                 }
-            } else {
-                LogPrint(BCLog::NET, "Unknown inv type \"%s\" received from peer=%d\n", inv.ToString(), pfrom.GetId());
             }
         }
 
-        if (best_block != nullptr) {
-            m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETHEADERS, m_chainman.ActiveChain().GetLocator(pindexBestHeader), *best_block));
-            LogPrint(BCLog::NET, "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, best_block->ToString(), pfrom.GetId());
-        }
-
         return;
     }
 
@@ -3297,13 +3646,12 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         const uint256& txid = ptx->GetHash();
         const uint256& wtxid = ptx->GetWitnessHash();
 
-        LOCK2(cs_main, g_cs_orphans);
-
-        CNodeState* nodestate = State(pfrom.GetId());
+        LOCK2(cs_main, m_tx_download_mutex);
+        LOCK(g_cs_orphans);
 
-        const uint256& hash = nodestate->m_wtxid_relay ? wtxid : txid;
+        const uint256& hash = peer->m_wtxid_relay ? wtxid : txid;
         pfrom.AddKnownTx(hash);
-        if (nodestate->m_wtxid_relay && txid != wtxid) {
+        if (peer->m_wtxid_relay && txid != wtxid) {
             // Insert txid into filterInventoryKnown, even for
             // wtxidrelay peers. This prevents re-adding of
             // unconfirmed parents to the recently_announced
@@ -3502,6 +3850,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
 
         bool received_new_header = false;
 
+        LOCK(m_block_download_mutex);
         {
         LOCK(cs_main);
 
@@ -3526,22 +3875,14 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             }
         }
 
-        // When we succeed in decoding a block's txids from a cmpctblock
-        // message we typically jump to the BLOCKTXN handling code, with a
-        // dummy (empty) BLOCKTXN message, to re-use the logic there in
-        // completing processing of the putative block (without cs_main).
-        bool fProcessBLOCKTXN = false;
-        CDataStream blockTxnMsg(SER_NETWORK, PROTOCOL_VERSION);
+        // Matching the short IDs against our mempool, and completing the
+        // block, is done on the reconstruction thread (without cs_main).
+        std::unique_ptr<CompactBlockReconstruction> reconstruction;
 
         // If we end up treating this as a plain headers message, call that as well
         // without cs_main.
         bool fRevertToHeaderProcessing = false;
 
-        // Keep a CBlock for "optimistic" compactblock reconstructions (see
-        // below)
-        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        bool fBlockReconstructed = false;
-
         {
         LOCK2(cs_main, g_cs_orphans);
         // If AcceptBlockHeader returned true, it set pindex
@@ -3601,53 +3942,25 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                     }
                 }
 
-                PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
-                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
-                if (status == READ_STATUS_INVALID) {
-                    RemoveBlockRequest(pindex->GetBlockHash()); // Reset in-flight state in case Misbehaving does not result in a disconnect
-                    Misbehaving(pfrom.GetId(), 100, "invalid compact block");
-                    return;
-                } else if (status == READ_STATUS_FAILED) {
-                    // Duplicate txindexes, the block is now in-flight, so just request it
-                    std::vector<CInv> vInv(1);
-                    vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), cmpctblock.header.GetHash());
-                    m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
-                    return;
-                }
-
-                BlockTransactionsRequest req;
-                for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
-                    if (!partialBlock.IsTxAvailable(i))
-                        req.indexes.push_back(i);
-                }
-                if (req.indexes.empty()) {
-                    // Dirty hack to jump to BLOCKTXN code (TODO: move message handling into their own functions)
-                    BlockTransactions txn;
-                    txn.blockhash = cmpctblock.header.GetHash();
-                    blockTxnMsg << txn;
-                    fProcessBLOCKTXN = true;
-                } else {
-                    req.blockhash = pindex->GetBlockHash();
-                    m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETBLOCKTXN, req));
-                }
+                // The (uninitialized) partialBlock marks the block as being
+                // downloaded using compact blocks until the reconstruction
+                // thread hands back the one it initializes.
+                reconstruction = std::make_unique<CompactBlockReconstruction>();
+                reconstruction->in_flight = true;
             } else {
                 // This block is either already in flight from a different
                 // peer, or this peer has too many blocks outstanding to
                 // download from.
                 // Optimistically try to reconstruct anyway since we might be
                 // able to without any round trips.
-                PartiallyDownloadedBlock tempBlock(&m_mempool);
-                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
-                if (status != READ_STATUS_OK) {
-                    // TODO: don't ignore failures
-                    return;
-                }
-                std::vector<CTransactionRef> dummy;
-                status = tempBlock.FillBlock(*pblock, dummy);
-                if (status == READ_STATUS_OK) {
-                    fBlockReconstructed = true;
-                }
+                reconstruction = std::make_unique<CompactBlockReconstruction>();
+                reconstruction->in_flight = false;
             }
+            reconstruction->peer_id = pfrom.GetId();
+            reconstruction->hash = pindex->GetBlockHash();
+            reconstruction->partial_block = std::make_unique<PartiallyDownloadedBlock>(&m_mempool);
+            reconstruction->cmpctblock = std::move(cmpctblock);
+            reconstruction->extra_txn = vExtraTxnForCompact;
         } else {
             if (fAlreadyInFlight) {
                 // We requested this block, but its far into the future, so our
@@ -3663,8 +3976,9 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         }
         } // cs_main
 
-        if (fProcessBLOCKTXN) {
-            return ProcessMessage(pfrom, NetMsgType::BLOCKTXN, blockTxnMsg, time_received, interruptMsgProc);
+        if (reconstruction) {
+            QueueReconstruction(*peer, std::move(reconstruction));
+            return;
         }
 
         if (fRevertToHeaderProcessing) {
@@ -3675,33 +3989,6 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             // will be detected and the peer will be disconnected/discouraged.
             return ProcessHeadersMessage(pfrom, *peer, {cmpctblock.header}, /*via_compact_block=*/true);
         }
-
-        if (fBlockReconstructed) {
-            // If we got here, we were able to optimistically reconstruct a
-            // block that is in flight from some other peer.
-            {
-                LOCK(cs_main);
-                mapBlockSource.emplace(pblock->GetHash(), std::make_pair(pfrom.GetId(), false));
-            }
-            // Setting force_processing to true means that we bypass some of
-            // our anti-DoS protections in AcceptBlock, which filters
-            // unrequested blocks that might be trying to waste our resources
-            // (eg disk space). Because we only try to reconstruct blocks when
-            // we're close to caught up (via the CanDirectFetch() requirement
-            // above, combined with the behavior of not requesting blocks until
-            // we have a chain with at least nMinimumChainWork), and we ignore
-            // compact blocks with less work than our tip, it is safe to treat
-            // reconstructed compact blocks as having been requested.
-            ProcessBlock(pfrom, pblock, /*force_processing=*/true);
-            LOCK(cs_main); // hold cs_main for CBlockIndex::IsValid()
-            if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS)) {
-                // Clear download state for this block, which is in
-                // process from some other peer.  We do this after calling
-                // ProcessNewBlock so that a malleated cmpctblock announcement
-                // can't be used to interfere with block relay.
-                RemoveBlockRequest(pblock->GetHash());
-            }
-        }
         return;
     }
 
@@ -3716,8 +4003,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         BlockTransactions resp;
         vRecv >> resp;
 
-        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        bool fBlockRead = false;
+        auto reconstruction = std::make_unique<CompactBlockReconstruction>();
         {
             LOCK(cs_main);
 
@@ -3728,55 +4014,15 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                 return;
             }
 
-            PartiallyDownloadedBlock& partialBlock = *it->second.second->partialBlock;
-            ReadStatus status = partialBlock.FillBlock(*pblock, resp.txn);
-            if (status == READ_STATUS_INVALID) {
-                RemoveBlockRequest(resp.blockhash); // Reset in-flight state in case Misbehaving does not result in a disconnect
-                Misbehaving(pfrom.GetId(), 100, "invalid compact block/non-matching block transactions");
-                return;
-            } else if (status == READ_STATUS_FAILED) {
-                // Might have collided, fall back to getdata now :(
-                std::vector<CInv> invs;
-                invs.push_back(CInv(MSG_BLOCK | GetFetchFlags(pfrom), resp.blockhash));
-                m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETDATA, invs));
-            } else {
-                // Block is either okay, or possibly we received
-                // READ_STATUS_CHECKBLOCK_FAILED.
-                // Note that CheckBlock can only fail for one of a few reasons:
-                // 1. bad-proof-of-work (impossible here, because we've already
-                //    accepted the header)
-                // 2. merkleroot doesn't match the transactions given (already
-                //    caught in FillBlock with READ_STATUS_FAILED, so
-                //    impossible here)
-                // 3. the block is otherwise invalid (eg invalid coinbase,
-                //    block is too big, too many legacy sigops, etc).
-                // So if CheckBlock failed, #3 is the only possibility.
-                // Under BIP 152, we don't discourage the peer unless proof of work is
-                // invalid (we don't require all the stateless checks to have
-                // been run).  This is handled below, so just treat this as
-                // though the block was successfully read, and rely on the
-                // handling in ProcessNewBlock to ensure the block index is
-                // updated, etc.
-                RemoveBlockRequest(resp.blockhash); // it is now an empty pointer
-                fBlockRead = true;
-                // mapBlockSource is used for potentially punishing peers and
-                // updating which peers send us compact blocks, so the race
-                // between here and cs_main in ProcessNewBlock is fine.
-                // BIP 152 permits peers to relay compact blocks after validating
-                // the header only; we should not punish peers if the block turns
-                // out to be invalid.
-                mapBlockSource.emplace(resp.blockhash, std::make_pair(pfrom.GetId(), false));
-            }
-        } // Don't hold cs_main when we call into ProcessNewBlock
-        if (fBlockRead) {
-            // Since we requested this block (it was in mapBlocksInFlight), force it to be processed,
-            // even if it would not be a candidate for new tip (missing previous block, chain not long enough, etc)
-            // This bypasses some anti-DoS logic in AcceptBlock (eg to prevent
-            // disk-space attacks), but this should be safe due to the
-            // protections in the compact block handler -- see related comment
-            // in compact block optimistic reconstruction handling.
-            ProcessBlock(pfrom, pblock, /*force_processing=*/true);
+            // The block is completed on the reconstruction thread, which takes
+            // the partial block; the block stays in flight until it is done.
+            reconstruction->peer_id = pfrom.GetId();
+            reconstruction->hash = resp.blockhash;
+            reconstruction->in_flight = true;
+            reconstruction->partial_block = std::move(it->second.second->partialBlock);
+            reconstruction->missing_txn = std::move(resp.txn);
         }
+        QueueReconstruction(*peer, std::move(reconstruction));
         return;
     }
 
@@ -3802,6 +4048,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        LOCK(m_block_download_mutex);
         return ProcessHeadersMessage(pfrom, *peer, headers, /*via_compact_block=*/false);
     }
 
@@ -3824,14 +4071,21 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             LOCK(cs_main);
             // Always process the block if we requested it, since we may
             // need it even when it's not a candidate for a new best tip.
-            forceProcessing = IsBlockRequested(hash);
-            RemoveBlockRequest(hash);
+            const auto it_in_flight{mapBlocksInFlight.find(hash)};
+            forceProcessing = it_in_flight != mapBlocksInFlight.end();
+            // The block has arrived, so whoever it was requested from is no
+            // longer stalling the download window.
+            if (forceProcessing) State(it_in_flight->second.first)->m_stalling_since = 0us;
             // mapBlockSource is only used for punishing peers and setting
             // which peers send us compact blocks, so the race between here and
             // cs_main in ProcessNewBlock is fine.
             mapBlockSource.emplace(hash, std::make_pair(pfrom.GetId(), true));
         }
         ProcessBlock(pfrom, pblock, forceProcessing);
+        // Keep the block in flight until it has been stored, so that another
+        // message handler thread does not request it from a different peer
+        // in the meantime.
+        WITH_LOCK(cs_main, RemoveBlockRequest(hash));
         return;
     }
 
@@ -3858,7 +4112,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         }
         peer->m_getaddr_recvd = true;
 
-        peer->m_addrs_to_send.clear();
+        WITH_LOCK(peer->m_addrs_to_send_mutex, peer->m_addrs_to_send.clear());
         std::vector<CAddress> vAddr;
         if (pfrom.HasPermission(NetPermissionFlags::Addr)) {
             vAddr = m_connman.GetAddresses(MAX_ADDR_TO_SEND, MAX_PCT_ADDR_TO_SEND, /* network */ std::nullopt);
@@ -4072,7 +4326,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         std::vector<CInv> vInv;
         vRecv >> vInv;
         if (vInv.size() <= MAX_PEER_TX_ANNOUNCEMENTS + MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
-            LOCK(::cs_main);
+            LOCK(m_tx_download_mutex);
             for (CInv &inv : vInv) {
                 if (inv.IsGenTxMsg()) {
                     // If we receive a NOTFOUND message for a tx we requested, mark the announcement for it as
@@ -4142,13 +4396,15 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
         }
     }
 
-    {
-        LOCK2(cs_main, g_cs_orphans);
-        if (!peer->m_orphan_work_set.empty()) {
-            ProcessOrphanTx(peer->m_orphan_work_set);
-        }
+    if (WITH_LOCK(g_cs_orphans, return !peer->m_orphan_work_set.empty())) {
+        LOCK2(cs_main, m_tx_download_mutex);
+        LOCK(g_cs_orphans);
+        ProcessOrphanTx(peer->m_orphan_work_set);
     }
 
+    // Messages following a compact block wait for its reconstruction.
+    if (!FinishReconstruction(*pfrom, *peer)) return false;
+
     if (pfrom->fDisconnect)
         return false;
 
@@ -4206,6 +4462,7 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
     } catch (...) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes): Unknown exception caught\n", __func__, SanitizeString(msg.m_type), msg.m_message_size);
     }
+    pfrom->m_recv_buffers.Put(std::move(msg.m_recv));
 
     return fMoreWork;
 }
@@ -4453,7 +4710,7 @@ void PeerManagerImpl::MaybeSendAddr(CNode& node, Peer& peer, std::chrono::micros
         // bandwidth cost that we can incur by doing this (which happens
         // once a day on average).
         if (peer.m_next_local_addr_send != 0us) {
-            peer.m_addr_known->reset();
+            WITH_LOCK(peer.m_addrs_to_send_mutex, peer.m_addr_known->reset());
         }
         if (std::optional<CAddress> local_addr = GetLocalAddrForPeer(&node)) {
             FastRandomContext insecure_rand;
@@ -4467,6 +4724,7 @@ void PeerManagerImpl::MaybeSendAddr(CNode& node, Peer& peer, std::chrono::micros
 
     peer.m_next_addr_send = GetExponentialRand(current_time, AVG_ADDRESS_BROADCAST_INTERVAL);
 
+    LOCK(peer.m_addrs_to_send_mutex);
     if (!Assume(peer.m_addrs_to_send.size() <= MAX_ADDR_TO_SEND)) {
         // Should be impossible since we always check size before adding to
         // m_addrs_to_send. Recover by trimming the vector.
@@ -4475,7 +4733,7 @@ void PeerManagerImpl::MaybeSendAddr(CNode& node, Peer& peer, std::chrono::micros
 
     // Remove addr records that the peer already knows about, and add new
     // addrs to the m_addr_known filter on the same pass.
-    auto addr_already_known = [&peer](const CAddress& addr) {
+    auto addr_already_known = [&peer](const CAddress& addr) EXCLUSIVE_LOCKS_REQUIRED(peer.m_addrs_to_send_mutex) {
         bool ret = peer.m_addr_known->contains(addr.GetKey());
         if (!ret) peer.m_addr_known->insert(addr.GetKey());
         return ret;
@@ -4575,10 +4833,11 @@ bool PeerManagerImpl::SetupAddressRelay(const CNode& node, Peer& peer)
     // information of addr traffic to infer the link.
     if (node.IsBlockOnlyConn()) return false;
 
-    if (!peer.m_addr_relay_enabled.exchange(true)) {
+    if (!peer.m_addr_relay_enabled) {
         // First addr message we have received from the peer, initialize
-        // m_addr_known
-        peer.m_addr_known = std::make_unique<CRollingBloomFilter>(5000, 0.001);
+        // m_addr_known before other peers may relay addresses to it
+        WITH_LOCK(peer.m_addrs_to_send_mutex, peer.m_addr_known = std::make_unique<CRollingBloomFilter>(5000, 0.001));
+        peer.m_addr_relay_enabled = true;
     }
 
     return true;
@@ -4616,6 +4875,8 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
 
     MaybeSendAddr(*pto, *peer, current_time);
 
+    // Download if this is a nice peer, or we have no nice peers and this one might do.
+    bool fFetch;
     {
         LOCK(cs_main);
 
@@ -4624,7 +4885,7 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
         // Start block sync
         if (pindexBestHeader == nullptr)
             pindexBestHeader = m_chainman.ActiveChain().Tip();
-        bool fFetch = state.fPreferredDownload || (nPreferredDownload == 0 && !pto->fClient && !pto->IsAddrFetchConn()); // Download if this is a nice peer, or we have no nice peers and this one might do.
+        fFetch = state.fPreferredDownload || (nPreferredDownload == 0 && !pto->fClient && !pto->IsAddrFetchConn());
         if (!state.fSyncStarted && !pto->fClient && !fImporting && !fReindex) {
             // Only actively request headers from a single peer, unless we're close to today.
             if ((nSyncStarted == 0 && fFetch) || pindexBestHeader->GetBlockTime() > GetAdjustedTime() - 24 * 60 * 60) {
@@ -4732,10 +4993,10 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                         LOCK(cs_most_recent_block);
                         if (most_recent_block_hash == pBestIndex->GetBlockHash()) {
                             if (state.fWantsCmpctWitness || !fWitnessesPresentInMostRecentCompactBlock)
-                                m_connman.PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *most_recent_compact_block));
+                                PushRelayMessage(*pto, NetMsgType::CMPCTBLOCK, most_recent_block_hash, nSendFlags, *most_recent_compact_block);
                             else {
-                                CBlockHeaderAndShortTxIDs cmpctblock(*most_recent_block, state.fWantsCmpctWitness);
-                                m_connman.PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+                                PushRelayMessage(*pto, NetMsgType::CMPCTBLOCK, most_recent_block_hash, nSendFlags,
+                                                 CBlockHeaderAndShortTxIDs{*most_recent_block, state.fWantsCmpctWitness});
                             }
                             fGotBlockFromCache = true;
                         }
@@ -4790,157 +5051,164 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
             }
             peer->m_blocks_for_headers_relay.clear();
         }
+    } // release cs_main
 
-        //
-        // Message: inventory
-        //
-        std::vector<CInv> vInv;
-        {
-            LOCK(peer->m_block_inv_mutex);
-            vInv.reserve(std::max<size_t>(peer->m_blocks_for_inv_relay.size(), INVENTORY_BROADCAST_MAX));
-
-            // Add blocks
-            for (const uint256& hash : peer->m_blocks_for_inv_relay) {
-                vInv.push_back(CInv(MSG_BLOCK, hash));
-                if (vInv.size() == MAX_INV_SZ) {
-                    m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
-                    vInv.clear();
-                }
+    //
+    // Message: inventory
+    //
+    std::vector<CInv> vInv;
+    {
+        LOCK(peer->m_block_inv_mutex);
+        vInv.reserve(std::max<size_t>(peer->m_blocks_for_inv_relay.size(), INVENTORY_BROADCAST_MAX));
+
+        // Add blocks
+        for (const uint256& hash : peer->m_blocks_for_inv_relay) {
+            vInv.push_back(CInv(MSG_BLOCK, hash));
+            if (vInv.size() == MAX_INV_SZ) {
+                m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                vInv.clear();
             }
-            peer->m_blocks_for_inv_relay.clear();
         }
+        peer->m_blocks_for_inv_relay.clear();
+    }
 
-        if (pto->m_tx_relay != nullptr) {
-                LOCK(pto->m_tx_relay->cs_tx_inventory);
-                // Check whether periodic sends should happen
-                bool fSendTrickle = pto->HasPermission(NetPermissionFlags::NoBan);
-                if (pto->m_tx_relay->nNextInvSend < current_time) {
-                    fSendTrickle = true;
-                    if (pto->IsInboundConn()) {
-                        pto->m_tx_relay->nNextInvSend = NextInvToInbounds(current_time, INBOUND_INVENTORY_BROADCAST_INTERVAL);
-                    } else {
-                        pto->m_tx_relay->nNextInvSend = GetExponentialRand(current_time, OUTBOUND_INVENTORY_BROADCAST_INTERVAL);
-                    }
+    if (pto->m_tx_relay != nullptr) {
+            LOCK(pto->m_tx_relay->cs_tx_inventory);
+            // Check whether periodic sends should happen
+            bool fSendTrickle = pto->HasPermission(NetPermissionFlags::NoBan);
+            if (pto->m_tx_relay->nNextInvSend < current_time) {
+                fSendTrickle = true;
+                if (pto->IsInboundConn()) {
+                    pto->m_tx_relay->nNextInvSend = NextInvToInbounds(current_time, INBOUND_INVENTORY_BROADCAST_INTERVAL);
+                } else {
+                    pto->m_tx_relay->nNextInvSend = GetExponentialRand(current_time, OUTBOUND_INVENTORY_BROADCAST_INTERVAL);
                 }
+            }
 
-                // Time to send but the peer has requested we not relay transactions.
-                if (fSendTrickle) {
-                    LOCK(pto->m_tx_relay->cs_filter);
-                    if (!pto->m_tx_relay->fRelayTxes) pto->m_tx_relay->setInventoryTxToSend.clear();
-                }
+            // Time to send but the peer has requested we not relay transactions.
+            if (fSendTrickle) {
+                LOCK(pto->m_tx_relay->cs_filter);
+                if (!pto->m_tx_relay->fRelayTxes) pto->m_tx_relay->setInventoryTxToSend.clear();
+            }
 
-                // Respond to BIP35 mempool requests
-                if (fSendTrickle && pto->m_tx_relay->fSendMempool) {
-                    auto vtxinfo = m_mempool.infoAll();
-                    pto->m_tx_relay->fSendMempool = false;
-                    const CFeeRate filterrate{pto->m_tx_relay->minFeeFilter.load()};
-
-                    LOCK(pto->m_tx_relay->cs_filter);
-
-                    for (const auto& txinfo : vtxinfo) {
-                        const uint256& hash = state.m_wtxid_relay ? txinfo.tx->GetWitnessHash() : txinfo.tx->GetHash();
-                        CInv inv(state.m_wtxid_relay ? MSG_WTX : MSG_TX, hash);
-                        pto->m_tx_relay->setInventoryTxToSend.erase(hash);
-                        // Don't send transactions that peers will not put into their mempool
-                        if (txinfo.fee < filterrate.GetFee(txinfo.vsize)) {
-                            continue;
-                        }
-                        if (pto->m_tx_relay->pfilter) {
-                            if (!pto->m_tx_relay->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
-                        }
-                        pto->m_tx_relay->filterInventoryKnown.insert(hash);
-                        // Responses to MEMPOOL requests bypass the m_recently_announced_invs filter.
-                        vInv.push_back(inv);
-                        if (vInv.size() == MAX_INV_SZ) {
-                            m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
-                            vInv.clear();
-                        }
+            // Respond to BIP35 mempool requests
+            if (fSendTrickle && pto->m_tx_relay->fSendMempool) {
+                auto vtxinfo = m_mempool.infoAll();
+                pto->m_tx_relay->fSendMempool = false;
+                const CFeeRate filterrate{pto->m_tx_relay->minFeeFilter.load()};
+
+                LOCK(pto->m_tx_relay->cs_filter);
+
+                for (const auto& txinfo : vtxinfo) {
+                    const uint256& hash = peer->m_wtxid_relay ? txinfo.tx->GetWitnessHash() : txinfo.tx->GetHash();
+                    CInv inv(peer->m_wtxid_relay ? MSG_WTX : MSG_TX, hash);
+                    pto->m_tx_relay->setInventoryTxToSend.erase(hash);
+                    // Don't send transactions that peers will not put into their mempool
+                    if (txinfo.fee < filterrate.GetFee(txinfo.vsize)) {
+                        continue;
+                    }
+                    if (pto->m_tx_relay->pfilter) {
+                        if (!pto->m_tx_relay->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+                    }
+                    pto->m_tx_relay->filterInventoryKnown.insert(hash);
+                    // Responses to MEMPOOL requests bypass the m_recently_announced_invs filter.
+                    vInv.push_back(inv);
+                    if (vInv.size() == MAX_INV_SZ) {
+                        m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                        vInv.clear();
                     }
-                    pto->m_tx_relay->m_last_mempool_req = std::chrono::duration_cast<std::chrono::seconds>(current_time);
                 }
+                pto->m_tx_relay->m_last_mempool_req = std::chrono::duration_cast<std::chrono::seconds>(current_time);
+            }
 
-                // Determine transactions to relay
-                if (fSendTrickle) {
-                    // Produce a vector with all candidates for sending
-                    std::vector<std::set<uint256>::iterator> vInvTx;
-                    vInvTx.reserve(pto->m_tx_relay->setInventoryTxToSend.size());
-                    for (std::set<uint256>::iterator it = pto->m_tx_relay->setInventoryTxToSend.begin(); it != pto->m_tx_relay->setInventoryTxToSend.end(); it++) {
-                        vInvTx.push_back(it);
+            // Determine transactions to relay
+            if (fSendTrickle) {
+                // Produce a vector with all candidates for sending
+                std::vector<std::set<uint256>::iterator> vInvTx;
+                vInvTx.reserve(pto->m_tx_relay->setInventoryTxToSend.size());
+                for (std::set<uint256>::iterator it = pto->m_tx_relay->setInventoryTxToSend.begin(); it != pto->m_tx_relay->setInventoryTxToSend.end(); it++) {
+                    vInvTx.push_back(it);
+                }
+                const CFeeRate filterrate{pto->m_tx_relay->minFeeFilter.load()};
+                // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
+                // A heap is used so that not all items need sorting if only a few are being sent.
+                CompareInvMempoolOrder compareInvMempoolOrder(&m_mempool, peer->m_wtxid_relay);
+                std::make_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
+                // No reason to drain out at many times the network's capacity,
+                // especially since we have many peers and some will draw much shorter delays.
+                unsigned int nRelayedTransactions = 0;
+                LOCK(pto->m_tx_relay->cs_filter);
+                while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX) {
+                    // Fetch the top element from the heap
+                    std::pop_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
+                    std::set<uint256>::iterator it = vInvTx.back();
+                    vInvTx.pop_back();
+                    uint256 hash = *it;
+                    CInv inv(peer->m_wtxid_relay ? MSG_WTX : MSG_TX, hash);
+                    // Remove it from the to-be-sent set
+                    pto->m_tx_relay->setInventoryTxToSend.erase(it);
+                    // Check if not in the filter already
+                    if (pto->m_tx_relay->filterInventoryKnown.contains(hash)) {
+                        continue;
                     }
-                    const CFeeRate filterrate{pto->m_tx_relay->minFeeFilter.load()};
-                    // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
-                    // A heap is used so that not all items need sorting if only a few are being sent.
-                    CompareInvMempoolOrder compareInvMempoolOrder(&m_mempool, state.m_wtxid_relay);
-                    std::make_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
-                    // No reason to drain out at many times the network's capacity,
-                    // especially since we have many peers and some will draw much shorter delays.
-                    unsigned int nRelayedTransactions = 0;
-                    LOCK(pto->m_tx_relay->cs_filter);
-                    while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX) {
-                        // Fetch the top element from the heap
-                        std::pop_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
-                        std::set<uint256>::iterator it = vInvTx.back();
-                        vInvTx.pop_back();
-                        uint256 hash = *it;
-                        CInv inv(state.m_wtxid_relay ? MSG_WTX : MSG_TX, hash);
-                        // Remove it from the to-be-sent set
-                        pto->m_tx_relay->setInventoryTxToSend.erase(it);
-                        // Check if not in the filter already
-                        if (pto->m_tx_relay->filterInventoryKnown.contains(hash)) {
-                            continue;
-                        }
-                        // Not in the mempool anymore? don't bother sending it.
-                        auto txinfo = m_mempool.info(ToGenTxid(inv));
-                        if (!txinfo.tx) {
-                            continue;
-                        }
-                        auto txid = txinfo.tx->GetHash();
-                        auto wtxid = txinfo.tx->GetWitnessHash();
-                        // Peer told you to not send transactions at that feerate? Don't bother sending it.
-                        if (txinfo.fee < filterrate.GetFee(txinfo.vsize)) {
-                            continue;
-                        }
-                        if (pto->m_tx_relay->pfilter && !pto->m_tx_relay->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
-                        // Send
-                        State(pto->GetId())->m_recently_announced_invs.insert(hash);
-                        vInv.push_back(inv);
-                        nRelayedTransactions++;
+                    // Not in the mempool anymore? don't bother sending it.
+                    auto txinfo = m_mempool.info(ToGenTxid(inv));
+                    if (!txinfo.tx) {
+                        continue;
+                    }
+                    auto txid = txinfo.tx->GetHash();
+                    auto wtxid = txinfo.tx->GetWitnessHash();
+                    // Peer told you to not send transactions at that feerate? Don't bother sending it.
+                    if (txinfo.fee < filterrate.GetFee(txinfo.vsize)) {
+                        continue;
+                    }
+                    if (pto->m_tx_relay->pfilter && !pto->m_tx_relay->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+                    // Send
+                    WITH_LOCK(peer->m_recently_announced_invs_mutex, peer->m_recently_announced_invs.insert(hash));
+                    vInv.push_back(inv);
+                    nRelayedTransactions++;
+                    {
+                        LOCK(m_relay_mutex);
+                        // Expire old relay messages
+                        while (!g_relay_expiration.empty() && g_relay_expiration.front().first < current_time)
                         {
-                            // Expire old relay messages
-                            while (!g_relay_expiration.empty() && g_relay_expiration.front().first < current_time)
-                            {
-                                mapRelay.erase(g_relay_expiration.front().second);
-                                g_relay_expiration.pop_front();
-                            }
-
-                            auto ret = mapRelay.emplace(txid, std::move(txinfo.tx));
-                            if (ret.second) {
-                                g_relay_expiration.emplace_back(current_time + RELAY_TX_CACHE_TIME, ret.first);
-                            }
-                            // Add wtxid-based lookup into mapRelay as well, so that peers can request by wtxid
-                            auto ret2 = mapRelay.emplace(wtxid, ret.first->second);
-                            if (ret2.second) {
-                                g_relay_expiration.emplace_back(current_time + RELAY_TX_CACHE_TIME, ret2.first);
-                            }
+                            mapRelay.erase(g_relay_expiration.front().second);
+                            g_relay_expiration.pop_front();
                         }
-                        if (vInv.size() == MAX_INV_SZ) {
-                            m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
-                            vInv.clear();
+
+                        auto ret = mapRelay.emplace(txid, std::move(txinfo.tx));
+                        if (ret.second) {
+                            g_relay_expiration.emplace_back(current_time + RELAY_TX_CACHE_TIME, ret.first);
                         }
-                        pto->m_tx_relay->filterInventoryKnown.insert(hash);
-                        if (hash != txid) {
-                            // Insert txid into filterInventoryKnown, even for
-                            // wtxidrelay peers. This prevents re-adding of
-                            // unconfirmed parents to the recently_announced
-                            // filter, when a child tx is requested. See
-                            // ProcessGetData().
-                            pto->m_tx_relay->filterInventoryKnown.insert(txid);
+                        // Add wtxid-based lookup into mapRelay as well, so that peers can request by wtxid
+                        auto ret2 = mapRelay.emplace(wtxid, ret.first->second);
+                        if (ret2.second) {
+                            g_relay_expiration.emplace_back(current_time + RELAY_TX_CACHE_TIME, ret2.first);
                         }
                     }
+                    if (vInv.size() == MAX_INV_SZ) {
+                        m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                        vInv.clear();
+                    }
+                    pto->m_tx_relay->filterInventoryKnown.insert(hash);
+                    if (hash != txid) {
+                        // Insert txid into filterInventoryKnown, even for
+                        // wtxidrelay peers. This prevents re-adding of
+                        // unconfirmed parents to the recently_announced
+                        // filter, when a child tx is requested. See
+                        // ProcessGetData().
+                        pto->m_tx_relay->filterInventoryKnown.insert(txid);
+                    }
                 }
-        }
-        if (!vInv.empty())
-            m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+            }
+    }
+    if (!vInv.empty())
+        m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+
+    {
+        LOCK2(m_block_download_mutex, cs_main);
+
+        CNodeState& state = *State(pto->GetId());
 
         // Detect whether we're stalling
         if (state.m_stalling_since.count() && state.m_stalling_since < current_time - BLOCK_STALLING_TIMEOUT) {
@@ -5028,6 +5296,7 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
         //
         // Message: getdata (transactions)
         //
+        LOCK(m_tx_download_mutex);
         std::vector<std::pair<NodeId, GenTxid>> expired;
         auto requestable = m_txrequest.GetRequestable(pto->GetId(), current_time, &expired);
         for (const auto& entry : expired) {
@@ -12,6 +12,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 extern RecursiveMutex cs_main;
@@ -188,7 +189,8 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 
-void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFiles, const ArgsManager& args);
+/** Import blocks and load the mempool afterwards, using load_mempool instead of CChainState::LoadMempool() if given. */
+void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFiles, const ArgsManager& args, const std::function<void(CChainState&)>& load_mempool = {});
 } // namespace node
 
 #endif // BITCOIN_NODE_BLOCKSTORAGE_H
@@ -9,6 +9,8 @@
 #include <interfaces/chain.h>
 #include <net.h>
 #include <net_processing.h>
+#include <node/mempool_journal.h>
+#include <node/miner.h>
 #include <policy/fees.h>
 #include <scheduler.h>
 #include <txmempool.h>
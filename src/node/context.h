@@ -27,6 +27,9 @@ class WalletLoader;
 } // namespace interfaces
 
 namespace node {
+class BlockTemplateCache;
+class MempoolJournal;
+
 //! NodeContext struct containing references to chain state and connection
 //! state.
 //!
@@ -43,9 +46,11 @@ struct NodeContext {
     std::unique_ptr<AddrMan> addrman;
     std::unique_ptr<CConnman> connman;
     std::unique_ptr<CTxMemPool> mempool;
+    std::unique_ptr<MempoolJournal> mempool_journal;
     std::unique_ptr<CBlockPolicyEstimator> fee_estimator;
     std::unique_ptr<PeerManager> peerman;
     std::unique_ptr<ChainstateManager> chainman;
+    std::unique_ptr<BlockTemplateCache> block_template_cache;
     std::unique_ptr<BanMan> banman;
     ArgsManager* args{nullptr}; // Currently a raw pointer because the memory is not managed by this struct
     std::unique_ptr<interfaces::Chain> chain;
@@ -0,0 +1,375 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/mempool_journal.h>
+
+#include <clientversion.h>
+#include <consensus/amount.h>
+#include <logging.h>
+#include <serialize.h>
+#include <shutdown.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <util/hasher.h>
+#include <util/system.h>
+#include <util/thread.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <ios>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace node {
+static const uint64_t MEMPOOL_JOURNAL_VERSION = 1;
+
+MempoolJournal::MempoolJournal(CTxMemPool& pool, const fs::path& data_dir)
+    : m_pool{pool},
+      m_path{data_dir / "mempool.journal"},
+      m_new_path{data_dir / "mempool.journal.new"},
+      m_dump_path{data_dir / "mempool.dat"} {}
+
+MempoolJournal::~MempoolJournal()
+{
+    WaitForCompaction();
+    LOCK(m_mutex);
+    if (m_file) std::fclose(m_file);
+}
+
+template <typename... Args>
+void MempoolJournal::Append(Record type, const Args&... args)
+{
+    AssertLockHeld(m_mutex);
+    if (!m_file && !m_compacting) return;
+    CDataStream record{SER_DISK, CLIENT_VERSION};
+    record << uint8_t(type);
+    (record << ... << args);
+    if (m_compacting) {
+        const auto bytes{MakeUCharSpan(record)};
+        m_compact_records.insert(m_compact_records.end(), bytes.begin(), bytes.end());
+    }
+    if (!m_file) return;
+    const size_t written{std::fwrite(record.data(), 1, record.size(), m_file)};
+    if (written != record.size()) {
+        LogPrintf("Failed to append to mempool journal. Continuing anyway.\n");
+    }
+    m_journal_bytes += written;
+}
+
+void MempoolJournal::Load(CChainState& active_chainstate)
+{
+    std::set<uint256> txids;
+    bool replayed{false};
+    // A mempool.dat written (or put in place) after the last change to the
+    // journal takes precedence.
+    if (fs::exists(m_path) && !(fs::exists(m_dump_path) && fs::last_write_time(m_dump_path) > fs::last_write_time(m_path))) {
+        const ReplayResult result{Replay(active_chainstate, txids)};
+        if (result == ReplayResult::UNUSABLE) {
+            // Leave the journal as it is, for the software that wrote it.
+            // Changes to the mempool are not recorded.
+            m_pool.SetIsLoaded(!ShutdownRequested());
+            return;
+        }
+        replayed = result == ReplayResult::COMPLETE;
+    } else {
+        LoadMempool(m_pool, active_chainstate);
+    }
+    if (!ShutdownRequested()) {
+        if (replayed) {
+            LOCK(m_mutex);
+            Reconcile(txids);
+        } else {
+            WITH_LOCK(m_mutex, m_compacting = true);
+            Compact();
+        }
+    }
+    m_pool.SetIsLoaded(!ShutdownRequested());
+}
+
+MempoolJournal::ReplayResult MempoolJournal::Replay(CChainState& active_chainstate, std::set<uint256>& txids)
+{
+    FILE* filestr{fsbridge::fopen(m_path, "rb")};
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool journal from disk. Changes to the mempool will not be persisted.\n");
+        return ReplayResult::UNUSABLE;
+    }
+
+    std::vector<MempoolFileEntry> entries;
+    std::unordered_map<uint256, size_t, SaltedTxidHasher> index;
+    std::map<uint256, CAmount> deltas;
+    std::set<uint256> unbroadcast_txids;
+    const auto add = [&](MempoolFileEntry&& entry) {
+        if (index.emplace(entry.tx->GetHash(), entries.size()).second) entries.push_back(std::move(entry));
+    };
+
+    bool complete{false};
+    uint64_t snapshot_bytes{0};
+    const uint64_t journal_bytes{fs::file_size(m_path)};
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_JOURNAL_VERSION) {
+            LogPrintf("Unknown mempool journal version %d. Not loading it, and changes to the mempool will not be persisted.\n", version);
+            return ReplayResult::UNUSABLE;
+        }
+        uint64_t num;
+        file >> num;
+        while (num) {
+            --num;
+            MempoolFileEntry entry{};
+            file >> entry.tx;
+            file >> entry.time;
+            add(std::move(entry));
+            if (ShutdownRequested())
+                return ReplayResult::TRUNCATED;
+        }
+        snapshot_bytes = std::ftell(file.Get());
+
+        while (uint64_t(std::ftell(file.Get())) < journal_bytes) {
+            uint8_t type;
+            file >> type;
+            switch (Record{type}) {
+            case Record::ADD: {
+                MempoolFileEntry entry{};
+                file >> entry.tx;
+                file >> entry.time;
+                add(std::move(entry));
+                break;
+            }
+            case Record::REMOVE: {
+                uint256 txid;
+                file >> txid;
+                const auto it = index.find(txid);
+                if (it != index.end()) {
+                    entries[it->second].tx = nullptr;
+                    index.erase(it);
+                }
+                break;
+            }
+            case Record::DELTAS:
+                file >> deltas;
+                break;
+            case Record::UNBROADCAST:
+                file >> unbroadcast_txids;
+                break;
+            default:
+                throw std::ios_base::failure("unknown record type");
+            }
+        }
+        complete = true;
+    } catch (const std::exception& e) {
+        // Most likely the last record was only partially written. Load what
+        // was read so far; the journal is compacted afterwards.
+        LogPrintf("Failed to deserialize mempool journal on disk: %s. Continuing anyway.\n", e.what());
+    }
+    file.fclose();
+
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const MempoolFileEntry& entry) { return entry.tx == nullptr; }), entries.end());
+    for (MempoolFileEntry& entry : entries) {
+        const uint256& txid{entry.tx->GetHash()};
+        const auto delta = deltas.find(txid);
+        if (delta != deltas.end()) {
+            entry.fee_delta = delta->second;
+            deltas.erase(delta);
+        }
+        txids.insert(txid);
+    }
+    LogPrintf("Replaying mempool journal: %d transactions, %d bytes of %d since the last snapshot\n",
+              entries.size(), journal_bytes - snapshot_bytes, journal_bytes);
+    {
+        LOCK(m_mutex);
+        m_snapshot_bytes = snapshot_bytes;
+        m_journal_bytes = journal_bytes;
+    }
+    const bool loaded{LoadMempoolEntries(m_pool, active_chainstate, std::move(entries), deltas, unbroadcast_txids)};
+    return loaded && complete ? ReplayResult::COMPLETE : ReplayResult::TRUNCATED;
+}
+
+void MempoolJournal::Reconcile(const std::set<uint256>& txids)
+{
+    AssertLockHeld(m_mutex);
+    m_file = fsbridge::fopen(m_path, "ab");
+    if (!m_file) {
+        LogPrintf("Failed to open mempool journal for appending. Changes to the mempool will not be persisted.\n");
+        return;
+    }
+    // Transactions that could not be loaded, and those added to the mempool
+    // while loading, before changes were recorded.
+    std::set<uint256> missing{txids};
+    std::vector<TxMempoolInfo> vinfo;
+    {
+        LOCK(m_pool.cs);
+        vinfo = m_pool.infoAll();
+        m_snapshot_sequence = m_pool.GetSequence();
+    }
+    for (const TxMempoolInfo& info : vinfo) {
+        if (missing.erase(info.tx->GetHash()) == 0) {
+            Append(Record::ADD, *info.tx, int64_t{count_seconds(info.m_time)});
+        }
+    }
+    for (const uint256& txid : missing) {
+        Append(Record::REMOVE, txid);
+    }
+}
+
+bool MempoolJournal::Compact()
+{
+    const auto start{std::chrono::steady_clock::now()};
+
+    std::map<uint256, CAmount> deltas;
+    std::vector<TxMempoolInfo> vinfo;
+    std::set<uint256> unbroadcast_txids;
+    uint64_t sequence;
+    {
+        LOCK2(m_mutex, m_pool.cs);
+        assert(m_compacting);
+        m_compact_records.clear();
+        deltas = m_pool.mapDeltas;
+        vinfo = m_pool.infoAll();
+        unbroadcast_txids = m_pool.GetUnbroadcastTxs();
+        sequence = m_pool.GetSequence();
+    }
+
+    // Records keep being appended to the current journal, and collected in
+    // m_compact_records, while the snapshot is written.
+    FILE* filestr{fsbridge::fopen(m_new_path, "wb")};
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    uint64_t snapshot_bytes;
+    uint64_t journal_bytes;
+    try {
+        if (file.IsNull()) {
+            throw std::runtime_error("Open failed");
+        }
+        file << MEMPOOL_JOURNAL_VERSION;
+        file << uint64_t{vinfo.size()};
+        for (const auto& info : vinfo) {
+            file << *info.tx;
+            file << int64_t{count_seconds(info.m_time)};
+        }
+        snapshot_bytes = std::ftell(file.Get());
+        file << uint8_t(Record::DELTAS) << deltas;
+        file << uint8_t(Record::UNBROADCAST) << unbroadcast_txids;
+        journal_bytes = std::ftell(file.Get());
+        if (!FileCommit(file.Get())) {
+            throw std::runtime_error("FileCommit failed");
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to compact mempool journal: %s. Continuing anyway.\n", e.what());
+        file.fclose();
+        LOCK(m_mutex);
+        m_compacting = false;
+        if (!m_file) {
+            m_file = fsbridge::fopen(m_path, "ab");
+            if (m_file) m_journal_bytes += std::fwrite(m_compact_records.data(), 1, m_compact_records.size(), m_file);
+        }
+        m_compact_records = {};
+        return false;
+    }
+
+    LOCK(m_mutex);
+    m_compacting = false;
+    journal_bytes += std::fwrite(m_compact_records.data(), 1, m_compact_records.size(), file.Get());
+    m_compact_records = {};
+    file.fclose();
+    if (m_file) {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    if (!RenameOver(m_new_path, m_path)) {
+        // The current journal is complete, as all records were appended to it as well.
+        LogPrintf("Failed to compact mempool journal: Rename failed. Continuing anyway.\n");
+        m_file = fsbridge::fopen(m_path, "ab");
+        return false;
+    }
+
+    m_file = fsbridge::fopen(m_path, "ab");
+    if (!m_file) {
+        LogPrintf("Failed to open mempool journal for appending. Changes to the mempool will not be persisted.\n");
+        return false;
+    }
+    m_snapshot_bytes = snapshot_bytes;
+    m_journal_bytes = journal_bytes;
+    m_snapshot_sequence = sequence;
+    LogPrint(BCLog::MEMPOOL, "Compacted mempool journal: %d transactions, %d bytes in %gs\n",
+             vinfo.size(), journal_bytes, CountSecondsDouble(std::chrono::steady_clock::now() - start));
+    return true;
+}
+
+void MempoolJournal::MaybeCompact()
+{
+    LOCK(m_mutex);
+    if (!m_file || m_compacting) return;
+    if (m_journal_bytes - m_snapshot_bytes > std::max(m_snapshot_bytes, MEMPOOL_JOURNAL_MIN_COMPACT_BYTES)) {
+        // The previous compaction has finished, so this does not block.
+        if (m_compact_thread.joinable()) m_compact_thread.join();
+        m_compacting = true;
+        m_compact_thread = std::thread(&util::TraceThread, "mempjournal", [this] { Compact(); });
+    } else {
+        std::fflush(m_file);
+    }
+}
+
+void MempoolJournal::WaitForCompaction()
+{
+    std::thread compact_thread{WITH_LOCK(m_mutex, return std::move(m_compact_thread))};
+    if (compact_thread.joinable()) compact_thread.join();
+}
+
+void MempoolJournal::Flush()
+{
+    WaitForCompaction();
+    LOCK(m_mutex);
+    if (!m_file) return;
+    const auto start{std::chrono::steady_clock::now()};
+    Append(Record::DELTAS, WITH_LOCK(m_pool.cs, return m_pool.mapDeltas));
+    Append(Record::UNBROADCAST, m_pool.GetUnbroadcastTxs());
+    if (!FileCommit(m_file)) {
+        LogPrintf("Failed to flush mempool journal to disk. Continuing anyway.\n");
+        return;
+    }
+    LogPrintf("Flushed mempool journal: %d bytes since the last snapshot, %gs to flush\n",
+              m_journal_bytes - m_snapshot_bytes, CountSecondsDouble(std::chrono::steady_clock::now() - start));
+}
+
+void MempoolJournal::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence)
+{
+    LOCK(m_mutex);
+    if (mempool_sequence < m_snapshot_sequence) return;
+    AppendAdd(tx->GetHash());
+}
+
+void MempoolJournal::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence)
+{
+    LOCK(m_mutex);
+    if (mempool_sequence < m_snapshot_sequence) return;
+    Append(Record::REMOVE, tx->GetHash());
+}
+
+void MempoolJournal::MempoolTransactionsRemovedForBlock(const std::vector<CTransactionRef>& txs_removed_for_block, uint64_t mempool_sequence)
+{
+    LOCK(m_mutex);
+    if (mempool_sequence < m_snapshot_sequence) return;
+    for (const auto& tx : txs_removed_for_block) {
+        Append(Record::REMOVE, tx->GetHash());
+    }
+}
+
+void MempoolJournal::AppendAdd(const uint256& txid)
+{
+    AssertLockHeld(m_mutex);
+    // The transaction may have left the mempool again already, in which case
+    // its removal is announced later on.
+    const TxMempoolInfo info{m_pool.info(GenTxid::Txid(txid))};
+    if (info.tx) {
+        Append(Record::ADD, *info.tx, int64_t{count_seconds(info.m_time)});
+    }
+}
+} // namespace node
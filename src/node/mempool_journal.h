@@ -0,0 +1,130 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_MEMPOOL_JOURNAL_H
+#define BITCOIN_NODE_MEMPOOL_JOURNAL_H
+
+#include <fs.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+#include <uint256.h>
+#include <validationinterface.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+class CChainState;
+class CTxMemPool;
+
+namespace node {
+/** How often the mempool journal is flushed and checked for compaction. */
+static constexpr std::chrono::minutes MEMPOOL_JOURNAL_COMPACT_INTERVAL{1};
+/** Records appended to the mempool journal below this size never trigger a compaction. */
+static constexpr uint64_t MEMPOOL_JOURNAL_MIN_COMPACT_BYTES{1 << 20};
+
+/**
+ * Append-only log of the mempool, kept in mempool.journal when -persistmempool
+ * is set, so that the mempool does not have to be dumped as a whole at shutdown.
+ *
+ * The journal starts with a snapshot of the mempool, in the same layout as the
+ * transactions of mempool.dat, followed by a record for every transaction
+ * added to or removed from the mempool since, as announced through the
+ * validation interface. Shutdown appends the fee deltas and the unbroadcast
+ * set and syncs the file; once the records appended after the snapshot
+ * outgrow it, the journal is rewritten as a new snapshot on a separate
+ * thread, while records keep being appended.
+ * The time spent at shutdown and the amount of data written are proportional
+ * to the churn of the mempool rather than to its size.
+ *
+ * Notifications are delivered in the order of the changes they announce, so
+ * the records following a snapshot taken at any time are a suffix of the
+ * history of the mempool. Replaying them on top of the snapshot yields the
+ * mempool at the time of the last record, even if some of them describe
+ * changes that were already part of the snapshot. Notifications carrying a
+ * mempool sequence number from before the snapshot are skipped all the same,
+ * so that loading the mempool does not append all of it again.
+ */
+class MempoolJournal final : public CValidationInterface
+{
+public:
+    MempoolJournal(CTxMemPool& pool, const fs::path& data_dir);
+    ~MempoolJournal();
+
+    /**
+     * Load the mempool from the journal, or from mempool.dat if there is no
+     * journal or mempool.dat is more recent, and start recording changes.
+     * Marks the mempool as loaded unless shutdown was requested.
+     */
+    void Load(CChainState& active_chainstate) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Flush appended records to the OS, and start compacting the journal if they outgrew the snapshot. */
+    void MaybeCompact() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Wait for a compaction in progress, append the fee deltas and the unbroadcast set and sync the journal to disk. */
+    void Flush() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void MempoolTransactionsRemovedForBlock(const std::vector<CTransactionRef>& txs_removed_for_block, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    enum class Record : uint8_t {
+        ADD = 0,         //!< Transaction and the time it entered the mempool
+        REMOVE = 1,      //!< Txid of a transaction that left the mempool
+        DELTAS = 2,      //!< All fee deltas, replacing earlier ones
+        UNBROADCAST = 3, //!< The unbroadcast set, replacing earlier ones
+    };
+
+    enum class ReplayResult {
+        COMPLETE,  //!< The journal was read to the end
+        TRUNCATED, //!< Reading stopped early, most likely at a partially written record
+        UNUSABLE,  //!< The journal could not be opened or has an unknown version, and was not read
+    };
+
+    /** Read the journal and add its transactions to the mempool. */
+    ReplayResult Replay(CChainState& active_chainstate, std::set<uint256>& txids) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Append the records that bring the replayed journal in line with the mempool. */
+    void Reconcile(const std::set<uint256>& txids) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /**
+     * Rewrite the journal as a snapshot of the mempool. Only taking the
+     * snapshot holds m_mutex; the records appended while it is written and
+     * synced are carried over to the new journal.
+     */
+    bool Compact() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Wait for the compaction started by MaybeCompact(), if any, to finish. */
+    void WaitForCompaction() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Append a record for a transaction added to the mempool, if it is still there. */
+    void AppendAdd(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    template <typename... Args>
+    void Append(Record type, const Args&... args) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    Mutex m_mutex;
+    CTxMemPool& m_pool;
+    const fs::path m_path;
+    const fs::path m_new_path;
+    const fs::path m_dump_path;
+    //! Opened for appending once the mempool is loaded; changes before that are not recorded.
+    FILE* m_file GUARDED_BY(m_mutex){nullptr};
+    //! Size of the snapshot at the start of the journal
+    uint64_t m_snapshot_bytes GUARDED_BY(m_mutex){0};
+    //! Size of the whole journal
+    uint64_t m_journal_bytes GUARDED_BY(m_mutex){0};
+    //! Mempool sequence number at the time of the last snapshot or reconciliation
+    uint64_t m_snapshot_sequence GUARDED_BY(m_mutex){0};
+    //! Whether a snapshot is being written
+    bool m_compacting GUARDED_BY(m_mutex){false};
+    //! Records appended since the snapshot being written was taken
+    std::vector<unsigned char> m_compact_records GUARDED_BY(m_mutex);
+    //! Runs the compactions started by MaybeCompact()
+    std::thread m_compact_thread GUARDED_BY(m_mutex);
+};
+} // namespace node
+
+#endif // BITCOIN_NODE_MEMPOOL_JOURNAL_H
@@ -20,10 +20,14 @@
 #include <primitives/transaction.h>
 #include <timedata.h>
 #include <util/moneystr.h>
+#include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/thread.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <algorithm>
+#include <stdexcept>
 #include <utility>
 
 namespace node {
@@ -448,6 +452,138 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
     }
 }
 
+BlockTemplateCache::BlockTemplateCache(ChainstateManager& chainman, const CTxMemPool& mempool)
+    : m_chainman{chainman}, m_mempool{mempool} {}
+
+BlockTemplateCache::~BlockTemplateCache()
+{
+    Stop();
+}
+
+void BlockTemplateCache::Start()
+{
+    assert(!m_thread.joinable());
+    WITH_LOCK(m_mutex, m_stop = false);
+    m_thread = std::thread(&util::TraceThread, "blktemplate", [this] { ThreadRebuild(); });
+}
+
+void BlockTemplateCache::Stop()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_rebuild_cv.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+std::shared_ptr<const CBlockTemplate> BlockTemplateCache::Get(unsigned int& transactions_updated, bool up_to_date)
+{
+    {
+        LOCK(::cs_main);
+        const CBlockIndex* tip{m_chainman.ActiveChain().Tip()};
+        const unsigned int mempool_updated{m_mempool.GetTransactionsUpdated()};
+        LOCK(m_mutex);
+        // A template that was not maintained may be far behind the mempool
+        if (!IsMaintained()) up_to_date = true;
+        m_last_request = GetTime<std::chrono::seconds>();
+        if (m_template && tip && m_template->block.hashPrevBlock == tip->GetBlockHash() &&
+            (!up_to_date || m_transactions_updated == mempool_updated)) {
+            transactions_updated = m_transactions_updated;
+            return m_template;
+        }
+    }
+    return Build(transactions_updated);
+}
+
+void BlockTemplateCache::AddListener(Listener listener)
+{
+    LOCK(m_mutex);
+    m_listeners.push_back(std::move(listener));
+}
+
+std::shared_ptr<const CBlockTemplate> BlockTemplateCache::Build(unsigned int& transactions_updated)
+{
+    // Neither the tip nor (for the most part) the mempool change while
+    // cs_main is held, and templates are stored in the order they were
+    // assembled in.
+    LOCK(::cs_main);
+    transactions_updated = m_mempool.GetTransactionsUpdated();
+    std::shared_ptr<const CBlockTemplate> block_template{BlockAssembler(m_chainman.ActiveChainstate(), m_mempool, Params()).CreateNewBlock(CScript() << OP_TRUE)};
+    LOCK(m_mutex);
+    m_template = block_template;
+    m_transactions_updated = transactions_updated;
+    return block_template;
+}
+
+void BlockTemplateCache::Rebuild()
+{
+    std::shared_ptr<const CBlockTemplate> block_template;
+    try {
+        unsigned int transactions_updated;
+        block_template = Build(transactions_updated);
+    } catch (const std::runtime_error& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+        return;
+    }
+    // Listeners may be added while they are called
+    const std::vector<Listener> listeners{WITH_LOCK(m_mutex, return m_listeners)};
+    if (listeners.empty()) return;
+    for (const Listener& listener : listeners) {
+        listener(m_notified_template, block_template);
+    }
+    m_notified_template = std::move(block_template);
+}
+
+void BlockTemplateCache::ThreadRebuild()
+{
+    SetSyscallSandboxPolicy(SyscallSandboxPolicy::BLOCK_TEMPLATE);
+    WAIT_LOCK(m_mutex, lock);
+    while (!m_stop) {
+        if (!m_rebuild_time) {
+            m_rebuild_cv.wait(lock);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < *m_rebuild_time) {
+            m_rebuild_cv.wait_until(lock, *m_rebuild_time);
+            continue;
+        }
+        m_rebuild_time.reset();
+        REVERSE_LOCK(lock);
+        Rebuild();
+    }
+}
+
+bool BlockTemplateCache::IsMaintained() const
+{
+    return !m_listeners.empty() || (m_last_request && GetTime<std::chrono::seconds>() - *m_last_request <= BLOCK_TEMPLATE_IDLE_TIMEOUT);
+}
+
+void BlockTemplateCache::ScheduleRebuild(std::chrono::milliseconds delay)
+{
+    {
+        LOCK(m_mutex);
+        if (!IsMaintained()) return;
+        const auto rebuild_time{std::chrono::steady_clock::now() + delay};
+        if (m_rebuild_time && *m_rebuild_time <= rebuild_time) return;
+        m_rebuild_time = rebuild_time;
+    }
+    m_rebuild_cv.notify_one();
+}
+
+void BlockTemplateCache::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence)
+{
+    ScheduleRebuild(BLOCK_TEMPLATE_REBUILD_DELAY);
+}
+
+void BlockTemplateCache::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence)
+{
+    ScheduleRebuild(BLOCK_TEMPLATE_REBUILD_DELAY);
+}
+
+void BlockTemplateCache::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == pindexFork) return;
+    ScheduleRebuild(std::chrono::milliseconds{0});
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -7,11 +7,18 @@
 #define BITCOIN_NODE_MINER_H
 
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
+#include <validationinterface.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <stdint.h>
+#include <thread>
+#include <vector>
 
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index_container.hpp>
@@ -201,6 +208,81 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set& mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
 };
 
+/** How long changes to the mempool are collected before the cached block template is rebuilt. */
+static constexpr std::chrono::milliseconds BLOCK_TEMPLATE_REBUILD_DELAY{500};
+/** How long the cached block template is kept up to date after it was last requested. */
+static constexpr std::chrono::minutes BLOCK_TEMPLATE_IDLE_TIMEOUT{2};
+
+/**
+ * Keeps a template for the next block ready, so that getblocktemplate does
+ * not have to assemble one while the caller waits.
+ *
+ * The template is assembled again on a thread of its own right after the tip
+ * changed, and BLOCK_TEMPLATE_REBUILD_DELAY after the first of a series of
+ * changes to the mempool, so it lags behind the mempool by about that much.
+ * It is only maintained while a listener is added, or for
+ * BLOCK_TEMPLATE_IDLE_TIMEOUT after it was last requested, so nodes that do
+ * not mine don't pay for it. The coinbase pays to OP_TRUE, like the one of
+ * getblocktemplate.
+ */
+class BlockTemplateCache final : public CValidationInterface
+{
+public:
+    /** Called on the block template thread with the previous template, if any, and the new one. */
+    using Listener = std::function<void(const std::shared_ptr<const CBlockTemplate>& old_template, const std::shared_ptr<const CBlockTemplate>& new_template)>;
+
+    BlockTemplateCache(ChainstateManager& chainman, const CTxMemPool& mempool);
+    ~BlockTemplateCache();
+
+    /** Start the thread that rebuilds the template. */
+    void Start() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Stop the thread that rebuilds the template. */
+    void Stop() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /**
+     * Return the cached template, or assemble one now if there is none on top
+     * of the current tip or, with up_to_date, if the mempool changed since it
+     * was assembled. transactions_updated is set to the mempool's
+     * GetTransactionsUpdated() as of when the template was assembled.
+     */
+    std::shared_ptr<const CBlockTemplate> Get(unsigned int& transactions_updated, bool up_to_date) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Call listener whenever the template was rebuilt, and keep it up to date from now on. */
+    void AddListener(Listener listener) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    /** Whether there are listeners, or the template was requested within BLOCK_TEMPLATE_IDLE_TIMEOUT */
+    bool IsMaintained() const EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** Rebuild after delay, unless a rebuild is due earlier already. */
+    void ScheduleRebuild(std::chrono::milliseconds delay) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Assemble a new template and store it. */
+    std::shared_ptr<const CBlockTemplate> Build(unsigned int& transactions_updated) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void Rebuild() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void ThreadRebuild() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    ChainstateManager& m_chainman;
+    const CTxMemPool& m_mempool;
+
+    Mutex m_mutex;
+    std::condition_variable m_rebuild_cv;
+    std::vector<Listener> m_listeners GUARDED_BY(m_mutex);
+    //! When the template was last requested through Get()
+    std::optional<std::chrono::seconds> m_last_request GUARDED_BY(m_mutex);
+    std::shared_ptr<const CBlockTemplate> m_template GUARDED_BY(m_mutex);
+    unsigned int m_transactions_updated GUARDED_BY(m_mutex){0};
+    //! When the next rebuild is due, if one is
+    std::optional<std::chrono::steady_clock::time_point> m_rebuild_time GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
+    //! Last template passed to the listeners, only used on the block template thread
+    std::shared_ptr<const CBlockTemplate> m_notified_template;
+};
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
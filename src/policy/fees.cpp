@@ -13,6 +13,8 @@
 #include <util/serfloat.h>
 #include <util/system.h>
 
+#include <algorithm>
+
 static const char* FEE_ESTIMATES_FILENAME = "fee_estimates.dat";
 
 static constexpr double INF_FEERATE = 1e99;
@@ -70,6 +72,12 @@ private:
     // Track the historical moving average of these totals over blocks
     std::vector<std::vector<double>> confAvg; // confAvg[Y][X]
 
+    // Count the txs of the current block in each bucket that took Y periods
+    // to confirm. Folded into the running totals of confAvg by
+    // UpdateRecorded, so that recording a tx is O(1).
+    std::vector<std::vector<int>> m_block_confirmed; // m_block_confirmed[Y][X]
+    bool m_has_block_confirmed{false};
+
     // Track moving avg of txs which have been evicted from the mempool
     // after failing to be confirmed within Y blocks
     std::vector<std::vector<double>> failAvg; // failAvg[Y][X]
@@ -113,9 +121,13 @@ public:
      * Record a new transaction data point in the current block stats
      * @param blocksToConfirm the number of blocks it took this transaction to confirm
      * @param val the feerate of the transaction
+     * @param bucketindex the bucket of val, as returned by NewTx
      * @warning blocksToConfirm is 1-based and has to be >= 1
      */
-    void Record(int blocksToConfirm, double val);
+    void Record(int blocksToConfirm, double val, unsigned int bucketindex);
+
+    /** Add the transactions recorded for the current block to the confirmation averages */
+    void UpdateRecorded();
 
     /** Record a new transaction entering the mempool*/
     unsigned int NewTx(unsigned int nBlockHeight, double val);
@@ -181,6 +193,8 @@ void TxConfirmStats::resizeInMemoryCounters(size_t newbuckets) {
         unconfTxs[i].resize(newbuckets);
     }
     oldUnconfTxs.resize(newbuckets);
+    m_block_confirmed.assign(confAvg.size(), std::vector<int>(newbuckets));
+    m_has_block_confirmed = false;
 }
 
 // Roll the unconfirmed txs circular buffer
@@ -193,28 +207,48 @@ void TxConfirmStats::ClearCurrent(unsigned int nBlockHeight)
 }
 
 
-void TxConfirmStats::Record(int blocksToConfirm, double feerate)
+void TxConfirmStats::Record(int blocksToConfirm, double feerate, unsigned int bucketindex)
 {
     // blocksToConfirm is 1-based
     if (blocksToConfirm < 1)
         return;
-    int periodsToConfirm = (blocksToConfirm + scale - 1) / scale;
-    unsigned int bucketindex = bucketMap.lower_bound(feerate)->second;
-    for (size_t i = periodsToConfirm; i <= confAvg.size(); i++) {
-        confAvg[i - 1][bucketindex]++;
+    unsigned int periodsToConfirm = (blocksToConfirm + scale - 1) / scale;
+    if (periodsToConfirm <= m_block_confirmed.size()) {
+        m_block_confirmed[periodsToConfirm - 1][bucketindex]++;
+        m_has_block_confirmed = true;
     }
     txCtAvg[bucketindex]++;
     m_feerate_avg[bucketindex] += feerate;
 }
 
+void TxConfirmStats::UpdateRecorded()
+{
+    if (!m_has_block_confirmed) return;
+    // A tx confirmed within Y periods counts for every target of Y periods
+    // or more, so accumulate the counts over the periods.
+    for (unsigned int i = 0; i < confAvg.size(); i++) {
+        for (unsigned int j = 0; j < buckets.size(); j++) {
+            if (i > 0) m_block_confirmed[i][j] += m_block_confirmed[i - 1][j];
+            confAvg[i][j] += m_block_confirmed[i][j];
+        }
+    }
+    for (auto& confirmed : m_block_confirmed) {
+        std::fill(confirmed.begin(), confirmed.end(), 0);
+    }
+    m_has_block_confirmed = false;
+}
+
 void TxConfirmStats::UpdateMovingAverages()
 {
     assert(confAvg.size() == failAvg.size());
-    for (unsigned int j = 0; j < buckets.size(); j++) {
-        for (unsigned int i = 0; i < confAvg.size(); i++) {
+    // Walk each vector front to back so the loops can be vectorized.
+    for (unsigned int i = 0; i < confAvg.size(); i++) {
+        for (unsigned int j = 0; j < buckets.size(); j++) {
             confAvg[i][j] *= decay;
             failAvg[i][j] *= decay;
         }
+    }
+    for (unsigned int j = 0; j < buckets.size(); j++) {
         m_feerate_avg[j] *= decay;
         txCtAvg[j] *= decay;
     }
@@ -499,18 +533,24 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
 bool CBlockPolicyEstimator::_removeTx(const uint256& hash, bool inBlock)
 {
     AssertLockHeld(m_cs_fee_estimator);
-    std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
+    const auto pos = mapMemPoolTxs.find(hash);
     if (pos != mapMemPoolTxs.end()) {
-        feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
-        shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
-        longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
-        mapMemPoolTxs.erase(hash);
+        _removeTx(pos, inBlock);
         return true;
     } else {
         return false;
     }
 }
 
+void CBlockPolicyEstimator::_removeTx(TxStatsMap::iterator pos, bool inBlock)
+{
+    AssertLockHeld(m_cs_fee_estimator);
+    feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+    shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+    longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+    mapMemPoolTxs.erase(pos);
+}
+
 CBlockPolicyEstimator::CBlockPolicyEstimator()
     : nBestSeenHeight(0), firstRecordedHeight(0), historicalFirst(0), historicalBest(0), trackedTxs(0), untrackedTxs(0)
 {
@@ -571,9 +611,10 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     // Feerates are stored and reported as BTC-per-kb:
     CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
 
-    mapMemPoolTxs[hash].blockHeight = txHeight;
+    TxStatsInfo& info = mapMemPoolTxs[hash];
+    info.blockHeight = txHeight;
     unsigned int bucketIndex = feeStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
-    mapMemPoolTxs[hash].bucketIndex = bucketIndex;
+    info.bucketIndex = bucketIndex;
     unsigned int bucketIndex2 = shortStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
     assert(bucketIndex == bucketIndex2);
     unsigned int bucketIndex3 = longStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
@@ -583,10 +624,14 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
 bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
 {
     AssertLockHeld(m_cs_fee_estimator);
-    if (!_removeTx(entry->GetTx().GetHash(), true)) {
+    const auto pos = mapMemPoolTxs.find(entry->GetTx().GetHash());
+    if (pos == mapMemPoolTxs.end()) {
         // This transaction wasn't being tracked for fee estimation
         return false;
     }
+    // The bucket was derived from the same feerate when the tx was tracked.
+    const unsigned int bucketIndex = pos->second.bucketIndex;
+    _removeTx(pos, true);
 
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
@@ -602,9 +647,9 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     // Feerates are stored and reported as BTC-per-kb:
     CFeeRate feeRate(entry->GetFee(), entry->GetTxSize());
 
-    feeStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
-    shortStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
-    longStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
+    feeStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK(), bucketIndex);
+    shortStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK(), bucketIndex);
+    longStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK(), bucketIndex);
     return true;
 }
 
@@ -642,6 +687,9 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
         if (processBlockTx(nBlockHeight, entry))
             countedTxs++;
     }
+    feeStats->UpdateRecorded();
+    shortStats->UpdateRecorded();
+    longStats->UpdateRecorded();
 
     if (firstRecordedHeight == 0 && countedTxs > 0) {
         firstRecordedHeight = nBestSeenHeight;
@@ -1009,7 +1057,9 @@ FeeFilterRounder::FeeFilterRounder(const CFeeRate& minIncrementalFee)
 
 CAmount FeeFilterRounder::round(CAmount currentMinFee)
 {
+    AssertLockNotHeld(m_insecure_rand_mutex);
     std::set<double>::iterator it = feeset.lower_bound(currentMinFee);
+    LOCK(m_insecure_rand_mutex);
     if ((it != feeset.begin() && insecure_rand.rand32() % 3 != 0) || it == feeset.end()) {
         it--;
     }
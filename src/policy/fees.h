@@ -10,11 +10,13 @@
 #include <uint256.h>
 #include <random.h>
 #include <sync.h>
+#include <util/hasher.h>
 
 #include <array>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class CAutoFile;
@@ -252,8 +254,10 @@ private:
         TxStatsInfo() : blockHeight(0), bucketIndex(0) {}
     };
 
+    using TxStatsMap = std::unordered_map<uint256, TxStatsInfo, SaltedTxidHasher>;
+
     // map of txids to information about that transaction
-    std::map<uint256, TxStatsInfo> mapMemPoolTxs GUARDED_BY(m_cs_fee_estimator);
+    TxStatsMap mapMemPoolTxs GUARDED_BY(m_cs_fee_estimator);
 
     /** Classes to track historical data on transaction confirmations */
     std::unique_ptr<TxConfirmStats> feeStats PT_GUARDED_BY(m_cs_fee_estimator);
@@ -283,6 +287,8 @@ private:
     /** A non-thread-safe helper for the removeTx function */
     bool _removeTx(const uint256& hash, bool inBlock)
         EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    void _removeTx(TxStatsMap::iterator pos, bool inBlock)
+        EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
 };
 
 class FeeFilterRounder
@@ -299,12 +305,13 @@ public:
     /** Create new FeeFilterRounder */
     explicit FeeFilterRounder(const CFeeRate& minIncrementalFee);
 
-    /** Quantize a minimum fee for privacy purpose before broadcast. Not thread-safe due to use of FastRandomContext */
-    CAmount round(CAmount currentMinFee);
+    /** Quantize a minimum fee for privacy purpose before broadcast. */
+    CAmount round(CAmount currentMinFee) EXCLUSIVE_LOCKS_REQUIRED(!m_insecure_rand_mutex);
 
 private:
     std::set<double> feeset;
-    FastRandomContext insecure_rand;
+    Mutex m_insecure_rand_mutex;
+    FastRandomContext insecure_rand GUARDED_BY(m_insecure_rand_mutex);
 };
 
 #endif // BITCOIN_POLICY_FEES_H
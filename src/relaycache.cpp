@@ -0,0 +1,59 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <relaycache.h>
+
+#include <util/time.h>
+
+std::optional<CSharedNetMsg> RelayCache::Find(const std::string& msg_type, const uint256& hash, int flags)
+{
+    const auto now{GetTime<std::chrono::seconds>()};
+    LOCK(m_mutex);
+    Trim(now);
+    const auto it = m_entries.find(Key{msg_type, hash, flags});
+    if (it == m_entries.end()) return std::nullopt;
+    return it->second.msg;
+}
+
+CSharedNetMsg RelayCache::Add(const std::string& msg_type, const uint256& hash, int flags, CSharedNetMsg&& msg)
+{
+    // Messages larger than the whole cache would only push out everything else.
+    const size_t bytes{msg.m_header->size() + msg.m_data->size()};
+    if (bytes > m_max_bytes) return std::move(msg);
+
+    const auto now{GetTime<std::chrono::seconds>()};
+    LOCK(m_mutex);
+    // Don't hand out an expired message kept under the same identity.
+    Trim(now);
+    const auto [it, inserted] = m_entries.try_emplace(Key{msg_type, hash, flags}, Entry{std::move(msg), now, bytes});
+    CSharedNetMsg result{it->second.msg};
+    if (inserted) {
+        m_order.push_back(it);
+        m_bytes += bytes;
+        Trim(now);
+    }
+    return result;
+}
+
+void RelayCache::Trim(std::chrono::seconds now)
+{
+    AssertLockHeld(m_mutex);
+    while (!m_order.empty() && (m_bytes > m_max_bytes || m_order.front()->second.time + m_expiry <= now)) {
+        m_bytes -= m_order.front()->second.bytes;
+        m_entries.erase(m_order.front());
+        m_order.pop_front();
+    }
+}
+
+size_t RelayCache::Count() const
+{
+    LOCK(m_mutex);
+    return m_entries.size();
+}
+
+size_t RelayCache::Bytes() const
+{
+    LOCK(m_mutex);
+    return m_bytes;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RELAYCACHE_H
+#define BITCOIN_RELAYCACHE_H
+
+#include <net.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+
+/** Default for the total size of the messages kept in a RelayCache. */
+static constexpr size_t DEFAULT_RELAY_CACHE_BYTES{32 << 20};
+/** How long a RelayCache keeps a message after it was serialized. */
+static constexpr std::chrono::seconds RELAY_CACHE_EXPIRY{60};
+
+/**
+ * Keeps recently serialized transactions and blocks, so that relaying one to
+ * many peers serializes it only once, and their send queues share the result.
+ *
+ * A message is identified by its type, the hash of the object it holds (the
+ * wtxid of a transaction, the hash of a block) and the flags it is serialized
+ * with, which together determine its contents, or for types like cmpctblock
+ * whose contents are not unique, make any of them equally valid to send.
+ *
+ * Messages are kept for a short while and up to a total size, and the oldest
+ * are forgotten first. Thread-safe.
+ */
+class RelayCache
+{
+public:
+    explicit RelayCache(size_t max_bytes = DEFAULT_RELAY_CACHE_BYTES, std::chrono::seconds expiry = RELAY_CACHE_EXPIRY)
+        : m_max_bytes{max_bytes}, m_expiry{expiry} {}
+
+    /** Look up a message that was serialized before, and has not expired yet. */
+    std::optional<CSharedNetMsg> Find(const std::string& msg_type, const uint256& hash, int flags) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /**
+     * Remember a serialized message. If another one with the same identity is
+     * already kept (because it was serialized concurrently), that one is returned
+     * instead, so that all peers share the same buffers.
+     */
+    CSharedNetMsg Add(const std::string& msg_type, const uint256& hash, int flags, CSharedNetMsg&& msg) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Look up a message, serializing it with `make`, which returns a CSerializedNetMsg, if it is not kept yet. */
+    template <typename Fn>
+    CSharedNetMsg Get(const std::string& msg_type, const uint256& hash, int flags, Fn&& make) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        if (auto msg{Find(msg_type, hash, flags)}) return std::move(*msg);
+        return Add(msg_type, hash, flags, CSharedNetMsg{make()});
+    }
+
+    /** Number of messages kept. */
+    size_t Count() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Total size of the messages kept. */
+    size_t Bytes() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    using Key = std::tuple<std::string, uint256, int>;
+
+    struct Entry {
+        CSharedNetMsg msg;
+        std::chrono::seconds time;
+        size_t bytes;
+    };
+
+    /** Forget messages that expired, and the oldest ones until the rest take up at most m_max_bytes. */
+    void Trim(std::chrono::seconds now) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    const size_t m_max_bytes;
+    const std::chrono::seconds m_expiry;
+
+    mutable Mutex m_mutex;
+    std::map<Key, Entry> m_entries GUARDED_BY(m_mutex);
+    //! The kept messages in the order they were added
+    std::deque<std::map<Key, Entry>::iterator> m_order GUARDED_BY(m_mutex);
+    size_t m_bytes GUARDED_BY(m_mutex){0};
+};
+
+#endif // BITCOIN_RELAYCACHE_H
@@ -39,6 +39,8 @@ using node::ReadBlockFromDisk;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
 static constexpr unsigned int MAX_REST_HEADERS_RESULTS = 2000;
+//! Size from which the buffered pieces of a streamed reply are sent as a chunk
+static constexpr size_t REST_CHUNK_SIZE{1 << 16};
 
 enum class RetFormat {
     UNDEF,
@@ -176,6 +178,38 @@ static std::string AvailableDataFormatsString()
     return formats;
 }
 
+/**
+ * Sends a reply in chunks of about REST_CHUNK_SIZE bytes, as its pieces are
+ * written, so that large JSON replies are never held in memory as a whole.
+ */
+class ChunkedReplyWriter
+{
+public:
+    ChunkedReplyWriter(HTTPRequest* req, int status) : m_req{req}
+    {
+        m_req->WriteReplyStart(status);
+    }
+
+    void Write(const std::string& piece)
+    {
+        m_buffer += piece;
+        if (m_buffer.size() >= REST_CHUNK_SIZE) {
+            m_req->WriteReplyChunk(m_buffer);
+            m_buffer.clear();
+        }
+    }
+
+    void End()
+    {
+        m_req->WriteReplyChunk(m_buffer);
+        m_req->WriteReplyEnd();
+    }
+
+private:
+    HTTPRequest* m_req;
+    std::string m_buffer;
+};
+
 static bool CheckWarmup(HTTPRequest* req)
 {
     std::string statusmessage;
@@ -323,10 +357,11 @@ static bool rest_block(const std::any& context,
     }
 
     case RetFormat::JSON: {
-        UniValue objBlock = blockToJSON(block, tip, pblockindex, tx_verbosity);
-        std::string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        ChunkedReplyWriter writer{req, HTTP_OK};
+        BlockToJSONStream(block, tip, pblockindex, tx_verbosity, [&writer](const std::string& piece) { writer.Write(piece); });
+        writer.Write("\n");
+        writer.End();
         return true;
     }
 
@@ -600,9 +635,10 @@ static bool rest_mempool_info(const std::any& context, HTTPRequest* req, const s
     }
 }
 
-static bool rest_mempool_contents(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+static bool rest_mempool_feehistogram(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
 {
-    if (!CheckWarmup(req)) return false;
+    if (!CheckWarmup(req))
+        return false;
     const CTxMemPool* mempool = GetMemPool(context, req);
     if (!mempool) return false;
     std::string param;
@@ -610,9 +646,9 @@ static bool rest_mempool_contents(const std::any& context, HTTPRequest* req, con
 
     switch (rf) {
     case RetFormat::JSON: {
-        UniValue mempoolObject = MempoolToJSON(*mempool, true);
+        UniValue histogram = MempoolFeeHistogramToJSON(*mempool);
 
-        std::string strJSON = mempoolObject.write() + "\n";
+        std::string strJSON = histogram.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strJSON);
         return true;
@@ -623,6 +659,111 @@ static bool rest_mempool_contents(const std::any& context, HTTPRequest* req, con
     }
 }
 
+static bool rest_mempool_contents(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req)) return false;
+    const CTxMemPool* mempool = GetMemPool(context, req);
+    if (!mempool) return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    switch (rf) {
+    case RetFormat::JSON: {
+        req->WriteHeader("Content-Type", "application/json");
+        ChunkedReplyWriter writer{req, HTTP_OK};
+        bool first{true};
+        writer.Write("{");
+        ForEachMempoolEntryJSON(*mempool, [&](const uint256& txid, UniValue&& info) {
+            writer.Write((first ? "\"" : ",\"") + txid.ToString() + "\":" + info.write());
+            first = false;
+        });
+        writer.Write("}\n");
+        writer.End();
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+}
+
+static bool rest_mempool_since(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req)) return false;
+    const CTxMemPool* mempool = GetMemPool(context, req);
+    if (!mempool) return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RetFormat::BINARY && rf != RetFormat::HEX) {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: bin, hex)");
+    }
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+    if (path.size() != 2) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "No session specified. Use /rest/mempool/since/<session>/<sequence>.<ext>.");
+    }
+    const auto session{ToIntegral<uint64_t>(path[0])};
+    if (!session) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid session: " + path[0] + ". Use /rest/mempool/since/<session>/<sequence>.<ext>.");
+    }
+    const auto since{ToIntegral<uint64_t>(path[1])};
+    if (!since) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid sequence: " + path[1] + ". Use /rest/mempool/since/<session>/<sequence>.<ext>.");
+    }
+
+    // Collect the changes, or all of the mempool if the client has to start
+    // over, while holding the lock; serialize them after releasing it.
+    std::optional<std::vector<MempoolDelta>> deltas;
+    std::vector<CTransactionRef> added;
+    uint64_t sequence;
+    {
+        LOCK(mempool->cs);
+        sequence = mempool->GetSequence();
+        // Sequence numbers of another session, e.g. from before a restart,
+        // say nothing about this mempool.
+        if (*session == mempool->GetSequenceSession()) deltas = mempool->GetDeltasSince(*since);
+        if (deltas) {
+            for (const MempoolDelta& delta : *deltas) {
+                if (delta.type == MempoolDelta::Type::ADDED) added.push_back(mempool->get(delta.txid));
+            }
+        } else {
+            for (const TxMempoolInfo& info : mempool->infoAll()) added.push_back(info.tx);
+        }
+    }
+
+    req->WriteHeader("Content-Type", rf == RetFormat::BINARY ? "application/octet-stream" : "text/plain");
+    ChunkedReplyWriter writer{req, HTTP_OK};
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    const auto flush = [&] {
+        writer.Write(rf == RetFormat::BINARY ? ss.str() : HexStr(ss));
+        ss.clear();
+    };
+    ss << mempool->GetSequenceSession() << sequence << bool{!deltas};
+    flush();
+    auto tx = added.begin();
+    if (deltas) {
+        for (const MempoolDelta& delta : *deltas) {
+            if (delta.type == MempoolDelta::Type::ADDED) {
+                // Added transactions that left the mempool again are skipped;
+                // their removal follows.
+                if (*tx) ss << uint8_t(MempoolDelta::Type::ADDED) << **tx;
+                ++tx;
+            } else {
+                ss << uint8_t(MempoolDelta::Type::REMOVED) << delta.txid;
+            }
+            flush();
+        }
+    } else {
+        for (; tx != added.end(); ++tx) {
+            ss << uint8_t(MempoolDelta::Type::ADDED) << **tx;
+            flush();
+        }
+    }
+    if (rf == RetFormat::HEX) writer.Write("\n");
+    writer.End();
+    return true;
+}
+
 static bool rest_tx(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -934,6 +1075,8 @@ static const struct {
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
+      {"/rest/mempool/feehistogram", rest_mempool_feehistogram},
+      {"/rest/mempool/since/", rest_mempool_since},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
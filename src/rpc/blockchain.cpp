@@ -52,6 +52,7 @@
 
 #include <univalue.h>
 
+#include <algorithm>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -166,19 +167,24 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, TxVerbosity verbosity)
+/** The description of a block by getblock, without the transactions */
+static UniValue blockInfoToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex)
 {
     UniValue result = blockheaderToJSON(tip, blockindex);
 
     result.pushKV("strippedsize", (int)::GetSerializeSize(block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
     result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
     result.pushKV("weight", (int)::GetBlockWeight(block));
-    UniValue txs(UniValue::VARR);
+    return result;
+}
 
+/** Call fn with the description of each transaction of a block by getblock, in order */
+static void ForEachBlockTxJSON(const CBlock& block, const CBlockIndex* blockindex, TxVerbosity verbosity, const std::function<void(UniValue&&)>& fn)
+{
     switch (verbosity) {
         case TxVerbosity::SHOW_TXID:
             for (const CTransactionRef& tx : block.vtx) {
-                txs.push_back(tx->GetHash().GetHex());
+                fn(UniValue{tx->GetHash().GetHex()});
             }
             break;
 
@@ -193,16 +199,38 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIn
                 const CTxUndo* txundo = (have_undo && i > 0) ? &blockUndo.vtxundo.at(i - 1) : nullptr;
                 UniValue objTx(UniValue::VOBJ);
                 TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags(), txundo, verbosity);
-                txs.push_back(objTx);
+                fn(std::move(objTx));
             }
             break;
     }
+}
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, TxVerbosity verbosity)
+{
+    UniValue result = blockInfoToJSON(block, tip, blockindex);
+    UniValue txs(UniValue::VARR);
+    ForEachBlockTxJSON(block, blockindex, verbosity, [&txs](UniValue&& tx) { txs.push_back(tx); });
     result.pushKV("tx", txs);
 
     return result;
 }
 
+void BlockToJSONStream(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, TxVerbosity verbosity, const std::function<void(const std::string&)>& write)
+{
+    // Write the block description up to its closing brace, then the
+    // transactions one at a time.
+    std::string json{blockInfoToJSON(block, tip, blockindex).write()};
+    json.back() = ',';
+    json += "\"tx\":[";
+    write(json);
+    bool first{true};
+    ForEachBlockTxJSON(block, blockindex, verbosity, [&](UniValue&& tx) {
+        write((first ? "" : ",") + tx.write());
+        first = false;
+    });
+    write("]}");
+}
+
 static RPCHelpMan getblockcount()
 {
     return RPCHelpMan{"getblockcount",
@@ -513,7 +541,9 @@ static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPool
 
     UniValue spent(UniValue::VARR);
     const CTxMemPool::txiter& it = pool.mapTx.find(tx.GetHash());
-    const CTxMemPoolEntry::Children& children = it->GetMemPoolChildrenConst();
+    // Children are stored unordered; report them sorted by txid.
+    std::vector<CTxMemPoolEntry::CTxMemPoolEntryRef> children(it->GetMemPoolChildrenConst().begin(), it->GetMemPoolChildrenConst().end());
+    std::sort(children.begin(), children.end(), CompareIteratorByHash{});
     for (const CTxMemPoolEntry& child : children) {
         spent.push_back(child.GetTx().GetHash().ToString());
     }
@@ -533,6 +563,36 @@ static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPool
     info.pushKV("unbroadcast", pool.IsUnbroadcastTx(tx.GetHash()));
 }
 
+void ForEachMempoolEntryJSON(const CTxMemPool& pool, const std::function<void(const uint256& txid, UniValue&& info)>& fn)
+{
+    std::vector<uint256> txids;
+    {
+        LOCK(pool.cs);
+        txids.reserve(pool.mapTx.size());
+        for (const CTxMemPoolEntry& e : pool.mapTx) {
+            txids.push_back(e.GetTx().GetHash());
+        }
+    }
+    std::vector<std::pair<uint256, UniValue>> batch;
+    for (size_t start = 0; start < txids.size(); start += MEMPOOL_JSON_BATCH_SIZE) {
+        const size_t end{std::min(start + MEMPOOL_JSON_BATCH_SIZE, txids.size())};
+        {
+            LOCK(pool.cs);
+            for (size_t i = start; i < end; ++i) {
+                const auto it = pool.mapTx.find(txids[i]);
+                if (it == pool.mapTx.end()) continue;
+                UniValue info(UniValue::VOBJ);
+                entryToJSON(pool, info, *it);
+                batch.emplace_back(txids[i], std::move(info));
+            }
+        }
+        for (auto& [txid, info] : batch) {
+            fn(txid, std::move(info));
+        }
+        batch.clear();
+    }
+}
+
 UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose, bool include_mempool_sequence)
 {
     if (verbose) {
@@ -1856,6 +1916,52 @@ static RPCHelpMan getmempoolinfo()
     };
 }
 
+UniValue MempoolFeeHistogramToJSON(const CTxMemPool& pool)
+{
+    const FeeHistogram histogram{WITH_LOCK(pool.cs, return pool.GetFeeHistogram())};
+    UniValue ret(UniValue::VARR);
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        UniValue bucket(UniValue::VOBJ);
+        bucket.pushKV("from", MEMPOOL_FEE_HISTOGRAM_BOUNDS[i]);
+        if (i + 1 < histogram.size()) bucket.pushKV("to", MEMPOOL_FEE_HISTOGRAM_BOUNDS[i + 1]);
+        bucket.pushKV("count", histogram[i].count);
+        bucket.pushKV("vsize", histogram[i].vsize);
+        bucket.pushKV("fees", ValueFromAmount(histogram[i].fees));
+        ret.push_back(bucket);
+    }
+    return ret;
+}
+
+static RPCHelpMan getmempoolfeehistogram()
+{
+    return RPCHelpMan{"getmempoolfeehistogram",
+                "\nReturns the number, total virtual size and total fees of the mempool transactions in fee rate buckets.\n"
+                "Transactions are counted at their individual fee rate, including fee deltas from prioritisetransaction.\n"
+                "The first bucket also holds the transactions paying less than its lower bound.\n",
+                {},
+                RPCResult{
+                    RPCResult::Type::ARR, "", "",
+                    {
+                        {RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::NUM, "from", "Lower bound of the fee rate bucket in " + CURRENCY_ATOM + "/vB"},
+                            {RPCResult::Type::NUM, "to", /*optional=*/true, "Upper bound (exclusive) of the fee rate bucket in " + CURRENCY_ATOM + "/vB, if not the last bucket"},
+                            {RPCResult::Type::NUM, "count", "Number of transactions in the bucket"},
+                            {RPCResult::Type::NUM, "vsize", "Sum of the virtual sizes of the transactions in the bucket"},
+                            {RPCResult::Type::STR_AMOUNT, "fees", "Sum of the modified fees of the transactions in the bucket in " + CURRENCY_UNIT},
+                        }},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getmempoolfeehistogram", "")
+            + HelpExampleRpc("getmempoolfeehistogram", "")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    return MempoolFeeHistogramToJSON(EnsureAnyMemPool(request.context));
+},
+    };
+}
+
 static RPCHelpMan preciousblock()
 {
     return RPCHelpMan{"preciousblock",
@@ -2847,6 +2953,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         &getmempooldescendants,              },
     { "blockchain",         &getmempoolentry,                    },
     { "blockchain",         &getmempoolinfo,                     },
+    { "blockchain",         &getmempoolfeehistogram,             },
     { "blockchain",         &getrawmempool,                      },
     { "blockchain",         &gettxout,                           },
     { "blockchain",         &gettxoutsetinfo,                    },
@@ -12,7 +12,10 @@
 #include <sync.h>
 
 #include <any>
+#include <cstddef>
+#include <functional>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 extern RecursiveMutex cs_main;
@@ -22,6 +25,7 @@ class CBlockIndex;
 class CChainState;
 class CTxMemPool;
 class UniValue;
+class uint256;
 namespace node {
 struct NodeContext;
 } // namespace node
@@ -42,12 +46,34 @@ void RPCNotifyBlockChange(const CBlockIndex*);
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, TxVerbosity verbosity) LOCKS_EXCLUDED(cs_main);
 
+/**
+ * Write the same JSON as blockToJSON, in pieces passed to write, so that the
+ * description of the whole block is never held in memory at once.
+ */
+void BlockToJSONStream(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, TxVerbosity verbosity, const std::function<void(const std::string&)>& write) LOCKS_EXCLUDED(cs_main);
+
 /** Mempool information to JSON */
 UniValue MempoolInfoToJSON(const CTxMemPool& pool);
 
+/** Mempool fee histogram to JSON */
+UniValue MempoolFeeHistogramToJSON(const CTxMemPool& pool);
+
 /** Mempool to JSON */
 UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose = false, bool include_mempool_sequence = false);
 
+/** Number of mempool entries described per acquisition of the mempool lock by ForEachMempoolEntryJSON */
+static constexpr size_t MEMPOOL_JSON_BATCH_SIZE{1000};
+
+/**
+ * Call fn with the txid and the verbose getrawmempool description of every
+ * transaction in the mempool. The mempool lock is held to list the txids, and
+ * then while describing MEMPOOL_JSON_BATCH_SIZE of them at a time, but not
+ * while fn is called. Transactions that left the mempool meanwhile are
+ * skipped, so the result is not a snapshot of the mempool at a single time,
+ * unlike MempoolToJSON.
+ */
+void ForEachMempoolEntryJSON(const CTxMemPool& pool, const std::function<void(const uint256& txid, UniValue&& info)>& fn);
+
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex) LOCKS_EXCLUDED(cs_main);
 
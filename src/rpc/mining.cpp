@@ -42,6 +42,7 @@
 #include <stdint.h>
 
 using node::BlockAssembler;
+using node::BlockTemplateCache;
 using node::CBlockTemplate;
 using node::IncrementExtraNonce;
 using node::NodeContext;
@@ -525,6 +526,8 @@ static RPCHelpMan getblocktemplate()
     return RPCHelpMan{"getblocktemplate",
         "\nIf the request parameters include a 'mode' key, that is used to explicitly select between the default 'template' request or a 'proposal'.\n"
         "It returns data needed to construct a block to work on.\n"
+        "The template is assembled in the background after the mempool changed, so its transactions can lag behind\n"
+        "the mempool by up to " + ToString(count_milliseconds(node::BLOCK_TEMPLATE_REBUILD_DELAY)) + " milliseconds, and a template is reused for up to 5 seconds.\n"
         "For full specification, see BIPs 22, 23, 9, and 145:\n"
         "    https://github.com/bitcoin/bips/blob/master/bip-0022.mediawiki\n"
         "    https://github.com/bitcoin/bips/blob/master/bip-0023.mediawiki\n"
@@ -770,9 +773,13 @@ static RPCHelpMan getblocktemplate()
         CBlockIndex* pindexPrevNew = active_chain.Tip();
         nStart = GetTime();
 
-        // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(active_chainstate, mempool, Params()).CreateNewBlock(scriptDummy);
+        // Create new block, unless the cache has assembled it already
+        if (BlockTemplateCache* cache = node.block_template_cache.get()) {
+            pblocktemplate = std::make_unique<CBlockTemplate>(*cache->Get(nTransactionsUpdatedLast, /*up_to_date=*/false));
+        } else {
+            CScript scriptDummy = CScript() << OP_TRUE;
+            pblocktemplate = BlockAssembler(active_chainstate, mempool, Params()).CreateNewBlock(scriptDummy);
+        }
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
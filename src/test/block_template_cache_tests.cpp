@@ -0,0 +1,128 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/miner.h>
+#include <script/script.h>
+#include <sync.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <util/time.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using node::BLOCK_TEMPLATE_IDLE_TIMEOUT;
+using node::BLOCK_TEMPLATE_REBUILD_DELAY;
+using node::BlockTemplateCache;
+using node::CBlockTemplate;
+
+BOOST_FIXTURE_TEST_SUITE(block_template_cache_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(block_template_cache)
+{
+    CTxMemPool& pool = *m_node.mempool;
+    const CScript p2pk = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Fees of the templates passed to the listener, and their change.
+    Mutex mutex;
+    std::vector<std::pair<CAmount, CAmount>> notified;
+    const auto wait_for_notifications = [&](size_t count) {
+        while (WITH_LOCK(mutex, return notified.size()) < count) {
+            UninterruptibleSleep(std::chrono::milliseconds{10});
+        }
+    };
+
+    BlockTemplateCache cache{*m_node.chainman, pool};
+    cache.AddListener([&](const std::shared_ptr<const CBlockTemplate>& old_template, const std::shared_ptr<const CBlockTemplate>& new_template) {
+        const CAmount old_fees{old_template ? -old_template->vTxFees.front() : 0};
+        LOCK(mutex);
+        notified.emplace_back(-new_template->vTxFees.front(), -new_template->vTxFees.front() - old_fees);
+    });
+    RegisterValidationInterface(&cache);
+    cache.Start();
+
+    // The first template is assembled on request and kept.
+    unsigned int transactions_updated;
+    const auto empty_template{cache.Get(transactions_updated, /*up_to_date=*/false)};
+    BOOST_CHECK_EQUAL(empty_template->block.vtx.size(), 1U);
+    BOOST_CHECK_EQUAL(empty_template->block.hashPrevBlock, WITH_LOCK(cs_main, return m_node.chainman->ActiveChain().Tip()->GetBlockHash()));
+    BOOST_CHECK(cache.Get(transactions_updated, /*up_to_date=*/true) == empty_template);
+
+    // A change to the mempool is picked up by up to date requests right away,
+    // and by a rebuild on the block template thread after a while.
+    const CMutableTransaction tx{CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 1, coinbaseKey, p2pk, 49 * COIN)};
+    const auto tx_template{cache.Get(transactions_updated, /*up_to_date=*/true)};
+    BOOST_CHECK_EQUAL(transactions_updated, pool.GetTransactionsUpdated());
+    BOOST_REQUIRE_EQUAL(tx_template->block.vtx.size(), 2U);
+    BOOST_CHECK_EQUAL(tx_template->block.vtx[1]->GetHash(), tx.GetHash());
+    wait_for_notifications(1);
+    BOOST_CHECK(WITH_LOCK(mutex, return notified.back()) == std::make_pair(CAmount{COIN}, CAmount{COIN}));
+
+    // A new tip triggers a rebuild right away.
+    CreateAndProcessBlock({tx}, p2pk);
+    wait_for_notifications(2);
+    BOOST_CHECK(WITH_LOCK(mutex, return notified.back()) == std::make_pair(CAmount{0}, CAmount{-COIN}));
+    const auto next_template{cache.Get(transactions_updated, /*up_to_date=*/false)};
+    BOOST_CHECK_EQUAL(next_template->block.vtx.size(), 1U);
+    BOOST_CHECK_EQUAL(next_template->block.hashPrevBlock, WITH_LOCK(cs_main, return m_node.chainman->ActiveChain().Tip()->GetBlockHash()));
+
+    UnregisterValidationInterface(&cache);
+    SyncWithValidationInterfaceQueue();
+    cache.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(idle_timeout)
+{
+    CTxMemPool& pool = *m_node.mempool;
+    const CScript p2pk = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const auto wait_for_rebuild{[] { UninterruptibleSleep(BLOCK_TEMPLATE_REBUILD_DELAY * 3); }};
+
+    BlockTemplateCache cache{*m_node.chainman, pool};
+    RegisterValidationInterface(&cache);
+    cache.Start();
+    SetMockTime(GetTime<std::chrono::seconds>());
+
+    // Without listeners, the template is assembled on request.
+    const CTransactionRef tx1{MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 1, coinbaseKey, p2pk, 49 * COIN))};
+    SyncWithValidationInterfaceQueue();
+    wait_for_rebuild();
+    unsigned int transactions_updated;
+    auto block_template{cache.Get(transactions_updated, /*up_to_date=*/false)};
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 2U);
+
+    // While it is being requested, the template is kept up to date, and
+    // served as is.
+    const CTransactionRef tx2{MakeTransactionRef(CreateValidMempoolTransaction(tx1, 0, 1, coinbaseKey, p2pk, 48 * COIN))};
+    SyncWithValidationInterfaceQueue();
+    wait_for_rebuild();
+    // Only the caller holds on to the replaced template
+    BOOST_CHECK_EQUAL(block_template.use_count(), 1);
+    block_template = cache.Get(transactions_updated, /*up_to_date=*/false);
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 3U);
+    BOOST_CHECK_EQUAL(transactions_updated, pool.GetTransactionsUpdated());
+
+    // Once it was not requested for a while, it is left alone, and assembled
+    // on request again.
+    SetMockTime(GetTime<std::chrono::seconds>() + BLOCK_TEMPLATE_IDLE_TIMEOUT + std::chrono::seconds{1});
+    CreateValidMempoolTransaction(tx2, 0, 1, coinbaseKey, p2pk, 47 * COIN);
+    SyncWithValidationInterfaceQueue();
+    wait_for_rebuild();
+    // The cache holds on to the template as well
+    BOOST_CHECK_EQUAL(block_template.use_count(), 2);
+    block_template = cache.Get(transactions_updated, /*up_to_date=*/false);
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 4U);
+
+    UnregisterValidationInterface(&cache);
+    SyncWithValidationInterfaceQueue();
+    cache.Stop();
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 
 #include <arith_uint256.h>
 #include <banman.h>
+#include <blockencodings.h>
 #include <chainparams.h>
 #include <net.h>
 #include <net_processing.h>
@@ -427,21 +428,138 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
     peerLogic->FinalizeNode(dummyNode);
 }
 
+BOOST_FIXTURE_TEST_CASE(disconnect_during_reconstruction, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    auto connman = std::make_unique<CConnman>(0x1337, 0x1337, *m_node.addrman);
+    // The reconstruction thread is not started, so the compact block stays pending.
+    auto peerLogic = PeerManager::make(chainparams, *connman, *m_node.addrman, nullptr,
+                                       *m_node.chainman, *m_node.mempool, false);
+    const std::atomic<bool> interrupt{false};
+
+    CAddress addr(ip(0xa0b0c001), NODE_NONE);
+    CNode dummyNode{id++,
+                    ServiceFlags(NODE_NETWORK | NODE_WITNESS),
+                    /*sock=*/nullptr,
+                    addr,
+                    /*nKeyedNetGroupIn=*/0,
+                    /*nLocalHostNonceIn=*/0,
+                    CAddress(),
+                    /*addrNameIn=*/"",
+                    ConnectionType::OUTBOUND_FULL_RELAY,
+                    /*inbound_onion=*/false};
+    dummyNode.SetCommonVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&dummyNode);
+    dummyNode.nVersion = PROTOCOL_VERSION;
+    dummyNode.fSuccessfullyConnected = true;
+
+    CDataStream sendcmpct{SER_NETWORK, PROTOCOL_VERSION};
+    sendcmpct << /*high_bandwidth=*/false << /*version=*/uint64_t{2};
+    peerLogic->ProcessMessage(dummyNode, NetMsgType::SENDCMPCT, sendcmpct, GetTime<std::chrono::microseconds>(), interrupt);
+
+    // The compact block is requested from the peer while it is reconstructed.
+    const CBlock block{CreateBlock({}, CScript() << OP_TRUE, m_node.chainman->ActiveChainstate())};
+    CDataStream cmpctblock{SER_NETWORK, PROTOCOL_VERSION};
+    cmpctblock << CBlockHeaderAndShortTxIDs{block, /*fUseWTXID=*/true};
+    peerLogic->ProcessMessage(dummyNode, NetMsgType::CMPCTBLOCK, cmpctblock, GetTime<std::chrono::microseconds>(), interrupt);
+    CNodeStateStats stats;
+    BOOST_REQUIRE(peerLogic->GetNodeStateStats(dummyNode.GetId(), stats));
+    BOOST_CHECK_EQUAL(stats.vHeightInFlight.size(), 1U);
+
+    // Disconnecting the peer forgets about the reconstruction, and the
+    // reconstruction is dropped once it is done.
+    peerLogic->FinalizeNode(dummyNode);
+    BOOST_CHECK(!peerLogic->GetNodeStateStats(dummyNode.GetId(), stats));
+    peerLogic->StartReconstructionThread();
+}
+
+BOOST_FIXTURE_TEST_CASE(orphan_chain_resolves, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    auto connman = std::make_unique<CConnman>(0x1337, 0x1337, *m_node.addrman);
+    auto peerLogic = PeerManager::make(chainparams, *connman, *m_node.addrman, nullptr,
+                                       *m_node.chainman, *m_node.mempool, false);
+    std::atomic<bool> interrupt{false};
+
+    CAddress addr(ip(0xa0b0c002), NODE_NONE);
+    CNode dummyNode{id++,
+                    ServiceFlags(NODE_NETWORK | NODE_WITNESS),
+                    /*sock=*/nullptr,
+                    addr,
+                    /*nKeyedNetGroupIn=*/0,
+                    /*nLocalHostNonceIn=*/0,
+                    CAddress(),
+                    /*addrNameIn=*/"",
+                    ConnectionType::OUTBOUND_FULL_RELAY,
+                    /*inbound_onion=*/false};
+    dummyNode.SetCommonVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&dummyNode);
+    dummyNode.nVersion = PROTOCOL_VERSION;
+    dummyNode.fSuccessfullyConnected = true;
+
+    // A chain of transactions, each spending the one before
+    const CScript script_pub_key{GetScriptForRawPubKey(coinbaseKey.GetPubKey())};
+    std::vector<CTransactionRef> chain;
+    CTransactionRef parent{m_coinbase_txns[0]};
+    for (int i = 0; i < 20; ++i) {
+        chain.push_back(MakeTransactionRef(CreateValidMempoolTransaction(parent, /*input_vout=*/0, /*input_height=*/1, coinbaseKey,
+                                                                         script_pub_key, /*output_amount=*/(49 - i) * COIN, /*submit=*/false)));
+        parent = chain.back();
+    }
+
+    // Relayed from the last to the first, all but the first become orphans.
+    const auto send_tx{[&](const CTransactionRef& tx) {
+        CDataStream msg{SER_NETWORK, PROTOCOL_VERSION};
+        msg << tx;
+        peerLogic->ProcessMessage(dummyNode, NetMsgType::TX, msg, GetTime<std::chrono::microseconds>(), interrupt);
+    }};
+    for (auto it{chain.rbegin()}; it != std::prev(chain.rend()); ++it) {
+        send_tx(*it);
+    }
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), 0U);
+
+    // Accepting the first one resolves the rest of the chain, a few orphans at a time.
+    send_tx(chain.front());
+    int passes{0};
+    while (peerLogic->ProcessMessages(&dummyNode, interrupt)) {
+        BOOST_REQUIRE_LT(++passes, int(chain.size()));
+    }
+    BOOST_CHECK_GT(passes, 0);
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), chain.size());
+    for (const CTransactionRef& tx : chain) {
+        BOOST_CHECK(m_node.mempool->exists(GenTxid::Txid(tx->GetHash())));
+    }
+
+    peerLogic->FinalizeNode(dummyNode);
+}
+
 class TxOrphanageTest : public TxOrphanage
 {
 public:
-    inline size_t CountOrphans() const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
+    inline size_t CountOrphans() const
     {
-        return m_orphans.size();
+        size_t count{0};
+        for (const Shard& shard : m_shards) {
+            LOCK(shard.m_mutex);
+            count += shard.m_orphans.size();
+        }
+        return count;
     }
 
-    CTransactionRef RandomOrphan() EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
+    CTransactionRef RandomOrphan()
     {
-        std::map<uint256, OrphanTx>::iterator it;
-        it = m_orphans.lower_bound(InsecureRand256());
-        if (it == m_orphans.end())
-            it = m_orphans.begin();
-        return it->second.tx;
+        // The orphan with the lowest txid not below a random one, or else the lowest txid
+        const uint256 random_txid{InsecureRand256()};
+        const OrphanTx* next{nullptr};
+        const OrphanTx* first{nullptr};
+        for (const Shard& shard : m_shards) {
+            LOCK(shard.m_mutex);
+            for (const auto& [txid, orphan] : shard.m_orphans) {
+                if (!first || txid < first->tx->GetHash()) first = &orphan;
+                if (!(txid < random_txid) && (!next || txid < next->tx->GetHash())) next = &orphan;
+            }
+        }
+        return next ? next->tx : first->tx;
     }
 };
 
@@ -469,8 +587,6 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     FillableSigningProvider keystore;
     BOOST_CHECK(keystore.AddKey(key));
 
-    LOCK(g_cs_orphans);
-
     // 50 orphan transactions:
     for (int i = 0; i < 50; i++)
     {
@@ -544,4 +660,43 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(orphanage.CountOrphans() == 0);
 }
 
+BOOST_AUTO_TEST_CASE(orphans_erased_for_block)
+{
+    TxOrphanageTest orphanage;
+    const uint256 parent_txid{InsecureRand256()};
+    const auto make_tx{[](const std::vector<COutPoint>& prevouts) {
+        CMutableTransaction tx;
+        for (const COutPoint& prevout : prevouts) {
+            tx.vin.emplace_back(prevout);
+            tx.vin.back().scriptSig << OP_1;
+        }
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1 * CENT;
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        return MakeTransactionRef(tx);
+    }};
+
+    // Orphans spending either output of the same parent, and one the block includes
+    const CTransactionRef spends_output_0{make_tx({COutPoint{parent_txid, 0}})};
+    const CTransactionRef spends_output_1{make_tx({COutPoint{parent_txid, 1}})};
+    const CTransactionRef spends_both{make_tx({COutPoint{parent_txid, 1}, COutPoint{parent_txid, 0}})};
+    const CTransactionRef included{make_tx({COutPoint{InsecureRand256(), 0}})};
+    for (const CTransactionRef& tx : {spends_output_0, spends_output_1, spends_both, included}) {
+        BOOST_CHECK(orphanage.AddTx(tx, /*peer=*/0));
+    }
+
+    // The block spends the parent's output 0 with some other transaction
+    CBlock block;
+    block.vtx.push_back(make_tx({COutPoint{parent_txid, 0}, COutPoint{InsecureRand256(), 0}}));
+    block.vtx.push_back(included);
+    orphanage.EraseForBlock(block);
+
+    BOOST_CHECK(!orphanage.HaveTx(GenTxid::Txid(spends_output_0->GetHash())));
+    BOOST_CHECK(!orphanage.HaveTx(GenTxid::Txid(spends_both->GetHash())));
+    BOOST_CHECK(!orphanage.HaveTx(GenTxid::Txid(included->GetHash())));
+    // Only spending another output of the same parent does not conflict with the block
+    BOOST_CHECK(orphanage.HaveTx(GenTxid::Txid(spends_output_1->GetHash())));
+    BOOST_CHECK_EQUAL(orphanage.CountOrphans(), 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -13,6 +13,7 @@
 #include <util/time.h>
 #include <version.h>
 
+#include <algorithm>
 #include <memory>
 
 FuzzedSock::FuzzedSock(FuzzedDataProvider& fuzzed_data_provider)
@@ -73,6 +74,13 @@ ssize_t FuzzedSock::Send(const void* data, size_t len, int flags) const
     return r;
 }
 
+ssize_t FuzzedSock::SendMany(Span<const Span<const unsigned char>> buffers, int flags) const
+{
+    size_t len{0};
+    for (size_t i = 0; i < std::min(buffers.size(), MAX_SEND_BUFFERS); ++i) len += buffers[i].size();
+    return Send(nullptr, len, flags);
+}
+
 ssize_t FuzzedSock::Recv(void* buf, size_t len, int flags) const
 {
     // Have a permanent error at recv_errnos[0] because when the fuzzed data is exhausted
@@ -10,6 +10,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <array>
+
 BOOST_AUTO_TEST_SUITE(hash_tests)
 
 BOOST_AUTO_TEST_CASE(murmurhash3)
@@ -145,6 +147,23 @@ BOOST_AUTO_TEST_CASE(siphash)
         BOOST_CHECK_EQUAL(SipHashUint256(k1, k2, x), sip256.Finalize());
         BOOST_CHECK_EQUAL(SipHashUint256Extra(k1, k2, x, n), sip288.Finalize());
     }
+
+    // Check consistency between SipHashUint256 and SipHashUint256Lanes.
+    for (int i = 0; i < 16; ++i) {
+        uint64_t k1 = ctx.rand64();
+        uint64_t k2 = ctx.rand64();
+        std::array<uint256, SIPHASH_LANES> vals;
+        std::array<const uint256*, SIPHASH_LANES> val_ptrs;
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+            vals[l] = InsecureRand256();
+            val_ptrs[l] = &vals[l];
+        }
+        std::array<uint64_t, SIPHASH_LANES> hashes;
+        SipHashUint256Lanes(k1, k2, val_ptrs, hashes);
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+            BOOST_CHECK_EQUAL(hashes[l], SipHashUint256(k1, k2, vals[l]));
+        }
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
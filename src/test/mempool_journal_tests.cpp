@@ -0,0 +1,141 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <clientversion.h>
+#include <node/mempool_journal.h>
+#include <script/script.h>
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <vector>
+
+using node::MempoolJournal;
+
+BOOST_FIXTURE_TEST_SUITE(mempool_journal_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(mempool_journal_replay)
+{
+    CTxMemPool& pool = *m_node.mempool;
+    CChainState& chainstate = m_node.chainman->ActiveChainstate();
+    const fs::path journal_path{m_args.GetDataDirNet() / "mempool.journal"};
+    const CScript p2pk = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Simulate a restart: forget the mempool and load it from the journal.
+    const auto restart = [&](std::unique_ptr<MempoolJournal>& journal) {
+        if (journal) {
+            SyncWithValidationInterfaceQueue();
+            journal->Flush();
+            UnregisterValidationInterface(journal.get());
+        }
+        {
+            LOCK(pool.cs);
+            for (const TxMempoolInfo& info : pool.infoAll()) {
+                pool.ClearPrioritisation(info.tx->GetHash());
+                pool.RemoveUnbroadcastTx(info.tx->GetHash());
+            }
+            pool.clear();
+        }
+        journal = std::make_unique<MempoolJournal>(pool, m_args.GetDataDirNet());
+        RegisterValidationInterface(journal.get());
+        journal->Load(chainstate);
+    };
+
+    // Without a journal or mempool.dat, loading starts a journal with an empty snapshot.
+    std::unique_ptr<MempoolJournal> journal;
+    restart(journal);
+    BOOST_CHECK(fs::exists(journal_path));
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+
+    // A chain of three transactions.
+    std::vector<CTransactionRef> txs{m_coinbase_txns[0]};
+    for (int i = 0; i < 3; ++i) {
+        SetMockTime(GetTime() + 10);
+        txs.push_back(MakeTransactionRef(CreateValidMempoolTransaction(txs.back(), 0, i == 0 ? 1 : 101, coinbaseKey, p2pk, (48 - i) * COIN)));
+    }
+    txs.erase(txs.begin());
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+    const auto time = pool.info(GenTxid::Txid(txs[1]->GetHash())).m_time;
+    {
+        LOCK(pool.cs);
+        pool.removeRecursive(*txs[2], MemPoolRemovalReason::CONFLICT);
+        pool.AddUnbroadcastTx(txs[1]->GetHash());
+    }
+    pool.PrioritiseTransaction(txs[0]->GetHash(), 1000);
+
+    // Only the changes since the snapshot are appended.
+    restart(journal);
+    BOOST_CHECK_EQUAL(pool.size(), 2U);
+    BOOST_CHECK(pool.exists(GenTxid::Txid(txs[0]->GetHash())));
+    BOOST_CHECK(pool.exists(GenTxid::Txid(txs[1]->GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(txs[2]->GetHash())));
+    BOOST_CHECK(pool.info(GenTxid::Txid(txs[1]->GetHash())).m_time == time);
+    {
+        LOCK(pool.cs);
+        const auto entry = pool.mapTx.find(txs[0]->GetHash());
+        BOOST_CHECK_EQUAL(entry->GetModifiedFee() - entry->GetFee(), 1000);
+        BOOST_CHECK(pool.IsUnbroadcastTx(txs[1]->GetHash()));
+    }
+
+    // Confirming a transaction removes it from the journal too.
+    CreateAndProcessBlock({CMutableTransaction{*txs[0]}}, p2pk);
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+    restart(journal);
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+    BOOST_CHECK(pool.exists(GenTxid::Txid(txs[1]->GetHash())));
+
+    // Transactions of a block that were not in the mempool are not recorded.
+    SyncWithValidationInterfaceQueue();
+    journal->MaybeCompact();
+    const auto journal_size{fs::file_size(journal_path)};
+    const CMutableTransaction unrelated_tx{CreateValidMempoolTransaction(m_coinbase_txns[1], 0, 2, coinbaseKey, p2pk, 48 * COIN, /*submit=*/false)};
+    CreateAndProcessBlock({unrelated_tx}, p2pk);
+    SyncWithValidationInterfaceQueue();
+    journal->MaybeCompact();
+    BOOST_CHECK_EQUAL(fs::file_size(journal_path), journal_size);
+
+    // A partially written record is dropped, along with everything after it,
+    // and the journal is rewritten as a snapshot.
+    SyncWithValidationInterfaceQueue();
+    journal->Flush();
+    UnregisterValidationInterface(journal.get());
+    journal.reset();
+    fs::resize_file(journal_path, fs::file_size(journal_path) - 1);
+    restart(journal);
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+    BOOST_CHECK(WITH_LOCK(pool.cs, return !pool.IsUnbroadcastTx(txs[1]->GetHash())));
+    const auto snapshot_size{fs::file_size(journal_path)};
+    restart(journal);
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+
+    // Nothing but the fee deltas and unbroadcast set is appended when the
+    // mempool did not change.
+    SyncWithValidationInterfaceQueue();
+    journal->Flush();
+    UnregisterValidationInterface(journal.get());
+    journal.reset();
+    BOOST_CHECK_LT(fs::file_size(journal_path) - snapshot_size, 100U);
+
+    // A journal of an unknown version is neither loaded nor overwritten.
+    {
+        CAutoFile file{fsbridge::fopen(journal_path, "wb"), SER_DISK, CLIENT_VERSION};
+        file << uint64_t{2} << uint64_t{0};
+    }
+    const auto unknown_size{fs::file_size(journal_path)};
+    restart(journal);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    SyncWithValidationInterfaceQueue();
+    journal->Flush();
+    BOOST_CHECK_EQUAL(fs::file_size(journal_path), unknown_size);
+    UnregisterValidationInterface(journal.get());
+    journal.reset();
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
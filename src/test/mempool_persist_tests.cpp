@@ -0,0 +1,77 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <clientversion.h>
+#include <script/script.h>
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(mempool_persist_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(mempool_dat_v2_roundtrip)
+{
+    CTxMemPool& pool = *m_node.mempool;
+    CChainState& chainstate = m_node.chainman->ActiveChainstate();
+    const fs::path dat_path{m_args.GetDataDirNet() / "mempool.dat"};
+    const CScript p2pk = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    const auto clear = [&] {
+        LOCK(pool.cs);
+        for (const TxMempoolInfo& info : pool.infoAll()) {
+            pool.ClearPrioritisation(info.tx->GetHash());
+            pool.RemoveUnbroadcastTx(info.tx->GetHash());
+        }
+        pool.clear();
+    };
+
+    // A chain of three transactions, in three levels, and an unrelated one.
+    CreateAndProcessBlock({}, p2pk);
+    std::vector<CTransactionRef> txs{m_coinbase_txns[0]};
+    for (int i = 0; i < 3; ++i) {
+        txs.push_back(MakeTransactionRef(CreateValidMempoolTransaction(txs.back(), 0, i == 0 ? 1 : 101, coinbaseKey, p2pk, (48 - i) * COIN)));
+    }
+    txs.erase(txs.begin());
+    txs.push_back(MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[1], 0, 2, coinbaseKey, p2pk, 48 * COIN)));
+    BOOST_CHECK_EQUAL(pool.size(), 4U);
+    pool.PrioritiseTransaction(txs[1]->GetHash(), 1000);
+    WITH_LOCK(pool.cs, pool.AddUnbroadcastTx(txs[2]->GetHash()));
+
+    BOOST_REQUIRE(DumpMempool(pool, fsbridge::fopen, /*skip_file_commit=*/true));
+    {
+        CAutoFile file{fsbridge::fopen(dat_path, "rb"), SER_DISK, CLIENT_VERSION};
+        uint64_t version, num_levels, level_size;
+        file >> version >> num_levels;
+        BOOST_CHECK_EQUAL(version, 2U);
+        BOOST_CHECK_EQUAL(num_levels, 3U);
+        file >> level_size;
+        BOOST_CHECK_EQUAL(level_size, 2U);
+    }
+    clear();
+    BOOST_CHECK(LoadMempool(pool, chainstate));
+    BOOST_CHECK_EQUAL(pool.size(), 4U);
+    for (const CTransactionRef& tx : txs) {
+        BOOST_CHECK(pool.exists(GenTxid::Txid(tx->GetHash())));
+    }
+    {
+        LOCK(pool.cs);
+        const auto entry = pool.mapTx.find(txs[1]->GetHash());
+        BOOST_CHECK_EQUAL(entry->GetModifiedFee() - entry->GetFee(), 1000);
+        BOOST_CHECK(pool.IsUnbroadcastTx(txs[2]->GetHash()));
+    }
+
+    // A file whose index is cut short is rejected as a whole.
+    BOOST_REQUIRE(DumpMempool(pool, fsbridge::fopen, /*skip_file_commit=*/true));
+    fs::resize_file(dat_path, 8 + 8 + 3 * 8 + 32 + 4 * 8 + 10);
+    clear();
+    BOOST_CHECK(!LoadMempool(pool, chainstate));
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
+#include <deque>
 #include <vector>
 
 BOOST_FIXTURE_TEST_SUITE(mempool_tests, TestingSetup)
@@ -426,6 +427,7 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     CTxMemPool pool;
     LOCK2(cs_main, pool.cs);
     TestMemPoolEntryHelper entry;
+    const uint64_t start_sequence{pool.GetSequence()};
 
     CMutableTransaction tx1 = CMutableTransaction();
     tx1.vin.resize(1);
@@ -537,7 +539,12 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
         pool.addUnchecked(entry.Fee(1000LL).FromTx(tx5));
     pool.addUnchecked(entry.Fee(9000LL).FromTx(tx7));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() / 2); // should maximize mempool size by only removing 5/7
+    // should maximize mempool size by only removing 5/7; leave a little room
+    // over half, as vTxHashes does not shrink and entries carry no per-link
+    // allocations that would otherwise go away with 5/7. The removals logged
+    // for GetDeltasSince() don't go away either.
+    const size_t delta_log_usage{memusage::DynamicUsage(std::deque<MempoolDelta>(pool.GetSequence() - start_sequence)) - memusage::DynamicUsage(std::deque<MempoolDelta>())};
+    pool.TrimToSize((pool.DynamicMemoryUsage() - delta_log_usage) * 11 / 20 + delta_log_usage);
     BOOST_CHECK(pool.exists(GenTxid::Txid(tx4.GetHash())));
     BOOST_CHECK(!pool.exists(GenTxid::Txid(tx5.GetHash())));
     BOOST_CHECK(pool.exists(GenTxid::Txid(tx6.GetHash())));
@@ -573,6 +580,155 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     // ... unless it has gone all the way to 0 (after getting past 1000/2)
 }
 
+BOOST_AUTO_TEST_CASE(MempoolMemoryUsageTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // vTxHashes keeps its capacity when emptied, so leave it out of the comparison.
+    const auto usage_without_hashes = [&]() EXCLUSIVE_LOCKS_REQUIRED(pool.cs) {
+        return pool.DynamicMemoryUsage() - memusage::DynamicUsage(pool.vTxHashes);
+    };
+    const size_t empty_usage = usage_without_hashes();
+
+    // A chain of 10 transactions, each spending the previous one.
+    std::vector<CTransactionRef> chain;
+    for (int i = 0; i < 10; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        if (chain.empty()) {
+            tx.vin[0].scriptSig = CScript() << OP_1;
+        } else {
+            tx.vin[0].prevout = COutPoint(chain.back()->GetHash(), 0);
+        }
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        chain.push_back(MakeTransactionRef(tx));
+        pool.addUnchecked(entry.Fee(1000LL).FromTx(chain.back()));
+    }
+    const size_t full_usage = usage_without_hashes();
+    BOOST_CHECK_GT(full_usage, empty_usage);
+
+    // Every node freed by the removal is subtracted from the pool's usage
+    // again. Only the removals logged for GetDeltasSince() remain.
+    pool.removeRecursive(*chain.front(), REMOVAL_REASON_DUMMY);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    BOOST_CHECK_EQUAL(usage_without_hashes(), empty_usage + memusage::DynamicUsage(std::deque<MempoolDelta>(chain.size())) - memusage::DynamicUsage(std::deque<MempoolDelta>()));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolFeeHistogramTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    BOOST_CHECK_EQUAL(GetFeeHistogramBucket(0, 100), 0U);
+    BOOST_CHECK_EQUAL(GetFeeHistogramBucket(-100, 100), 0U);
+    BOOST_CHECK_EQUAL(GetFeeHistogramBucket(199, 100), 0U);
+    BOOST_CHECK_EQUAL(GetFeeHistogramBucket(200, 100), 1U);
+    BOOST_CHECK_EQUAL(GetFeeHistogramBucket(10 * COIN, 100), MEMPOOL_FEE_HISTOGRAM_BOUNDS.size() - 1);
+
+    // A parent paying 2 sat/vB and a child paying 10 sat/vB.
+    CMutableTransaction parent;
+    parent.vin.resize(1);
+    parent.vin[0].scriptSig = CScript() << OP_1;
+    parent.vout.resize(1);
+    parent.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    parent.vout[0].nValue = 10 * COIN;
+    const int64_t parent_vsize{GetVirtualTransactionSize(CTransaction{parent})};
+    pool.addUnchecked(entry.Fee(2 * parent_vsize).FromTx(parent));
+
+    CMutableTransaction child;
+    child.vin.resize(1);
+    child.vin[0].prevout = COutPoint(parent.GetHash(), 0);
+    child.vout.resize(1);
+    child.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    child.vout[0].nValue = 10 * COIN;
+    const int64_t child_vsize{GetVirtualTransactionSize(CTransaction{child})};
+    pool.addUnchecked(entry.Fee(10 * child_vsize).FromTx(child));
+
+    const size_t parent_bucket{GetFeeHistogramBucket(2 * parent_vsize, parent_vsize)};
+    const size_t child_bucket{GetFeeHistogramBucket(10 * child_vsize, child_vsize)};
+    BOOST_CHECK_EQUAL(MEMPOOL_FEE_HISTOGRAM_BOUNDS[parent_bucket], 2);
+    BOOST_CHECK_EQUAL(MEMPOOL_FEE_HISTOGRAM_BOUNDS[child_bucket], 10);
+    FeeHistogram histogram{pool.GetFeeHistogram()};
+    BOOST_CHECK_EQUAL(histogram[parent_bucket].count, 1U);
+    BOOST_CHECK_EQUAL(histogram[parent_bucket].vsize, parent_vsize);
+    BOOST_CHECK_EQUAL(histogram[parent_bucket].fees, 2 * parent_vsize);
+    BOOST_CHECK_EQUAL(histogram[child_bucket].count, 1U);
+
+    // Prioritising the parent moves it to the bucket of its modified fee rate.
+    pool.PrioritiseTransaction(parent.GetHash(), 8 * parent_vsize);
+    histogram = pool.GetFeeHistogram();
+    BOOST_CHECK_EQUAL(histogram[parent_bucket].count, 0U);
+    BOOST_CHECK_EQUAL(histogram[child_bucket].count, 2U);
+    BOOST_CHECK_EQUAL(histogram[child_bucket].vsize, parent_vsize + child_vsize);
+    BOOST_CHECK_EQUAL(histogram[child_bucket].fees, 10 * (parent_vsize + child_vsize));
+
+    // Removing the transactions empties the histogram again.
+    pool.removeRecursive(CTransaction{parent}, REMOVAL_REASON_DUMMY);
+    histogram = pool.GetFeeHistogram();
+    BOOST_CHECK(std::all_of(histogram.begin(), histogram.end(), [](const FeeHistogramBucket& bucket) {
+        return bucket.count == 0 && bucket.vsize == 0 && bucket.fees == 0;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolDeltaLogTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+
+    // Nothing changed yet.
+    const uint64_t start{pool.GetSequence()};
+    BOOST_CHECK(pool.GetDeltasSince(start)->empty());
+    BOOST_CHECK(!pool.GetDeltasSince(start - 1));
+    BOOST_CHECK(!pool.GetDeltasSince(start + 1));
+
+    // Additions are assigned their sequence number by validation, removals by the mempool.
+    pool.addUnchecked(entry.FromTx(tx));
+    BOOST_CHECK_EQUAL(pool.GetAndIncrementSequence(MempoolDelta::Type::ADDED, tx.GetHash()), start);
+    pool.removeRecursive(CTransaction{tx}, REMOVAL_REASON_DUMMY);
+    BOOST_CHECK_EQUAL(pool.GetSequence(), start + 2);
+    std::optional<std::vector<MempoolDelta>> deltas{pool.GetDeltasSince(start)};
+    BOOST_REQUIRE(deltas);
+    BOOST_REQUIRE_EQUAL(deltas->size(), 2U);
+    BOOST_CHECK_EQUAL((*deltas)[0].sequence, start);
+    BOOST_CHECK((*deltas)[0].type == MempoolDelta::Type::ADDED);
+    BOOST_CHECK((*deltas)[0].txid == tx.GetHash());
+    BOOST_CHECK_EQUAL((*deltas)[1].sequence, start + 1);
+    BOOST_CHECK((*deltas)[1].type == MempoolDelta::Type::REMOVED);
+    BOOST_CHECK((*deltas)[1].txid == tx.GetHash());
+    deltas = pool.GetDeltasSince(start + 1);
+    BOOST_REQUIRE(deltas);
+    BOOST_CHECK_EQUAL(deltas->size(), 1U);
+    BOOST_CHECK(pool.GetDeltasSince(start + 2)->empty());
+
+    // Only the last MEMPOOL_DELTA_LOG_SIZE changes are kept, and the memory
+    // they take is counted as the mempool's.
+    const size_t usage{pool.DynamicMemoryUsage()};
+    for (size_t i = 0; i < MEMPOOL_DELTA_LOG_SIZE - 1; ++i) {
+        pool.GetAndIncrementSequence(MempoolDelta::Type::ADDED, tx.GetHash());
+    }
+    BOOST_CHECK_EQUAL(pool.GetDeltasSince(start + 1)->size(), MEMPOOL_DELTA_LOG_SIZE);
+    BOOST_CHECK(!pool.GetDeltasSince(start));
+    BOOST_CHECK_GE(pool.DynamicMemoryUsage(), usage + (MEMPOOL_DELTA_LOG_SIZE - 2) * sizeof(MempoolDelta));
+
+    // Clearing the mempool starts over.
+    pool.clear();
+    BOOST_CHECK(!pool.GetDeltasSince(start + 1));
+    BOOST_CHECK(pool.GetDeltasSince(pool.GetSequence())->empty());
+}
+
 inline CTransactionRef make_tx(std::vector<CAmount>&& output_values, std::vector<CTransactionRef>&& inputs=std::vector<CTransactionRef>(), std::vector<uint32_t>&& input_indices=std::vector<uint32_t>())
 {
     CMutableTransaction tx = CMutableTransaction();
@@ -786,4 +942,59 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 4ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolUpdateFromBlockTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // b1 and b2 are confirmed and then disconnected again; m1, m2 and m3
+    // stay in the mempool throughout:
+    //
+    // b1 ---> b2
+    //  |       |
+    //  v       v
+    // m1 ---> m2 ---> m3
+    CTransactionRef b1 = make_tx(/*output_values=*/{10 * COIN, 10 * COIN});
+    CTransactionRef b2 = make_tx(/*output_values=*/{9 * COIN}, /*inputs=*/{b1});
+    CTransactionRef m1 = make_tx(/*output_values=*/{9 * COIN}, /*inputs=*/{b1}, /*input_indices=*/{1});
+    CTransactionRef m2 = make_tx(/*output_values=*/{17 * COIN}, /*inputs=*/{b2, m1});
+    CTransactionRef m3 = make_tx(/*output_values=*/{16 * COIN}, /*inputs=*/{m2});
+    const std::vector<CTransactionRef> block{b1, b2};
+    const std::vector<uint256> block_hashes{b1->GetHash(), b2->GetHash()};
+    const uint64_t no_limit = std::numeric_limits<uint64_t>::max();
+
+    const auto reorg = [&](uint64_t ancestor_count_limit) EXCLUSIVE_LOCKS_REQUIRED(::cs_main, pool.cs) {
+        pool.clear();
+        for (const auto& tx : {b1, b2, m1, m2, m3}) pool.addUnchecked(entry.Fee(1000LL).FromTx(tx));
+        pool.removeForBlock(block, 1);
+        BOOST_CHECK_EQUAL(pool.size(), 3U);
+        for (const auto& tx : block) pool.addUnchecked(entry.Fee(1000LL).FromTx(tx));
+        pool.UpdateTransactionsFromBlock(block_hashes, no_limit, ancestor_count_limit);
+    };
+    const auto check_counts = [&](const CTransactionRef& tx, uint64_t ancestors, uint64_t descendants) EXCLUSIVE_LOCKS_REQUIRED(pool.cs) {
+        const auto it = pool.mapTx.find(tx->GetHash());
+        BOOST_REQUIRE(it != pool.mapTx.end());
+        BOOST_CHECK_EQUAL(it->GetCountWithAncestors(), ancestors);
+        BOOST_CHECK_EQUAL(it->GetCountWithDescendants(), descendants);
+    };
+
+    reorg(no_limit);
+    BOOST_CHECK_EQUAL(pool.size(), 5U);
+    check_counts(b1, 1, 5);
+    check_counts(b2, 2, 3);
+    check_counts(m1, 2, 3);
+    check_counts(m2, 4, 2);
+    check_counts(m3, 5, 1);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(b1->GetHash())->GetMemPoolChildrenConst().size(), 2U);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(m2->GetHash())->GetMemPoolParentsConst().size(), 2U);
+
+    // Descendants exceeding the ancestor limit after the reorg are removed.
+    reorg(/*ancestor_count_limit=*/4);
+    BOOST_CHECK_EQUAL(pool.size(), 4U);
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(m3->GetHash())));
+    check_counts(b1, 1, 4);
+    check_counts(m2, 4, 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -909,4 +909,106 @@ BOOST_AUTO_TEST_CASE(initial_advertise_from_version_message)
     TestOnlyResetTimeData();
 }
 
+BOOST_AUTO_TEST_CASE(push_shared_message)
+{
+#ifndef WIN32
+    CConnman connman{0x1337, 0x1337, *m_node.addrman};
+    const CNetMsgMaker msg_maker{PROTOCOL_VERSION};
+
+    // Each peer's socket is one end of a socket pair, the other end of which receives what is sent to it.
+    std::vector<std::unique_ptr<CNode>> peers;
+    std::vector<Sock> receivers;
+    for (NodeId id = 0; id < 2; ++id) {
+        int s[2];
+        BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, s), 0);
+        receivers.emplace_back(s[1]);
+        peers.push_back(std::make_unique<CNode>(id, NODE_NETWORK, std::make_shared<Sock>(s[0]), CAddress{}, 0, 0, CAddress{},
+                                                std::string{}, ConnectionType::OUTBOUND_FULL_RELAY, /*inbound_onion=*/false));
+    }
+
+    CSharedNetMsg shared{msg_maker.Make(NetMsgType::PING, uint64_t{42})};
+    std::vector<unsigned char> expected;
+    const auto expect = [&expected](CSerializedNetMsg msg) {
+        std::vector<unsigned char> header;
+        V1TransportSerializer{}.prepareForTransport(msg, header);
+        expected.insert(expected.end(), header.begin(), header.end());
+        expected.insert(expected.end(), msg.data.begin(), msg.data.end());
+    };
+    expect(msg_maker.Make(NetMsgType::VERACK));
+    expect(msg_maker.Make(NetMsgType::PING, uint64_t{42}));
+
+    for (const auto& peer : peers) {
+        connman.PushMessage(peer.get(), msg_maker.Make(NetMsgType::VERACK));
+        connman.PushMessage(peer.get(), shared);
+    }
+    // The send queues referenced the shared buffers rather than copies, and released them once sent.
+    BOOST_CHECK_EQUAL(shared.m_data.use_count(), 1);
+
+    for (const Sock& receiver : receivers) {
+        std::vector<unsigned char> received(expected.size() + 1);
+        BOOST_CHECK_EQUAL(receiver.Recv(received.data(), received.size(), MSG_DONTWAIT), ssize_t(expected.size()));
+        received.resize(expected.size());
+        BOOST_CHECK(received == expected);
+    }
+#endif // WIN32
+}
+
+BOOST_AUTO_TEST_CASE(recv_buffer_pool)
+{
+    RecvBufferPool pool;
+    V1TransportDeserializer deserializer{Params(), /*node_id=*/0, SER_NETWORK, INIT_PROTO_VERSION, &pool};
+    const CNetMsgMaker msg_maker{INIT_PROTO_VERSION};
+    const auto receive = [&](CSerializedNetMsg msg) {
+        std::vector<unsigned char> bytes;
+        V1TransportSerializer{}.prepareForTransport(msg, bytes);
+        bytes.insert(bytes.end(), msg.data.begin(), msg.data.end());
+        Span<const uint8_t> msg_bytes{bytes};
+        while (!msg_bytes.empty()) {
+            BOOST_REQUIRE_GE(deserializer.Read(msg_bytes), 0);
+        }
+        BOOST_REQUIRE(deserializer.Complete());
+        bool reject_message;
+        CNetMessage received{deserializer.GetMessage(GetTime<std::chrono::microseconds>(), reject_message)};
+        BOOST_REQUIRE(!reject_message);
+        return received;
+    };
+
+    // The next message is received into the buffer of one that has been processed.
+    CNetMessage first{receive(msg_maker.Make(NetMsgType::PING, uint64_t{1}))};
+    const uint8_t* const first_data{UCharCast(first.m_recv.data())};
+    pool.Put(std::move(first.m_recv));
+    CNetMessage second{receive(msg_maker.Make(NetMsgType::PING, uint64_t{2}))};
+    BOOST_CHECK_EQUAL(UCharCast(second.m_recv.data()), first_data);
+    uint64_t nonce;
+    second.m_recv >> nonce;
+    BOOST_CHECK_EQUAL(nonce, 2U);
+
+    // Reused buffers come back empty, with the requested serialization parameters.
+    CDataStream used{SER_DISK, CLIENT_VERSION};
+    used << uint64_t{3};
+    pool.Put(std::move(used));
+    const CDataStream reused{pool.Get(SER_NETWORK, PROTOCOL_VERSION)};
+    BOOST_CHECK(reused.empty());
+    BOOST_CHECK_GT(reused.capacity(), 0U);
+    BOOST_CHECK_EQUAL(reused.GetType(), SER_NETWORK);
+    BOOST_CHECK_EQUAL(reused.GetVersion(), PROTOCOL_VERSION);
+
+    // Buffers past MAX_BUFFER_SIZE are not kept.
+    CDataStream big{SER_NETWORK, PROTOCOL_VERSION};
+    big.reserve(RecvBufferPool::MAX_BUFFER_SIZE + 1);
+    pool.Put(std::move(big));
+    BOOST_CHECK_EQUAL(pool.Get(SER_NETWORK, PROTOCOL_VERSION).capacity(), 0U);
+
+    // At most MAX_BUFFERS buffers are kept.
+    for (size_t i = 0; i < RecvBufferPool::MAX_BUFFERS + 1; ++i) {
+        CDataStream buffer{SER_NETWORK, PROTOCOL_VERSION};
+        buffer.reserve(100);
+        pool.Put(std::move(buffer));
+    }
+    for (size_t i = 0; i < RecvBufferPool::MAX_BUFFERS; ++i) {
+        BOOST_CHECK_GE(pool.Get(SER_NETWORK, PROTOCOL_VERSION).capacity(), 100U);
+    }
+    BOOST_CHECK_EQUAL(pool.Get(SER_NETWORK, PROTOCOL_VERSION).capacity(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
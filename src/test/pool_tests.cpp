@@ -0,0 +1,181 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memusage.h>
+#include <support/allocators/pool.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(basic_allocating)
+{
+    auto resource = PoolResource<8, 8>(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 0U);
+
+    // first chunk is already allocated, carving out 8 bytes
+    void* block = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 8U);
+
+    // freeing the block puts it into the freelist, the next allocation of the
+    // same size reuses it
+    resource.Deallocate(block, 8, 8);
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 0U);
+    void* b = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(b, block);
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 8U);
+
+    // zero-sized allocations still hand out a unique block
+    void* z = resource.Allocate(0, 1);
+    BOOST_CHECK(z != b);
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 16U);
+    resource.Deallocate(z, 0, 1);
+
+    // too big to fit into the pool: falls back to operator new, but is still accounted
+    void* big = resource.Allocate(16, 8);
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 8U + memusage::MallocUsage(16));
+    resource.Deallocate(big, 16, 8);
+
+    // too large alignment also falls back
+    void* aligned = resource.Allocate(8, 64);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(aligned) % 64, 0U);
+    resource.Deallocate(aligned, 8, 64);
+
+    resource.Deallocate(b, 8, 8);
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 0U);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(allocate_new_chunks)
+{
+    auto resource = PoolResource<16, 8>(64);
+    std::vector<void*> blocks;
+    for (int i = 0; i < 10; ++i) {
+        blocks.push_back(resource.Allocate(16, 8));
+    }
+    // 4 blocks of 16 bytes fit into each 64 byte chunk
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 3U);
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 10U * 16);
+
+    for (void* block : blocks) {
+        resource.Deallocate(block, 16, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 0U);
+
+    // Everything is served from the freelist, no new chunk is needed
+    for (int i = 0; i < 10; ++i) {
+        blocks[i] = resource.Allocate(16, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 3U);
+    for (void* block : blocks) {
+        resource.Deallocate(block, 16, 8);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(held_memory)
+{
+    auto resource = PoolResource<16, 8>(64);
+    const size_t chunk_usage = resource.DynamicMemoryUsage();
+    BOOST_CHECK_GE(chunk_usage, 64U);
+    BOOST_CHECK_EQUAL(resource.ReusableBytes(), 64U);
+
+    std::vector<void*> blocks;
+    for (int i = 0; i < 6; ++i) {
+        blocks.push_back(resource.Allocate(16, 8));
+    }
+    BOOST_CHECK_EQUAL(resource.DynamicMemoryUsage(), 2 * chunk_usage);
+    BOOST_CHECK_EQUAL(resource.ReusableBytes(), 2U * 16);
+
+    // Freed chunk memory is still held, but reused by allocations of the same size
+    for (void* block : blocks) {
+        resource.Deallocate(block, 16, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 0U);
+    BOOST_CHECK_EQUAL(resource.DynamicMemoryUsage(), 2 * chunk_usage);
+    BOOST_CHECK_EQUAL(resource.ReusableBytes(), 8U * 16);
+
+    // Blocks of 16 bytes cannot serve allocations of 8 bytes, so these need a new chunk
+    // once the rest of the current chunk is used up
+    for (int i = 0; i < 5; ++i) {
+        blocks[i] = resource.Allocate(8, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 3U);
+    BOOST_CHECK_EQUAL(resource.DynamicMemoryUsage(), 3 * chunk_usage);
+    BOOST_CHECK_EQUAL(resource.ReusableBytes(), 6U * 16 + 64 - 8);
+    for (int i = 0; i < 5; ++i) {
+        resource.Deallocate(blocks[i], 8, 8);
+    }
+
+    // Allocations served by operator new() are held until they are freed
+    void* big = resource.Allocate(100, 8);
+    BOOST_CHECK_EQUAL(resource.DynamicMemoryUsage(), 3 * chunk_usage + memusage::MallocUsage(100));
+    resource.Deallocate(big, 100, 8);
+    BOOST_CHECK_EQUAL(resource.DynamicMemoryUsage(), 3 * chunk_usage);
+}
+
+BOOST_AUTO_TEST_CASE(random_allocations)
+{
+    auto resource = PoolResource<128, 8>(65536);
+    std::vector<std::pair<std::byte*, size_t>> ptr_size;
+    size_t expected_in_use{0};
+
+    for (int i = 0; i < 1000; ++i) {
+        if (ptr_size.empty() || InsecureRandBool()) {
+            const size_t size = InsecureRandRange(200);
+            std::byte* ptr = static_cast<std::byte*>(resource.Allocate(size, 8));
+            BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(ptr) % 8, 0U);
+            // make sure the memory does not overlap with anything else
+            for (size_t j = 0; j < size; ++j) {
+                ptr[j] = std::byte(i);
+            }
+            ptr_size.emplace_back(ptr, size);
+            expected_in_use += size <= 128 ? std::max<size_t>((size + 7) / 8 * 8, 8) : memusage::MallocUsage(size);
+        } else {
+            const size_t idx = InsecureRandRange(ptr_size.size());
+            const auto [ptr, size] = ptr_size[idx];
+            resource.Deallocate(ptr, size, 8);
+            expected_in_use -= size <= 128 ? std::max<size_t>((size + 7) / 8 * 8, 8) : memusage::MallocUsage(size);
+            ptr_size[idx] = ptr_size.back();
+            ptr_size.pop_back();
+        }
+        BOOST_CHECK_EQUAL(resource.BytesInUse(), expected_in_use);
+    }
+
+    for (const auto& [ptr, size] : ptr_size) {
+        resource.Deallocate(ptr, size, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(node_container)
+{
+    using Alloc = PoolAllocator<std::pair<const int, int>, 128, alignof(void*)>;
+    Alloc::ResourceType resource{};
+    {
+        std::map<int, int, std::less<int>, Alloc> m{Alloc{&resource}};
+        for (int i = 0; i < 1000; ++i) {
+            m[i] = i * 2;
+        }
+        BOOST_CHECK_EQUAL(m.size(), 1000U);
+        BOOST_CHECK(resource.BytesInUse() > 0);
+        const size_t usage_full = resource.BytesInUse();
+        for (int i = 0; i < 500; ++i) {
+            m.erase(i);
+        }
+        BOOST_CHECK_EQUAL(resource.BytesInUse(), usage_full / 2);
+        for (int i = 500; i < 1000; ++i) {
+            BOOST_CHECK_EQUAL(m.at(i), i * 2);
+        }
+    }
+    BOOST_CHECK_EQUAL(resource.BytesInUse(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,102 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <netmessagemaker.h>
+#include <protocol.h>
+#include <relaycache.h>
+#include <serialize.h>
+#include <test/util/setup_common.h>
+#include <uint256.h>
+#include <util/time.h>
+#include <version.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+using namespace std::literals;
+
+BOOST_FIXTURE_TEST_SUITE(relaycache_tests, BasicTestingSetup)
+
+static CSerializedNetMsg MakeTx(size_t size)
+{
+    return CNetMsgMaker{PROTOCOL_VERSION}.Make(NetMsgType::TX, std::vector<unsigned char>(size));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_once)
+{
+    RelayCache cache;
+    const uint256 hash{InsecureRand256()};
+    int made{0};
+    const auto make = [&made] { ++made; return MakeTx(100); };
+
+    const CSharedNetMsg first{cache.Get(NetMsgType::TX, hash, 0, make)};
+    const CSharedNetMsg second{cache.Get(NetMsgType::TX, hash, 0, make)};
+    BOOST_CHECK_EQUAL(made, 1);
+    BOOST_CHECK(first.m_data == second.m_data);
+    BOOST_CHECK(first.m_header == second.m_header);
+
+    // The same object serialized differently, or as another message type, is kept apart.
+    cache.Get(NetMsgType::TX, hash, SERIALIZE_TRANSACTION_NO_WITNESS, make);
+    cache.Get(NetMsgType::BLOCK, hash, 0, make);
+    BOOST_CHECK_EQUAL(made, 3);
+    BOOST_CHECK_EQUAL(cache.Count(), 3U);
+
+    // A message that was serialized concurrently by another thread loses to the one kept.
+    const CSharedNetMsg added{cache.Add(NetMsgType::TX, hash, 0, CSharedNetMsg{MakeTx(100)})};
+    BOOST_CHECK(added.m_data == first.m_data);
+    BOOST_CHECK(!cache.Find(NetMsgType::TX, InsecureRand256(), 0));
+}
+
+BOOST_AUTO_TEST_CASE(bounded_size)
+{
+    const CSharedNetMsg msg{MakeTx(1000)};
+    const size_t msg_bytes{msg.m_header->size() + msg.m_data->size()};
+    RelayCache cache{/*max_bytes=*/3 * msg_bytes};
+
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 5; ++i) {
+        hashes.push_back(InsecureRand256());
+        cache.Add(NetMsgType::TX, hashes.back(), 0, CSharedNetMsg{msg});
+        BOOST_CHECK_LE(cache.Bytes(), 3 * msg_bytes);
+    }
+    // The oldest are forgotten first.
+    BOOST_CHECK_EQUAL(cache.Count(), 3U);
+    BOOST_CHECK(!cache.Find(NetMsgType::TX, hashes[1], 0));
+    BOOST_CHECK(cache.Find(NetMsgType::TX, hashes[2], 0));
+
+    // Messages too large to keep are still handed back.
+    const CSharedNetMsg large{cache.Add(NetMsgType::BLOCK, InsecureRand256(), 0, CSharedNetMsg{MakeTx(4 * msg_bytes)})};
+    BOOST_CHECK_GT(large.m_data->size(), 3 * msg_bytes);
+    BOOST_CHECK_EQUAL(cache.Count(), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(expiry)
+{
+    SetMockTime(1000s);
+    RelayCache cache{DEFAULT_RELAY_CACHE_BYTES, /*expiry=*/60s};
+    const uint256 old_hash{InsecureRand256()};
+    cache.Add(NetMsgType::TX, old_hash, 0, CSharedNetMsg{MakeTx(100)});
+
+    SetMockTime(1059s);
+    const uint256 new_hash{InsecureRand256()};
+    cache.Add(NetMsgType::TX, new_hash, 0, CSharedNetMsg{MakeTx(100)});
+    BOOST_CHECK_EQUAL(cache.Count(), 2U);
+    BOOST_CHECK(cache.Find(NetMsgType::TX, old_hash, 0));
+
+    // Expired messages are not found, even before anything else is added.
+    SetMockTime(1060s);
+    BOOST_CHECK(!cache.Find(NetMsgType::TX, old_hash, 0));
+    BOOST_CHECK(cache.Find(NetMsgType::TX, new_hash, 0));
+    BOOST_CHECK_EQUAL(cache.Count(), 1U);
+
+    // Nor is an expired message returned in place of a new one.
+    SetMockTime(1120s);
+    const CSharedNetMsg msg{MakeTx(100)};
+    BOOST_CHECK(cache.Add(NetMsgType::TX, new_hash, 0, CSharedNetMsg{msg}).m_data == msg.m_data);
+    BOOST_CHECK_EQUAL(cache.Count(), 1U);
+    SetMockTime(0s);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
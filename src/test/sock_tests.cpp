@@ -6,12 +6,15 @@
 #include <test/util/setup_common.h>
 #include <threadinterrupt.h>
 #include <util/sock.h>
+#include <util/sock_events.h>
 #include <util/system.h>
 
 #include <boost/test/unit_test.hpp>
 
 #include <cassert>
+#include <memory>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -175,6 +178,64 @@ BOOST_AUTO_TEST_CASE(recv_until_terminator_limit)
     receiver.join();
 }
 
+BOOST_AUTO_TEST_CASE(sock_events)
+{
+    for (const SockEventsBackend backend : {SockEventsBackend::SELECT, SockEventsBackend::POLL, SockEventsBackend::EPOLL}) {
+        const std::unique_ptr<SockEvents> sock_events{MakeSockEvents(backend)};
+        if (!sock_events) continue;
+
+        int s[2];
+        CreateSocketPair(s);
+        Sock sock0(s[0]);
+        Sock sock1(s[1]);
+        int key0, key1;
+        std::vector<SockEvents::Ready> ready;
+
+        // Nothing is ready until data arrives.
+        BOOST_CHECK(sock_events->Set(&key0, sock0.Get(), Sock::RECV));
+        BOOST_CHECK(sock_events->Set(&key1, sock1.Get(), Sock::RECV));
+        BOOST_REQUIRE(sock_events->Wait(0ms, ready));
+        BOOST_CHECK(ready.empty());
+        BOOST_REQUIRE_EQUAL(sock1.Send("a", 1, 0), 1);
+        BOOST_REQUIRE(sock_events->Wait(1min, ready));
+        BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+        BOOST_CHECK(ready[0].key == &key0);
+        BOOST_CHECK_EQUAL(ready[0].occurred, Sock::RECV);
+
+        // Changing the events of interest takes effect with the next wait.
+        BOOST_CHECK(sock_events->Set(&key0, sock0.Get(), 0));
+        BOOST_CHECK(sock_events->Set(&key1, sock1.Get(), Sock::RECV | Sock::SEND));
+        BOOST_REQUIRE(sock_events->Wait(1min, ready));
+        BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+        BOOST_CHECK(ready[0].key == &key1);
+        BOOST_CHECK_EQUAL(ready[0].occurred, Sock::SEND);
+
+        // Removed sockets are not reported anymore, and hangups always are.
+        sock_events->Remove(&key1);
+        sock1.Reset();
+        BOOST_REQUIRE(sock_events->Wait(1min, ready));
+        BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+        BOOST_CHECK(ready[0].key == &key0);
+        BOOST_CHECK(ready[0].occurred & SockEvents::ERR);
+
+        // A socket closed while it was registered, whose descriptor now refers
+        // to another socket, can be waited for again.
+        int s2[2];
+        CreateSocketPair(s2);
+        const SOCKET fd{sock0.Release()};
+        BOOST_REQUIRE_EQUAL(dup2(s2[0], fd), int(fd));
+        close(s2[0]);
+        Sock sock2(fd);
+        Sock sock3(s2[1]);
+        BOOST_CHECK(sock_events->Set(&key0, sock2.Get(), Sock::RECV | Sock::SEND));
+        BOOST_REQUIRE(sock_events->Wait(1min, ready));
+        BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+        BOOST_CHECK(ready[0].key == &key0);
+        BOOST_CHECK_EQUAL(ready[0].occurred, Sock::SEND);
+        sock_events->Remove(&key0);
+    }
+}
+
 #endif /* WIN32 */
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -383,4 +383,74 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, Dersig100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(parallel_checkinputs_test, TestChain100Setup)
+{
+    // The scripts of transactions with many inputs are checked on the script
+    // check threads, which the testing setup starts.
+    BOOST_REQUIRE(g_parallel_script_checks);
+
+    const CScript p2pk = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    FillableSigningProvider keystore;
+    BOOST_CHECK(keystore.AddKey(coinbaseKey));
+
+    CMutableTransaction fan_out;
+    fan_out.vin.emplace_back(COutPoint(m_coinbase_txns[0]->GetHash(), 0));
+    fan_out.vout.assign(20, CTxOut(2 * COIN, p2pk));
+    BOOST_CHECK(SignSignature(keystore, *m_coinbase_txns[0], fan_out, 0, SIGHASH_ALL));
+    const CTransactionRef fan_out_tx = MakeTransactionRef(fan_out);
+
+    CMutableTransaction spend;
+    for (uint32_t i = 0; i < fan_out.vout.size(); ++i) {
+        spend.vin.emplace_back(COutPoint(fan_out_tx->GetHash(), i));
+    }
+    spend.vout.assign(1, CTxOut(39 * COIN, p2pk));
+    for (uint32_t i = 0; i < spend.vin.size(); ++i) {
+        BOOST_CHECK(SignSignature(keystore, *fan_out_tx, spend, i, SIGHASH_ALL));
+    }
+
+    LOCK(cs_main);
+    BOOST_CHECK(m_node.chainman->ProcessTransaction(fan_out_tx).m_result_type == MempoolAcceptResult::ResultType::VALID);
+
+    // A single bad signature among many inputs is found and reported like it
+    // is by the serial checks.
+    CMutableTransaction bad_spend{spend};
+    bad_spend.vin[13].scriptSig = spend.vin[12].scriptSig;
+    const MempoolAcceptResult bad_result = m_node.chainman->ProcessTransaction(MakeTransactionRef(bad_spend));
+    BOOST_CHECK(bad_result.m_result_type == MempoolAcceptResult::ResultType::INVALID);
+    BOOST_CHECK_EQUAL(bad_result.m_state.GetRejectReason().rfind("mandatory-script-verify-flag-failed", 0), 0U);
+
+    BOOST_CHECK(m_node.chainman->ProcessTransaction(MakeTransactionRef(spend)).m_result_type == MempoolAcceptResult::ResultType::VALID);
+    BOOST_CHECK(m_node.mempool->exists(GenTxid::Txid(spend.GetHash())));
+
+    // The same for the scripts of a package, which are checked all at once:
+    // the failing transaction is found and reported with its reason.
+    CMutableTransaction package_parent;
+    package_parent.vin.emplace_back(COutPoint(spend.GetHash(), 0));
+    package_parent.vout.assign(20, CTxOut(19 * COIN / 10, p2pk));
+    BOOST_CHECK(SignSignature(keystore, CTransaction{spend}, package_parent, 0, SIGHASH_ALL));
+    const CTransactionRef package_parent_tx = MakeTransactionRef(package_parent);
+    CMutableTransaction package_child{spend};
+    package_child.vout[0].nValue = 37 * COIN;
+    for (CTxIn& txin : package_child.vin) {
+        txin.prevout.hash = package_parent_tx->GetHash();
+    }
+    for (uint32_t i = 0; i < package_child.vin.size(); ++i) {
+        BOOST_CHECK(SignSignature(keystore, *package_parent_tx, package_child, i, SIGHASH_ALL));
+    }
+    CMutableTransaction bad_package_child{package_child};
+    bad_package_child.vin[7].scriptSig = package_child.vin[6].scriptSig;
+    const CTransactionRef bad_package_child_tx = MakeTransactionRef(bad_package_child);
+    const auto bad_package_result = ProcessNewPackage(m_node.chainman->ActiveChainstate(), *m_node.mempool, {package_parent_tx, bad_package_child_tx}, /*test_accept=*/false);
+    BOOST_CHECK_EQUAL(bad_package_result.m_state.GetResult(), PackageValidationResult::PCKG_TX);
+    BOOST_CHECK_EQUAL(bad_package_result.m_tx_results.size(), 1U);
+    const auto it_bad_child = bad_package_result.m_tx_results.find(bad_package_child_tx->GetWitnessHash());
+    BOOST_REQUIRE(it_bad_child != bad_package_result.m_tx_results.end());
+    BOOST_CHECK_EQUAL(it_bad_child->second.m_state.GetRejectReason().rfind("mandatory-script-verify-flag-failed", 0), 0U);
+    BOOST_CHECK(!m_node.mempool->exists(GenTxid::Txid(package_parent_tx->GetHash())));
+
+    const auto package_result = ProcessNewPackage(m_node.chainman->ActiveChainstate(), *m_node.mempool, {package_parent_tx, MakeTransactionRef(package_child)}, /*test_accept=*/false);
+    BOOST_CHECK_MESSAGE(package_result.m_state.IsValid(), package_result.m_state.GetRejectReason());
+    BOOST_CHECK(m_node.mempool->exists(GenTxid::Txid(package_child.GetHash())));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
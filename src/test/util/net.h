@@ -10,11 +10,13 @@
 #include <net.h>
 #include <util/sock.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstring>
 #include <memory>
 #include <string>
+#include <thread>
 
 struct ConnmanTestMsg : public CConnman {
     using CConnman::CConnman;
@@ -40,6 +42,22 @@ struct ConnmanTestMsg : public CConnman {
 
     void ProcessMessagesOnce(CNode& node) { m_msgproc->ProcessMessages(&node, flagInterruptMsgProc); }
 
+    /** Run the message handler loop on as many threads as Start() would. */
+    void StartMessageHandlers()
+    {
+        for (int i = 0; i < m_num_msghand_threads; ++i) {
+            m_message_handler_threads.emplace_back([this] { ThreadMessageHandler(); });
+        }
+    }
+    void StopMessageHandlers()
+    {
+        WITH_LOCK(mutexMsgProc, flagInterruptMsgProc = true);
+        condMsgProc.notify_all();
+        for (std::thread& thread : m_message_handler_threads) thread.join();
+        m_message_handler_threads.clear();
+        flagInterruptMsgProc = false;
+    }
+
     void NodeReceiveMsgBytes(CNode& node, Span<const uint8_t> msg_bytes, bool& complete) const;
 
     bool ReceiveMsgFrom(CNode& node, CSerializedNetMsg& ser_msg) const;
@@ -115,6 +133,13 @@ public:
 
     ssize_t Send(const void*, size_t len, int) const override { return len; }
 
+    ssize_t SendMany(Span<const Span<const unsigned char>> buffers, int) const override
+    {
+        size_t len{0};
+        for (size_t i = 0; i < std::min(buffers.size(), MAX_SEND_BUFFERS); ++i) len += buffers[i].size();
+        return len;
+    }
+
     ssize_t Recv(void* buf, size_t len, int flags) const override
     {
         const size_t consume_bytes{std::min(len, m_contents.size() - m_consumed)};
@@ -231,6 +231,7 @@ TestingSetup::TestingSetup(const std::string& chainName, const std::vector<const
     m_node.peerman = PeerManager::make(chainparams, *m_node.connman, *m_node.addrman,
                                        m_node.banman.get(), *m_node.chainman,
                                        *m_node.mempool, false);
+    m_node.peerman->StartReconstructionThread();
     {
         CConnman::Options options;
         options.m_msgproc = m_node.peerman.get();
@@ -117,53 +117,68 @@ size_t CTxMemPoolEntry::GetTxSize() const
 }
 
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap& cachedDescendants,
-                                      const std::set<uint256>& setExclude, std::set<uint256>& descendants_to_remove,
+                                      const TxidSet& setExclude, std::set<uint256>& descendants_to_remove,
                                       uint64_t ancestor_size_limit, uint64_t ancestor_count_limit)
 {
-    CTxMemPoolEntry::Children stageEntries, descendants;
-    stageEntries = updateIt->GetMemPoolChildrenConst();
-
-    while (!stageEntries.empty()) {
-        const CTxMemPoolEntry& descendant = *stageEntries.begin();
-        descendants.insert(descendant);
-        stageEntries.erase(descendant);
-        const CTxMemPoolEntry::Children& children = descendant.GetMemPoolChildrenConst();
-        for (const CTxMemPoolEntry& childEntry : children) {
-            cacheMap::iterator cacheIt = cachedDescendants.find(mapTx.iterator_to(childEntry));
+    // The cache line of updateIt, i.e. its descendants that are not excluded.
+    std::vector<txiter>& cache_line = cachedDescendants[updateIt];
+    // Every entry is marked visited when it is first staged or added to
+    // descendants, so neither vector ever holds duplicates.
+    std::vector<txiter> stageEntries, descendants;
+    {
+        WITH_FRESH_EPOCH(m_epoch);
+        // Children with a cache line have been updated before (they are
+        // excluded, as are all their descendants that are not in the cache
+        // line), so only the cache line needs to be added and the subgraph
+        // below them is never walked again.
+        auto stage_child = [&](const CTxMemPoolEntry& child) EXCLUSIVE_LOCKS_REQUIRED(cs, m_epoch) {
+            const txiter childIt = mapTx.iterator_to(child);
+            cacheMap::const_iterator cacheIt = cachedDescendants.find(childIt);
             if (cacheIt != cachedDescendants.end()) {
-                // We've already calculated this one, just add the entries for this set
-                // but don't traverse again.
                 for (txiter cacheEntry : cacheIt->second) {
-                    descendants.insert(*cacheEntry);
+                    if (!visited(cacheEntry)) descendants.push_back(cacheEntry);
                 }
-            } else if (!descendants.count(childEntry)) {
+            } else if (!visited(childIt)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                stageEntries.push_back(childIt);
             }
+        };
+        for (const CTxMemPoolEntry& child : updateIt->GetMemPoolChildrenConst()) {
+            stage_child(child);
         }
-    }
+        while (!stageEntries.empty()) {
+            const txiter descendant = stageEntries.back();
+            stageEntries.pop_back();
+            descendants.push_back(descendant);
+            for (const CTxMemPoolEntry& childEntry : descendant->GetMemPoolChildrenConst()) {
+                stage_child(childEntry);
+            }
+        }
+    } // release epoch guard
     // descendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (const CTxMemPoolEntry& descendant : descendants) {
-        if (!setExclude.count(descendant.GetTx().GetHash())) {
-            modifySize += descendant.GetTxSize();
-            modifyFee += descendant.GetModifiedFee();
+    for (const txiter descendant : descendants) {
+        if (!setExclude.count(descendant->GetTx().GetHash())) {
+            modifySize += descendant->GetTxSize();
+            modifyFee += descendant->GetModifiedFee();
             modifyCount++;
-            cachedDescendants[updateIt].insert(mapTx.iterator_to(descendant));
+            cache_line.push_back(descendant);
             // Update ancestor state for each descendant
-            mapTx.modify(mapTx.iterator_to(descendant), update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCost()));
+            mapTx.modify(descendant, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCost()));
             // Don't directly remove the transaction here -- doing so would
             // invalidate iterators in cachedDescendants. Mark it for removal
             // by inserting into descendants_to_remove.
-            if (descendant.GetCountWithAncestors() > ancestor_count_limit || descendant.GetSizeWithAncestors() > ancestor_size_limit) {
-                descendants_to_remove.insert(descendant.GetTx().GetHash());
+            if (descendant->GetCountWithAncestors() > ancestor_count_limit || descendant->GetSizeWithAncestors() > ancestor_size_limit) {
+                descendants_to_remove.insert(descendant->GetTx().GetHash());
             }
         }
     }
-    mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
+    if (modifyCount > 0) {
+        mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
+    }
 }
 
 void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashesToUpdate, uint64_t ancestor_size_limit, uint64_t ancestor_count_limit)
@@ -176,7 +191,7 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
 
     // Use a set for lookups into vHashesToUpdate (these entries are already
     // accounted for in the state of their ancestors)
-    std::set<uint256> setAlreadyIncluded(vHashesToUpdate.begin(), vHashesToUpdate.end());
+    const TxidSet setAlreadyIncluded(vHashesToUpdate.begin(), vHashesToUpdate.end(), vHashesToUpdate.size(), SaltedTxidHasher());
 
     std::set<uint256> descendants_to_remove;
 
@@ -191,10 +206,18 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
         if (it == mapTx.end()) {
             continue;
         }
-        auto iter = mapNextTx.lower_bound(COutPoint(hash, 0));
         // First calculate the children, and update CTxMemPool::m_children to
         // include them, and update their CTxMemPoolEntry::m_parents to include this tx.
         // we cache the in-mempool children to avoid duplicate updates
+        auto iter = mapNextTx.lower_bound(COutPoint(hash, 0));
+        if (iter == mapNextTx.end() || iter->first->hash != hash) {
+            // Nothing in the mempool spends this transaction, so its
+            // descendant state is already correct and there is nothing to
+            // update. Leave an empty cache line so that ancestors in
+            // vHashesToUpdate do not walk it again.
+            mapMemPoolDescendantsToUpdate.emplace(it, std::vector<txiter>{});
+            continue;
+        }
         {
             WITH_FRESH_EPOCH(m_epoch);
             for (; iter != mapNextTx.end() && iter->first->hash == hash; ++iter) {
@@ -233,12 +256,18 @@ bool CTxMemPool::CalculateAncestorsAndCheckLimits(size_t entry_size,
 {
     size_t totalSizeWithAncestors = entry_size;
 
-    while (!staged_ancestors.empty()) {
-        const CTxMemPoolEntry& stage = staged_ancestors.begin()->get();
-        txiter stageit = mapTx.iterator_to(stage);
+    // Ancestors are added to setAncestors as soon as they are discovered, so
+    // that each one is staged exactly once.
+    std::vector<txiter> stage;
+    stage.reserve(staged_ancestors.size());
+    for (const CTxMemPoolEntry& ancestor : staged_ancestors) {
+        txiter ancestor_it = mapTx.iterator_to(ancestor);
+        if (setAncestors.insert(ancestor_it).second) stage.push_back(ancestor_it);
+    }
 
-        setAncestors.insert(stageit);
-        staged_ancestors.erase(stage);
+    while (!stage.empty()) {
+        const txiter stageit = stage.back();
+        stage.pop_back();
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry_size > limitDescendantSize) {
@@ -257,10 +286,10 @@ bool CTxMemPool::CalculateAncestorsAndCheckLimits(size_t entry_size,
             txiter parent_it = mapTx.iterator_to(parent);
 
             // If this is a new ancestor, add it.
-            if (setAncestors.count(parent_it) == 0) {
-                staged_ancestors.insert(parent);
+            if (setAncestors.insert(parent_it).second) {
+                stage.push_back(parent_it);
             }
-            if (staged_ancestors.size() + setAncestors.size() + entry_count > limitAncestorCount) {
+            if (setAncestors.size() + entry_count > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
                 return false;
             }
@@ -462,8 +491,11 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator, int check_ratio)
-    : m_check_ratio(check_ratio), minerPolicyEstimator(estimator)
+    : m_check_ratio(check_ratio), minerPolicyEstimator(estimator),
+      mapTx{indexed_transaction_set::allocator_type{&m_pool_resource}},
+      mapNextTx{NextTxMap::allocator_type{&m_pool_resource}}
 {
+    m_pool_container_usage = WITH_LOCK(cs, return PoolMemoryUsage());
     _clear(); //lock free clear
 }
 
@@ -498,6 +530,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     if (delta) {
             mapTx.modify(newit, update_fee_delta(delta));
     }
+    UpdateFeeHistogram(*newit, true);
 
     // Update cachedInnerUsage to include contained transaction's usage.
     // (When we update the entry for in-mempool parents, memory usage will be
@@ -535,11 +568,27 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     newit->vTxHashesIdx = vTxHashes.size() - 1;
 }
 
+uint64_t CTxMemPool::GetAndIncrementSequence(MempoolDelta::Type type, const uint256& txid)
+{
+    AssertLockHeld(cs);
+    if (m_delta_log.size() == MEMPOOL_DELTA_LOG_SIZE) m_delta_log.pop_front();
+    m_delta_log.push_back({m_sequence_number, type, txid});
+    return m_sequence_number++;
+}
+
+std::optional<std::vector<MempoolDelta>> CTxMemPool::GetDeltasSince(uint64_t sequence) const
+{
+    AssertLockHeld(cs);
+    const uint64_t oldest{m_delta_log.empty() ? m_sequence_number : m_delta_log.front().sequence};
+    if (sequence < oldest || sequence > m_sequence_number) return std::nullopt;
+    return std::vector<MempoolDelta>(m_delta_log.begin() + (sequence - oldest), m_delta_log.end());
+}
+
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 {
     // We increment mempool sequence value no matter removal reason
     // even if not directly reported below.
-    uint64_t mempool_sequence = GetAndIncrementSequence();
+    uint64_t mempool_sequence = GetAndIncrementSequence(MempoolDelta::Type::REMOVED, it->GetTx().GetHash());
 
     if (reason != MemPoolRemovalReason::BLOCK) {
         // Notify clients that a transaction has been removed from the mempool
@@ -566,13 +615,37 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 
     totalTxSize -= it->GetTxSize();
     m_total_fee -= it->GetFee();
+    UpdateFeeHistogram(*it, false);
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
+    cachedInnerUsage -= it->GetMemPoolParentsConst().DynamicMemoryUsage() + it->GetMemPoolChildrenConst().DynamicMemoryUsage();
     mapTx.erase(it);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
 }
 
+size_t GetFeeHistogramBucket(CAmount fee, int64_t vsize)
+{
+    const CAmount rate{CFeeRate(fee, vsize).GetFeePerK()};
+    const auto it{std::upper_bound(MEMPOOL_FEE_HISTOGRAM_BOUNDS.begin(), MEMPOOL_FEE_HISTOGRAM_BOUNDS.end(), rate,
+                                   [](CAmount fee_rate, CAmount bound) { return fee_rate < bound * 1000; })};
+    return it == MEMPOOL_FEE_HISTOGRAM_BOUNDS.begin() ? 0 : it - MEMPOOL_FEE_HISTOGRAM_BOUNDS.begin() - 1;
+}
+
+void CTxMemPool::UpdateFeeHistogram(const CTxMemPoolEntry& entry, bool add)
+{
+    AssertLockHeld(cs);
+    FeeHistogramBucket& bucket{m_fee_histogram[GetFeeHistogramBucket(entry.GetModifiedFee(), entry.GetTxSize())]};
+    if (add) {
+        ++bucket.count;
+        bucket.vsize += entry.GetTxSize();
+        bucket.fees += entry.GetModifiedFee();
+    } else {
+        --bucket.count;
+        bucket.vsize -= entry.GetTxSize();
+        bucket.fees -= entry.GetModifiedFee();
+    }
+}
+
 // Calculates descendants of entry that are not already in setDescendants, and adds to
 // setDescendants. Assumes entryit is already a tx in the mempool and CTxMemPoolEntry::m_children
 // is correct for tx and all descendants.
@@ -581,23 +654,23 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries& setDescendants) const
 {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+    std::vector<txiter> stage;
+    if (setDescendants.insert(entryit).second) {
+        stage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
-    // already been walked, or will be walked in this iteration).
+    // already been walked, or will be walked in this iteration). Entries are
+    // added to setDescendants when staged, so each one is walked only once.
     while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(it);
+        const txiter it = stage.back();
+        stage.pop_back();
 
         const CTxMemPoolEntry::Children& children = it->GetMemPoolChildrenConst();
         for (const CTxMemPoolEntry& child : children) {
             txiter childiter = mapTx.iterator_to(child);
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+            if (setDescendants.insert(childiter).second) {
+                stage.push_back(childiter);
             }
         }
     }
@@ -687,10 +760,14 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
     if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    const uint64_t mempool_sequence{GetSequence()};
+    std::vector<CTransactionRef> txs_removed_for_block;
+    txs_removed_for_block.reserve(entries.size());
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
         if (it != mapTx.end()) {
+            txs_removed_for_block.push_back(it->GetSharedTx());
             setEntries stage;
             stage.insert(it);
             RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
@@ -698,6 +775,9 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
         removeConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
     }
+    if (!txs_removed_for_block.empty()) {
+        GetMainSignals().MempoolTransactionsRemovedForBlock(txs_removed_for_block, mempool_sequence);
+    }
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = true;
 }
@@ -708,6 +788,10 @@ void CTxMemPool::_clear()
     mapNextTx.clear();
     totalTxSize = 0;
     m_total_fee = 0;
+    m_fee_histogram = {};
+    // Transactions removed here are not assigned sequence numbers, so the
+    // delta log can no longer bring an earlier view of the mempool up to date.
+    m_delta_log.clear();
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
@@ -734,6 +818,7 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
     uint64_t checkTotal = 0;
     CAmount check_total_fee{0};
     uint64_t innerUsage = 0;
+    FeeHistogram check_fee_histogram{};
     uint64_t prev_ancestor_count{0};
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(&active_coins_tip));
@@ -741,10 +826,14 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
     for (const auto& it : GetSortedDepthAndScore()) {
         checkTotal += it->GetTxSize();
         check_total_fee += it->GetFee();
+        FeeHistogramBucket& bucket{check_fee_histogram[GetFeeHistogramBucket(it->GetModifiedFee(), it->GetTxSize())]};
+        ++bucket.count;
+        bucket.vsize += it->GetTxSize();
+        bucket.fees += it->GetModifiedFee();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction& tx = it->GetTx();
-        innerUsage += memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
-        CTxMemPoolEntry::Parents setParentCheck;
+        innerUsage += it->GetMemPoolParentsConst().DynamicMemoryUsage() + it->GetMemPoolChildrenConst().DynamicMemoryUsage();
+        std::set<CTxMemPoolEntry::CTxMemPoolEntryRef, CompareIteratorByHash> setParentCheck;
         for (const CTxIn &txin : tx.vin) {
             // Check that every mempool transaction's inputs refer to available coins, or other mempool tx's.
             indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
@@ -763,11 +852,13 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
             assert(it3->first == &txin.prevout);
             assert(it3->second == &tx);
         }
-        auto comp = [](const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) -> bool {
-            return a.GetTx().GetHash() == b.GetTx().GetHash();
+        // Parents and children are unordered and free of duplicates, so
+        // checking size and membership is enough.
+        auto in_check_set = [](const std::set<CTxMemPoolEntry::CTxMemPoolEntryRef, CompareIteratorByHash>& check_set) {
+            return [&check_set](const CTxMemPoolEntry& e) { return check_set.count(e) != 0; };
         };
         assert(setParentCheck.size() == it->GetMemPoolParentsConst().size());
-        assert(std::equal(setParentCheck.begin(), setParentCheck.end(), it->GetMemPoolParentsConst().begin(), comp));
+        assert(std::all_of(it->GetMemPoolParentsConst().begin(), it->GetMemPoolParentsConst().end(), in_check_set(setParentCheck)));
         // Verify ancestor state is correct.
         setEntries setAncestors;
         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -793,7 +884,7 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
         prev_ancestor_count = it->GetCountWithAncestors();
 
         // Check children against mapNextTx
-        CTxMemPoolEntry::Children setChildrenCheck;
+        std::set<CTxMemPoolEntry::CTxMemPoolEntryRef, CompareIteratorByHash> setChildrenCheck;
         auto iter = mapNextTx.lower_bound(COutPoint(it->GetTx().GetHash(), 0));
         uint64_t child_sizes = 0;
         for (; iter != mapNextTx.end() && iter->first->hash == it->GetTx().GetHash(); ++iter) {
@@ -804,7 +895,7 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
             }
         }
         assert(setChildrenCheck.size() == it->GetMemPoolChildrenConst().size());
-        assert(std::equal(setChildrenCheck.begin(), setChildrenCheck.end(), it->GetMemPoolChildrenConst().begin(), comp));
+        assert(std::all_of(it->GetMemPoolChildrenConst().begin(), it->GetMemPoolChildrenConst().end(), in_check_set(setChildrenCheck)));
         // Also check to make sure size is greater than sum with immediate children.
         // just a sanity check, not definitive that this calc is correct...
         assert(it->GetSizeWithDescendants() >= child_sizes + it->GetTxSize());
@@ -826,6 +917,11 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
 
     assert(totalTxSize == checkTotal);
     assert(m_total_fee == check_total_fee);
+    for (size_t i = 0; i < m_fee_histogram.size(); ++i) {
+        assert(m_fee_histogram[i].count == check_fee_histogram[i].count);
+        assert(m_fee_histogram[i].vsize == check_fee_histogram[i].vsize);
+        assert(m_fee_histogram[i].fees == check_fee_histogram[i].fees);
+    }
     assert(innerUsage == cachedInnerUsage);
 }
 
@@ -931,7 +1027,9 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
         delta += nFeeDelta;
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
+            UpdateFeeHistogram(*it, false);
             mapTx.modify(it, update_fee_delta(delta));
+            UpdateFeeHistogram(*it, true);
             // Now update all ancestors' modified fees with descendants
             setEntries setAncestors;
             uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -1034,8 +1132,22 @@ void CCoinsViewMemPool::PackageAddTransaction(const CTransactionRef& tx)
 
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
-    // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    // What the empty containers take from m_pool_resource (the first chunk,
+    // mapTx's header node and the initial bucket arrays) is not counted, as
+    // before, and neither is what the empty delta log takes.
+    static const size_t empty_delta_log_usage{memusage::DynamicUsage(std::deque<MempoolDelta>{})};
+    return PoolMemoryUsage() - m_pool_container_usage + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + memusage::DynamicUsage(m_delta_log) - empty_delta_log_usage + cachedInnerUsage;
+}
+
+size_t CTxMemPool::PoolMemoryUsage() const
+{
+    AssertLockHeld(cs);
+    // Count all the chunks and bucket arrays held by the resource, except for
+    // the memory that adding transactions reuses before any new chunk is
+    // allocated. Leaving that out keeps the usage going down as transactions
+    // are evicted, which TrimToSize() relies on; counting the freed blocks
+    // would make it evict the whole mempool once a new chunk was needed.
+    return m_pool_resource.DynamicMemoryUsage() - m_pool_resource.ReusableBytes();
 }
 
 void CTxMemPool::RemoveUnbroadcastTx(const uint256& txid, const bool unchecked) {
@@ -1084,22 +1196,22 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, bool validFeeEstimat
 void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
 {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Children s;
-    if (add && entry->GetMemPoolChildren().insert(*child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && entry->GetMemPoolChildren().erase(*child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Children& children = entry->GetMemPoolChildren();
+    const size_t usage_before = children.DynamicMemoryUsage();
+    if (add ? children.insert(*child) : children.erase(*child)) {
+        cachedInnerUsage += children.DynamicMemoryUsage();
+        cachedInnerUsage -= usage_before;
     }
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
 {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Parents s;
-    if (add && entry->GetMemPoolParents().insert(*parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && entry->GetMemPoolParents().erase(*parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Parents& parents = entry->GetMemPoolParents();
+    const size_t usage_before = parents.DynamicMemoryUsage();
+    if (add ? parents.insert(*parent) : parents.erase(*parent)) {
+        cachedInnerUsage += parents.DynamicMemoryUsage();
+        cachedInnerUsage -= usage_before;
     }
 }
 
@@ -1140,9 +1252,13 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
-    while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
-
+    const auto& index = mapTx.get<descendant_score>();
+    auto it = index.begin();
+    std::vector<CTransactionRef> txn;
+    // The removals are logged for GetDeltasSince(), which grows the log until
+    // it is full. That growth must not cause more removals, so leave it out.
+    const size_t delta_log_usage{memusage::DynamicUsage(m_delta_log)};
+    while (!mapTx.empty() && DynamicMemoryUsage() - (memusage::DynamicUsage(m_delta_log) - delta_log_usage) > sizelimit) {
         // We set the new mempool min fee to the feerate of the removed set, plus the
         // "minimum reasonable fee rate" (ie some value under which we consider txn
         // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
@@ -1156,17 +1272,27 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
         CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
-        std::vector<CTransaction> txn;
-        if (pvNoSpendsRemaining) {
-            txn.reserve(stage.size());
-            for (txiter iter : stage)
-                txn.push_back(iter->GetTx());
+        // Removing a package none of whose transactions has a parent left in
+        // the mempool does not change the descendant score of any other
+        // entry, so the next package to evict is the next entry in the index
+        // that is not being removed. Otherwise the scores of the remaining
+        // ancestors drop and the sweep starts over.
+        bool has_remaining_parent = false;
+        txn.clear();
+        for (txiter iter : stage) {
+            for (const CTxMemPoolEntry& parent : iter->GetMemPoolParentsConst()) {
+                if (!stage.count(mapTx.iterator_to(parent))) has_remaining_parent = true;
+            }
+            if (pvNoSpendsRemaining) txn.push_back(iter->GetSharedTx());
         }
+        while (it != index.end() && stage.count(mapTx.project<0>(it))) ++it;
+
         RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
+        if (has_remaining_parent) it = index.begin();
         if (pvNoSpendsRemaining) {
-            for (const CTransaction& tx : txn) {
-                for (const CTxIn& txin : tx.vin) {
-                    if (exists(GenTxid::Txid(txin.prevout.hash))) continue;
+            for (const CTransactionRef& tx : txn) {
+                for (const CTxIn& txin : tx->vin) {
+                    if (mapTx.count(txin.prevout.hash)) continue;
                     pvNoSpendsRemaining->push_back(txin.prevout);
                 }
             }
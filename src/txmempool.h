@@ -6,21 +6,31 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <optional>
 #include <set>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <coins.h>
 #include <consensus/amount.h>
 #include <indirectmap.h>
+#include <memusage.h>
 #include <policy/feerate.h>
 #include <policy/packages.h>
+#include <prevector.h>
 #include <primitives/transaction.h>
 #include <random.h>
+#include <support/allocators/pool.h>
 #include <sync.h>
 #include <util/epochguard.h>
 #include <util/hasher.h>
@@ -70,6 +80,79 @@ struct CompareIteratorByHash {
     }
 };
 
+class CTxMemPoolEntry;
+
+/** The in-mempool parents or children of a CTxMemPoolEntry.
+ *
+ * Nearly all transactions have only a handful of direct in-mempool relatives,
+ * so they are kept in a prevector with inline capacity for N entries rather
+ * than a node-based std::set. Membership tests are linear scans comparing
+ * entry addresses, which is cheaper than a tree lookup at these sizes, and
+ * iterating does not chase pointers. Elements are unique but unordered.
+ */
+template <unsigned int N>
+class MemPoolEntryLinks
+{
+    typedef prevector<N, const CTxMemPoolEntry*> container_type;
+    container_type m_links;
+
+public:
+    typedef std::reference_wrapper<const CTxMemPoolEntry> value_type;
+
+    /** Iterates over the linked entries as const CTxMemPoolEntry&. */
+    class const_iterator
+    {
+        typename container_type::const_iterator m_it;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef MemPoolEntryLinks::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const CTxMemPoolEntry* pointer;
+        typedef const CTxMemPoolEntry& reference;
+
+        const_iterator() = default;
+        explicit const_iterator(typename container_type::const_iterator it) : m_it(it) {}
+        reference operator*() const { return **m_it; }
+        pointer operator->() const { return *m_it; }
+        const_iterator& operator++() { ++m_it; return *this; }
+        const_iterator operator++(int) { const_iterator copy(*this); ++m_it; return copy; }
+        bool operator==(const const_iterator& other) const { return m_it == other.m_it; }
+        bool operator!=(const const_iterator& other) const { return m_it != other.m_it; }
+    };
+    typedef const_iterator iterator;
+
+    const_iterator begin() const { return const_iterator(m_links.begin()); }
+    const_iterator end() const { return const_iterator(m_links.end()); }
+    size_t size() const { return m_links.size(); }
+    bool empty() const { return m_links.empty(); }
+
+    bool count(const CTxMemPoolEntry& entry) const
+    {
+        return std::find(m_links.begin(), m_links.end(), &entry) != m_links.end();
+    }
+
+    /** Add entry, returns false if it was already present. */
+    bool insert(const CTxMemPoolEntry& entry)
+    {
+        if (count(entry)) return false;
+        m_links.push_back(&entry);
+        return true;
+    }
+
+    /** Remove entry, returns false if it was not present. Does not preserve order. */
+    bool erase(const CTxMemPoolEntry& entry)
+    {
+        auto it = std::find(m_links.begin(), m_links.end(), &entry);
+        if (it == m_links.end()) return false;
+        *it = m_links.back();
+        m_links.pop_back();
+        return true;
+    }
+
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(m_links); }
+};
+
 /** \class CTxMemPoolEntry
  *
  * CTxMemPoolEntry stores data about the corresponding transaction, as well
@@ -87,8 +170,8 @@ class CTxMemPoolEntry
 public:
     typedef std::reference_wrapper<const CTxMemPoolEntry> CTxMemPoolEntryRef;
     // two aliases, should the types ever diverge
-    typedef std::set<CTxMemPoolEntryRef, CompareIteratorByHash> Parents;
-    typedef std::set<CTxMemPoolEntryRef, CompareIteratorByHash> Children;
+    typedef MemPoolEntryLinks<2> Parents;
+    typedef MemPoolEntryLinks<2> Children;
 
 private:
     const CTransactionRef tx;
@@ -312,6 +395,13 @@ public:
     }
 };
 
+/** Largest block served from the mempool's node pool. This fits a mapTx node
+ * (entry plus the links of all five indexes) and a mapNextTx node. */
+static constexpr size_t MEMPOOL_POOL_MAX_BLOCK_SIZE_BYTES{512};
+using MemPoolResource = PoolResource<MEMPOOL_POOL_MAX_BLOCK_SIZE_BYTES, alignof(void*)>;
+template <typename T>
+using MemPoolAllocator = PoolAllocator<T, MEMPOOL_POOL_MAX_BLOCK_SIZE_BYTES, alignof(void*)>;
+
 // Multi_index tag names
 struct descendant_score {};
 struct entry_time {};
@@ -320,6 +410,50 @@ struct index_by_wtxid {};
 
 class CBlockPolicyEstimator;
 
+/**
+ * Lower bounds, in sat/vB, of the buckets of the mempool fee histogram. They
+ * grow roughly logarithmically; the first bucket also holds the transactions
+ * paying less than its bound.
+ */
+static constexpr std::array<CAmount, 39> MEMPOOL_FEE_HISTOGRAM_BOUNDS{
+    1, 2, 3, 4, 5, 6, 8, 10, 12, 15, 20, 25, 30, 40, 50, 60, 70, 80, 100, 120,
+    140, 170, 200, 250, 300, 400, 500, 600, 700, 800, 1000, 1200, 1400, 1700,
+    2000, 3000, 5000, 7000, 10000};
+
+/** The mempool transactions whose fee rate falls into a bucket of the fee histogram. */
+struct FeeHistogramBucket
+{
+    /** Number of transactions. */
+    uint64_t count{0};
+
+    /** Sum of their virtual sizes. */
+    int64_t vsize{0};
+
+    /** Sum of their modified fees. */
+    CAmount fees{0};
+};
+
+using FeeHistogram = std::array<FeeHistogramBucket, MEMPOOL_FEE_HISTOGRAM_BOUNDS.size()>;
+
+/** Index of the bucket of the mempool fee histogram a transaction with this fee and virtual size belongs to. */
+size_t GetFeeHistogramBucket(CAmount fee, int64_t vsize);
+
+/** Number of recent additions to and removals from the mempool kept in its delta log. */
+static constexpr size_t MEMPOOL_DELTA_LOG_SIZE{50000};
+
+/** A transaction added to or removed from the mempool, with the mempool sequence number assigned to the change. */
+struct MempoolDelta
+{
+    enum class Type : uint8_t {
+        ADDED = 0,
+        REMOVED = 1,
+    };
+
+    uint64_t sequence;
+    Type type;
+    uint256 txid;
+};
+
 /**
  * Information about a mempool transaction.
  */
@@ -435,6 +569,7 @@ protected:
 
     uint64_t totalTxSize GUARDED_BY(cs);      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     CAmount m_total_fee GUARDED_BY(cs);       //!< sum of all mempool tx's fees (NOT modified fee)
+    FeeHistogram m_fee_histogram GUARDED_BY(cs){}; //!< mempool tx's by individual modified fee rate
     uint64_t cachedInnerUsage GUARDED_BY(cs); //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
 
     mutable int64_t lastRollingFeeUpdate GUARDED_BY(cs);
@@ -447,6 +582,14 @@ protected:
     // is added or removed from the mempool for any reason.
     mutable uint64_t m_sequence_number GUARDED_BY(cs){1};
 
+    // Random identifier of the sequence numbers above, which start over
+    // with every mempool, e.g. after a restart. Never 0.
+    const uint64_t m_sequence_session{1 + GetRand(std::numeric_limits<uint64_t>::max() - 1)};
+
+    // The last MEMPOOL_DELTA_LOG_SIZE changes that were assigned a sequence
+    // number, without gaps, oldest first.
+    std::deque<MempoolDelta> m_delta_log GUARDED_BY(cs);
+
     void trackPackageRemoved(const CFeeRate& rate) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     bool m_is_loaded GUARDED_BY(cs){false};
@@ -484,7 +627,8 @@ public:
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByAncestorFee
             >
-        >
+        >,
+        MemPoolAllocator<CTxMemPoolEntry>
     > indexed_transaction_set;
 
     /**
@@ -515,6 +659,17 @@ public:
      * the mempool is consistent with the new chain tip and fully populated.
      */
     mutable RecursiveMutex cs;
+private:
+    /** Slab arena backing the nodes of mapTx and mapNextTx. Must be declared
+     * before (and hence outlive) the containers allocating from it. */
+    MemPoolResource m_pool_resource GUARDED_BY(cs);
+    /** PoolMemoryUsage() of the empty containers, which is not attributable
+     * to any entry and left out of DynamicMemoryUsage(). */
+    size_t m_pool_container_usage GUARDED_BY(cs){0};
+
+    /** Memory held by m_pool_resource that is not available to new entries */
+    size_t PoolMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+public:
     indexed_transaction_set mapTx GUARDED_BY(cs);
 
     using txiter = indexed_transaction_set::nth_index<0>::type::const_iterator;
@@ -524,7 +679,8 @@ public:
 
     uint64_t CalculateDescendantMaximum(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
+    typedef std::map<txiter, std::vector<txiter>, CompareIteratorByHash> cacheMap;
+    typedef std::unordered_set<uint256, SaltedTxidHasher> TxidSet;
 
 
     void UpdateParent(txiter entry, txiter parent, bool add) EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -557,7 +713,8 @@ private:
                                           std::string &errString) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 public:
-    indirectmap<COutPoint, const CTransaction*> mapNextTx GUARDED_BY(cs);
+    using NextTxMap = indirectmap<COutPoint, const CTransaction*, MemPoolAllocator<std::pair<const COutPoint* const, const CTransaction*>>>;
+    NextTxMap mapNextTx GUARDED_BY(cs);
     std::map<uint256, CAmount> mapDeltas GUARDED_BY(cs);
 
     /** Create a new CTxMemPool.
@@ -704,12 +861,15 @@ public:
     CFeeRate GetMinFee(size_t sizelimit) const;
 
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
+      *  Packages are evicted in descendant score order, in a single sweep of the
+      *  index unless evicting a package changes the score of its ancestors.
       *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
       */
     void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
-    /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
+    /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions.
+      *  Only the oldest entry is looked at when nothing expired. */
     int Expire(std::chrono::seconds time) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /**
@@ -744,6 +904,15 @@ public:
         return m_total_fee;
     }
 
+    /** The mempool transactions in each bucket of MEMPOOL_FEE_HISTOGRAM_BOUNDS,
+     *  by their individual modified fee rate. Kept up to date as transactions
+     *  are added, removed and prioritised, so this does not walk the mempool. */
+    FeeHistogram GetFeeHistogram() const EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        AssertLockHeld(cs);
+        return m_fee_histogram;
+    }
+
     bool exists(const GenTxid& gtxid) const
     {
         LOCK(cs);
@@ -790,15 +959,25 @@ public:
         return m_unbroadcast_txids.count(txid) != 0;
     }
 
-    /** Guards this internal counter for external reporting */
-    uint64_t GetAndIncrementSequence() const EXCLUSIVE_LOCKS_REQUIRED(cs) {
-        return m_sequence_number++;
-    }
+    /** Guards this internal counter for external reporting. Every change
+     *  assigned a sequence number is recorded in the delta log. */
+    uint64_t GetAndIncrementSequence(MempoolDelta::Type type, const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     uint64_t GetSequence() const EXCLUSIVE_LOCKS_REQUIRED(cs) {
         return m_sequence_number;
     }
 
+    /** Identifies the mempool that assigned a sequence number, so that
+     *  sequence numbers from before a restart are not taken for new ones. */
+    uint64_t GetSequenceSession() const {
+        return m_sequence_session;
+    }
+
+    /** The changes to the mempool from mempool sequence number `sequence` up
+     *  to GetSequence(), oldest first, or nothing if the delta log no longer
+     *  reaches back that far or the sequence number was not assigned yet. */
+    std::optional<std::vector<MempoolDelta>> GetDeltasSince(uint64_t sequence) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
 private:
     /** UpdateForDescendants is used by UpdateTransactionsFromBlock to update
      *  the descendants for a single transaction that has been added to the
@@ -807,19 +986,20 @@ private:
      *
      * @pre CTxMemPool::m_children is correct for the given tx and all
      *      descendants.
-     * @pre cachedDescendants is an accurate cache where each entry has all
-     *      descendants of the corresponding key, including those that should
-     *      be removed for violation of ancestor limits.
-     * @post if updateIt has any non-excluded descendants, cachedDescendants has
-     *       a new cache line for updateIt.
+     * @pre cachedDescendants has a line for every entry of setExclude that
+     *      is a descendant of updateIt, holding all of its non-excluded
+     *      descendants, including those that should be removed for violation
+     *      of ancestor limits. This holds when entries are updated in reverse
+     *      topological order.
+     * @post cachedDescendants has a new cache line for updateIt.
      * @post descendants_to_remove has a new entry for any descendant which exceeded
      *       ancestor limits relative to updateIt.
      *
      * @param[in] updateIt the entry to update for its descendants
      * @param[in,out] cachedDescendants a cache where each line corresponds to all
-     *     descendants. It will be updated with the descendants of the transaction
-     *     being updated, so that future invocations don't need to walk the same
-     *     transaction again, if encountered in another transaction chain.
+     *     non-excluded descendants. It will be updated with the descendants of the
+     *     transaction being updated, so that future invocations don't need to walk
+     *     the same transactions again, if encountered in another transaction chain.
      * @param[in] setExclude the set of descendant transactions in the mempool
      *     that must not be accounted for (because any descendants in setExclude
      *     were added to the mempool after the transaction being updated and hence
@@ -833,8 +1013,8 @@ private:
      *     allowed for any descendant
      */
     void UpdateForDescendants(txiter updateIt, cacheMap& cachedDescendants,
-                              const std::set<uint256>& setExclude, std::set<uint256>& descendants_to_remove,
-                              uint64_t ancestor_size_limit, uint64_t ancestor_count_limit) EXCLUSIVE_LOCKS_REQUIRED(cs);
+                              const TxidSet& setExclude, std::set<uint256>& descendants_to_remove,
+                              uint64_t ancestor_size_limit, uint64_t ancestor_count_limit) EXCLUSIVE_LOCKS_REQUIRED(cs) LOCKS_EXCLUDED(m_epoch);
     /** Update ancestors of hash to add/remove it as a descendant transaction. */
     void UpdateAncestorsOf(bool add, txiter hash, setEntries &setAncestors) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Set ancestor state for an entry */
@@ -845,6 +1025,8 @@ private:
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Add an entry to (add = true) or remove it from the fee histogram, at its current modified fee. */
+    void UpdateFeeHistogram(const CTxMemPoolEntry& entry, bool add) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /** Before calling removeUnchecked for a given transaction,
      *  UpdateForRemoveFromMempool must be called on the entire (dependent) set
@@ -8,6 +8,7 @@
 #include <logging.h>
 #include <policy/policy.h>
 
+#include <algorithm>
 #include <cassert>
 
 /** Expiration time for orphan transactions in seconds */
@@ -19,10 +20,10 @@ RecursiveMutex g_cs_orphans;
 
 bool TxOrphanage::AddTx(const CTransactionRef& tx, NodeId peer)
 {
-    AssertLockHeld(g_cs_orphans);
+    LOCK(m_mutex);
 
     const uint256& hash = tx->GetHash();
-    if (m_orphans.count(hash))
+    if (HaveTx(GenTxid::Txid(hash)))
         return false;
 
     // Ignore big transactions, to avoid a
@@ -39,100 +40,137 @@ bool TxOrphanage::AddTx(const CTransactionRef& tx, NodeId peer)
         return false;
     }
 
-    auto ret = m_orphans.emplace(hash, OrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, m_orphan_list.size()});
-    assert(ret.second);
-    m_orphan_list.push_back(ret.first);
-    // Allow for lookups in the orphan pool by wtxid, as well as txid
-    m_wtxid_to_orphan_it.emplace(tx->GetWitnessHash(), ret.first);
+    {
+        Shard& shard = GetShard(hash);
+        LOCK(shard.m_mutex);
+        auto ret = shard.m_orphans.emplace(hash, OrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, m_orphan_list.size()});
+        assert(ret.second);
+        m_orphan_list.push_back(hash);
+    }
+    {
+        // Allow for lookups in the orphan pool by wtxid, as well as txid
+        Shard& shard = GetShard(tx->GetWitnessHash());
+        LOCK(shard.m_mutex);
+        shard.m_wtxid_to_txid.emplace(tx->GetWitnessHash(), hash);
+    }
     for (const CTxIn& txin : tx->vin) {
-        m_outpoint_to_orphan_it[txin.prevout].insert(ret.first);
+        Shard& shard = GetShard(txin.prevout.hash);
+        LOCK(shard.m_mutex);
+        std::vector<uint256>& children = shard.m_parent_to_children[txin.prevout.hash];
+        // A transaction spending several outputs of the same parent is only listed once
+        if (std::find(children.begin(), children.end(), hash) == children.end()) children.push_back(hash);
     }
 
-    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
-             m_orphans.size(), m_outpoint_to_orphan_it.size());
+    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u)\n", hash.ToString(), m_orphan_list.size());
     return true;
 }
 
 int TxOrphanage::EraseTx(const uint256& txid)
 {
-    AssertLockHeld(g_cs_orphans);
-    std::map<uint256, OrphanTx>::iterator it = m_orphans.find(txid);
-    if (it == m_orphans.end())
-        return 0;
-    for (const CTxIn& txin : it->second.tx->vin)
+    LOCK(m_mutex);
+    return _EraseTx(txid);
+}
+
+int TxOrphanage::_EraseTx(const uint256& txid)
+{
+    AssertLockHeld(m_mutex);
+
+    OrphanTx orphan;
     {
-        auto itPrev = m_outpoint_to_orphan_it.find(txin.prevout);
-        if (itPrev == m_outpoint_to_orphan_it.end())
+        Shard& shard = GetShard(txid);
+        LOCK(shard.m_mutex);
+        auto it = shard.m_orphans.find(txid);
+        if (it == shard.m_orphans.end())
+            return 0;
+        orphan = std::move(it->second);
+        shard.m_orphans.erase(it);
+    }
+    const CTransaction& tx = *orphan.tx;
+    for (const CTxIn& txin : tx.vin)
+    {
+        Shard& shard = GetShard(txin.prevout.hash);
+        LOCK(shard.m_mutex);
+        auto itPrev = shard.m_parent_to_children.find(txin.prevout.hash);
+        if (itPrev == shard.m_parent_to_children.end())
             continue;
-        itPrev->second.erase(it);
-        if (itPrev->second.empty())
-            m_outpoint_to_orphan_it.erase(itPrev);
+        std::vector<uint256>& children = itPrev->second;
+        children.erase(std::remove(children.begin(), children.end(), txid), children.end());
+        if (children.empty())
+            shard.m_parent_to_children.erase(itPrev);
     }
 
-    size_t old_pos = it->second.list_pos;
-    assert(m_orphan_list[old_pos] == it);
+    size_t old_pos = orphan.list_pos;
+    assert(m_orphan_list[old_pos] == txid);
     if (old_pos + 1 != m_orphan_list.size()) {
         // Unless we're deleting the last entry in m_orphan_list, move the last
         // entry to the position we're deleting.
-        auto it_last = m_orphan_list.back();
-        m_orphan_list[old_pos] = it_last;
-        it_last->second.list_pos = old_pos;
+        const uint256 txid_last = m_orphan_list.back();
+        m_orphan_list[old_pos] = txid_last;
+        Shard& shard = GetShard(txid_last);
+        LOCK(shard.m_mutex);
+        shard.m_orphans.at(txid_last).list_pos = old_pos;
     }
     m_orphan_list.pop_back();
-    m_wtxid_to_orphan_it.erase(it->second.tx->GetWitnessHash());
-
-    m_orphans.erase(it);
+    {
+        Shard& shard = GetShard(tx.GetWitnessHash());
+        LOCK(shard.m_mutex);
+        shard.m_wtxid_to_txid.erase(tx.GetWitnessHash());
+    }
     return 1;
 }
 
 void TxOrphanage::EraseForPeer(NodeId peer)
 {
-    AssertLockHeld(g_cs_orphans);
+    LOCK(m_mutex);
 
-    int nErased = 0;
-    std::map<uint256, OrphanTx>::iterator iter = m_orphans.begin();
-    while (iter != m_orphans.end())
-    {
-        std::map<uint256, OrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer)
-        {
-            nErased += EraseTx(maybeErase->second.tx->GetHash());
+    std::vector<uint256> vOrphanErase;
+    for (const Shard& shard : m_shards) {
+        LOCK(shard.m_mutex);
+        for (const auto& [txid, orphan] : shard.m_orphans) {
+            if (orphan.fromPeer == peer) vOrphanErase.push_back(txid);
         }
     }
+    int nErased = 0;
+    for (const uint256& txid : vOrphanErase) {
+        nErased += _EraseTx(txid);
+    }
     if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx from peer=%d\n", nErased, peer);
 }
 
 unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans)
 {
-    AssertLockHeld(g_cs_orphans);
+    LOCK(m_mutex);
 
     unsigned int nEvicted = 0;
-    static int64_t nNextSweep;
     int64_t nNow = GetTime();
-    if (nNextSweep <= nNow) {
+    if (m_next_sweep <= nNow) {
         // Sweep out expired orphan pool entries:
-        int nErased = 0;
         int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        std::map<uint256, OrphanTx>::iterator iter = m_orphans.begin();
-        while (iter != m_orphans.end())
-        {
-            std::map<uint256, OrphanTx>::iterator maybeErase = iter++;
-            if (maybeErase->second.nTimeExpire <= nNow) {
-                nErased += EraseTx(maybeErase->second.tx->GetHash());
-            } else {
-                nMinExpTime = std::min(maybeErase->second.nTimeExpire, nMinExpTime);
+        std::vector<uint256> vOrphanErase;
+        for (const Shard& shard : m_shards) {
+            LOCK(shard.m_mutex);
+            for (const auto& [txid, orphan] : shard.m_orphans) {
+                if (orphan.nTimeExpire <= nNow) {
+                    vOrphanErase.push_back(txid);
+                } else {
+                    nMinExpTime = std::min(orphan.nTimeExpire, nMinExpTime);
+                }
             }
         }
+        int nErased = 0;
+        for (const uint256& txid : vOrphanErase) {
+            nErased += _EraseTx(txid);
+        }
         // Sweep again 5 minutes after the next entry that expires in order to batch the linear scan.
-        nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
+        m_next_sweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
         if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n", nErased);
     }
     FastRandomContext rng;
-    while (m_orphans.size() > max_orphans)
+    while (m_orphan_list.size() > max_orphans)
     {
         // Evict a random orphan:
         size_t randompos = rng.randrange(m_orphan_list.size());
-        EraseTx(m_orphan_list[randompos]->first);
+        _EraseTx(m_orphan_list[randompos]);
         ++nEvicted;
     }
     return nEvicted;
@@ -140,53 +178,65 @@ unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans)
 
 void TxOrphanage::AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const
 {
-    AssertLockHeld(g_cs_orphans);
-    for (unsigned int i = 0; i < tx.vout.size(); i++) {
-        const auto it_by_prev = m_outpoint_to_orphan_it.find(COutPoint(tx.GetHash(), i));
-        if (it_by_prev != m_outpoint_to_orphan_it.end()) {
-            for (const auto& elem : it_by_prev->second) {
-                orphan_work_set.insert(elem->first);
-            }
-        }
+    const Shard& shard = GetShard(tx.GetHash());
+    LOCK(shard.m_mutex);
+    const auto it_by_parent = shard.m_parent_to_children.find(tx.GetHash());
+    if (it_by_parent != shard.m_parent_to_children.end()) {
+        orphan_work_set.insert(it_by_parent->second.begin(), it_by_parent->second.end());
     }
 }
 
 bool TxOrphanage::HaveTx(const GenTxid& gtxid) const
 {
-    LOCK(g_cs_orphans);
+    const Shard& shard = GetShard(gtxid.GetHash());
+    LOCK(shard.m_mutex);
     if (gtxid.IsWtxid()) {
-        return m_wtxid_to_orphan_it.count(gtxid.GetHash());
+        return shard.m_wtxid_to_txid.count(gtxid.GetHash());
     } else {
-        return m_orphans.count(gtxid.GetHash());
+        return shard.m_orphans.count(gtxid.GetHash());
     }
 }
 
 std::pair<CTransactionRef, NodeId> TxOrphanage::GetTx(const uint256& txid) const
 {
-    AssertLockHeld(g_cs_orphans);
-
-    const auto it = m_orphans.find(txid);
-    if (it == m_orphans.end()) return {nullptr, -1};
+    const Shard& shard = GetShard(txid);
+    LOCK(shard.m_mutex);
+    const auto it = shard.m_orphans.find(txid);
+    if (it == shard.m_orphans.end()) return {nullptr, -1};
     return {it->second.tx, it->second.fromPeer};
 }
 
 void TxOrphanage::EraseForBlock(const CBlock& block)
 {
-    LOCK(g_cs_orphans);
-
-    std::vector<uint256> vOrphanErase;
+    LOCK(m_mutex);
 
+    // The outputs the block spends, and the orphans spending any output of
+    // the same parents, looking up each parent once.
+    std::set<COutPoint> spent;
+    std::set<uint256> parents;
+    std::set<uint256> candidates;
     for (const CTransactionRef& ptx : block.vtx) {
-        const CTransaction& tx = *ptx;
-
-        // Which orphan pool entries must we evict?
-        for (const auto& txin : tx.vin) {
-            auto itByPrev = m_outpoint_to_orphan_it.find(txin.prevout);
-            if (itByPrev == m_outpoint_to_orphan_it.end()) continue;
-            for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
-                const CTransaction& orphanTx = *(*mi)->second.tx;
-                const uint256& orphanHash = orphanTx.GetHash();
+        for (const auto& txin : ptx->vin) {
+            spent.insert(txin.prevout);
+            if (!parents.insert(txin.prevout.hash).second) continue;
+            const Shard& shard = GetShard(txin.prevout.hash);
+            LOCK(shard.m_mutex);
+            auto itByParent = shard.m_parent_to_children.find(txin.prevout.hash);
+            if (itByParent == shard.m_parent_to_children.end()) continue;
+            candidates.insert(itByParent->second.begin(), itByParent->second.end());
+        }
+    }
+
+    // Which orphan pool entries must we evict? Only the orphans spending one
+    // of these very outputs conflict with the block.
+    std::vector<uint256> vOrphanErase;
+    for (const uint256& orphanHash : candidates) {
+        const CTransactionRef orphanTx = GetTx(orphanHash).first;
+        if (!orphanTx) continue;
+        for (const CTxIn& orphan_txin : orphanTx->vin) {
+            if (spent.count(orphan_txin.prevout)) {
                 vOrphanErase.push_back(orphanHash);
+                break;
             }
         }
     }
@@ -195,7 +245,7 @@ void TxOrphanage::EraseForBlock(const CBlock& block)
     if (vOrphanErase.size()) {
         int nErased = 0;
         for (const uint256& orphanHash : vOrphanErase) {
-            nErased += EraseTx(orphanHash);
+            nErased += _EraseTx(orphanHash);
         }
         LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx included or conflicted by block\n", nErased);
     }
@@ -9,49 +9,59 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <sync.h>
+#include <util/hasher.h>
 
-/** Guards orphan transactions and extra txs for compact blocks */
+#include <array>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/** Guards the orphan work sets of peers and extra txs for compact blocks */
 extern RecursiveMutex g_cs_orphans;
 
 /** A class to track orphan transactions (failed on TX_MISSING_INPUTS)
  * Since we cannot distinguish orphans from bad transactions with
  * non-existent inputs, we heavily limit the number of orphans
  * we keep and the duration we keep them for.
+ *
+ * The orphans and their indexes are spread over shards, each with its own
+ * lock, so that looking up different transactions does not contend. Changes
+ * are serialized by m_mutex, and lock one shard at a time.
  */
 class TxOrphanage {
 public:
     /** Add a new orphan transaction */
-    bool AddTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    bool AddTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Check if we already have an orphan transaction (by txid or wtxid) */
-    bool HaveTx(const GenTxid& gtxid) const LOCKS_EXCLUDED(::g_cs_orphans);
+    bool HaveTx(const GenTxid& gtxid) const;
 
     /** Get an orphan transaction and its originating peer
      * (Transaction ref will be nullptr if not found)
      */
-    std::pair<CTransactionRef, NodeId> GetTx(const uint256& txid) const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    std::pair<CTransactionRef, NodeId> GetTx(const uint256& txid) const;
 
     /** Erase an orphan by txid */
-    int EraseTx(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    int EraseTx(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Erase all orphans announced by a peer (eg, after that peer disconnects) */
-    void EraseForPeer(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    void EraseForPeer(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Erase all orphans included in or invalidated by a new block */
-    void EraseForBlock(const CBlock& block) LOCKS_EXCLUDED(::g_cs_orphans);
+    void EraseForBlock(const CBlock& block) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Limit the orphanage to the given maximum */
-    unsigned int LimitOrphans(unsigned int max_orphans) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    unsigned int LimitOrphans(unsigned int max_orphans) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
     /** Add any orphans that list a particular tx as a parent into a peer's work set
      * (ie orphans that may have found their final missing parent, and so should be reconsidered for the mempool) */
-    void AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    void AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const;
 
     /** Return how many entries exist in the orphange */
-    size_t Size() LOCKS_EXCLUDED(::g_cs_orphans)
+    size_t Size() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
     {
-        LOCK(::g_cs_orphans);
-        return m_orphans.size();
+        LOCK(m_mutex);
+        return m_orphan_list.size();
     }
 
 protected:
@@ -62,31 +72,43 @@ protected:
         size_t list_pos;
     };
 
-    /** Map from txid to orphan transaction record. Limited by
-     *  -maxorphantx/DEFAULT_MAX_ORPHAN_TRANSACTIONS */
-    std::map<uint256, OrphanTx> m_orphans GUARDED_BY(g_cs_orphans);
+    static constexpr size_t NUM_SHARDS{16};
 
-    using OrphanMap = decltype(m_orphans);
+    struct Shard {
+        mutable Mutex m_mutex;
 
-    struct IteratorComparator
-    {
-        template<typename I>
-        bool operator()(const I& a, const I& b) const
-        {
-            return &(*a) < &(*b);
-        }
+        /** Map from txid to orphan transaction record, for the txids in
+         *  this shard. Limited by -maxorphantx/DEFAULT_MAX_ORPHAN_TRANSACTIONS */
+        std::unordered_map<uint256, OrphanTx, SaltedTxidHasher> m_orphans GUARDED_BY(m_mutex);
+
+        /** Map from the wtxids in this shard to the txid of the orphan
+         *  transaction with that witness id. */
+        std::unordered_map<uint256, uint256, SaltedTxidHasher> m_wtxid_to_txid GUARDED_BY(m_mutex);
+
+        /** Map from the txids in this shard to the txids of the orphan
+         *  transactions that spend one of its outputs. */
+        std::unordered_map<uint256, std::vector<uint256>, SaltedTxidHasher> m_parent_to_children GUARDED_BY(m_mutex);
     };
 
-    /** Index from the parents' COutPoint into the m_orphans. Used
-     *  to remove orphan transactions from the m_orphans */
-    std::map<COutPoint, std::set<OrphanMap::iterator, IteratorComparator>> m_outpoint_to_orphan_it GUARDED_BY(g_cs_orphans);
+    /** Serializes changes to the orphanage. Acquired before any shard's m_mutex. */
+    mutable Mutex m_mutex;
+
+    std::array<Shard, NUM_SHARDS> m_shards;
 
-    /** Orphan transactions in vector for quick random eviction */
-    std::vector<OrphanMap::iterator> m_orphan_list GUARDED_BY(g_cs_orphans);
+    /** Picks the shard for a txid or wtxid. */
+    const SaltedTxidHasher m_shard_hasher;
 
-    /** Index from wtxid into the m_orphans to lookup orphan
-     *  transactions using their witness ids. */
-    std::map<uint256, OrphanMap::iterator> m_wtxid_to_orphan_it GUARDED_BY(g_cs_orphans);
+    Shard& GetShard(const uint256& hash) { return m_shards[m_shard_hasher(hash) % NUM_SHARDS]; }
+    const Shard& GetShard(const uint256& hash) const { return m_shards[m_shard_hasher(hash) % NUM_SHARDS]; }
+
+    /** Txids of the orphan transactions in vector for quick random eviction */
+    std::vector<uint256> m_orphan_list GUARDED_BY(m_mutex);
+
+    /** When to next sweep out expired orphans */
+    int64_t m_next_sweep GUARDED_BY(m_mutex){0};
+
+    /** Erase an orphan by txid */
+    int _EraseTx(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
 };
 
 #endif // BITCOIN_TXORPHANAGE_H
@@ -9,13 +9,17 @@
 #include <primitives/transaction.h>
 #include <random.h>
 #include <uint256.h>
+#include <util/hasher.h>
 
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-
+#include <algorithm>
 #include <chrono>
+#include <limits>
+#include <map>
+#include <optional>
+#include <set>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <assert.h>
 
@@ -24,7 +28,6 @@ namespace {
 /** The various states a (txhash,peer) pair can be in.
  *
  * Note that CANDIDATE is split up into 3 substates (DELAYED, BEST, READY), allowing more efficient implementation.
- * Also note that the sorting order of ByTxHashView relies on the specific order of values in this enum.
  *
  * Expected behaviour is:
  *   - When first announced by a peer, the state is CANDIDATE_DELAYED until reqtime is reached.
@@ -53,60 +56,58 @@ enum class State : uint8_t {
 //! Type alias for sequence numbers.
 using SequenceNumber = uint64_t;
 
+//! Type alias for priorities.
+using Priority = uint64_t;
+
+//! Type alias for positions in the vector that holds all announcements.
+using AnnouncementSlot = uint32_t;
+
+//! Marks the absence of an announcement, like the end of a per-peer list.
+constexpr AnnouncementSlot NO_ANNOUNCEMENT{std::numeric_limits<AnnouncementSlot>::max()};
+
 /** An announcement. This is the data we track for each txid or wtxid that is announced to us by each peer. */
 struct Announcement {
     /** Txid or wtxid that was announced. */
-    const uint256 m_txhash;
+    uint256 m_txhash;
     /** For CANDIDATE_{DELAYED,BEST,READY} the reqtime; for REQUESTED the expiry. */
     std::chrono::microseconds m_time;
     /** What peer the request was from. */
-    const NodeId m_peer;
+    NodeId m_peer;
     /** What sequence number this announcement has. */
-    const SequenceNumber m_sequence : 59;
+    SequenceNumber m_sequence;
+    /** The priority of this announcement, computed when it was created. */
+    Priority m_priority;
+    /** The neighbours of this announcement in the list of its peer's announcements it is on. */
+    AnnouncementSlot m_peer_prev{NO_ANNOUNCEMENT};
+    AnnouncementSlot m_peer_next{NO_ANNOUNCEMENT};
+    /** Changes whenever the entry for this announcement in the time heaps goes stale. */
+    uint32_t m_generation{0};
     /** Whether the request is preferred. */
-    const bool m_preferred : 1;
+    bool m_preferred;
     /** Whether this is a wtxid request. */
-    const bool m_is_wtxid : 1;
-
-    /** What state this announcement is in.
-     *  This is a uint8_t instead of a State to silence a GCC warning in versions prior to 8.4 and 9.3.
-     *  See https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61414 */
-    uint8_t m_state : 3;
-
-    /** Convert m_state to a State enum. */
-    State GetState() const { return static_cast<State>(m_state); }
-
-    /** Convert a State enum to a uint8_t and store it in m_state. */
-    void SetState(State state) { m_state = static_cast<uint8_t>(state); }
+    bool m_is_wtxid;
+    /** What state this announcement is in. */
+    State m_state{State::CANDIDATE_DELAYED};
 
     /** Whether this announcement is selected. There can be at most 1 selected peer per txhash. */
     bool IsSelected() const
     {
-        return GetState() == State::CANDIDATE_BEST || GetState() == State::REQUESTED;
+        return m_state == State::CANDIDATE_BEST || m_state == State::REQUESTED;
     }
 
     /** Whether this announcement is waiting for a certain time to pass. */
     bool IsWaiting() const
     {
-        return GetState() == State::REQUESTED || GetState() == State::CANDIDATE_DELAYED;
+        return m_state == State::REQUESTED || m_state == State::CANDIDATE_DELAYED;
     }
 
     /** Whether this announcement can feasibly be selected if the current IsSelected() one disappears. */
     bool IsSelectable() const
     {
-        return GetState() == State::CANDIDATE_READY || GetState() == State::CANDIDATE_BEST;
+        return m_state == State::CANDIDATE_READY || m_state == State::CANDIDATE_BEST;
     }
-
-    /** Construct a new announcement from scratch, initially in CANDIDATE_DELAYED state. */
-    Announcement(const GenTxid& gtxid, NodeId peer, bool preferred, std::chrono::microseconds reqtime,
-        SequenceNumber sequence) :
-        m_txhash(gtxid.GetHash()), m_time(reqtime), m_peer(peer), m_sequence(sequence), m_preferred(preferred),
-        m_is_wtxid(gtxid.IsWtxid()), m_state(static_cast<uint8_t>(State::CANDIDATE_DELAYED)) {}
 };
 
-//! Type alias for priorities.
-using Priority = uint64_t;
-
 /** A functor with embedded salt that computes priority of an announcement.
  *
  * Higher priorities are selected first.
@@ -130,53 +131,52 @@ public:
     }
 };
 
-// Definitions for the 3 indexes used in the main data structure.
+// The main data structure keeps all announcements in one vector, and indexes them in three ways:
 //
-// Each index has a By* type to identify it, a By*View data type to represent the view of announcement it is sorted
-// by, and an By*ViewExtractor type to convert an announcement into the By*View type.
-// See https://www.boost.org/doc/libs/1_58_0/libs/multi_index/doc/reference/key_extraction.html#key_extractors
-// for more information about the key extraction concept.
-
-// The ByPeer index is sorted by (peer, state == CANDIDATE_BEST, txhash)
+// * By txhash: a hash table maps every txhash to the (few) announcements for it, whose slots are stored together.
+//   Uses:
+//   - Looking up existing announcements by peer/txhash, by binary search among the announcements for the txhash.
+//   - Deleting all announcements with a given txhash in ForgetTxHash.
+//   - Finding the CANDIDATE_BEST or REQUESTED announcement for a txhash, and the best CANDIDATE_READY to convert to
+//     CANDIDATE_BEST when that one goes away.
+//   - Determining when no more non-COMPLETED announcements for a given txhash exist, so the COMPLETED ones can be
+//     deleted.
 //
-// Uses:
-// * Looking up existing announcements by peer/txhash, by checking both (peer, false, txhash) and
-//   (peer, true, txhash).
-// * Finding all CANDIDATE_BEST announcements for a given peer in GetRequestable.
-struct ByPeer {};
-using ByPeerView = std::tuple<NodeId, bool, const uint256&>;
-struct ByPeerViewExtractor
-{
-    using result_type = ByPeerView;
-    result_type operator()(const Announcement& ann) const
+// * By peer: every peer has two intrusive doubly-linked lists through its announcements, one for CANDIDATE_BEST
+//   ones and one for all others.
+//   Uses:
+//   - Finding all CANDIDATE_BEST announcements for a given peer in GetRequestable.
+//   - Finding all announcements for a given peer in DisconnectedPeer.
+//
+// * By time: see TimeHeap.
+
+/** The announcements for one txhash. */
+struct TxHashGroup {
+    struct Entry {
+        NodeId m_peer;
+        AnnouncementSlot m_slot;
+    };
+    //! The peer and slot of every announcement for this txhash, sorted by peer.
+    std::vector<Entry> m_entries;
+    //! The IsSelected() announcement for this txhash, if any.
+    AnnouncementSlot m_selected{NO_ANNOUNCEMENT};
+    //! Number of non-COMPLETED announcements for this txhash.
+    size_t m_num_non_completed{0};
+
+    std::vector<Entry>::iterator LowerBound(NodeId peer)
     {
-        return ByPeerView{ann.m_peer, ann.GetState() == State::CANDIDATE_BEST, ann.m_txhash};
+        return std::lower_bound(m_entries.begin(), m_entries.end(), peer,
+                                [](const Entry& entry, NodeId peer) { return entry.m_peer < peer; });
     }
-};
 
-// The ByTxHash index is sorted by (txhash, state, priority).
-//
-// Note: priority == 0 whenever state != CANDIDATE_READY.
-//
-// Uses:
-// * Deleting all announcements with a given txhash in ForgetTxHash.
-// * Finding the best CANDIDATE_READY to convert to CANDIDATE_BEST, when no other CANDIDATE_READY or REQUESTED
-//   announcement exists for that txhash.
-// * Determining when no more non-COMPLETED announcements for a given txhash exist, so the COMPLETED ones can be
-//   deleted.
-struct ByTxHash {};
-using ByTxHashView = std::tuple<const uint256&, State, Priority>;
-class ByTxHashViewExtractor {
-    const PriorityComputer& m_computer;
-public:
-    explicit ByTxHashViewExtractor(const PriorityComputer& computer) : m_computer(computer) {}
-    using result_type = ByTxHashView;
-    result_type operator()(const Announcement& ann) const
+    //! Find the announcement for a peer, or NO_ANNOUNCEMENT.
+    AnnouncementSlot Find(NodeId peer)
     {
-        const Priority prio = (ann.GetState() == State::CANDIDATE_READY) ? m_computer(ann) : 0;
-        return ByTxHashView{ann.m_txhash, ann.GetState(), prio};
+        const auto it = LowerBound(peer);
+        return it != m_entries.end() && it->m_peer == peer ? it->m_slot : NO_ANNOUNCEMENT;
     }
 };
+using TxHashIndex = std::unordered_map<uint256, TxHashGroup, SaltedTxidHasher>;
 
 enum class WaitState {
     //! Used for announcements that need efficient testing of "is their timestamp in the future?".
@@ -194,45 +194,82 @@ WaitState GetWaitState(const Announcement& ann)
     return WaitState::NO_EVENT;
 }
 
-// The ByTime index is sorted by (wait_state, time).
-//
-// All announcements with a timestamp in the future can be found by iterating the index forward from the beginning.
-// All announcements with a timestamp in the past can be found by iterating the index backwards from the end.
-//
-// Uses:
-// * Finding CANDIDATE_DELAYED announcements whose reqtime has passed, and REQUESTED announcements whose expiry has
-//   passed.
-// * Finding CANDIDATE_READY/BEST announcements whose reqtime is in the future (when the clock time went backwards).
-struct ByTime {};
-using ByTimeView = std::pair<WaitState, std::chrono::microseconds>;
-struct ByTimeViewExtractor
+/** The time of an announcement, as of a given generation of it. */
+struct TimeEntry {
+    std::chrono::microseconds m_time;
+    AnnouncementSlot m_slot;
+    uint32_t m_generation;
+};
+
+/** A binary heap of the times of announcements in one WaitState, with the one for which `Compare` holds against
+ *  all others on top.
+ *
+ * All announcements with a timestamp in the future are in a heap with the earliest first, and all announcements
+ * with a timestamp in the past in one with the latest first.
+ *
+ * Uses:
+ * * Finding CANDIDATE_DELAYED announcements whose reqtime has passed, and REQUESTED announcements whose expiry has
+ *   passed.
+ * * Finding CANDIDATE_READY/BEST announcements whose reqtime is in the future (when the clock time went backwards).
+ *
+ * Rather than being removed when an announcement changes, entries are made stale by changing its m_generation, and
+ * skipped when they come up. Whenever more than half of the entries could be stale, they are purged.
+ */
+template <typename Compare>
+class TimeHeap
 {
-    using result_type = ByTimeView;
-    result_type operator()(const Announcement& ann) const
+    std::vector<TimeEntry> m_entries;
+
+public:
+    void Push(const TimeEntry& entry)
+    {
+        m_entries.push_back(entry);
+        std::push_heap(m_entries.begin(), m_entries.end(), Compare{});
+    }
+
+    //! Drop stale entries from the top, and return the top one left (or nullptr if none).
+    template <typename IsCurrent>
+    const TimeEntry* Top(IsCurrent is_current)
     {
-        return ByTimeView{GetWaitState(ann), ann.m_time};
+        while (!m_entries.empty() && !is_current(m_entries.front())) Pop();
+        return m_entries.empty() ? nullptr : &m_entries.front();
     }
+
+    void Pop()
+    {
+        std::pop_heap(m_entries.begin(), m_entries.end(), Compare{});
+        m_entries.pop_back();
+    }
+
+    //! Drop all stale entries if there are more than `num_current` entries to spare.
+    template <typename IsCurrent>
+    void MaybePurge(size_t num_current, IsCurrent is_current)
+    {
+        if (m_entries.size() <= 2 * num_current + 64) return;
+        m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                       [&](const TimeEntry& entry) { return !is_current(entry); }),
+                        m_entries.end());
+        std::make_heap(m_entries.begin(), m_entries.end(), Compare{});
+    }
+
+    const std::vector<TimeEntry>& Entries() const { return m_entries; }
 };
 
-/** Data type for the main data structure (Announcement objects with ByPeer/ByTxHash/ByTime indexes). */
-using Index = boost::multi_index_container<
-    Announcement,
-    boost::multi_index::indexed_by<
-        boost::multi_index::ordered_unique<boost::multi_index::tag<ByPeer>, ByPeerViewExtractor>,
-        boost::multi_index::ordered_non_unique<boost::multi_index::tag<ByTxHash>, ByTxHashViewExtractor>,
-        boost::multi_index::ordered_non_unique<boost::multi_index::tag<ByTime>, ByTimeViewExtractor>
-    >
->;
-
-/** Helper type to simplify syntax of iterator types. */
-template<typename Tag>
-using Iter = typename Index::index<Tag>::type::iterator;
-
-/** Per-peer statistics object. */
+struct EarliestFirst {
+    bool operator()(const TimeEntry& a, const TimeEntry& b) const { return a.m_time > b.m_time; }
+};
+
+struct LatestFirst {
+    bool operator()(const TimeEntry& a, const TimeEntry& b) const { return a.m_time < b.m_time; }
+};
+
+/** Per-peer statistics object, and the heads of the peer's lists of announcements. */
 struct PeerInfo {
     size_t m_total = 0; //!< Total number of announcements for this peer.
     size_t m_completed = 0; //!< Number of COMPLETED announcements for this peer.
     size_t m_requested = 0; //!< Number of REQUESTED announcements for this peer.
+    AnnouncementSlot m_best_head = NO_ANNOUNCEMENT; //!< First CANDIDATE_BEST announcement for this peer.
+    AnnouncementSlot m_other_head = NO_ANNOUNCEMENT; //!< First other announcement for this peer.
 };
 
 /** Per-txhash statistics object. Only used for sanity checking. */
@@ -262,38 +299,44 @@ bool operator==(const PeerInfo& a, const PeerInfo& b)
 };
 
 /** (Re)compute the PeerInfo map from the index. Only used for sanity checking. */
-std::unordered_map<NodeId, PeerInfo> RecomputePeerInfo(const Index& index)
+std::unordered_map<NodeId, PeerInfo> RecomputePeerInfo(const TxHashIndex& index, const std::vector<Announcement>& announcements)
 {
     std::unordered_map<NodeId, PeerInfo> ret;
-    for (const Announcement& ann : index) {
-        PeerInfo& info = ret[ann.m_peer];
-        ++info.m_total;
-        info.m_requested += (ann.GetState() == State::REQUESTED);
-        info.m_completed += (ann.GetState() == State::COMPLETED);
+    for (const auto& [txhash, group] : index) {
+        for (const TxHashGroup::Entry& entry : group.m_entries) {
+            const Announcement& ann = announcements[entry.m_slot];
+            PeerInfo& info = ret[ann.m_peer];
+            ++info.m_total;
+            info.m_requested += (ann.m_state == State::REQUESTED);
+            info.m_completed += (ann.m_state == State::COMPLETED);
+        }
     }
     return ret;
 }
 
 /** Compute the TxHashInfo map. Only used for sanity checking. */
-std::map<uint256, TxHashInfo> ComputeTxHashInfo(const Index& index, const PriorityComputer& computer)
+std::map<uint256, TxHashInfo> ComputeTxHashInfo(const TxHashIndex& index, const std::vector<Announcement>& announcements)
 {
     std::map<uint256, TxHashInfo> ret;
-    for (const Announcement& ann : index) {
-        TxHashInfo& info = ret[ann.m_txhash];
-        // Classify how many announcements of each state we have for this txhash.
-        info.m_candidate_delayed += (ann.GetState() == State::CANDIDATE_DELAYED);
-        info.m_candidate_ready += (ann.GetState() == State::CANDIDATE_READY);
-        info.m_candidate_best += (ann.GetState() == State::CANDIDATE_BEST);
-        info.m_requested += (ann.GetState() == State::REQUESTED);
-        // And track the priority of the best CANDIDATE_READY/CANDIDATE_BEST announcements.
-        if (ann.GetState() == State::CANDIDATE_BEST) {
-            info.m_priority_candidate_best = computer(ann);
-        }
-        if (ann.GetState() == State::CANDIDATE_READY) {
-            info.m_priority_best_candidate_ready = std::max(info.m_priority_best_candidate_ready, computer(ann));
+    for (const auto& [txhash, group] : index) {
+        for (const TxHashGroup::Entry& entry : group.m_entries) {
+            const Announcement& ann = announcements[entry.m_slot];
+            TxHashInfo& info = ret[ann.m_txhash];
+            // Classify how many announcements of each state we have for this txhash.
+            info.m_candidate_delayed += (ann.m_state == State::CANDIDATE_DELAYED);
+            info.m_candidate_ready += (ann.m_state == State::CANDIDATE_READY);
+            info.m_candidate_best += (ann.m_state == State::CANDIDATE_BEST);
+            info.m_requested += (ann.m_state == State::REQUESTED);
+            // And track the priority of the best CANDIDATE_READY/CANDIDATE_BEST announcements.
+            if (ann.m_state == State::CANDIDATE_BEST) {
+                info.m_priority_candidate_best = ann.m_priority;
+            }
+            if (ann.m_state == State::CANDIDATE_READY) {
+                info.m_priority_best_candidate_ready = std::max(info.m_priority_best_candidate_ready, ann.m_priority);
+            }
+            // Also keep track of which peers this txhash has an announcement for (so we can detect duplicates).
+            info.m_peers.push_back(ann.m_peer);
         }
-        // Also keep track of which peers this txhash has an announcement for (so we can detect duplicates).
-        info.m_peers.push_back(ann.m_peer);
     }
     return ret;
 }
@@ -314,21 +357,34 @@ class TxRequestTracker::Impl {
     //! This tracker's priority computer.
     const PriorityComputer m_computer;
 
-    //! This tracker's main data structure. See SanityCheck() for the invariants that apply to it.
-    Index m_index;
+    //! All announcements, and the slots in it that are unused. See SanityCheck() for the invariants that apply to
+    //! the data structure.
+    std::vector<Announcement> m_announcements;
+    std::vector<AnnouncementSlot> m_free_slots;
+
+    //! The announcements for every txhash.
+    TxHashIndex m_txhash_index;
 
-    //! Map with this tracker's per-peer statistics.
+    //! Map with this tracker's per-peer statistics and lists.
     std::unordered_map<NodeId, PeerInfo> m_peerinfo;
 
+    //! The times of all IsWaiting() announcements, and how many there are.
+    TimeHeap<EarliestFirst> m_future_events;
+    size_t m_future_count{0};
+
+    //! The times of all IsSelectable() announcements, and how many there are.
+    TimeHeap<LatestFirst> m_past_events;
+    size_t m_past_count{0};
+
 public:
     void SanityCheck() const
     {
-        // Recompute m_peerdata from m_index. This verifies the data in it as it should just be caching statistics
-        // on m_index. It also verifies the invariant that no PeerInfo announcements with m_total==0 exist.
-        assert(m_peerinfo == RecomputePeerInfo(m_index));
+        // Recompute m_peerdata from m_txhash_index. This verifies the data in it as it should just be caching
+        // statistics on it. It also verifies the invariant that no PeerInfo announcements with m_total==0 exist.
+        assert(m_peerinfo == RecomputePeerInfo(m_txhash_index, m_announcements));
 
-        // Calculate per-txhash statistics from m_index, and validate invariants.
-        for (auto& item : ComputeTxHashInfo(m_index, m_computer)) {
+        // Calculate per-txhash statistics from m_txhash_index, and validate invariants.
+        for (auto& item : ComputeTxHashInfo(m_txhash_index, m_announcements)) {
             TxHashInfo& info = item.second;
 
             // Cannot have only COMPLETED peer (txhash should have been forgotten already)
@@ -353,134 +409,264 @@ public:
             std::sort(info.m_peers.begin(), info.m_peers.end());
             assert(std::adjacent_find(info.m_peers.begin(), info.m_peers.end()) == info.m_peers.end());
         }
+
+        // Every announcement is in the group for its txhash, with its priority cached, and tracked in the time heap
+        // matching its WaitState. The groups are sorted by peer, and know their IsSelected() and non-COMPLETED
+        // announcements.
+        std::set<AnnouncementSlot> future_slots, past_slots;
+        for (const TimeEntry& entry : m_future_events.Entries()) {
+            if (IsCurrent(entry)) future_slots.insert(entry.m_slot);
+        }
+        for (const TimeEntry& entry : m_past_events.Entries()) {
+            if (IsCurrent(entry)) past_slots.insert(entry.m_slot);
+        }
+        size_t num_future{0}, num_past{0};
+        for (const auto& [txhash, group] : m_txhash_index) {
+            assert(!group.m_entries.empty());
+            AnnouncementSlot selected{NO_ANNOUNCEMENT};
+            size_t num_non_completed{0};
+            for (auto it = group.m_entries.begin(); it != group.m_entries.end(); ++it) {
+                const AnnouncementSlot slot{it->m_slot};
+                const Announcement& ann = m_announcements[slot];
+                assert(ann.m_peer == it->m_peer);
+                assert(it == group.m_entries.begin() || std::prev(it)->m_peer < it->m_peer);
+                if (ann.IsSelected()) selected = slot;
+                num_non_completed += ann.m_state != State::COMPLETED;
+                assert(ann.m_txhash == txhash);
+                assert(ann.m_priority == m_computer(ann));
+                const WaitState wait_state{GetWaitState(ann)};
+                assert(future_slots.count(slot) == (wait_state == WaitState::FUTURE_EVENT));
+                assert(past_slots.count(slot) == (wait_state == WaitState::PAST_EVENT));
+                num_future += wait_state == WaitState::FUTURE_EVENT;
+                num_past += wait_state == WaitState::PAST_EVENT;
+            }
+            assert(group.m_selected == selected);
+            assert(group.m_num_non_completed == num_non_completed);
+        }
+        assert(num_future == m_future_count && num_future == future_slots.size());
+        assert(num_past == m_past_count && num_past == past_slots.size());
+
+        // Every announcement is on the list of its peer that matches its state.
+        size_t num_listed{0};
+        for (const auto& [peer, info] : m_peerinfo) {
+            for (const bool best : {true, false}) {
+                AnnouncementSlot prev{NO_ANNOUNCEMENT};
+                for (AnnouncementSlot slot{best ? info.m_best_head : info.m_other_head}; slot != NO_ANNOUNCEMENT;
+                     slot = m_announcements[slot].m_peer_next) {
+                    const Announcement& ann = m_announcements[slot];
+                    assert(ann.m_peer == peer);
+                    assert((ann.m_state == State::CANDIDATE_BEST) == best);
+                    assert(ann.m_peer_prev == prev);
+                    prev = slot;
+                    ++num_listed;
+                }
+            }
+        }
+        assert(num_listed == Size());
     }
 
     void PostGetRequestableSanityCheck(std::chrono::microseconds now) const
     {
-        for (const Announcement& ann : m_index) {
-            if (ann.IsWaiting()) {
-                // REQUESTED and CANDIDATE_DELAYED must have a time in the future (they should have been converted
-                // to COMPLETED/CANDIDATE_READY respectively).
-                assert(ann.m_time > now);
-            } else if (ann.IsSelectable()) {
-                // CANDIDATE_READY and CANDIDATE_BEST cannot have a time in the future (they should have remained
-                // CANDIDATE_DELAYED, or should have been converted back to it if time went backwards).
-                assert(ann.m_time <= now);
+        for (const auto& [txhash, group] : m_txhash_index) {
+            for (const TxHashGroup::Entry& entry : group.m_entries) {
+                const Announcement& ann = m_announcements[entry.m_slot];
+                if (ann.IsWaiting()) {
+                    // REQUESTED and CANDIDATE_DELAYED must have a time in the future (they should have been converted
+                    // to COMPLETED/CANDIDATE_READY respectively).
+                    assert(ann.m_time > now);
+                } else if (ann.IsSelectable()) {
+                    // CANDIDATE_READY and CANDIDATE_BEST cannot have a time in the future (they should have remained
+                    // CANDIDATE_DELAYED, or should have been converted back to it if time went backwards).
+                    assert(ann.m_time <= now);
+                }
             }
         }
     }
 
 private:
-    //! Wrapper around Index::...::erase that keeps m_peerinfo up to date.
-    template<typename Tag>
-    Iter<Tag> Erase(Iter<Tag> it)
+    //! Whether an entry of the time heaps is not stale.
+    bool IsCurrent(const TimeEntry& entry) const
+    {
+        return m_announcements[entry.m_slot].m_generation == entry.m_generation;
+    }
+
+    //! Add the time of an announcement to the time heap for its WaitState, if any.
+    void TrackTime(AnnouncementSlot slot)
+    {
+        const Announcement& ann = m_announcements[slot];
+        const auto is_current = [this](const TimeEntry& entry) { return IsCurrent(entry); };
+        switch (GetWaitState(ann)) {
+        case WaitState::FUTURE_EVENT:
+            m_future_events.Push({ann.m_time, slot, ann.m_generation});
+            m_future_events.MaybePurge(++m_future_count, is_current);
+            break;
+        case WaitState::PAST_EVENT:
+            m_past_events.Push({ann.m_time, slot, ann.m_generation});
+            m_past_events.MaybePurge(++m_past_count, is_current);
+            break;
+        case WaitState::NO_EVENT:
+            break;
+        }
+    }
+
+    //! Make the entry of an announcement in the time heaps, if any, stale.
+    void UntrackTime(AnnouncementSlot slot)
+    {
+        Announcement& ann = m_announcements[slot];
+        switch (GetWaitState(ann)) {
+        case WaitState::FUTURE_EVENT:
+            --m_future_count;
+            ++ann.m_generation;
+            break;
+        case WaitState::PAST_EVENT:
+            --m_past_count;
+            ++ann.m_generation;
+            break;
+        case WaitState::NO_EVENT:
+            break;
+        }
+    }
+
+    //! The head of the list of its peer's announcements an announcement belongs on.
+    static AnnouncementSlot& ListHead(PeerInfo& info, const Announcement& ann)
+    {
+        return ann.m_state == State::CANDIDATE_BEST ? info.m_best_head : info.m_other_head;
+    }
+
+    void Link(PeerInfo& info, AnnouncementSlot slot)
+    {
+        Announcement& ann = m_announcements[slot];
+        AnnouncementSlot& head = ListHead(info, ann);
+        ann.m_peer_prev = NO_ANNOUNCEMENT;
+        ann.m_peer_next = head;
+        if (head != NO_ANNOUNCEMENT) m_announcements[head].m_peer_prev = slot;
+        head = slot;
+    }
+
+    void Unlink(PeerInfo& info, AnnouncementSlot slot)
+    {
+        const Announcement& ann = m_announcements[slot];
+        if (ann.m_peer_prev != NO_ANNOUNCEMENT) {
+            m_announcements[ann.m_peer_prev].m_peer_next = ann.m_peer_next;
+        } else {
+            ListHead(info, ann) = ann.m_peer_next;
+        }
+        if (ann.m_peer_next != NO_ANNOUNCEMENT) m_announcements[ann.m_peer_next].m_peer_prev = ann.m_peer_prev;
+    }
+
+    //! Delete an announcement, except from the group for its txhash, which is left to the caller.
+    void Erase(AnnouncementSlot slot)
     {
-        auto peerit = m_peerinfo.find(it->m_peer);
-        peerit->second.m_completed -= it->GetState() == State::COMPLETED;
-        peerit->second.m_requested -= it->GetState() == State::REQUESTED;
+        const Announcement& ann = m_announcements[slot];
+        auto peerit = m_peerinfo.find(ann.m_peer);
+        UntrackTime(slot);
+        Unlink(peerit->second, slot);
+        peerit->second.m_completed -= ann.m_state == State::COMPLETED;
+        peerit->second.m_requested -= ann.m_state == State::REQUESTED;
         if (--peerit->second.m_total == 0) m_peerinfo.erase(peerit);
-        return m_index.get<Tag>().erase(it);
+        m_free_slots.push_back(slot);
     }
 
-    //! Wrapper around Index::...::modify that keeps m_peerinfo up to date.
-    template<typename Tag, typename Modifier>
-    void Modify(Iter<Tag> it, Modifier modifier)
+    //! Delete all announcements for a txhash.
+    void EraseGroup(TxHashIndex::iterator group_it)
     {
-        auto peerit = m_peerinfo.find(it->m_peer);
-        peerit->second.m_completed -= it->GetState() == State::COMPLETED;
-        peerit->second.m_requested -= it->GetState() == State::REQUESTED;
-        m_index.get<Tag>().modify(it, std::move(modifier));
-        peerit->second.m_completed += it->GetState() == State::COMPLETED;
-        peerit->second.m_requested += it->GetState() == State::REQUESTED;
+        for (const TxHashGroup::Entry& entry : group_it->second.m_entries) Erase(entry.m_slot);
+        m_txhash_index.erase(group_it);
+    }
+
+    //! Change the state (and time) of an announcement, keeping m_peerinfo, the peer's lists, the group for its
+    //! txhash and the time heaps up to date.
+    void Modify(TxHashGroup& group, AnnouncementSlot slot, State state,
+                std::optional<std::chrono::microseconds> time = std::nullopt)
+    {
+        Announcement& ann = m_announcements[slot];
+        PeerInfo& info = m_peerinfo.find(ann.m_peer)->second;
+        info.m_completed -= ann.m_state == State::COMPLETED;
+        info.m_requested -= ann.m_state == State::REQUESTED;
+        group.m_num_non_completed -= ann.m_state != State::COMPLETED;
+        if (group.m_selected == slot) group.m_selected = NO_ANNOUNCEMENT;
+        const bool relist{(ann.m_state == State::CANDIDATE_BEST) != (state == State::CANDIDATE_BEST)};
+        const bool retime{(ann.IsWaiting() != (state == State::REQUESTED || state == State::CANDIDATE_DELAYED)) ||
+                          (ann.IsSelectable() != (state == State::CANDIDATE_READY || state == State::CANDIDATE_BEST)) ||
+                          (time && *time != ann.m_time)};
+        if (retime) UntrackTime(slot);
+        if (relist) Unlink(info, slot);
+        ann.m_state = state;
+        if (time) ann.m_time = *time;
+        if (relist) Link(info, slot);
+        if (retime) TrackTime(slot);
+        info.m_completed += ann.m_state == State::COMPLETED;
+        info.m_requested += ann.m_state == State::REQUESTED;
+        group.m_num_non_completed += ann.m_state != State::COMPLETED;
+        if (ann.IsSelected()) group.m_selected = slot;
     }
 
     //! Convert a CANDIDATE_DELAYED announcement into a CANDIDATE_READY. If this makes it the new best
     //! CANDIDATE_READY (and no REQUESTED exists) and better than the CANDIDATE_BEST (if any), it becomes the new
     //! CANDIDATE_BEST.
-    void PromoteCandidateReady(Iter<ByTxHash> it)
-    {
-        assert(it != m_index.get<ByTxHash>().end());
-        assert(it->GetState() == State::CANDIDATE_DELAYED);
-        // Convert CANDIDATE_DELAYED to CANDIDATE_READY first.
-        Modify<ByTxHash>(it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_READY); });
-        // The following code relies on the fact that the ByTxHash is sorted by txhash, and then by state (first
-        // _DELAYED, then _READY, then _BEST/REQUESTED). Within the _READY announcements, the best one (highest
-        // priority) comes last. Thus, if an existing _BEST exists for the same txhash that this announcement may
-        // be preferred over, it must immediately follow the newly created _READY.
-        auto it_next = std::next(it);
-        if (it_next == m_index.get<ByTxHash>().end() || it_next->m_txhash != it->m_txhash ||
-            it_next->GetState() == State::COMPLETED) {
-            // This is the new best CANDIDATE_READY, and there is no IsSelected() announcement for this txhash
-            // already.
-            Modify<ByTxHash>(it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
-        } else if (it_next->GetState() == State::CANDIDATE_BEST) {
-            Priority priority_old = m_computer(*it_next);
-            Priority priority_new = m_computer(*it);
-            if (priority_new > priority_old) {
-                // There is a CANDIDATE_BEST announcement already, but this one is better.
-                Modify<ByTxHash>(it_next, [](Announcement& ann){ ann.SetState(State::CANDIDATE_READY); });
-                Modify<ByTxHash>(it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
-            }
+    void PromoteCandidateReady(TxHashGroup& group, AnnouncementSlot slot)
+    {
+        const Announcement& ann = m_announcements[slot];
+        assert(ann.m_state == State::CANDIDATE_DELAYED);
+        const AnnouncementSlot selected{group.m_selected};
+        if (selected == NO_ANNOUNCEMENT) {
+            // There is no IsSelected() announcement for this txhash, which implies that there are no other
+            // CANDIDATE_READY ones either. This is the new CANDIDATE_BEST.
+            Modify(group, slot, State::CANDIDATE_BEST);
+        } else if (m_announcements[selected].m_state == State::CANDIDATE_BEST &&
+                   ann.m_priority > m_announcements[selected].m_priority) {
+            // There is a CANDIDATE_BEST announcement already, but this one is better.
+            Modify(group, selected, State::CANDIDATE_READY);
+            Modify(group, slot, State::CANDIDATE_BEST);
+        } else {
+            Modify(group, slot, State::CANDIDATE_READY);
         }
     }
 
     //! Change the state of an announcement to something non-IsSelected(). If it was IsSelected(), the next best
     //! announcement will be marked CANDIDATE_BEST.
-    void ChangeAndReselect(Iter<ByTxHash> it, State new_state)
+    void ChangeAndReselect(TxHashGroup& group, AnnouncementSlot slot, State new_state)
     {
         assert(new_state == State::COMPLETED || new_state == State::CANDIDATE_DELAYED);
-        assert(it != m_index.get<ByTxHash>().end());
-        if (it->IsSelected() && it != m_index.get<ByTxHash>().begin()) {
-            auto it_prev = std::prev(it);
-            // The next best CANDIDATE_READY, if any, immediately precedes the REQUESTED or CANDIDATE_BEST
-            // announcement in the ByTxHash index.
-            if (it_prev->m_txhash == it->m_txhash && it_prev->GetState() == State::CANDIDATE_READY) {
-                // If one such CANDIDATE_READY exists (for this txhash), convert it to CANDIDATE_BEST.
-                Modify<ByTxHash>(it_prev, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
+        if (m_announcements[slot].IsSelected()) {
+            // If any CANDIDATE_READY exists (for this txhash), convert the best one to CANDIDATE_BEST.
+            AnnouncementSlot best{NO_ANNOUNCEMENT};
+            for (const TxHashGroup::Entry& entry : group.m_entries) {
+                const Announcement& other = m_announcements[entry.m_slot];
+                if (other.m_state == State::CANDIDATE_READY &&
+                    (best == NO_ANNOUNCEMENT || other.m_priority > m_announcements[best].m_priority)) {
+                    best = entry.m_slot;
+                }
             }
+            if (best != NO_ANNOUNCEMENT) Modify(group, best, State::CANDIDATE_BEST);
         }
-        Modify<ByTxHash>(it, [new_state](Announcement& ann){ ann.SetState(new_state); });
+        Modify(group, slot, new_state);
     }
 
-    //! Check if 'it' is the only announcement for a given txhash that isn't COMPLETED.
-    bool IsOnlyNonCompleted(Iter<ByTxHash> it)
+    //! Check if 'slot' is the only announcement for a given txhash that isn't COMPLETED.
+    bool IsOnlyNonCompleted(const TxHashGroup& group, AnnouncementSlot slot) const
     {
-        assert(it != m_index.get<ByTxHash>().end());
-        assert(it->GetState() != State::COMPLETED); // Not allowed to call this on COMPLETED announcements.
-
-        // This announcement has a predecessor that belongs to the same txhash. Due to ordering, and the
-        // fact that 'it' is not COMPLETED, its predecessor cannot be COMPLETED here.
-        if (it != m_index.get<ByTxHash>().begin() && std::prev(it)->m_txhash == it->m_txhash) return false;
-
-        // This announcement has a successor that belongs to the same txhash, and is not COMPLETED.
-        if (std::next(it) != m_index.get<ByTxHash>().end() && std::next(it)->m_txhash == it->m_txhash &&
-            std::next(it)->GetState() != State::COMPLETED) return false;
-
-        return true;
+        assert(m_announcements[slot].m_state != State::COMPLETED); // Not allowed to call this on COMPLETED announcements.
+        return group.m_num_non_completed == 1;
     }
 
     /** Convert any announcement to a COMPLETED one. If there are no non-COMPLETED announcements left for this
      *  txhash, they are deleted. If this was a REQUESTED announcement, and there are other CANDIDATEs left, the
      *  best one is made CANDIDATE_BEST. Returns whether the announcement still exists. */
-    bool MakeCompleted(Iter<ByTxHash> it)
+    bool MakeCompleted(TxHashIndex::iterator group_it, AnnouncementSlot slot)
     {
-        assert(it != m_index.get<ByTxHash>().end());
-
         // Nothing to be done if it's already COMPLETED.
-        if (it->GetState() == State::COMPLETED) return true;
+        if (m_announcements[slot].m_state == State::COMPLETED) return true;
 
-        if (IsOnlyNonCompleted(it)) {
+        if (IsOnlyNonCompleted(group_it->second, slot)) {
             // This is the last non-COMPLETED announcement for this txhash. Delete all.
-            uint256 txhash = it->m_txhash;
-            do {
-                it = Erase<ByTxHash>(it);
-            } while (it != m_index.get<ByTxHash>().end() && it->m_txhash == txhash);
+            EraseGroup(group_it);
             return false;
         }
 
         // Mark the announcement COMPLETED, and select the next best announcement (the first CANDIDATE_READY) if
         // needed.
-        ChangeAndReselect(it, State::COMPLETED);
+        ChangeAndReselect(group_it->second, slot, State::COMPLETED);
 
         return true;
     }
@@ -492,103 +678,113 @@ private:
     void SetTimePoint(std::chrono::microseconds now, std::vector<std::pair<NodeId, GenTxid>>* expired)
     {
         if (expired) expired->clear();
+        const auto is_current = [this](const TimeEntry& entry) { return IsCurrent(entry); };
 
         // Iterate over all CANDIDATE_DELAYED and REQUESTED from old to new, as long as they're in the past,
         // and convert them to CANDIDATE_READY and COMPLETED respectively.
-        while (!m_index.empty()) {
-            auto it = m_index.get<ByTime>().begin();
-            if (it->GetState() == State::CANDIDATE_DELAYED && it->m_time <= now) {
-                PromoteCandidateReady(m_index.project<ByTxHash>(it));
-            } else if (it->GetState() == State::REQUESTED && it->m_time <= now) {
-                if (expired) expired->emplace_back(it->m_peer, ToGenTxid(*it));
-                MakeCompleted(m_index.project<ByTxHash>(it));
+        while (const TimeEntry* entry = m_future_events.Top(is_current)) {
+            if (entry->m_time > now) break;
+            const AnnouncementSlot slot{entry->m_slot};
+            m_future_events.Pop();
+            const Announcement& ann = m_announcements[slot];
+            const auto group_it = m_txhash_index.find(ann.m_txhash);
+            if (ann.m_state == State::CANDIDATE_DELAYED) {
+                PromoteCandidateReady(group_it->second, slot);
             } else {
-                break;
+                assert(ann.m_state == State::REQUESTED);
+                if (expired) expired->emplace_back(ann.m_peer, ToGenTxid(ann));
+                MakeCompleted(group_it, slot);
             }
         }
 
-        while (!m_index.empty()) {
-            // If time went backwards, we may need to demote CANDIDATE_BEST and CANDIDATE_READY announcements back
-            // to CANDIDATE_DELAYED. This is an unusual edge case, and unlikely to matter in production. However,
-            // it makes it much easier to specify and test TxRequestTracker::Impl's behaviour.
-            auto it = std::prev(m_index.get<ByTime>().end());
-            if (it->IsSelectable() && it->m_time > now) {
-                ChangeAndReselect(m_index.project<ByTxHash>(it), State::CANDIDATE_DELAYED);
-            } else {
-                break;
-            }
+        // If time went backwards, we may need to demote CANDIDATE_BEST and CANDIDATE_READY announcements back
+        // to CANDIDATE_DELAYED. This is an unusual edge case, and unlikely to matter in production. However,
+        // it makes it much easier to specify and test TxRequestTracker::Impl's behaviour.
+        while (const TimeEntry* entry = m_past_events.Top(is_current)) {
+            if (entry->m_time <= now) break;
+            const AnnouncementSlot slot{entry->m_slot};
+            m_past_events.Pop();
+            ChangeAndReselect(m_txhash_index.find(m_announcements[slot].m_txhash)->second, slot, State::CANDIDATE_DELAYED);
         }
     }
 
 public:
     explicit Impl(bool deterministic) :
-        m_computer(deterministic),
-        // Explicitly initialize m_index as we need to pass a reference to m_computer to ByTxHashViewExtractor.
-        m_index(boost::make_tuple(
-            boost::make_tuple(ByPeerViewExtractor(), std::less<ByPeerView>()),
-            boost::make_tuple(ByTxHashViewExtractor(m_computer), std::less<ByTxHashView>()),
-            boost::make_tuple(ByTimeViewExtractor(), std::less<ByTimeView>())
-        )) {}
-
-    // Disable copying and assigning (a default copy won't work due the stateful ByTxHashViewExtractor).
+        m_computer(deterministic) {}
+
+    // Disable copying and assigning.
     Impl(const Impl&) = delete;
     Impl& operator=(const Impl&) = delete;
 
     void DisconnectedPeer(NodeId peer)
     {
-        auto& index = m_index.get<ByPeer>();
-        auto it = index.lower_bound(ByPeerView{peer, false, uint256::ZERO});
-        while (it != index.end() && it->m_peer == peer) {
-            // Check what to continue with after this iteration. 'it' will be deleted in what follows, so we need to
-            // decide what to continue with afterwards. There are a number of cases to consider:
-            // - std::next(it) is end() or belongs to a different peer. In that case, this is the last iteration
-            //   of the loop (denote this by setting it_next to end()).
-            // - 'it' is not the only non-COMPLETED announcement for its txhash. This means it will be deleted, but
-            //   no other Announcement objects will be modified. Continue with std::next(it) if it belongs to the
-            //   same peer, but decide this ahead of time (as 'it' may change position in what follows).
-            // - 'it' is the only non-COMPLETED announcement for its txhash. This means it will be deleted along
-            //   with all other announcements for the same txhash - which may include std::next(it). However, other
-            //   than 'it', no announcements for the same peer can be affected (due to (peer, txhash) uniqueness).
-            //   In other words, the situation where std::next(it) is deleted can only occur if std::next(it)
-            //   belongs to a different peer but the same txhash as 'it'. This is covered by the first bulletpoint
-            //   already, and we'll have set it_next to end().
-            auto it_next = (std::next(it) == index.end() || std::next(it)->m_peer != peer) ? index.end() :
-                std::next(it);
+        auto peerit = m_peerinfo.find(peer);
+        if (peerit == m_peerinfo.end()) return;
+
+        // Collect the peer's announcements first, as their lists change in what follows. Handling one of them
+        // cannot delete another one: only announcements for the same txhash can be deleted along with it, and
+        // no other one for that txhash belongs to this peer.
+        std::vector<AnnouncementSlot> slots;
+        slots.reserve(peerit->second.m_total);
+        for (const AnnouncementSlot head : {peerit->second.m_best_head, peerit->second.m_other_head}) {
+            for (AnnouncementSlot slot{head}; slot != NO_ANNOUNCEMENT; slot = m_announcements[slot].m_peer_next) {
+                slots.push_back(slot);
+            }
+        }
+
+        for (const AnnouncementSlot slot : slots) {
             // If the announcement isn't already COMPLETED, first make it COMPLETED (which will mark other
             // CANDIDATEs as CANDIDATE_BEST, or delete all of a txhash's announcements if no non-COMPLETED ones are
             // left).
-            if (MakeCompleted(m_index.project<ByTxHash>(it))) {
+            const auto group_it = m_txhash_index.find(m_announcements[slot].m_txhash);
+            if (MakeCompleted(group_it, slot)) {
                 // Then actually delete the announcement (unless it was already deleted by MakeCompleted).
-                Erase<ByPeer>(it);
+                group_it->second.m_entries.erase(group_it->second.LowerBound(peer));
+                Erase(slot);
             }
-            it = it_next;
         }
     }
 
     void ForgetTxHash(const uint256& txhash)
     {
-        auto it = m_index.get<ByTxHash>().lower_bound(ByTxHashView{txhash, State::CANDIDATE_DELAYED, 0});
-        while (it != m_index.get<ByTxHash>().end() && it->m_txhash == txhash) {
-            it = Erase<ByTxHash>(it);
-        }
+        const auto group_it = m_txhash_index.find(txhash);
+        if (group_it != m_txhash_index.end()) EraseGroup(group_it);
     }
 
     void ReceivedInv(NodeId peer, const GenTxid& gtxid, bool preferred,
         std::chrono::microseconds reqtime)
     {
-        // Bail out if we already have a CANDIDATE_BEST announcement for this (txhash, peer) combination. The case
-        // where there is a non-CANDIDATE_BEST announcement already will be caught by the uniqueness property of the
-        // ByPeer index when we try to emplace the new object below.
-        if (m_index.get<ByPeer>().count(ByPeerView{peer, true, gtxid.GetHash()})) return;
-
-        // Try creating the announcement with CANDIDATE_DELAYED state (which will fail due to the uniqueness
-        // of the ByPeer index if a non-CANDIDATE_BEST announcement already exists with the same txhash and peer).
-        // Bail out in that case.
-        auto ret = m_index.get<ByPeer>().emplace(gtxid, peer, preferred, reqtime, m_current_sequence);
-        if (!ret.second) return;
+        // Bail out if we already have an announcement for this (txhash, peer) combination.
+        TxHashGroup& group = m_txhash_index.try_emplace(gtxid.GetHash()).first->second;
+        const auto entry_it = group.LowerBound(peer);
+        if (entry_it != group.m_entries.end() && entry_it->m_peer == peer) return;
+
+        // Create the announcement with CANDIDATE_DELAYED state, in an unused slot if there is one.
+        AnnouncementSlot slot;
+        if (m_free_slots.empty()) {
+            slot = m_announcements.size();
+            m_announcements.emplace_back();
+        } else {
+            slot = m_free_slots.back();
+            m_free_slots.pop_back();
+        }
+        Announcement& ann = m_announcements[slot];
+        ann.m_txhash = gtxid.GetHash();
+        ann.m_time = reqtime;
+        ann.m_peer = peer;
+        ann.m_sequence = m_current_sequence;
+        ann.m_priority = m_computer(gtxid.GetHash(), peer, preferred);
+        ann.m_preferred = preferred;
+        ann.m_is_wtxid = gtxid.IsWtxid();
+        ann.m_state = State::CANDIDATE_DELAYED;
+        group.m_entries.insert(entry_it, {peer, slot});
+        ++group.m_num_non_completed;
 
         // Update accounting metadata.
-        ++m_peerinfo[peer].m_total;
+        PeerInfo& info = m_peerinfo[peer];
+        ++info.m_total;
+        Link(info, slot);
+        TrackTime(slot);
         ++m_current_sequence;
     }
 
@@ -601,11 +797,12 @@ public:
 
         // Find all CANDIDATE_BEST announcements for this peer.
         std::vector<const Announcement*> selected;
-        auto it_peer = m_index.get<ByPeer>().lower_bound(ByPeerView{peer, true, uint256::ZERO});
-        while (it_peer != m_index.get<ByPeer>().end() && it_peer->m_peer == peer &&
-            it_peer->GetState() == State::CANDIDATE_BEST) {
-            selected.emplace_back(&*it_peer);
-            ++it_peer;
+        const auto peerit = m_peerinfo.find(peer);
+        if (peerit != m_peerinfo.end()) {
+            for (AnnouncementSlot slot{peerit->second.m_best_head}; slot != NO_ANNOUNCEMENT;
+                 slot = m_announcements[slot].m_peer_next) {
+                selected.emplace_back(&m_announcements[slot]);
+            }
         }
 
         // Sort by sequence number.
@@ -624,16 +821,19 @@ public:
 
     void RequestedTx(NodeId peer, const uint256& txhash, std::chrono::microseconds expiry)
     {
-        auto it = m_index.get<ByPeer>().find(ByPeerView{peer, true, txhash});
-        if (it == m_index.get<ByPeer>().end()) {
+        const auto group_it = m_txhash_index.find(txhash);
+        if (group_it == m_txhash_index.end()) return;
+        TxHashGroup& group = group_it->second;
+        const AnnouncementSlot slot{group.Find(peer)};
+        if (slot == NO_ANNOUNCEMENT) return;
+
+        const State state{m_announcements[slot].m_state};
+        if (state != State::CANDIDATE_BEST) {
             // There is no CANDIDATE_BEST announcement, look for a _READY or _DELAYED instead. If the caller only
             // ever invokes RequestedTx with the values returned by GetRequestable, and no other non-const functions
             // other than ForgetTxHash and GetRequestable in between, this branch will never execute (as txhashes
             // returned by GetRequestable always correspond to CANDIDATE_BEST announcements).
-
-            it = m_index.get<ByPeer>().find(ByPeerView{peer, false, txhash});
-            if (it == m_index.get<ByPeer>().end() || (it->GetState() != State::CANDIDATE_DELAYED &&
-                                                      it->GetState() != State::CANDIDATE_READY)) {
+            if (state != State::CANDIDATE_DELAYED && state != State::CANDIDATE_READY) {
                 // There is no CANDIDATE announcement tracked for this peer, so we have nothing to do. Either this
                 // txhash wasn't tracked at all (and the caller should have called ReceivedInv), or it was already
                 // requested and/or completed for other reasons and this is just a superfluous RequestedTx call.
@@ -643,38 +843,33 @@ public:
             // Look for an existing CANDIDATE_BEST or REQUESTED with the same txhash. We only need to do this if the
             // found announcement had a different state than CANDIDATE_BEST. If it did, invariants guarantee that no
             // other CANDIDATE_BEST or REQUESTED can exist.
-            auto it_old = m_index.get<ByTxHash>().lower_bound(ByTxHashView{txhash, State::CANDIDATE_BEST, 0});
-            if (it_old != m_index.get<ByTxHash>().end() && it_old->m_txhash == txhash) {
-                if (it_old->GetState() == State::CANDIDATE_BEST) {
+            const AnnouncementSlot old_slot{group.m_selected};
+            if (old_slot != NO_ANNOUNCEMENT) {
+                if (m_announcements[old_slot].m_state == State::CANDIDATE_BEST) {
                     // The data structure's invariants require that there can be at most one CANDIDATE_BEST or one
                     // REQUESTED announcement per txhash (but not both simultaneously), so we have to convert any
                     // existing CANDIDATE_BEST to another CANDIDATE_* when constructing another REQUESTED.
                     // It doesn't matter whether we pick CANDIDATE_READY or _DELAYED here, as SetTimePoint()
                     // will correct it at GetRequestable() time. If time only goes forward, it will always be
                     // _READY, so pick that to avoid extra work in SetTimePoint().
-                    Modify<ByTxHash>(it_old, [](Announcement& ann) { ann.SetState(State::CANDIDATE_READY); });
-                } else if (it_old->GetState() == State::REQUESTED) {
+                    Modify(group, old_slot, State::CANDIDATE_READY);
+                } else {
                     // As we're no longer waiting for a response to the previous REQUESTED announcement, convert it
                     // to COMPLETED. This also helps guaranteeing progress.
-                    Modify<ByTxHash>(it_old, [](Announcement& ann) { ann.SetState(State::COMPLETED); });
+                    Modify(group, old_slot, State::COMPLETED);
                 }
             }
         }
 
-        Modify<ByPeer>(it, [expiry](Announcement& ann) {
-            ann.SetState(State::REQUESTED);
-            ann.m_time = expiry;
-        });
+        Modify(group, slot, State::REQUESTED, expiry);
     }
 
     void ReceivedResponse(NodeId peer, const uint256& txhash)
     {
-        // We need to search the ByPeer index for both (peer, false, txhash) and (peer, true, txhash).
-        auto it = m_index.get<ByPeer>().find(ByPeerView{peer, false, txhash});
-        if (it == m_index.get<ByPeer>().end()) {
-            it = m_index.get<ByPeer>().find(ByPeerView{peer, true, txhash});
-        }
-        if (it != m_index.get<ByPeer>().end()) MakeCompleted(m_index.project<ByTxHash>(it));
+        const auto group_it = m_txhash_index.find(txhash);
+        if (group_it == m_txhash_index.end()) return;
+        const AnnouncementSlot slot{group_it->second.Find(peer)};
+        if (slot != NO_ANNOUNCEMENT) MakeCompleted(group_it, slot);
     }
 
     size_t CountInFlight(NodeId peer) const
@@ -699,7 +894,7 @@ public:
     }
 
     //! Count how many announcements are being tracked in total across all peers and transactions.
-    size_t Size() const { return m_index.size(); }
+    size_t Size() const { return m_announcements.size() - m_free_slots.size(); }
 
     uint64_t ComputePriority(const uint256& txhash, NodeId peer, bool preferred) const
     {
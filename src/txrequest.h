@@ -90,8 +90,10 @@
  * Complexity:
  * - Memory usage is proportional to the total number of tracked announcements (Size()) plus the number of
  *   peers with a nonzero number of tracked announcements.
- * - CPU usage is generally logarithmic in the total number of tracked announcements, plus the number of
- *   announcements affected by an operation (amortized O(1) per announcement).
+ * - CPU usage is generally constant in the total number of tracked announcements, and linear in the number of
+ *   announcements for the same txhash (which is bounded by the number of peers), plus the number of announcements
+ *   affected by an operation (amortized O(1) per announcement). Only moving time, in GetRequestable, is logarithmic
+ *   in the total number of tracked announcements.
  */
 class TxRequestTracker {
     // Avoid littering this header file with implementation details.
@@ -10,6 +10,8 @@
 #include <util/system.h>
 #include <util/time.h>
 
+#include <algorithm>
+#include <array>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -64,6 +66,25 @@ ssize_t Sock::Send(const void* data, size_t len, int flags) const
     return send(m_socket, static_cast<const char*>(data), len, flags);
 }
 
+ssize_t Sock::SendMany(Span<const Span<const unsigned char>> buffers, int flags) const
+{
+    if (buffers.empty()) return 0;
+#ifdef WIN32
+    return Send(buffers[0].data(), buffers[0].size(), flags);
+#else
+    std::array<iovec, MAX_SEND_BUFFERS> iov;
+    const size_t count{std::min(buffers.size(), iov.size())};
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<unsigned char*>(buffers[i].data());
+        iov[i].iov_len = buffers[i].size();
+    }
+    msghdr msg{};
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = count;
+    return sendmsg(m_socket, &msg, flags);
+#endif
+}
+
 ssize_t Sock::Recv(void* buf, size_t len, int flags) const
 {
     return recv(m_socket, static_cast<char*>(buf), len, flags);
@@ -6,6 +6,7 @@
 #define BITCOIN_UTIL_SOCK_H
 
 #include <compat.h>
+#include <span.h>
 #include <threadinterrupt.h>
 #include <util/time.h>
 
@@ -19,6 +20,9 @@
  */
 static constexpr auto MAX_WAIT_FOR_IO = 1s;
 
+/** Maximum number of buffers sent by one call to `Sock::SendMany()`. */
+static constexpr size_t MAX_SEND_BUFFERS{64};
+
 /**
  * RAII helper class that manages a socket. Mimics `std::unique_ptr`, but instead of a pointer it
  * contains a socket and closes it automatically when it goes out of scope.
@@ -85,6 +89,15 @@ public:
      */
     [[nodiscard]] virtual ssize_t Send(const void* data, size_t len, int flags) const;
 
+    /**
+     * Send the first `MAX_SEND_BUFFERS` of `buffers`, one after the other, in one system call.
+     * Equivalent to `sendmsg(2)` with an iovec per buffer, or to `Send()` of the first buffer
+     * where that is not available. Code that uses this wrapper can be unit tested if this
+     * method is overridden by a mock Sock implementation.
+     * @return number of bytes sent, or -1 on error
+     */
+    [[nodiscard]] virtual ssize_t SendMany(Span<const Span<const unsigned char>> buffers, int flags) const;
+
     /**
      * recv(2) wrapper. Equivalent to `recv(this->Get(), buf, len, flags);`. Code that uses this
      * wrapper can be unit tested if this method is overridden by a mock Sock implementation.
@@ -0,0 +1,270 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/sock_events.h>
+
+#include <compat.h>
+#include <logging.h>
+#include <sync.h>
+#include <util/sock.h>
+#include <util/time.h>
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#ifdef USE_POLL
+#include <poll.h>
+#endif
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+namespace {
+/**
+ * Keeps the registered sockets in a list, all of which is passed to the
+ * kernel on every wait. Backends implement Wait() on top of Snapshot().
+ */
+class ListSockEvents : public SockEvents
+{
+public:
+    bool Set(void* key, SOCKET socket, Event requested) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        const auto [it, inserted] = m_index.try_emplace(key, m_entries.size());
+        if (inserted) m_entries.push_back({key, socket, requested});
+        m_entries[it->second].socket = socket;
+        m_entries[it->second].requested = requested;
+        return true;
+    }
+
+    void Remove(void* key) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        const auto it = m_index.find(key);
+        if (it == m_index.end()) return;
+        const size_t pos{it->second};
+        m_index.erase(it);
+        if (pos + 1 != m_entries.size()) {
+            m_entries[pos] = m_entries.back();
+            m_index[m_entries[pos].key] = pos;
+        }
+        m_entries.pop_back();
+    }
+
+protected:
+    struct Entry {
+        void* key;
+        SOCKET socket;
+        Event requested;
+    };
+
+    /** Copy the registered sockets, so that the kernel can wait for them without holding the lock. */
+    const std::vector<Entry>& Snapshot() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        m_snapshot = m_entries;
+        return m_snapshot;
+    }
+
+private:
+    Mutex m_mutex;
+    std::vector<Entry> m_entries GUARDED_BY(m_mutex);
+    std::unordered_map<void*, size_t> m_index GUARDED_BY(m_mutex);
+    //! Only used by the waiting thread
+    std::vector<Entry> m_snapshot;
+};
+
+#ifdef USE_POLL
+class PollSockEvents final : public ListSockEvents
+{
+public:
+    bool Wait(std::chrono::milliseconds timeout, std::vector<Ready>& ready) override
+    {
+        ready.clear();
+        const std::vector<Entry>& entries{Snapshot()};
+        m_fds.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            m_fds[i].fd = entries[i].socket;
+            m_fds[i].events = ((entries[i].requested & Sock::RECV) ? POLLIN : 0) |
+                              ((entries[i].requested & Sock::SEND) ? POLLOUT : 0);
+            m_fds[i].revents = 0;
+        }
+
+        if (poll(m_fds.data(), m_fds.size(), count_milliseconds(timeout)) == SOCKET_ERROR) {
+            return false;
+        }
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            Event occurred{0};
+            if (m_fds[i].revents & POLLIN) occurred |= Sock::RECV;
+            if (m_fds[i].revents & POLLOUT) occurred |= Sock::SEND;
+            if (m_fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) occurred |= ERR;
+            if (occurred) ready.push_back({entries[i].key, occurred});
+        }
+        return true;
+    }
+
+private:
+    std::vector<pollfd> m_fds;
+};
+#else
+class SelectSockEvents final : public ListSockEvents
+{
+public:
+    bool Wait(std::chrono::milliseconds timeout, std::vector<Ready>& ready) override
+    {
+        ready.clear();
+        const std::vector<Entry>& entries{Snapshot()};
+        fd_set fdset_recv;
+        fd_set fdset_send;
+        fd_set fdset_error;
+        FD_ZERO(&fdset_recv);
+        FD_ZERO(&fdset_send);
+        FD_ZERO(&fdset_error);
+        SOCKET socket_max{0};
+        for (const Entry& entry : entries) {
+            if (!IsSelectableSocket(entry.socket)) continue;
+            if (entry.requested & Sock::RECV) FD_SET(entry.socket, &fdset_recv);
+            if (entry.requested & Sock::SEND) FD_SET(entry.socket, &fdset_send);
+            FD_SET(entry.socket, &fdset_error);
+            socket_max = std::max(socket_max, entry.socket);
+        }
+
+        timeval timeout_struct = MillisToTimeval(timeout);
+        if (select(socket_max + 1, &fdset_recv, &fdset_send, &fdset_error, &timeout_struct) == SOCKET_ERROR) {
+            return false;
+        }
+
+        for (const Entry& entry : entries) {
+            if (!IsSelectableSocket(entry.socket)) continue;
+            Event occurred{0};
+            if (FD_ISSET(entry.socket, &fdset_recv)) occurred |= Sock::RECV;
+            if (FD_ISSET(entry.socket, &fdset_send)) occurred |= Sock::SEND;
+            if (FD_ISSET(entry.socket, &fdset_error)) occurred |= ERR;
+            if (occurred) ready.push_back({entry.key, occurred});
+        }
+        return true;
+    }
+};
+#endif // USE_POLL
+
+#ifdef USE_EPOLL
+/**
+ * Keeps the registered sockets in the kernel, so that waiting costs time in
+ * proportion to the number of sockets that are ready rather than registered.
+ */
+class EpollSockEvents final : public SockEvents
+{
+public:
+    explicit EpollSockEvents(int epoll_fd) : m_epoll_fd{epoll_fd} {}
+
+    ~EpollSockEvents()
+    {
+        close(m_epoll_fd);
+    }
+
+    bool Set(void* key, SOCKET socket, Event requested) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        epoll_event event{};
+        // Errors and hangups are always reported.
+        event.events = ((requested & Sock::RECV) ? uint32_t{EPOLLIN} : 0) | ((requested & Sock::SEND) ? uint32_t{EPOLLOUT} : 0);
+        event.data.ptr = key;
+
+        LOCK(m_mutex);
+        auto [it, inserted] = m_sockets.try_emplace(key, socket);
+        if (!inserted && it->second != socket) {
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, it->second, nullptr);
+            it->second = socket;
+            inserted = true;
+        }
+        if (epoll_ctl(m_epoll_fd, inserted ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, socket, &event) == 0) return true;
+        LogPrintf("epoll_ctl error %s\n", NetworkErrorString(WSAGetLastError()));
+        // The kernel drops a socket from the epoll set once it is closed, and
+        // its descriptor may be reused since, so try registering it anew.
+        if (!inserted && epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, socket, &event) == 0) return true;
+        // Don't leave it registered for the previous events.
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, socket, nullptr);
+        m_sockets.erase(it);
+        return false;
+    }
+
+    void Remove(void* key) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        const auto it = m_sockets.find(key);
+        if (it == m_sockets.end()) return;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, it->second, nullptr);
+        m_sockets.erase(it);
+    }
+
+    bool Wait(std::chrono::milliseconds timeout, std::vector<Ready>& ready) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        ready.clear();
+        m_events.resize(std::max<size_t>(WITH_LOCK(m_mutex, return m_sockets.size()), 1));
+        const int count{epoll_wait(m_epoll_fd, m_events.data(), m_events.size(), count_milliseconds(timeout))};
+        if (count == SOCKET_ERROR) return false;
+
+        for (int i = 0; i < count; ++i) {
+            Event occurred{0};
+            if (m_events[i].events & EPOLLIN) occurred |= Sock::RECV;
+            if (m_events[i].events & EPOLLOUT) occurred |= Sock::SEND;
+            if (m_events[i].events & (EPOLLERR | EPOLLHUP)) occurred |= ERR;
+            ready.push_back({m_events[i].data.ptr, occurred});
+        }
+        return true;
+    }
+
+private:
+    const int m_epoll_fd;
+    Mutex m_mutex;
+    //! The socket registered for each key, to unregister it by
+    std::unordered_map<void*, SOCKET> m_sockets GUARDED_BY(m_mutex);
+    //! Only used by the waiting thread
+    std::vector<epoll_event> m_events;
+};
+#endif // USE_EPOLL
+} // namespace
+
+std::unique_ptr<SockEvents> MakeSockEvents(SockEventsBackend backend)
+{
+    switch (backend) {
+    case SockEventsBackend::SELECT:
+#ifndef USE_POLL
+        return std::make_unique<SelectSockEvents>();
+#else
+        return nullptr;
+#endif
+    case SockEventsBackend::POLL:
+#ifdef USE_POLL
+        return std::make_unique<PollSockEvents>();
+#else
+        return nullptr;
+#endif
+    case SockEventsBackend::EPOLL: {
+#ifdef USE_EPOLL
+        const int epoll_fd{epoll_create1(EPOLL_CLOEXEC)};
+        if (epoll_fd == -1) {
+            LogPrintf("epoll_create1 error %s\n", NetworkErrorString(WSAGetLastError()));
+            return nullptr;
+        }
+        return std::make_unique<EpollSockEvents>(epoll_fd);
+#else
+        return nullptr;
+#endif
+    }
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+std::unique_ptr<SockEvents> MakeSockEvents()
+{
+    for (const SockEventsBackend backend : {SockEventsBackend::EPOLL, SockEventsBackend::POLL, SockEventsBackend::SELECT}) {
+        if (auto sock_events{MakeSockEvents(backend)}) return sock_events;
+    }
+    assert(false);
+}
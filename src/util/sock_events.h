@@ -0,0 +1,76 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_SOCK_EVENTS_H
+#define BITCOIN_UTIL_SOCK_EVENTS_H
+
+#include <compat.h>
+#include <util/sock.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * Waits for a set of sockets to become ready for IO.
+ *
+ * Unlike `Sock::Wait()`, the sockets and the events of interest on them are
+ * registered once, and only updated when the interest changes, instead of
+ * being passed in full for every wait. Each socket is identified by a key
+ * chosen by the caller, which is handed back when the socket is ready.
+ *
+ * Registrations may be changed from any thread, also while another one waits,
+ * but only one thread may wait at a time. A socket must be removed before it
+ * is closed. Sockets removed during a wait may still be reported by it.
+ */
+class SockEvents
+{
+public:
+    using Event = Sock::Event;
+
+    /** Reported for sockets with an error or that were hung up, whether or not any events were requested. */
+    static constexpr Event ERR = 0b100;
+
+    /** A socket that is ready for (some of) the requested events, or has an error. */
+    struct Ready {
+        void* key;
+        Event occurred;
+    };
+
+    virtual ~SockEvents() = default;
+
+    /**
+     * Register a socket, or change the events of interest on an already registered one.
+     * @param[in] key Identifies the socket to the caller.
+     * @param[in] socket The socket to wait for.
+     * @param[in] requested Bitwise-or of `Sock::RECV` and `Sock::SEND`, or 0 to only be told about errors.
+     * @return false if the socket could not be registered
+     */
+    virtual bool Set(void* key, SOCKET socket, Event requested) = 0;
+
+    /** Stop waiting for a socket. Does nothing if it is not registered. */
+    virtual void Remove(void* key) = 0;
+
+    /**
+     * Wait for at least one registered socket to become ready.
+     * @param[in] timeout Wait at most this much.
+     * @param[out] ready The sockets that are ready, replacing earlier contents.
+     * @return false if waiting failed
+     */
+    virtual bool Wait(std::chrono::milliseconds timeout, std::vector<Ready>& ready) = 0;
+};
+
+enum class SockEventsBackend {
+    SELECT, //!< select(2), where poll(2) is not usable
+    POLL,   //!< poll(2)
+    EPOLL,  //!< epoll(7), on Linux
+};
+
+/** Create a SockEvents that uses the given system call, or nullptr if it is not available on this platform. */
+std::unique_ptr<SockEvents> MakeSockEvents(SockEventsBackend backend);
+
+/** Create a SockEvents that uses the most scalable system call available. */
+std::unique_ptr<SockEvents> MakeSockEvents();
+
+#endif // BITCOIN_UTIL_SOCK_EVENTS_H
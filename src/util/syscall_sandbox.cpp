@@ -865,7 +865,13 @@ void SetSyscallSandboxPolicy(SyscallSandboxPolicy syscall_policy)
         seccomp_policy_builder.AllowFileSystem();
         seccomp_policy_builder.AllowNetwork();
         break;
-    case SyscallSandboxPolicy::MESSAGE_HANDLER: // Thread: msghand
+    case SyscallSandboxPolicy::BLOCK_TEMPLATE: // Thread: blktemplate
+        seccomp_policy_builder.AllowFileSystem();
+        break;
+    case SyscallSandboxPolicy::COMPACT_BLOCK: // Thread: cmpctblock
+        seccomp_policy_builder.AllowFileSystem();
+        break;
+    case SyscallSandboxPolicy::MESSAGE_HANDLER: // Thread: msghand, msghand.<N>
         seccomp_policy_builder.AllowFileSystem();
         break;
     case SyscallSandboxPolicy::NET: // Thread: net
@@ -13,6 +13,8 @@ enum class SyscallSandboxPolicy {
     INITIALIZATION_MAP_PORT,
 
     // 2. Steady state (non-initialization, non-shutdown)
+    BLOCK_TEMPLATE,
+    COMPACT_BLOCK,
     MESSAGE_HANDLER,
     NET,
     NET_ADD_CONNECTION,
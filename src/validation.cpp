@@ -58,7 +58,9 @@
 #include <algorithm>
 #include <numeric>
 #include <optional>
+#include <queue>
 #include <string>
+#include <unordered_map>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -178,6 +180,8 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
                        std::vector<CScriptCheck>* pvChecks = nullptr)
                        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
 bool CheckFinalTx(const CBlockIndex* active_chain_tip, const CTransaction &tx, int flags)
 {
     AssertLockHeld(cs_main);
@@ -285,16 +289,20 @@ bool CheckSequenceLocks(CBlockIndex* tip,
 // Returns the script flags which should be checked for a given block
 static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& chainparams);
 
-static void LimitMempoolSize(CTxMemPool& pool, CCoinsViewCache& coins_cache, size_t limit, std::chrono::seconds age)
-    EXCLUSIVE_LOCKS_REQUIRED(::cs_main, pool.cs)
+void ExpireMempool(CTxMemPool& pool, std::chrono::seconds age)
 {
-    AssertLockHeld(::cs_main);
-    AssertLockHeld(pool.cs);
+    LOCK2(::cs_main, pool.cs);
     int expired = pool.Expire(GetTime<std::chrono::seconds>() - age);
     if (expired != 0) {
         LogPrint(BCLog::MEMPOOL, "Expired %i transactions from the memory pool\n", expired);
     }
+}
 
+static void LimitMempoolSize(CTxMemPool& pool, CCoinsViewCache& coins_cache, size_t limit)
+    EXCLUSIVE_LOCKS_REQUIRED(::cs_main, pool.cs)
+{
+    AssertLockHeld(::cs_main);
+    AssertLockHeld(pool.cs);
     std::vector<COutPoint> vNoSpendsRemaining;
     pool.TrimToSize(limit, &vNoSpendsRemaining);
     for (const COutPoint& removed : vNoSpendsRemaining)
@@ -406,8 +414,7 @@ void CChainState::MaybeUpdateMempoolForReorg(
     LimitMempoolSize(
         *m_mempool,
         this->CoinsTip(),
-        gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000,
-        std::chrono::hours{gArgs.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY)});
+        gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
 }
 
 /**
@@ -610,6 +617,12 @@ private:
     // only invoke this on transactions that have otherwise passed policy checks.
     bool PolicyScriptChecks(const ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Run the policy script checks of all transactions of a package on the script
+    // check threads. Returns the number of leading transactions that passed them,
+    // which is the package size if all did. The first failing transaction still
+    // needs PolicyScriptChecks() to fill in the reason.
+    size_t ParallelPackageScriptChecks(std::vector<Workspace>& workspaces) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Re-run the script checks, using consensus flags, and try to cache the
     // result in the scriptcache. This should be done after
     // PolicyScriptChecks(). This requires that all inputs either be in our
@@ -998,6 +1011,39 @@ bool MemPoolAccept::PolicyScriptChecks(const ATMPArgs& args, Workspace& ws)
     return true;
 }
 
+size_t MemPoolAccept::ParallelPackageScriptChecks(std::vector<Workspace>& workspaces)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+
+    // With pvChecks set, this only collects the checks (skipping cached
+    // transactions) and initializes the precomputed transaction data.
+    const auto add_checks = [&](Workspace& ws, std::vector<CScriptCheck>& checks) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+        TxValidationState state_dummy;
+        CheckInputScripts(*ws.m_ptx, state_dummy, m_view, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, ws.m_precomputed_txdata, &checks);
+    };
+
+    std::vector<CScriptCheck> checks;
+    for (Workspace& ws : workspaces) {
+        add_checks(ws, checks);
+    }
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(checks);
+    if (control.Wait()) return workspaces.size();
+
+    // Some check failed. Find the transaction it belongs to by checking them
+    // one at a time; the signatures of the ones before it are in the
+    // signature cache by now.
+    for (size_t i = 0; i < workspaces.size(); ++i) {
+        checks.clear();
+        add_checks(workspaces[i], checks);
+        control.Add(checks);
+        if (!control.Wait()) return i;
+    }
+    // Not reached unless the checks are inconsistent; leave them all to PolicyScriptChecks().
+    return 0;
+}
+
 bool MemPoolAccept::ConsensusScriptChecks(const ATMPArgs& args, Workspace& ws)
 {
     AssertLockHeld(cs_main);
@@ -1072,7 +1118,7 @@ bool MemPoolAccept::Finalize(const ATMPArgs& args, Workspace& ws)
     // in the package. LimitMempoolSize() should be called at the very end to make sure the mempool
     // is still within limits and package submission happens atomically.
     if (!args.m_package_submission && !bypass_limits) {
-        LimitMempoolSize(m_pool, m_active_chainstate.CoinsTip(), gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, std::chrono::hours{gArgs.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY)});
+        LimitMempoolSize(m_pool, m_active_chainstate.CoinsTip(), gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
         if (!m_pool.exists(GenTxid::Txid(hash)))
             return state.Invalid(TxValidationResult::TX_MEMPOOL_POLICY, "mempool full");
     }
@@ -1135,8 +1181,7 @@ bool MemPoolAccept::SubmitPackage(const ATMPArgs& args, std::vector<Workspace>&
     // It may or may not be the case that all the transactions made it into the mempool. Regardless,
     // make sure we haven't exceeded max mempool size.
     LimitMempoolSize(m_pool, m_active_chainstate.CoinsTip(),
-                     gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000,
-                     std::chrono::hours{gArgs.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY)});
+                     gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
 
     // Find the wtxids of the transactions that made it into the mempool. Allow partial submission,
     // but don't report success unless they all made it into the mempool.
@@ -1144,7 +1189,7 @@ bool MemPoolAccept::SubmitPackage(const ATMPArgs& args, std::vector<Workspace>&
         if (m_pool.exists(GenTxid::Wtxid(ws.m_ptx->GetWitnessHash()))) {
             results.emplace(ws.m_ptx->GetWitnessHash(),
                 MempoolAcceptResult::Success(std::move(ws.m_replaced_transactions), ws.m_vsize, ws.m_base_fees));
-            GetMainSignals().TransactionAddedToMempool(ws.m_ptx, m_pool.GetAndIncrementSequence());
+            GetMainSignals().TransactionAddedToMempool(ws.m_ptx, m_pool.GetAndIncrementSequence(MempoolDelta::Type::ADDED, ws.m_ptx->GetHash()));
         } else {
             all_submitted = false;
             ws.m_state.Invalid(TxValidationResult::TX_MEMPOOL_POLICY, "mempool full");
@@ -1178,7 +1223,7 @@ MempoolAcceptResult MemPoolAccept::AcceptSingleTransaction(const CTransactionRef
 
     if (!Finalize(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
 
-    GetMainSignals().TransactionAddedToMempool(ptx, m_pool.GetAndIncrementSequence());
+    GetMainSignals().TransactionAddedToMempool(ptx, m_pool.GetAndIncrementSequence(MempoolDelta::Type::ADDED, ptx->GetHash()));
     GetMainSignals().TransactionAddedToMempoolFee(ptx, ws.m_entry->GetFee());
 
     return MempoolAcceptResult::Success(std::move(ws.m_replaced_transactions), ws.m_vsize, ws.m_base_fees);
@@ -1224,8 +1269,13 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(const std::
         return PackageMempoolAcceptResult(package_state, std::move(results));
     }
 
-    for (Workspace& ws : workspaces) {
-        if (!PolicyScriptChecks(args, ws)) {
+    // Transactions that passed the parallel script checks are not checked
+    // again; only the first one that failed them is, for the failure reason.
+    const size_t num_scripts_checked{g_parallel_script_checks && workspaces.size() > 1 ? ParallelPackageScriptChecks(workspaces) : 0};
+
+    for (size_t i = 0; i < workspaces.size(); ++i) {
+        Workspace& ws = workspaces[i];
+        if (i >= num_scripts_checked && !PolicyScriptChecks(args, ws)) {
             // Exit early to avoid doing pointless work. Update the failed tx result; the rest are unfinished.
             package_state.Invalid(PackageValidationResult::PCKG_TX, "transaction failed");
             results.emplace(ws.m_ptx->GetWitnessHash(), MempoolAcceptResult::Failure(ws.m_state));
@@ -1601,6 +1651,10 @@ bool CScriptCheck::operator()() {
 static CuckooCache::cache<uint256, SignatureCacheHasher> g_scriptExecutionCache;
 static CSHA256 g_scriptExecutionCacheHasher;
 
+/** Minimum number of inputs for CheckInputScripts() to run the script checks of
+ * a lone transaction on the script check threads rather than inline. */
+static constexpr size_t MIN_PARALLEL_SCRIPT_CHECK_INPUTS{8};
+
 void InitScriptExecutionCache() {
     // Setup the salted hasher
     uint256 nonce = GetRandHash();
@@ -1625,7 +1679,8 @@ void InitScriptExecutionCache() {
  *
  * If pvChecks is not nullptr, script checks are pushed onto it instead of being performed inline. Any
  * script checks which are not necessary (eg due to script execution cache hits) are, obviously,
- * not pushed onto pvChecks/run.
+ * not pushed onto pvChecks/run. Otherwise, if parallel script checks are enabled and the transaction
+ * has at least MIN_PARALLEL_SCRIPT_CHECK_INPUTS inputs, the checks are run on the script check threads.
  *
  * Setting cacheSigStore/cacheFullScriptStore to false will remove elements from the corresponding cache
  * which are matched. This is useful for checking blocks where we will likely never need the cache
@@ -1674,6 +1729,22 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
     }
     assert(txdata.m_spent_outputs.size() == tx.vin.size());
 
+    if (!pvChecks && g_parallel_script_checks && tx.vin.size() >= MIN_PARALLEL_SCRIPT_CHECK_INPUTS) {
+        std::vector<CScriptCheck> checks;
+        checks.reserve(tx.vin.size());
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            checks.emplace_back(txdata.m_spent_outputs[i], tx, i, flags, cacheSigStore, &txdata);
+        }
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        control.Add(checks);
+        if (control.Wait()) {
+            if (cacheFullScriptStore) g_scriptExecutionCache.insert(hashCacheEntry);
+            return true;
+        }
+        // Fall through to the serial checks, which determine the failing input
+        // and the exact reason.
+    }
+
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
 
         // We very carefully only pass in things to CScriptCheck which
@@ -1826,8 +1897,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
 void StartScriptCheckWorkerThreads(int threads_num)
 {
     scriptcheckqueue.StartWorkerThreads(threads_num);
@@ -4518,7 +4587,218 @@ bool CChainState::ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
     return ret;
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_INDEX = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+
+/** Number of transactions LoadMempool() prevalidates at once before accepting them. */
+static constexpr size_t LOAD_MEMPOOL_BATCH_SIZE{1000};
+
+/**
+ * Order the transactions of a version 1 mempool.dat or the mempool journal so
+ * that in-file parents come before their children, keeping the file order
+ * wherever possible. Dumps are written in this order already, but this makes
+ * loading not depend on it.
+ */
+static std::vector<size_t> SortMempoolFileEntries(const std::vector<MempoolFileEntry>& entries,
+                                                  const std::unordered_map<uint256, size_t, SaltedTxidHasher>& index)
+{
+    std::vector<std::vector<size_t>> children(entries.size());
+    std::vector<size_t> num_parents(entries.size(), 0);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        std::set<size_t> parents;
+        for (const CTxIn& txin : entries[i].tx->vin) {
+            const auto it = index.find(txin.prevout.hash);
+            if (it != index.end() && it->second != i && parents.insert(it->second).second) {
+                children[it->second].push_back(i);
+                ++num_parents[i];
+            }
+        }
+    }
+    // Kahn's algorithm, always picking the earliest ready entry in the file.
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (num_parents[i] == 0) ready.push(i);
+    }
+    std::vector<size_t> order;
+    order.reserve(entries.size());
+    while (!ready.empty()) {
+        const size_t i = ready.top();
+        ready.pop();
+        order.push_back(i);
+        for (size_t child : children[i]) {
+            if (--num_parents[child] == 0) ready.push(child);
+        }
+    }
+    return order;
+}
+
+/**
+ * Verify the input scripts of a batch of transactions on the script check
+ * threads. This only fills the signature cache, so that accepting the
+ * transactions to the mempool afterwards (which checks everything again,
+ * serially and under cs_main) does not have to verify signatures itself.
+ * Inputs spending outputs of other transactions in the file are resolved from
+ * the file; transactions with inputs that cannot be resolved are skipped.
+ */
+static void PrevalidateMempoolFileEntries(const std::vector<MempoolFileEntry>& entries,
+                                          const std::unordered_map<uint256, size_t, SaltedTxidHasher>& index,
+                                          std::vector<size_t>::const_iterator begin,
+                                          std::vector<size_t>::const_iterator end,
+                                          CCoinsViewCache& coins_tip) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    // Referenced by the checks, so must not be reallocated.
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(end - begin);
+    std::vector<CScriptCheck> checks;
+    for (auto it = begin; it != end; ++it) {
+        const CTransaction& tx = *entries[*it].tx;
+        std::vector<CTxOut> spent_outputs;
+        spent_outputs.reserve(tx.vin.size());
+        for (const CTxIn& txin : tx.vin) {
+            const auto parent = index.find(txin.prevout.hash);
+            if (parent != index.end()) {
+                const CTransaction& parent_tx = *entries[parent->second].tx;
+                if (txin.prevout.n >= parent_tx.vout.size()) break;
+                spent_outputs.push_back(parent_tx.vout[txin.prevout.n]);
+            } else {
+                const Coin& coin = coins_tip.AccessCoin(txin.prevout);
+                if (coin.IsSpent()) break;
+                spent_outputs.push_back(coin.out);
+            }
+        }
+        if (tx.IsCoinBase() || spent_outputs.size() != tx.vin.size()) continue;
+        txdata.emplace_back();
+        txdata.back().Init(tx, std::move(spent_outputs));
+        for (unsigned int i = 0; i < tx.vin.size(); ++i) {
+            checks.emplace_back(txdata.back().m_spent_outputs[i], tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, /*cacheIn=*/true, &txdata.back());
+        }
+    }
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(checks);
+    // Failures are reported (per transaction) by AcceptToMemoryPool.
+    control.Wait();
+}
+
+bool LoadMempoolEntries(CTxMemPool& pool, CChainState& active_chainstate, std::vector<MempoolFileEntry> entries,
+                        const std::map<uint256, CAmount>& deltas, const std::set<uint256>& unbroadcast_txids,
+                        int64_t expired, int64_t already_there)
+{
+    int64_t nExpiryTimeout = gArgs.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    int64_t count = 0;
+    int64_t failed = 0;
+    int64_t unbroadcast = 0;
+    int64_t nNow = GetTime();
+
+    // Accept the transactions that have not expired in dependency order, so
+    // that their scripts can be checked in parallel.
+    const auto expired_begin = std::stable_partition(entries.begin(), entries.end(), [&](const MempoolFileEntry& entry) {
+        return entry.time > nNow - nExpiryTimeout;
+    });
+    for (auto it = expired_begin; it != entries.end(); ++it) {
+        if (it->fee_delta) {
+            pool.PrioritiseTransaction(it->tx->GetHash(), it->fee_delta);
+        }
+        ++expired;
+    }
+    entries.erase(expired_begin, entries.end());
+
+    std::unordered_map<uint256, size_t, SaltedTxidHasher> index;
+    index.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        index.emplace(entries[i].tx->GetHash(), i);
+    }
+
+    // A transaction never spends one of the same or a later level, so
+    // levelled entries need no sorting, and each level only depends on
+    // transactions already accepted.
+    const bool levelled{std::all_of(entries.begin(), entries.end(), [](const MempoolFileEntry& entry) { return entry.level.has_value(); }) &&
+                        std::is_sorted(entries.begin(), entries.end(), [](const MempoolFileEntry& a, const MempoolFileEntry& b) { return *a.level < *b.level; })};
+    std::vector<size_t> order;
+    if (levelled) {
+        order.resize(entries.size());
+        std::iota(order.begin(), order.end(), 0);
+    } else {
+        order = SortMempoolFileEntries(entries, index);
+    }
+
+    int last_progress{0};
+    for (auto batch_begin = order.cbegin(); batch_begin != order.cend();) {
+        auto batch_end = batch_begin + std::min<size_t>(LOAD_MEMPOOL_BATCH_SIZE, order.cend() - batch_begin);
+        if (levelled) {
+            batch_end = std::find_if(batch_begin, batch_end, [&](size_t i) { return *entries[i].level != *entries[*batch_begin].level; });
+        }
+        if (g_parallel_script_checks) {
+            LOCK(cs_main);
+            PrevalidateMempoolFileEntries(entries, index, batch_begin, batch_end, active_chainstate.CoinsTip());
+        }
+        for (auto it = batch_begin; it != batch_end; ++it) {
+            const MempoolFileEntry& entry = entries[*it];
+            CAmount amountdelta = entry.fee_delta;
+            if (amountdelta) {
+                pool.PrioritiseTransaction(entry.tx->GetHash(), amountdelta);
+            }
+            LOCK(cs_main);
+            const auto& accepted = AcceptToMemoryPool(active_chainstate, entry.tx, entry.time, /*bypass_limits=*/false, /*test_accept=*/false);
+            if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+                ++count;
+            } else {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (pool.exists(GenTxid::Txid(entry.tx->GetHash()))) {
+                    ++already_there;
+                } else {
+                    ++failed;
+                }
+            }
+            if (ShutdownRequested())
+                return false;
+        }
+        batch_begin = batch_end;
+        const int progress = (batch_begin - order.cbegin()) * 100 / order.size();
+        if (progress / 10 > last_progress / 10) {
+            LogPrintf("Loading mempool transactions from disk... %d%%\n", progress);
+            last_progress = progress;
+        }
+    }
+
+    for (const auto& i : deltas) {
+        pool.PrioritiseTransaction(i.first, i.second);
+    }
+
+    unbroadcast = unbroadcast_txids.size();
+    for (const auto& txid : unbroadcast_txids) {
+        // Ensure transactions were accepted to mempool then add to
+        // unbroadcast set.
+        if (pool.get(txid) != nullptr) pool.AddUnbroadcastTx(txid);
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i waiting for initial broadcast\n", count, failed, expired, already_there, unbroadcast);
+    return true;
+}
+
+namespace {
+/**
+ * Index entry of a transaction in a version 2 mempool.dat. The index has a
+ * fixed size per entry, so that it can be read (or mapped) as a whole and
+ * entries can be skipped without deserializing their transaction.
+ */
+struct MempoolFileIndexEntry {
+    uint256 txid;
+    int64_t time;
+    int64_t fee_delta;
+    //! Position of the serialized transaction, from the start of the file
+    uint64_t offset;
+    uint64_t size;
+
+    SERIALIZE_METHODS(MempoolFileIndexEntry, obj) { READWRITE(obj.txid, obj.time, obj.fee_delta, obj.offset, obj.size); }
+};
+} // namespace
+
+/** Size of a serialized MempoolFileIndexEntry. */
+static const uint64_t MEMPOOL_FILE_INDEX_ENTRY_SIZE{GetSerializeSize(MempoolFileIndexEntry{}, CLIENT_VERSION)};
 
 bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function)
 {
@@ -4530,78 +4810,97 @@ bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mocka
         return false;
     }
 
-    int64_t count = 0;
+    std::vector<MempoolFileEntry> entries;
+    std::map<uint256, CAmount> mapDeltas;
+    std::set<uint256> unbroadcast_txids;
     int64_t expired = 0;
-    int64_t failed = 0;
     int64_t already_there = 0;
-    int64_t unbroadcast = 0;
     int64_t nNow = GetTime();
-
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
-            return false;
-        }
-        uint64_t num;
-        file >> num;
-        while (num) {
-            --num;
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+        if (version == MEMPOOL_DUMP_VERSION_NO_INDEX) {
+            uint64_t num;
+            file >> num;
+            while (num) {
+                --num;
+                MempoolFileEntry entry;
+                file >> entry.tx;
+                file >> entry.time;
+                file >> entry.fee_delta;
+                entries.push_back(std::move(entry));
+                if (ShutdownRequested())
+                    return false;
             }
-            if (nTime > nNow - nExpiryTimeout) {
-                LOCK(cs_main);
-                const auto& accepted = AcceptToMemoryPool(active_chainstate, tx, nTime, /*bypass_limits=*/false, /*test_accept=*/false);
-                if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(GenTxid::Txid(tx->GetHash()))) {
-                        ++already_there;
-                    } else {
-                        ++failed;
+        } else if (version == MEMPOOL_DUMP_VERSION) {
+            // Transactions are grouped by their depth in the dumped mempool,
+            // parents first, so no transaction depends on a later one.
+            uint64_t num_levels;
+            file >> num_levels;
+            std::vector<uint64_t> level_sizes;
+            uint64_t num{0};
+            for (uint64_t i = 0; i < num_levels; ++i) {
+                uint64_t level_size;
+                file >> level_size;
+                level_sizes.push_back(level_size);
+                num += level_size;
+            }
+            // Only transactions that have not expired and are not in the
+            // mempool already are deserialized.
+            std::vector<std::pair<MempoolFileIndexEntry, uint64_t>> index;
+            uint64_t data_end{8 + 8 + 8 * num_levels + MEMPOOL_FILE_INDEX_ENTRY_SIZE * num};
+            uint64_t level{0};
+            while (num) {
+                --num;
+                while (level_sizes[level] == 0) ++level;
+                --level_sizes[level];
+                MempoolFileIndexEntry entry;
+                file >> entry;
+                data_end = std::max(data_end, entry.offset + entry.size);
+                if (entry.time <= nNow - nExpiryTimeout) {
+                    if (entry.fee_delta) {
+                        pool.PrioritiseTransaction(entry.txid, entry.fee_delta);
+                    }
+                    ++expired;
+                } else if (pool.exists(GenTxid::Txid(entry.txid))) {
+                    if (entry.fee_delta) {
+                        pool.PrioritiseTransaction(entry.txid, entry.fee_delta);
                     }
+                    ++already_there;
+                } else {
+                    index.emplace_back(entry, level);
                 }
-            } else {
-                ++expired;
             }
-            if (ShutdownRequested())
-                return false;
+            for (const auto& [index_entry, index_level] : index) {
+                if (uint64_t(std::ftell(file.Get())) != index_entry.offset && std::fseek(file.Get(), index_entry.offset, SEEK_SET) != 0) {
+                    throw std::ios_base::failure("seek failed");
+                }
+                MempoolFileEntry entry;
+                file >> entry.tx;
+                if (entry.tx->GetHash() != index_entry.txid) {
+                    throw std::ios_base::failure("transaction does not match its index entry");
+                }
+                entry.time = index_entry.time;
+                entry.fee_delta = index_entry.fee_delta;
+                entry.level = index_level;
+                entries.push_back(std::move(entry));
+                if (ShutdownRequested())
+                    return false;
+            }
+            if (std::fseek(file.Get(), data_end, SEEK_SET) != 0) {
+                throw std::ios_base::failure("seek failed");
+            }
+        } else {
+            return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
-
-        for (const auto& i : mapDeltas) {
-            pool.PrioritiseTransaction(i.first, i.second);
-        }
-
-        std::set<uint256> unbroadcast_txids;
         file >> unbroadcast_txids;
-        unbroadcast = unbroadcast_txids.size();
-        for (const auto& txid : unbroadcast_txids) {
-            // Ensure transactions were accepted to mempool then add to
-            // unbroadcast set.
-            if (pool.get(txid) != nullptr) pool.AddUnbroadcastTx(txid);
-        }
     } catch (const std::exception& e) {
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i waiting for initial broadcast\n", count, failed, expired, already_there, unbroadcast);
-    return true;
+    return LoadMempoolEntries(pool, active_chainstate, std::move(entries), mapDeltas, unbroadcast_txids, expired, already_there);
 }
 
 bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function, bool skip_file_commit)
@@ -4634,15 +4933,53 @@ bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function, bool s
 
         CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
 
-        uint64_t version = MEMPOOL_DUMP_VERSION;
-        file << version;
+        if (gArgs.GetBoolArg("-persistmempoolv1", DEFAULT_PERSIST_V1_DAT)) {
+            uint64_t version = MEMPOOL_DUMP_VERSION_NO_INDEX;
+            file << version;
 
-        file << (uint64_t)vinfo.size();
-        for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << int64_t{count_seconds(i.m_time)};
-            file << int64_t{i.nFeeDelta};
-            mapDeltas.erase(i.tx->GetHash());
+            file << (uint64_t)vinfo.size();
+            for (const auto& i : vinfo) {
+                file << *(i.tx);
+                file << int64_t{count_seconds(i.m_time)};
+                file << int64_t{i.nFeeDelta};
+                mapDeltas.erase(i.tx->GetHash());
+            }
+        } else {
+            // Group the transactions by their depth among the dumped
+            // transactions. infoAll() returns parents before their children.
+            std::unordered_map<uint256, uint64_t, SaltedTxidHasher> depths;
+            std::vector<std::vector<size_t>> levels;
+            for (size_t i = 0; i < vinfo.size(); ++i) {
+                uint64_t depth{0};
+                for (const CTxIn& txin : vinfo[i].tx->vin) {
+                    const auto it = depths.find(txin.prevout.hash);
+                    if (it != depths.end()) depth = std::max(depth, it->second + 1);
+                }
+                depths.emplace(vinfo[i].tx->GetHash(), depth);
+                if (depth >= levels.size()) levels.resize(depth + 1);
+                levels[depth].push_back(i);
+            }
+
+            uint64_t version = MEMPOOL_DUMP_VERSION;
+            file << version;
+            file << uint64_t{levels.size()};
+            for (const auto& level : levels) {
+                file << uint64_t{level.size()};
+            }
+            uint64_t offset{8 + 8 + 8 * levels.size() + MEMPOOL_FILE_INDEX_ENTRY_SIZE * vinfo.size()};
+            for (const auto& level : levels) {
+                for (size_t i : level) {
+                    const uint64_t size{GetSerializeSize(*vinfo[i].tx, CLIENT_VERSION)};
+                    file << MempoolFileIndexEntry{vinfo[i].tx->GetHash(), count_seconds(vinfo[i].m_time), vinfo[i].nFeeDelta, offset, size};
+                    offset += size;
+                    mapDeltas.erase(vinfo[i].tx->GetHash());
+                }
+            }
+            for (const auto& level : levels) {
+                for (size_t i : level) {
+                    file << *vinfo[i].tx;
+                }
+            }
         }
 
         file << mapDeltas;
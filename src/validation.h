@@ -28,6 +28,7 @@
 #include <util/translation.h>
 
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <optional>
@@ -74,6 +75,8 @@ static_assert(DEFAULT_DESCENDANT_SIZE_LIMIT >= MAX_PACKAGE_SIZE);
 
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
+/** How often the scheduler removes expired transactions from the mempool */
+static constexpr std::chrono::minutes MEMPOOL_EXPIRY_INTERVAL{1};
 /** Maximum number of dedicated script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 15;
 /** -par default (number of script-checking threads, 0 = auto) */
@@ -85,6 +88,8 @@ static constexpr bool DEFAULT_COINSTATSINDEX{false};
 static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -persistmempoolv1 */
+static const bool DEFAULT_PERSIST_V1_DAT = false;
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of ActiveChain().Tip() will not be pruned. */
@@ -1007,12 +1012,43 @@ public:
 
 using FopenFn = std::function<FILE*(const fs::path&, const char*)>;
 
+/**
+ * Remove the transactions that entered the mempool more than age ago, along
+ * with their descendants. Run from the scheduler every MEMPOOL_EXPIRY_INTERVAL
+ * rather than on every transaction accepted to the mempool; when nothing
+ * expired it only looks at the oldest entry.
+ */
+void ExpireMempool(CTxMemPool& pool, std::chrono::seconds age) LOCKS_EXCLUDED(::cs_main);
+
 /** Dump the mempool to disk. */
 bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function = fsbridge::fopen, bool skip_file_commit = false);
 
 /** Load the mempool from disk. */
 bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function = fsbridge::fopen);
 
+/** A transaction persisted across restarts, with the time it entered the mempool and its fee delta. */
+struct MempoolFileEntry {
+    CTransactionRef tx;
+    int64_t time;
+    int64_t fee_delta;
+    //! Depth among the persisted transactions, when known from the file
+    std::optional<uint64_t> level;
+};
+
+/**
+ * Add persisted transactions to the mempool, in dependency order, and apply
+ * the fee deltas of transactions not among them and the unbroadcast set.
+ * Expired transactions are only prioritised. Entries that all have a level,
+ * listed by increasing level, are accepted in that order a level at a time;
+ * others are sorted by their dependencies first. Shared by LoadMempool() and the
+ * mempool journal. Transactions the caller already skipped as expired or as
+ * being in the mempool are passed in through expired and already_there, to
+ * be included in the log.
+ */
+bool LoadMempoolEntries(CTxMemPool& pool, CChainState& active_chainstate, std::vector<MempoolFileEntry> entries,
+                        const std::map<uint256, CAmount>& deltas, const std::set<uint256>& unbroadcast_txids,
+                        int64_t expired = 0, int64_t already_there = 0);
+
 /**
  * Return the expected assumeutxo value for a given height, if one exists.
  *
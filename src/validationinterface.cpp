@@ -226,6 +226,13 @@ void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef& tx, MemP
                           tx->GetWitnessHash().ToString());
 }
 
+void CMainSignals::MempoolTransactionsRemovedForBlock(const std::vector<CTransactionRef>& txs_removed_for_block, uint64_t mempool_sequence) {
+    auto event = [txs_removed_for_block, mempool_sequence, this] {
+        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.MempoolTransactionsRemovedForBlock(txs_removed_for_block, mempool_sequence); });
+    };
+    ENQUEUE_AND_LOG_EVENT(event, "%s: %d transactions", __func__, txs_removed_for_block.size());
+}
+
 void CMainSignals::TransactionReplacedInMempool(const CTransactionRef& tx_replaced, const CAmount fee_replaced, const CTransactionRef& tx_replacement, const CAmount fee_replacement) {
     auto event = [tx_replaced, fee_replaced, tx_replacement, fee_replacement, this] {
         m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.TransactionReplacedInMempool(tx_replaced, fee_replaced, tx_replacement, fee_replacement); });
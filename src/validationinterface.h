@@ -11,6 +11,7 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 extern RecursiveMutex cs_main;
 class BlockValidationState;
@@ -143,6 +144,15 @@ protected:
      * Called on a background thread.
      */
     virtual void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) {}
+    /**
+     * Notifies listeners of the transactions removed from the mempool for
+     * being included in a block, which TransactionRemovedFromMempool does not
+     * announce. This is called before BlockConnected for the block.
+     * mempool_sequence is the mempool sequence number before the removals.
+     *
+     * Called on a background thread.
+     */
+    virtual void MempoolTransactionsRemovedForBlock(const std::vector<CTransactionRef>& txs_removed_for_block, uint64_t mempool_sequence) {}
     /**
      * Notifies listeners of a block being connected.
      * Provides a vector of transactions evicted from the mempool as a result.
@@ -218,6 +228,7 @@ public:
     void TransactionAddedToMempool(const CTransactionRef&, uint64_t mempool_sequence);
     void TransactionAddedToMempoolFee(const CTransactionRef&, const CAmount fee);
     void TransactionRemovedFromMempool(const CTransactionRef&, MemPoolRemovalReason, uint64_t mempool_sequence);
+    void MempoolTransactionsRemovedForBlock(const std::vector<CTransactionRef>&, uint64_t mempool_sequence);
     void TransactionReplacedInMempool(const CTransactionRef&, const CAmount, const CTransactionRef&, const CAmount);
     void BlockConnected(const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex);
     void HeaderAddedToChain(const CBlockIndex *);
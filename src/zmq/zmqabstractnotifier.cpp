@@ -77,3 +77,13 @@ bool CZMQAbstractNotifier::NotifyChainHeaderAdded(const CBlockIndex *)
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyMempoolHistogram(const CTxMemPool &)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockTemplateChanged(const node::CBlockTemplate *, const node::CBlockTemplate &)
+{
+    return true;
+}
@@ -11,9 +11,13 @@
 
 class CBlockIndex;
 class CTransaction;
+class CTxMemPool;
 class CZMQAbstractNotifier;
 typedef int64_t CAmount;
 enum class MemPoolRemovalReason;
+namespace node {
+struct CBlockTemplate;
+} // namespace node
 
 using CZMQNotifierFactory = std::unique_ptr<CZMQAbstractNotifier> (*)();
 
@@ -71,6 +75,10 @@ public:
     virtual bool NotifyChainBlockConnected(const CBlockIndex *pindex);
     // Notifies of a header connection to the chian.
     virtual bool NotifyChainHeaderAdded(const CBlockIndex *pindex);
+    // Notifies of the mempool fee histogram, periodically.
+    virtual bool NotifyMempoolHistogram(const CTxMemPool &pool);
+    // Notifies of a new template for the next block, after the mempool or the tip changed.
+    virtual bool NotifyBlockTemplateChanged(const node::CBlockTemplate *old_template, const node::CBlockTemplate &new_template);
 protected:
     void *psocket;
     std::string type;
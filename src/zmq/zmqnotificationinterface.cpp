@@ -45,6 +45,9 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubchaintipchanged"] = CZMQAbstractNotifier::Create<CZMQPublishChainTipChangedNotifier>;
     factories["pubchainconnected"] = CZMQAbstractNotifier::Create<CZMQPublishChainConnectedNotifier>;
     factories["pubchainheaderadded"] = CZMQAbstractNotifier::Create<CZMQPublishChainHeaderAddedNotifier>;
+    factories["pubmempoolhistogram"] = CZMQAbstractNotifier::Create<CZMQPublishMempoolHistogramNotifier>;
+    factories["pubblocktemplatechanged"] = CZMQAbstractNotifier::Create<CZMQPublishBlockTemplateChangedNotifier>;
+    factories["pubprojectedblock"] = CZMQAbstractNotifier::Create<CZMQPublishProjectedBlockNotifier>;
 
     std::list<std::unique_ptr<CZMQAbstractNotifier>> notifiers;
     for (const auto& entry : factories)
@@ -244,4 +247,18 @@ void CZMQNotificationInterface::HeaderAddedToChain(const CBlockIndex *pindexHead
     });
 }
 
+void CZMQNotificationInterface::NotifyMempoolHistogram(const CTxMemPool& pool)
+{
+    TryForEachAndRemoveFailed(notifiers, [&pool](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyMempoolHistogram(pool);
+    });
+}
+
+void CZMQNotificationInterface::NotifyBlockTemplateChanged(const node::CBlockTemplate* old_template, const node::CBlockTemplate& new_template)
+{
+    TryForEachAndRemoveFailed(notifiers, [old_template, &new_template](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockTemplateChanged(old_template, new_template);
+    });
+}
+
 CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
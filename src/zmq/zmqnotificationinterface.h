@@ -6,11 +6,19 @@
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
 #include <validationinterface.h>
+#include <chrono>
 #include <list>
 #include <memory>
 
 class CBlockIndex;
+class CTxMemPool;
 class CZMQAbstractNotifier;
+namespace node {
+struct CBlockTemplate;
+} // namespace node
+
+/** How often the mempool fee histogram is published, if it changed. */
+static constexpr std::chrono::seconds ZMQ_MEMPOOL_HISTOGRAM_INTERVAL{1};
 
 class CZMQNotificationInterface final : public CValidationInterface
 {
@@ -21,6 +29,12 @@ public:
 
     static CZMQNotificationInterface* Create();
 
+    /** Publish the mempool fee histogram. Called from the scheduler every ZMQ_MEMPOOL_HISTOGRAM_INTERVAL. */
+    void NotifyMempoolHistogram(const CTxMemPool& pool);
+
+    /** Publish a new template for the next block. Posted to the scheduler by the listener of node::BlockTemplateCache. */
+    void NotifyBlockTemplateChanged(const node::CBlockTemplate* old_template, const node::CBlockTemplate& new_template);
+
 protected:
     bool Initialize();
     void Shutdown();
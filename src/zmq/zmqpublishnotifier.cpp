@@ -6,16 +6,20 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <consensus/validation.h>
 #include <netbase.h>
 #include <node/blockstorage.h>
+#include <node/miner.h>
 #include <rpc/server.h>
 #include <streams.h>
+#include <txmempool.h>
 #include <util/system.h>
 #include <validation.h> // For cs_main
 #include <zmq/zmqutil.h>
 
 #include <zmq.h>
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstddef>
 #include <map>
@@ -40,6 +44,9 @@ static const char *MSG_MEMPOOLCONFIRMED = "mempoolconfirmed";
 static const char *MSG_CHAINTIPCHANGED = "chaintipchanged";
 static const char *MSG_CHAINCONNECTED = "chainconnected";
 static const char *MSG_CHAINHEADERADDED = "chainheaderadded";
+static const char *MSG_MEMPOOLHISTOGRAM = "mempoolhistogram";
+static const char *MSG_BLOCKTEMPLATECHANGED = "blocktemplatechanged";
+static const char *MSG_PROJECTEDBLOCK = "projectedblock";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -135,6 +142,17 @@ static zmq_message_part hashToZMQMessagePart(const uint256 hash) {
     return part_hash;
 }
 
+// converts a list of hashes into a single zmq_message_part, 32 bytes each
+static zmq_message_part hashesToZMQMessagePart(const std::vector<uint256>& hashes) {
+    zmq_message_part part_hashes;
+    part_hashes.reserve(hashes.size() * 32);
+    for (const uint256& hash : hashes) {
+        for (int i = 31; i >= 0; i--)
+            part_hashes.push_back((std::byte)hash.begin()[i]);
+    }
+    return part_hashes;
+}
+
 // converts a CTransaction into a zmq_message_part (by serializing it)
 static zmq_message_part transactionToZMQMessagePart(const CTransaction& transaction) {
     zmq_message_part part_transaction;
@@ -467,6 +485,74 @@ bool CZMQPublishMempoolConfirmedNotifier::NotifyMempoolTransactionConfirmed(cons
     return SendZmqMessage(MSG_MEMPOOLCONFIRMED, payload);
 }
 
+bool CZMQPublishMempoolHistogramNotifier::NotifyMempoolHistogram(const CTxMemPool &pool)
+{
+    const FeeHistogram histogram{WITH_LOCK(pool.cs, return pool.GetFeeHistogram())};
+    CDataStream ss_histogram(SER_NETWORK, PROTOCOL_VERSION);
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        ss_histogram << int64_t{MEMPOOL_FEE_HISTOGRAM_BOUNDS[i]} << histogram[i].count << histogram[i].vsize << int64_t{histogram[i].fees};
+    }
+    zmq_message_part part_histogram(ss_histogram.begin(), ss_histogram.end());
+    if (part_histogram == m_last_histogram) return true;
+    LogPrint(BCLog::ZMQ, "zmq: Publish mempoolhistogram\n");
+
+    std::vector<zmq_message_part> payload = {};
+    payload.push_back(part_histogram);
+    m_last_histogram = std::move(part_histogram);
+
+    return SendZmqMessage(MSG_MEMPOOLHISTOGRAM, payload);
+}
+
+bool CZMQPublishBlockTemplateChangedNotifier::NotifyBlockTemplateChanged(const node::CBlockTemplate *old_template, const node::CBlockTemplate &new_template)
+{
+    // The first entry of vTxFees is the negated sum of all the others.
+    const CAmount fees{-new_template.vTxFees.front()};
+    const CAmount fee_delta{old_template ? fees + old_template->vTxFees.front() : fees};
+    LogPrint(BCLog::ZMQ, "zmq: Publish blocktemplatechanged on %s, fees %d (%+d)\n", new_template.block.hashPrevBlock.GetHex(), fees, fee_delta);
+
+    std::vector<zmq_message_part> payload = {};
+    payload.push_back(hashToZMQMessagePart(new_template.block.hashPrevBlock));
+    payload.push_back(int32ToZMQMessagePart(int32_t(new_template.block.vtx.size() - 1)));
+    payload.push_back(int64ToZMQMessagePart(fees));
+    payload.push_back(int64ToZMQMessagePart(fee_delta));
+
+    return SendZmqMessage(MSG_BLOCKTEMPLATECHANGED, payload);
+}
+
+// returns the sorted txids of the transactions of a block template, without the coinbase
+static std::vector<uint256> GetTemplateTxids(const node::CBlockTemplate *block_template)
+{
+    std::vector<uint256> txids;
+    if (!block_template) return txids;
+    txids.reserve(block_template->block.vtx.size() - 1);
+    for (auto it = block_template->block.vtx.begin() + 1; it != block_template->block.vtx.end(); ++it) {
+        txids.push_back((*it)->GetHash());
+    }
+    std::sort(txids.begin(), txids.end());
+    return txids;
+}
+
+bool CZMQPublishProjectedBlockNotifier::NotifyBlockTemplateChanged(const node::CBlockTemplate *old_template, const node::CBlockTemplate &new_template)
+{
+    const std::vector<uint256> old_txids{GetTemplateTxids(old_template)};
+    const std::vector<uint256> new_txids{GetTemplateTxids(&new_template)};
+    std::vector<uint256> entered;
+    std::vector<uint256> left;
+    std::set_difference(new_txids.begin(), new_txids.end(), old_txids.begin(), old_txids.end(), std::back_inserter(entered));
+    std::set_difference(old_txids.begin(), old_txids.end(), new_txids.begin(), new_txids.end(), std::back_inserter(left));
+    if (old_template && old_template->block.hashPrevBlock == new_template.block.hashPrevBlock && entered.empty() && left.empty()) return true;
+    LogPrint(BCLog::ZMQ, "zmq: Publish projectedblock on %s, %d entered, %d left\n", new_template.block.hashPrevBlock.GetHex(), entered.size(), left.size());
+
+    std::vector<zmq_message_part> payload = {};
+    payload.push_back(hashToZMQMessagePart(new_template.block.hashPrevBlock));
+    payload.push_back(int64ToZMQMessagePart(-new_template.vTxFees.front()));
+    payload.push_back(int64ToZMQMessagePart(GetBlockWeight(new_template.block)));
+    payload.push_back(hashesToZMQMessagePart(entered));
+    payload.push_back(hashesToZMQMessagePart(left));
+
+    return SendZmqMessage(MSG_PROJECTEDBLOCK, payload);
+}
+
 bool CZMQPublishChainTipChangedNotifier::NotifyChainTipChanged(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
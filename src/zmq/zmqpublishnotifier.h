@@ -107,6 +107,27 @@ public:
     bool NotifyChainHeaderAdded(const CBlockIndex *pindexHeader) override;
 };
 
+class CZMQPublishMempoolHistogramNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    zmq_message_part m_last_histogram; //!< last published histogram, to skip unchanged ones
+
+public:
+    bool NotifyMempoolHistogram(const CTxMemPool &pool) override;
+};
+
+class CZMQPublishBlockTemplateChangedNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockTemplateChanged(const node::CBlockTemplate *old_template, const node::CBlockTemplate &new_template) override;
+};
+
+class CZMQPublishProjectedBlockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockTemplateChanged(const node::CBlockTemplate *old_template, const node::CBlockTemplate &new_template) override;
+};
+
 class CZMQPublishSequenceNotifier : public CZMQAbstractPublishNotifier
 {
 public:
@@ -88,6 +88,11 @@ class ConfArgsTest(BitcoinTestFramework):
             expected_msg='Error: No proxy server specified. Use -proxy=<ip> or -proxy=<ip:port>.',
             extra_args=['-proxy'],
         )
+        for msghand_threads in [0, 17]:
+            self.nodes[0].assert_start_raises_init_error(
+                expected_msg=f'Error: Invalid -msghandthreads value {msghand_threads} (must be between 1 and 16)',
+                extra_args=[f'-msghandthreads={msghand_threads}'],
+            )
 
     def test_log_buffer(self):
         self.stop_node(0)
@@ -16,6 +16,7 @@ import urllib.parse
 from test_framework.messages import (
     BLOCK_HEADER_SIZE,
     COIN,
+    CTransaction,
 )
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import (
@@ -83,6 +84,26 @@ class RESTTest (BitcoinTestFramework):
         elif ret_type == RetType.JSON:
             return json.loads(resp.read().decode('utf-8'), parse_float=Decimal)
 
+    def get_mempool_since(self, session, sequence):
+        """Return the session and next sequence, whether the whole mempool was returned, and the added and removed txids."""
+        response = BytesIO(self.test_rest_request(f"/mempool/since/{session}/{sequence}", req_type=ReqType.BIN, ret_type=RetType.BYTES))
+        next_session, next_sequence, full = unpack("<QQ?", response.read(17))
+        added = []
+        removed = []
+        while True:
+            kind = response.read(1)
+            if not kind:
+                break
+            if kind == b'\x00':
+                tx = CTransaction()
+                tx.deserialize(response)
+                tx.rehash()
+                added.append(tx.hash)
+            else:
+                assert_equal(kind, b'\x01')
+                removed.append(response.read(32)[::-1].hex())
+        return next_session, next_sequence, full, added, removed
+
     def run_test(self):
         self.url = urllib.parse.urlparse(self.nodes[0].url)
         self.wallet = MiniWallet(self.nodes[0])
@@ -321,9 +342,58 @@ class RESTTest (BitcoinTestFramework):
             assert_equal(json_obj[tx]['spentby'], txs[i + 1:i + 2])
             assert_equal(json_obj[tx]['depends'], txs[i - 1:i])
 
+        # The contents are streamed with chunked transfer encoding, and match the RPC
+        resp = self.test_rest_request("/mempool/contents", ret_type=RetType.OBJ)
+        assert_equal(resp.getheader('Transfer-Encoding'), 'chunked')
+        assert_equal(json.loads(resp.read().decode('utf-8'), parse_float=Decimal), self.nodes[0].getrawmempool(verbose=True))
+
+        # Check that the fee histogram accounts for them, like the RPC does
+        json_obj = self.test_rest_request("/mempool/feehistogram")
+        assert_equal(json_obj, self.nodes[0].getmempoolfeehistogram())
+        assert_equal(sum(bucket['count'] for bucket in json_obj), 3)
+        assert_equal(sum(bucket['vsize'] for bucket in json_obj), self.nodes[0].getmempoolinfo()['bytes'])
+
+        self.log.info("Test the /mempool/since URI")
+        # Session 0 returns the whole mempool
+        session, sequence, full, added, removed = self.get_mempool_since(0, 0)
+        assert_equal(sequence, self.nodes[0].getrawmempool(mempool_sequence=True)['mempool_sequence'])
+        assert full
+        assert_equal(sorted(added), sorted(txs))
+        assert_equal(removed, [])
+        assert_equal(self.get_mempool_since(session, sequence), (session, sequence, False, [], []))
+        # A sequence number that was not assigned yet returns the whole mempool too
+        assert_equal(self.get_mempool_since(session, sequence + 1)[2], True)
+        hex_response = self.test_rest_request(f"/mempool/since/{session}/{sequence}", req_type=ReqType.HEX, ret_type=RetType.BYTES)
+        assert_equal(bytes.fromhex(hex_response.decode('ascii').strip()), pack("<QQ?", session, sequence, False))
+        self.test_rest_request(f"/mempool/since/{sequence}", req_type=ReqType.BIN, status=400, ret_type=RetType.OBJ)
+        self.test_rest_request(f"/mempool/since/abc/{sequence}", req_type=ReqType.BIN, status=400, ret_type=RetType.OBJ)
+        self.test_rest_request(f"/mempool/since/{session}/abc", req_type=ReqType.BIN, status=400, ret_type=RetType.OBJ)
+        self.test_rest_request(f"/mempool/since/{session}/{sequence}", status=404, ret_type=RetType.OBJ)
+
+        # Sequence numbers start over after a restart. Those from before the
+        # restart return the whole mempool, even if they were assigned again.
+        self.restart_node(0)
+        self.connect_nodes(0, 1)
+        self.wait_until(lambda: self.nodes[0].getmempoolinfo()['loaded'])
+        old_session = session
+        sequence = self.nodes[0].getrawmempool(mempool_sequence=True)['mempool_sequence']
+        session, next_sequence, full, added, removed = self.get_mempool_since(old_session, sequence)
+        assert old_session != session
+        assert_equal(next_sequence, sequence)
+        assert full
+        assert_equal(sorted(added), sorted(txs))
+        assert_equal(self.get_mempool_since(session, sequence), (session, sequence, False, [], []))
+
         # Now mine the transactions
         newblockhash = self.generate(self.nodes[1], 1)
 
+        # Mining them removed them from the mempool
+        _, next_sequence, full, added, removed = self.get_mempool_since(session, sequence)
+        assert_equal(next_sequence, sequence + 3)
+        assert not full
+        assert_equal(added, [])
+        assert_equal(sorted(removed), sorted(txs))
+
         # Check if the 3 tx show up in the new block
         json_obj = self.test_rest_request(f"/block/{newblockhash[0]}")
         non_coinbase_txs = {tx['txid'] for tx in json_obj['tx']
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the ZMQ publisher blocktemplatechanged to notify about new templates
+for the next block"""
+import struct
+import zmq
+
+from test_framework.messages import COIN
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.wallet import MiniWallet
+from time import sleep
+from random import randint
+
+from test_framework.util_patched_zmq import ZMQSubscriber
+
+
+class ZMQTest (BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_py3_zmq()
+        self.skip_if_no_bitcoind_zmq()
+
+    def run_test(self):
+        import zmq
+        self.ctx = zmq.Context()
+        try:
+            self.test_block_template_changed()
+        finally:
+            # Destroy the ZMQ context.
+            self.log.debug("Destroying ZMQ context")
+            self.ctx.destroy(linger=None)
+
+    def receive_template(self, subscriber):
+        prev_hash, tx_count, fees, fee_delta = subscriber.receive_multi_payload()
+        return prev_hash.hex(), struct.unpack("<i", tx_count)[0], struct.unpack("<q", fees)[0], struct.unpack("<q", fee_delta)[0]
+
+    def test_block_template_changed(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+        self.generate(wallet, 101)
+
+        address = 'tcp://127.0.0.1:{}'.format(randint(20000, 50000))
+        socket = self.ctx.socket(zmq.SUB)
+        socket.set(zmq.RCVTIMEO, 2000)
+        subscriber = ZMQSubscriber(socket, b'blocktemplatechanged')
+
+        self.log.info("Test patched blocktemplatechanged topic")
+        self.restart_node(0, ['-zmqpub%s=%s' %
+                          (subscriber.topic.decode(), address)])
+        socket.connect(address)
+        # Relax so that the subscriber is ready before publishing zmq messages
+        sleep(0.2)
+
+        self.log.info("A new template is published after a transaction entered the mempool")
+        txid = wallet.send_self_transfer(from_node=node)['txid']
+        fee = int(node.getmempoolentry(txid)['fees']['base'] * COIN)
+        assert_equal(self.receive_template(subscriber), (node.getbestblockhash(), 1, fee, fee))
+        assert_equal(node.getblocktemplate({'rules': ['segwit']})['transactions'][0]['txid'], txid)
+
+        self.log.info("A new template is published after the tip changed")
+        tip = self.generate(node, 1)[0]
+        assert_equal(self.receive_template(subscriber), (tip, 0, 0, -fee))
+
+
+if __name__ == '__main__':
+    ZMQTest().main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the ZMQ publisher mempoolhistogram to notify about changes of the
+mempool fee histogram"""
+import struct
+import zmq
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.wallet import MiniWallet
+from time import sleep
+from random import randint
+
+from test_framework.util_patched_zmq import ZMQSubscriber
+
+BUCKET_FORMAT = '<qQqq'  # lower bound, count, vsize, fees
+
+
+def parse_histogram(payload):
+    size = struct.calcsize(BUCKET_FORMAT)
+    assert_equal(len(payload) % size, 0)
+    return [struct.unpack_from(BUCKET_FORMAT, payload, i) for i in range(0, len(payload), size)]
+
+
+class ZMQTest (BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_py3_zmq()
+        self.skip_if_no_bitcoind_zmq()
+
+    def run_test(self):
+        import zmq
+        self.ctx = zmq.Context()
+        try:
+            self.test_mempool_histogram()
+        finally:
+            # Destroy the ZMQ context.
+            self.log.debug("Destroying ZMQ context")
+            self.ctx.destroy(linger=None)
+
+    def test_mempool_histogram(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+        self.generate(wallet, 101)
+
+        address = 'tcp://127.0.0.1:{}'.format(randint(20000, 50000))
+        socket = self.ctx.socket(zmq.SUB)
+        socket.set(zmq.RCVTIMEO, 2000)
+        subscriber = ZMQSubscriber(socket, b'mempoolhistogram')
+
+        self.log.info("Test patched mempoolhistogram topic")
+        self.restart_node(0, ['-zmqpub%s=%s' %
+                          (subscriber.topic.decode(), address)])
+        socket.connect(address)
+        # Relax so that the subscriber is ready before publishing zmq messages
+        sleep(0.2)
+
+        self.log.info("The histogram is published once a transaction entered the mempool")
+        wallet.send_self_transfer(from_node=node)
+        node.mockscheduler(1)
+        expected = [(bucket['from'], bucket['count'], bucket['vsize'], int(bucket['fees'] * 100000000))
+                    for bucket in node.getmempoolfeehistogram()]
+        # The empty mempool may have been published before the transaction arrived.
+        while True:
+            payload, = subscriber.receive_multi_payload()
+            histogram = parse_histogram(payload)
+            if sum(bucket[1] for bucket in histogram) > 0:
+                break
+        assert_equal(histogram, expected)
+
+        self.log.info("An unchanged histogram is not published again")
+        node.mockscheduler(1)
+        try:
+            subscriber.receive_multi_payload()
+            assert False, "unchanged histogram published"
+        except zmq.error.Again as e:
+            self.log.info("ZMQ subscriber timed out as expected: {}".format(e))
+
+
+if __name__ == '__main__':
+    ZMQTest().main()
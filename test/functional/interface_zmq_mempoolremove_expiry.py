@@ -59,6 +59,7 @@ class ZMQTest (BitcoinTestFramework):
 
         self.log.info("Testing removal reason EXPIRY")
         DEFAULT_MEMPOOL_EXPIRY = 336
+        MEMPOOL_EXPIRY_INTERVAL = 60  # seconds
 
         self.log.info("Send a parent transaction that will expire.")
         parent_address = node.getnewaddress()
@@ -88,18 +89,17 @@ class ZMQTest (BitcoinTestFramework):
             "Let most of the timeout elapse and check that the parent tx is still in the mempool.")
         nearly_expiry_time = entry_time + 60 * 60 * DEFAULT_MEMPOOL_EXPIRY - 5
         node.setmocktime(nearly_expiry_time)
-        # Expiry of mempool transactions is only checked when a new transaction
-        # is added to the to the mempool.
-        node.sendtoaddress(node.getnewaddress(), 1.0)
+        # Let the scheduler run the periodic expiry of mempool transactions.
+        node.mockscheduler(MEMPOOL_EXPIRY_INTERVAL)
+        node.syncwithvalidationinterfacequeue()
         assert_equal(entry_time, node.getmempoolentry(parent_txid)["time"])
 
         self.log.info(
             "Transaction should be evicted from the mempool after the expiry time has passed.")
         expiry_time = entry_time + 60 * 60 * DEFAULT_MEMPOOL_EXPIRY + 5
         node.setmocktime(expiry_time)
-        # Expiry of mempool transactions is only checked when a new transaction
-        # is added to the to the mempool.
-        node.sendtoaddress(node.getnewaddress(), 1.0)
+        node.mockscheduler(MEMPOOL_EXPIRY_INTERVAL)
+        node.syncwithvalidationinterfacequeue()
 
         self.log.info(
             "The ZMQ interface should receive two removed transactions (the parent and the child).")
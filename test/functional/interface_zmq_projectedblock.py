@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the ZMQ publisher projectedblock to notify about the transactions
+entering and leaving the projected next block"""
+import struct
+import zmq
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.wallet import MiniWallet
+from time import sleep
+from random import randint
+
+from test_framework.util_patched_zmq import ZMQSubscriber
+
+
+def parse_txids(payload):
+    assert_equal(len(payload) % 32, 0)
+    return sorted(payload[i:i + 32].hex() for i in range(0, len(payload), 32))
+
+
+class ZMQTest (BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_py3_zmq()
+        self.skip_if_no_bitcoind_zmq()
+
+    def run_test(self):
+        import zmq
+        self.ctx = zmq.Context()
+        try:
+            self.test_projected_block()
+        finally:
+            # Destroy the ZMQ context.
+            self.log.debug("Destroying ZMQ context")
+            self.ctx.destroy(linger=None)
+
+    def receive_projected_block(self, subscriber):
+        prev_hash, fees, weight, entered, left = subscriber.receive_multi_payload()
+        return prev_hash.hex(), struct.unpack("<q", fees)[0], struct.unpack("<q", weight)[0], parse_txids(entered), parse_txids(left)
+
+    def test_projected_block(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+        self.generate(wallet, 101)
+
+        address = 'tcp://127.0.0.1:{}'.format(randint(20000, 50000))
+        socket = self.ctx.socket(zmq.SUB)
+        socket.set(zmq.RCVTIMEO, 2000)
+        subscriber = ZMQSubscriber(socket, b'projectedblock')
+
+        self.log.info("Test patched projectedblock topic")
+        self.restart_node(0, ['-zmqpub%s=%s' %
+                          (subscriber.topic.decode(), address)])
+        socket.connect(address)
+        # Relax so that the subscriber is ready before publishing zmq messages
+        sleep(0.2)
+
+        self.log.info("Transactions entering the mempool enter the projected block")
+        txids = sorted(wallet.send_self_transfer(from_node=node)['txid'] for _ in range(2))
+        template = node.getblocktemplate({'rules': ['segwit']})
+        fees = sum(tx['fee'] for tx in template['transactions'])
+        prev_hash, projected_fees, weight, entered, left = self.receive_projected_block(subscriber)
+        # The two transactions may have been picked up by separate rebuilds.
+        if entered != txids:
+            prev_hash, projected_fees, weight, more_entered, left = self.receive_projected_block(subscriber)
+            entered = sorted(entered + more_entered)
+        assert_equal((prev_hash, projected_fees, entered, left), (node.getbestblockhash(), fees, txids, []))
+        assert weight > sum(tx['weight'] for tx in template['transactions'])
+
+        self.log.info("Confirmed transactions leave the projected block")
+        tip = self.generate(node, 1)[0]
+        prev_hash, projected_fees, empty_weight, entered, left = self.receive_projected_block(subscriber)
+        assert_equal((prev_hash, projected_fees, entered, left), (tip, 0, [], txids))
+        assert empty_weight < weight
+
+
+if __name__ == '__main__':
+    ZMQTest().main()
@@ -24,6 +24,8 @@ class MempoolCompatibilityTest(BitcoinTestFramework):
     def set_test_params(self):
         self.num_nodes = 2
         self.wallet_names = [None]
+        # The old node only reads mempool.dat in the legacy format
+        self.extra_args = [[], ["-persistmempoolv1"]]
 
     def skip_test_if_missing_module(self):
         self.skip_if_no_previous_releases()
@@ -69,6 +71,9 @@ class MempoolCompatibilityTest(BitcoinTestFramework):
         unbroadcasted_tx_hash = new_wallet.send_self_transfer(from_node=new_node)['txid']
         assert unbroadcasted_tx_hash in new_node.getrawmempool()
         assert new_node.getmempoolentry(unbroadcasted_tx_hash)['unbroadcast']
+        # The new node keeps its mempool in a journal, which the old node
+        # cannot read, so mempool.dat has to be written explicitly.
+        new_node.savemempool()
         self.stop_node(1)
 
         self.log.info("Move mempool.dat from new to old node")
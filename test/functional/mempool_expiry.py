@@ -22,6 +22,7 @@ from test_framework.wallet import MiniWallet
 
 DEFAULT_MEMPOOL_EXPIRY = 336  # hours
 CUSTOM_MEMPOOL_EXPIRY = 10  # hours
+MEMPOOL_EXPIRY_INTERVAL = 60  # seconds
 
 
 class MempoolExpiryTest(BitcoinTestFramework):
@@ -44,11 +45,6 @@ class MempoolExpiryTest(BitcoinTestFramework):
         parent_utxo = self.wallet.get_utxo(txid=parent_txid)
         independent_utxo = self.wallet.get_utxo()
 
-        # Ensure the transactions we send to trigger the mempool check spend utxos that are independent of
-        # the transactions being tested for expiration.
-        trigger_utxo1 = self.wallet.get_utxo()
-        trigger_utxo2 = self.wallet.get_utxo()
-
         # Set the mocktime to the arrival time of the parent transaction.
         entry_time = node.getmempoolentry(parent_txid)['time']
         node.setmocktime(entry_time)
@@ -68,9 +64,10 @@ class MempoolExpiryTest(BitcoinTestFramework):
         # in the mempool.
         nearly_expiry_time = entry_time + 60 * 60 * timeout - 5
         node.setmocktime(nearly_expiry_time)
-        # Broadcast a transaction as the expiry of transactions in the mempool is only checked
-        # when a new transaction is added to the mempool.
-        self.wallet.send_self_transfer(from_node=node, utxo_to_spend=trigger_utxo1)
+        # Let the scheduler run the periodic expiry of transactions in the
+        # mempool, and wait for it to have finished.
+        node.mockscheduler(MEMPOOL_EXPIRY_INTERVAL)
+        node.syncwithvalidationinterfacequeue()
         self.log.info('Test parent tx not expired after {} hours.'.format(
             timedelta(seconds=(nearly_expiry_time-entry_time))))
         assert_equal(entry_time, node.getmempoolentry(parent_txid)['time'])
@@ -79,8 +76,8 @@ class MempoolExpiryTest(BitcoinTestFramework):
         # has passed.
         expiry_time = entry_time + 60 * 60 * timeout + 5
         node.setmocktime(expiry_time)
-        # Again, broadcast a transaction so the expiry of transactions in the mempool is checked.
-        self.wallet.send_self_transfer(from_node=node, utxo_to_spend=trigger_utxo2)
+        node.mockscheduler(MEMPOOL_EXPIRY_INTERVAL)
+        node.syncwithvalidationinterfacequeue()
         self.log.info('Test parent tx expiry after {} hours.'.format(
             timedelta(seconds=(expiry_time-entry_time))))
         assert_raises_rpc_error(-5, 'Transaction not in mempool',
@@ -4,8 +4,8 @@
 # file COPYING or http://www.opensource.org/licenses/mit-license.php.
 """Test mempool persistence.
 
-By default, bitcoind will dump mempool on shutdown and
-then reload it on startup. This can be overridden with
+By default, bitcoind keeps a journal of the mempool on disk
+and reloads it on startup. This can be overridden with
 the -persistmempool=0 command line option.
 
 Test is as follows:
@@ -28,9 +28,9 @@ Test is as follows:
   - Restart node0 with -persistmempool. Verify that it has 5
     transactions in its mempool. This tests that -persistmempool=0
     does not overwrite a previously valid mempool stored on disk.
-  - Remove node0 mempool.dat and verify savemempool RPC recreates it
-    and verify that node1 can load it and has 5 transactions in its
-    mempool.
+  - Verify that node0 persisted its mempool in mempool.journal, that
+    the savemempool RPC creates mempool.dat and that node1 can load it
+    and has 5 transactions in its mempool.
   - Verify that savemempool throws when the RPC is called if
     node1 can't write to disk.
 
@@ -147,8 +147,9 @@ class MempoolPersistTest(BitcoinTestFramework):
 
         mempooldat0 = os.path.join(self.nodes[0].datadir, self.chain, 'mempool.dat')
         mempooldat1 = os.path.join(self.nodes[1].datadir, self.chain, 'mempool.dat')
-        self.log.debug("Remove the mempool.dat file. Verify that savemempool to disk via RPC re-creates it")
-        os.remove(mempooldat0)
+        self.log.debug("Verify that the mempool is persisted in the journal, and that savemempool to disk via RPC creates mempool.dat")
+        assert os.path.isfile(os.path.join(self.nodes[0].datadir, self.chain, 'mempool.journal'))
+        assert not os.path.exists(mempooldat0)
         result0 = self.nodes[0].savemempool()
         assert os.path.isfile(mempooldat0)
         assert_equal(result0['filename'], mempooldat0)
@@ -64,7 +64,7 @@ class MempoolUnbroadcastTest(BitcoinTestFramework):
         assert rpc_tx_hsh not in mempool
         assert wallet_tx_hsh not in mempool
 
-        # ensure that unbroadcast txs are persisted to mempool.dat
+        # ensure that unbroadcast txs are persisted across restarts
         self.restart_node(0)
 
         self.log.info("Reconnect nodes & check if they are sent to node 1")
@@ -196,9 +196,14 @@ class BaseNode(P2PInterface):
             self.last_message.pop("inv", None)
 
 class SendHeadersTest(BitcoinTestFramework):
+    def add_options(self, parser):
+        parser.add_argument("--msghandthreads", dest="msghandthreads", default=1, type=int,
+                            help="Number of message handler threads the nodes run with")
+
     def set_test_params(self):
         self.setup_clean_chain = True
         self.num_nodes = 2
+        self.extra_args = [[f"-msghandthreads={self.options.msghandthreads}"]] * self.num_nodes
 
     def mine_blocks(self, count):
         """Mine count blocks and return the new tip."""
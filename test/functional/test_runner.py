@@ -117,6 +117,7 @@ BASE_SCRIPTS = [
     'wallet_signer.py --descriptors',
     # vv Tests less than 60s vv
     'p2p_sendheaders.py',
+    'p2p_sendheaders.py --msghandthreads=4',
     'wallet_importmulti.py --legacy-wallet',
     'mempool_limit.py',
     'rpc_txoutproof.py',
@@ -207,6 +208,9 @@ BASE_SCRIPTS = [
     'interface_zmq_chaintipchanged.py',
     'interface_zmq_chainblockconnected.py',
     'interface_zmq_chainheaderadded.py',
+    'interface_zmq_mempoolhistogram.py',
+    'interface_zmq_blocktemplatechanged.py',
+    'interface_zmq_projectedblock.py',
     'wallet_keypool.py --legacy-wallet',
     'wallet_keypool.py --descriptors',
     'wallet_descriptor.py --descriptors',